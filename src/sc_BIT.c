@@ -95,6 +95,7 @@ XSDB_BIT(void *Arg1, void *Arg2)
 	char TCL_File[STRLEN_MAX];
 	char TCL_Args[STRLEN_MAX] = { 0 };
 	char TclCmd[STRLEN_MAX]; /* TCL file and or argument with space delimter */
+	char *Save_Ptr;
 	char *TclFile, *TestBitIndex;
 	int Ret;
 
@@ -110,9 +111,9 @@ XSDB_BIT(void *Arg1, void *Arg2)
 	}
 
 	(void) strcpy(TclCmd, BIT_p->Level[Level].TCL_File);
-	TclFile = strtok(TclCmd, " ");
+	TclFile = strtok_r(TclCmd, " ", &Save_Ptr);
 	(void) sprintf(TCL_File, "%s%s", BIT_PATH, TclFile);
-	TestBitIndex = strtok(NULL, " ");
+	TestBitIndex = strtok_r(NULL, " ", &Save_Ptr);
 	if (strcmp(TclFile, BIT_LOAD_TCL) == 0) {
 		if (TestBitIndex == NULL) {
 			(void) sprintf(TCL_Args, "%s", Board_Name);
@@ -136,7 +137,7 @@ XSDB_BIT(void *Arg1, void *Arg2)
 	}
 
 	if (!BIT_p->Manual) {
-		SC_PRINT("%s: %s", BIT_p->Name, strtok(Output, "\n"));
+		SC_PRINT("%s: %s", BIT_p->Name, strtok_r(Output, "\n", &Save_Ptr));
 	}
 
 	return 0;
@@ -161,30 +162,30 @@ EBM_EEPROM_Check(void *Arg1, __attribute__((unused)) void *Arg2)
 		return -1;
 	}
 
-	FD = open(Daughter_Card->I2C_Bus, O_RDWR);
+	FD = I2C_Open(Daughter_Card->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to open I2C bus %s: %m", Daughter_Card->I2C_Bus);
 		SC_PRINT("%s: FAIL", BIT_p->Name);
 		return -1;
 	}
 
-	if (ioctl(FD, I2C_SLAVE_FORCE, Daughter_Card->I2C_Address) < 0) {
+	if (I2C_Set_Address(FD, Daughter_Card->I2C_Address) != 0) {
 		SC_ERR("failed to configure I2C bus for access to "
 		       "device address %#x: %m", Daughter_Card->I2C_Address);
 		SC_PRINT("%s: FAIL", BIT_p->Name);
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
-	if (read(FD, Buffer, 1) != 1) {
+	if (I2C_Read(FD, Daughter_Card->I2C_Address, Buffer, 1) != 1) {
 		SC_ERR("unable to access EEPROM device %#x",
 		       Daughter_Card->I2C_Address);
 		SC_PRINT("%s: FAIL", BIT_p->Name);
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	SC_PRINT("%s: PASS", BIT_p->Name);
 	return 0;
 }
@@ -215,7 +216,7 @@ DIMM_EEPROM_Check(void *Arg1, __attribute__((unused)) void *Arg2)
 	for (int i = 0; i < DIMMs->Numbers; i++) {
 		DIMM = &DIMMs->DIMM[i];
 		SC_INFO("DIMM: %s", DIMM->Name);
-		FD = open(DIMM->I2C_Bus, O_RDWR);
+		FD = I2C_Open(DIMM->I2C_Bus);
 		if (FD < 0) {
 			SC_ERR("unable to open I2C bus %s: %m", DIMM->I2C_Bus);
 			SC_PRINT("%s: FAIL", BIT_p->Name);
@@ -228,27 +229,47 @@ DIMM_EEPROM_Check(void *Arg1, __attribute__((unused)) void *Arg2)
 		I2C_READ(FD, DIMM->I2C_Address_SPD, 1, Out_Buffer, In_Buffer, Ret);
 		if (Ret != 0) {
 			SC_PRINT("%s: FAIL", BIT_p->Name);
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
 		if (In_Buffer[0] != 0xC) {
 			SC_ERR("DIMM is not DDR4");
 			SC_PRINT("%s: FAIL", BIT_p->Name);
-			(void) close(FD);
+			I2C_Close(FD);
 			return -1;
 		}
 
-		(void) close(FD);
+		I2C_Close(FD);
 	}
 
 	SC_PRINT("%s: PASS", BIT_p->Name);
 	return 0;
 }
 
+typedef struct {
+	Voltage_t	*Regulator;
+	float	Voltage;
+} Regulator_Read_t;
+
+static int
+Read_Regulator(void *Arg)
+{
+	Regulator_Read_t *Read = Arg;
+
+	SC_INFO("Voltage: %s", Read->Regulator->Name);
+	if (Access_Regulator(Read->Regulator, &Read->Voltage, 0) != 0) {
+		SC_ERR("failed to get voltage for %s", Read->Regulator->Name);
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * This routine gets the voltage from a regulator and compares it against
- * expected minimum and maximum values.
+ * expected minimum and maximum values.  Regulators on different buses are
+ * read at the same time.
  */
 int
 Voltages_Check(void *Arg1, __attribute__((unused)) void *Arg2)
@@ -256,6 +277,8 @@ Voltages_Check(void *Arg1, __attribute__((unused)) void *Arg2)
 	BIT_t *BIT_p = Arg1;
 	Voltages_t *Voltages;
 	Voltage_t *Regulator;
+	Regulator_Read_t Reads[LITEMS_MAX];
+	Fanout_Op_t Ops[LITEMS_MAX];
 	float Voltage;
 
 	Remove_BIT_Log();
@@ -266,12 +289,18 @@ Voltages_Check(void *Arg1, __attribute__((unused)) void *Arg2)
 		return -1;
 	}
 
+	for (int i = 0; i < Voltages->Numbers; i++) {
+		Reads[i].Regulator = &Voltages->Voltage[i];
+		Ops[i].Bus = Voltages->Voltage[i].I2C_Bus;
+		Ops[i].Op = Read_Regulator;
+		Ops[i].Arg = &Reads[i];
+	}
+
+	(void) Fanout(Ops, Voltages->Numbers);
 	for (int i = 0; i < Voltages->Numbers; i++) {
 		Regulator = &Voltages->Voltage[i];
-		SC_INFO("Voltage: %s", Regulator->Name);
-		if (Access_Regulator(Regulator, &Voltage, 0) != 0) {
-			SC_ERR("failed to get voltage for %s",
-			    Regulator->Name);
+		Voltage = Reads[i].Voltage;
+		if (Ops[i].Ret != 0) {
 			SC_PRINT("%s: FAIL", BIT_p->Name);
 			return -1;
 		}
@@ -359,6 +388,7 @@ DDRMC_Test(void *Arg1, void *Arg2)
 	BIT_t *BIT_p = Arg1;
 	int *DDRMC = (int *)Arg2;
 	FILE *FP;
+	pid_t PID;
 	char System_Cmd[SYSCMD_MAX];
 	char Buffer[STRLEN_MAX];
 	int Ret = 0;
@@ -376,7 +406,7 @@ DDRMC_Test(void *Arg1, void *Arg2)
 	(void) sprintf(System_Cmd, "cd %s; python3 ddrmc_check.py %d %s 2>&1 | tee %s",
 				Buffer, *DDRMC, Board_Name, BITLOGFILE);
 	SC_INFO("Command: %s", System_Cmd);
-	FP = popen(System_Cmd, "r");
+	FP = Job_Popen(System_Cmd, &PID);
 	if (FP == NULL) {
 		SC_ERR("failed to invoke %s: %m", System_Cmd);
 		Ret = -1;
@@ -388,10 +418,11 @@ DDRMC_Test(void *Arg1, void *Arg2)
 		if ((strstr(Buffer, "ERROR: ") != NULL)) {
 			SC_PRINT_N("%s", Buffer);
 			Ret = -1;
-			(void) pclose(FP);
+			(void) Job_Pclose(FP, PID);
 			goto Out;
 		}
 
+		Job_Progress(Buffer);
 		if ((strstr(Buffer, "Calibration Status: ") != NULL)) {
 			break;
 		}
@@ -404,7 +435,7 @@ DDRMC_Test(void *Arg1, void *Arg2)
 		Ret = -1;
 	}
 
-	(void) pclose(FP);
+	(void) Job_Pclose(FP, PID);
 
 Out:
 	(void) JTAG_Op(0);
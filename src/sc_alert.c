@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <gpiod.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Power Alerts
+ *
+ * The ALERT pin of an INA226 is asserted when the function enabled in its
+ * Mask/Enable register, e.g. by 'setINA226', trips against its Alert
+ * Limit register.  INA226s whose pin is routed to a GPIO line, named by
+ * 'Alert_Label' of their entry in the board JSON, are followed by the
+ * events of the line, the same way presence lines are, rather than by
+ * polling them.  The pin is open-drain, so several INA226s may share a
+ * line.
+ *
+ * Both edges are requested, as the polarity depends on the APOL bit of
+ * each INA226.  On an edge, the Mask/Enable register of every INA226 on
+ * the line is read, which also clears the Alert Function Flag of those
+ * that latch it, and those with the flag set are queued as an alert of
+ * the function they have enabled, along with the reading it's compared
+ * against and the limit.  'watchalert' subscribes the client to alerts,
+ * which are pushed as a line each, until the client sends another
+ * request or hangs up.  The queue keeps the last ALERT_QUEUE_SIZE alerts,
+ * and subscribers that fall further behind are told how many they missed.
+ */
+#define ALERT_LINES_MAX		ITEMS_MAX
+#define ALERT_QUEUE_SIZE	64
+
+/* Mask/Enable register(06h) */
+#define INA226_SOL	(1 << 15)
+#define INA226_AFF	(1 << 4)
+
+typedef enum {
+	ALERT_OVER_CURRENT,
+	ALERT_UNDER_CURRENT,
+	ALERT_OVER_VOLTAGE,
+	ALERT_UNDER_VOLTAGE,
+	ALERT_OVER_POWER,
+} Alert_Cause_t;
+
+/* In the order of the function bits of Mask/Enable, from SOL down */
+static const struct {
+	const char	*Name;
+	const char	*Key;
+	const char	*Label;
+	const char	*Limit_Label;
+} Alert_Causes[] = {
+	{ "over-current", "current", "Current(A)", "Limit(A)", },
+	{ "under-current", "current", "Current(A)", "Limit(A)", },
+	{ "over-voltage", "voltage", "Voltage(V)", "Limit(V)", },
+	{ "under-voltage", "voltage", "Voltage(V)", "Limit(V)", },
+	{ "over-power", "power", "Power(W)", "Limit(W)", },
+};
+
+typedef struct {
+	struct timespec	Time;		/* Of the edge, CLOCK_REALTIME */
+	INA226_t	*INA226;
+	Alert_Cause_t	Cause;
+	float	Value;
+	float	Limit;
+} Alert_t;
+
+typedef struct {
+	const char	*Label;
+	struct gpiod_line	*Line;
+	INA226_t	*INA226[LITEMS_MAX];
+	int	FD[LITEMS_MAX];
+	int	Numbers;
+} Alert_Line_t;
+
+typedef struct Alert_Watch {
+	Request_t	*Request;
+	int	Event_FD;
+	unsigned long	Next;
+	struct Alert_Watch	*Link;
+} Alert_Watch_t;
+
+static pthread_mutex_t Alert_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Alert_t Alert_Queue[ALERT_QUEUE_SIZE];
+static unsigned long Alert_Sequence;
+static Alert_Watch_t *Alert_Watches;
+static Alert_Line_t Alert_Lines[ALERT_LINES_MAX];
+static int Alert_Line_Numbers;
+static Request_t *Alert_Request;
+
+/*
+ * Convert the reading the function of the cause is compared against, or
+ * its limit, which has the same format.
+ */
+static float
+Alert_Value(INA226_t *INA226, Alert_Cause_t Cause, unsigned short Register)
+{
+	switch (Cause) {
+	case ALERT_OVER_CURRENT:
+	case ALERT_UNDER_CURRENT:
+		/* Shunt voltage of 2.5 uV per bit, over micro-Ohms */
+		return ((int16_t)Register * 2.5) / INA226->Shunt_Resistor *
+		       INA226->Phase_Multiplier;
+	case ALERT_OVER_VOLTAGE:
+	case ALERT_UNDER_VOLTAGE:
+		return (Register * 0.00125);
+	case ALERT_OVER_POWER:
+	default:
+		return (Register * INA226->Current_LSB * 25 *
+			INA226->Phase_Multiplier);
+	}
+}
+
+static void
+Alert_Push(const Alert_t *Alert)
+{
+	Alert_Watch_t *Watch;
+
+	(void) pthread_mutex_lock(&Alert_Lock);
+	Alert_Queue[Alert_Sequence % ALERT_QUEUE_SIZE] = *Alert;
+	Alert_Sequence++;
+	for (Watch = Alert_Watches; Watch != NULL; Watch = Watch->Link) {
+		(void) eventfd_write(Watch->Event_FD, 1);
+	}
+
+	(void) pthread_mutex_unlock(&Alert_Lock);
+}
+
+/*
+ * Read the Mask/Enable register of every INA226 on the line, and queue
+ * an alert for each that has tripped.
+ */
+static void
+Alert_Check(Alert_Line_t *Alert_Line, const struct timespec *Time)
+{
+	INA226_t *INA226;
+	I2C_Transaction_t Transaction;
+	unsigned char Buffer[5][2];
+	unsigned short Mask_Enable, Value;
+	Alert_t Alert;
+	int Function;
+
+	Worker_Acquire(Alert_Request);
+	for (int i = 0; i < Alert_Line->Numbers; i++) {
+		INA226 = Alert_Line->INA226[i];
+
+		/* Shunt voltage, bus voltage, power, Mask/Enable, Alert Limit */
+		I2C_Begin(&Transaction);
+		(void) I2C_Add_Read(&Transaction, INA226->I2C_Address, 0x1, 2, Buffer[0]);
+		(void) I2C_Add_Read(&Transaction, INA226->I2C_Address, 0x2, 2, Buffer[1]);
+		(void) I2C_Add_Read(&Transaction, INA226->I2C_Address, 0x3, 2, Buffer[2]);
+		(void) I2C_Add_Read(&Transaction, INA226->I2C_Address, 0x6, 2, Buffer[3]);
+		(void) I2C_Add_Read(&Transaction, INA226->I2C_Address, 0x7, 2, Buffer[4]);
+		if (I2C_Commit(Alert_Line->FD[i], &Transaction) != 0) {
+			SC_ERR("failed to read alert of %s", INA226->Name);
+			continue;
+		}
+
+		Mask_Enable = ((Buffer[3][0] << 8) | Buffer[3][1]);
+		if (!(Mask_Enable & INA226_AFF)) {
+			continue;
+		}
+
+		/* Only the most significant function bit that's set is in effect */
+		for (Function = 0; Function < ALERT_OVER_POWER; Function++) {
+			if (Mask_Enable & (INA226_SOL >> Function)) {
+				break;
+			}
+		}
+
+		if (!(Mask_Enable & (INA226_SOL >> Function))) {
+			continue;
+		}
+
+		Alert.Time = *Time;
+		Alert.INA226 = INA226;
+		Alert.Cause = Function;
+		Value = ((Buffer[Function / 2][0] << 8) | Buffer[Function / 2][1]);
+		Alert.Value = Alert_Value(INA226, Alert.Cause, Value);
+		Value = ((Buffer[4][0] << 8) | Buffer[4][1]);
+		Alert.Limit = Alert_Value(INA226, Alert.Cause, Value);
+		Alert_Push(&Alert);
+	}
+
+	Worker_Release(Alert_Request);
+}
+
+static void *
+Alert_Thread(void *Arg)
+{
+	struct pollfd FDs[ALERT_LINES_MAX];
+	struct gpiod_line_event Event;
+	Alert_Line_t *Alert_Line;
+	struct timespec Time;
+
+	for (int i = 0; i < Alert_Line_Numbers; i++) {
+		FDs[i].fd = gpiod_line_event_get_fd(Alert_Lines[i].Line);
+		FDs[i].events = POLLIN;
+
+		/* Catch up with, and clear, alerts from before sc_appd started */
+		(void) clock_gettime(CLOCK_REALTIME, &Time);
+		Alert_Check(&Alert_Lines[i], &Time);
+	}
+
+	while (1) {
+		if (poll(FDs, Alert_Line_Numbers, -1) < 0) {
+			continue;
+		}
+
+		for (int i = 0; i < Alert_Line_Numbers; i++) {
+			if (!(FDs[i].revents & POLLIN)) {
+				continue;
+			}
+
+			Alert_Line = &Alert_Lines[i];
+			if (gpiod_line_event_read(Alert_Line->Line, &Event) < 0) {
+				SC_ERR("failed to read alert line event");
+				continue;
+			}
+
+			Alert_Check(Alert_Line, &Event.ts);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Request events of the alert line of the INA226, unless another INA226
+ * on the same line already has.  A line that gpiod doesn't know about is
+ * skipped.
+ */
+static void
+Track_Alert(INA226_t *INA226)
+{
+	Alert_Line_t *Alert_Line = NULL;
+	struct gpiod_chip *Chip;
+	struct gpiod_line *Line;
+	char Chip_Name[STRLEN_MAX];
+	unsigned int Offset;
+	int FD;
+
+	for (int i = 0; i < Alert_Line_Numbers; i++) {
+		if (strcmp(Alert_Lines[i].Label, INA226->Alert_Label) == 0) {
+			Alert_Line = &Alert_Lines[i];
+			break;
+		}
+	}
+
+	if (Alert_Line == NULL) {
+		if ((Alert_Line_Numbers == ALERT_LINES_MAX) ||
+		    (gpiod_ctxless_find_line(INA226->Alert_Label, Chip_Name,
+					     STRLEN_MAX, &Offset) != 1)) {
+			return;
+		}
+
+		Chip = gpiod_chip_open_by_name(Chip_Name);
+		if (Chip == NULL) {
+			SC_ERR("failed to open gpio chip %s", Chip_Name);
+			return;
+		}
+
+		Line = gpiod_chip_get_line(Chip, Offset);
+		if ((Line == NULL) ||
+		    (gpiod_line_request_both_edges_events(Line, "sc_appd") == -1)) {
+			SC_ERR("failed to request events of gpio line %s",
+			       INA226->Alert_Label);
+			gpiod_chip_close(Chip);
+			return;
+		}
+
+		Alert_Line = &Alert_Lines[Alert_Line_Numbers++];
+		Alert_Line->Label = INA226->Alert_Label;
+		Alert_Line->Line = Line;
+	}
+
+	FD = I2C_Open(INA226->I2C_Bus);
+	if (FD < 0) {
+		SC_ERR("failed to access I2C bus %s: %m", INA226->I2C_Bus);
+		return;
+	}
+
+	Alert_Line->INA226[Alert_Line->Numbers] = INA226;
+	Alert_Line->FD[Alert_Line->Numbers++] = FD;
+	Add_Resource(Alert_Request, INA226->I2C_Bus);
+}
+
+/*
+ * Get the state of the line if it's one of the alert lines being
+ * followed, as held for events it can't be requested by 'gpioget'.
+ * Returns 1 if the line isn't followed.
+ */
+int
+Alert_Line_State(const char *Label, int *State)
+{
+	for (int i = 0; i < Alert_Line_Numbers; i++) {
+		if (strcmp(Alert_Lines[i].Label, Label) == 0) {
+			*State = gpiod_line_get_value(Alert_Lines[i].Line);
+			if (*State == -1) {
+				SC_ERR("failed to get state of gpio line %s", Label);
+				return -1;
+			}
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Follow the alert lines of the INA226s of the board, if any.
+ */
+int
+Alert_Init(void)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	pthread_t Thread;
+	int Ret;
+
+	for (int i = 0; (INA226s != NULL) && (i < INA226s->Numbers); i++) {
+		if (INA226s->INA226[i].Alert_Label == NULL) {
+			continue;
+		}
+
+		if (Alert_Request == NULL) {
+			Alert_Request = calloc(1, sizeof(Request_t));
+			if (Alert_Request == NULL) {
+				SC_ERR("failed to allocate alert request: %m");
+				return -1;
+			}
+
+			Alert_Request->Priority = PRIORITY_HIGH;
+		}
+
+		Track_Alert(&INA226s->INA226[i]);
+	}
+
+	if (Alert_Line_Numbers == 0) {
+		return 0;
+	}
+
+	Ret = pthread_create(&Thread, NULL, Alert_Thread, NULL);
+	if (Ret != 0) {
+		SC_ERR("failed to create alert thread: %s", strerror(Ret));
+		Alert_Line_Numbers = 0;
+		return -1;
+	}
+
+	(void) pthread_detach(Thread);
+	return 0;
+}
+
+static void
+Alert_Unsubscribe(Alert_Watch_t *Watch)
+{
+	Alert_Watch_t **Link;
+
+	(void) pthread_mutex_lock(&Alert_Lock);
+	for (Link = &Alert_Watches; *Link != NULL; Link = &(*Link)->Link) {
+		if (*Link == Watch) {
+			*Link = Watch->Link;
+			break;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&Alert_Lock);
+	(void) close(Watch->Event_FD);
+}
+
+static void
+Print_Alert(const Alert_t *Alert)
+{
+	char Timestamp[STRLEN_MAX];
+
+	(void) sprintf(Timestamp, "%ld.%06ld", (long)Alert->Time.tv_sec,
+		       (Alert->Time.tv_nsec / 1000));
+	Output_Begin(1);
+	Output_Number("time", NULL, Timestamp);
+	Output_String("name", NULL, Alert->INA226->Name);
+	Output_String("alert", NULL, Alert_Causes[Alert->Cause].Name);
+	Output_Float(Alert_Causes[Alert->Cause].Key, Alert_Causes[Alert->Cause].Label,
+		     4, Alert->Value);
+	Output_Float("limit", Alert_Causes[Alert->Cause].Limit_Label, 4, Alert->Limit);
+	Output_End();
+}
+
+static void *
+Alert_Watch_Thread(void *Arg)
+{
+	Alert_Watch_t *Watch = Arg;
+	Request_t *Request = Watch->Request;
+	Client_t *Client = Request->Client;
+	struct pollfd FDs[2];
+	Alert_t Alerts[ALERT_QUEUE_SIZE];
+	unsigned long Missed;
+	eventfd_t Count;
+	int Numbers;
+
+	SC_Sink = &Client->Sink;
+	FDs[0].fd = Client->FD;
+	FDs[0].events = POLLIN;
+	FDs[1].fd = Watch->Event_FD;
+	FDs[1].events = POLLIN;
+	while (1) {
+		if (poll(FDs, 2, -1) < 0) {
+			continue;
+		}
+
+		/* The client has sent another request, or hung up */
+		if (FDs[0].revents != 0) {
+			break;
+		}
+
+		(void) eventfd_read(Watch->Event_FD, &Count);
+
+		/* Copy the new alerts, so they're printed without the lock */
+		(void) pthread_mutex_lock(&Alert_Lock);
+		Missed = 0;
+		if ((Alert_Sequence - Watch->Next) > ALERT_QUEUE_SIZE) {
+			Missed = (Alert_Sequence - ALERT_QUEUE_SIZE - Watch->Next);
+			Watch->Next = (Alert_Sequence - ALERT_QUEUE_SIZE);
+		}
+
+		for (Numbers = 0; Watch->Next < Alert_Sequence; Numbers++) {
+			Alerts[Numbers] = Alert_Queue[Watch->Next++ % ALERT_QUEUE_SIZE];
+		}
+
+		(void) pthread_mutex_unlock(&Alert_Lock);
+		if (Missed > 0) {
+			Output_Begin(1);
+			Output_Int("missed", "Missed Alerts", Missed);
+			Output_End();
+		}
+
+		for (int i = 0; i < Numbers; i++) {
+			Print_Alert(&Alerts[i]);
+		}
+
+		if (Sink_Flush(&Client->Sink, NULL) != 0) {
+			break;
+		}
+	}
+
+	Alert_Unsubscribe(Watch);
+	SC_Sink = NULL;
+	Client->Status = 0;
+	free(Watch);
+	free(Request);
+	Complete_Request(Client);
+	return NULL;
+}
+
+/*
+ * Called by the event loop for 'watchalert'.  Returns 1 if the
+ * subscription thread now owns the request and the client, or 0 if the
+ * request has been completed here.
+ */
+int
+Alert_Watch_Start(Request_t *Request)
+{
+	Alert_Watch_t *Watch;
+	pthread_t Thread;
+	int Ret;
+
+	if (Alert_Line_Numbers == 0) {
+		SC_ERR("power alerts are not supported");
+		return 0;
+	}
+
+	Watch = calloc(1, sizeof(Alert_Watch_t));
+	if (Watch == NULL) {
+		SC_ERR("failed to allocate alert watch: %m");
+		return 0;
+	}
+
+	Watch->Request = Request;
+	Watch->Event_FD = eventfd(0, (EFD_NONBLOCK | EFD_CLOEXEC));
+	if (Watch->Event_FD == -1) {
+		SC_ERR("failed to create alert watch: %m");
+		free(Watch);
+		return 0;
+	}
+
+	/* Only alerts from now on are pushed */
+	(void) pthread_mutex_lock(&Alert_Lock);
+	Watch->Next = Alert_Sequence;
+	Watch->Link = Alert_Watches;
+	Alert_Watches = Watch;
+	(void) pthread_mutex_unlock(&Alert_Lock);
+
+	Ret = pthread_create(&Thread, NULL, Alert_Watch_Thread, Watch);
+	if (Ret != 0) {
+		SC_ERR("failed to create alert watch thread: %s", strerror(Ret));
+		Alert_Unsubscribe(Watch);
+		free(Watch);
+		return 0;
+	}
+
+	(void) pthread_detach(Thread);
+	return 1;
+}
@@ -6,11 +6,199 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include "sc_app.h"
 
 #define SOCKET_PATH	INSTALLDIR"/.sc_app/socket"
 
+/*
+ * Print the output of a session and strip the response terminators.
+ * Buffer must be NUL-terminated.  Returns -1 if any of the commands
+ * failed, or 0 otherwise.
+ */
+static int
+Session_Output(char *Buffer, int Length)
+{
+	static int In_Status = 0;
+	static char Status[STRLEN_MAX];
+	static int Status_Length = 0;
+	static int Ret = 0;
+	char *End;
+	char Saved;
+	int Body;
+
+	while (Length > 0) {
+		if (In_Status) {
+			if (*Buffer == '\n') {
+				Status[Status_Length] = '\0';
+				if (atoi(Status) != 0) {
+					Ret = -1;
+				}
+
+				In_Status = 0;
+				Status_Length = 0;
+			} else if (Status_Length < (STRLEN_MAX - 1)) {
+				Status[Status_Length++] = *Buffer;
+			}
+
+			Buffer++;
+			Length--;
+			continue;
+		}
+
+		End = memchr(Buffer, SC_EOR, Length);
+		Body = ((End != NULL) ? (End - Buffer) : Length);
+		if (Body > 0) {
+			Saved = Buffer[Body];
+			Buffer[Body] = '\0';
+			if (strstr(Buffer, "ERROR: ") != NULL) {
+				(void) fflush(stdout);
+				fprintf(stderr, "%s", Buffer);
+			} else {
+				fprintf(stdout, "%s", Buffer);
+			}
+
+			Buffer[Body] = Saved;
+		}
+
+		if (End != NULL) {
+			In_Status = 1;
+			Body++;
+		}
+
+		Buffer += Body;
+		Length -= Body;
+	}
+
+	(void) fflush(stdout);
+	return Ret;
+}
+
+/*
+ * Each line read from stdin is sent to sc_appd as the arguments of a
+ * command, e.g. '-c gettemp -t Versal'.  Commands are pipelined, i.e.
+ * a command is sent without waiting for the response of the previous
+ * one, and the connection is kept open until stdin is closed.  Commands
+ * are only sent as far as the socket takes them without blocking, and
+ * responses are read in the meantime, so that neither side waits on
+ * the other with a long script; stdin isn't read while commands are
+ * waiting to be sent.  A line that doesn't fit in the input buffer is
+ * skipped, and fails the session.
+ */
+static int
+Session(int Sock_FD, char *Request)
+{
+	struct pollfd FDs[2];
+	char Input[SYSCMD_MAX];
+	char Pending[4 * (SYSCMD_MAX + STRLEN_MAX)];
+	char InBuffer[SOCKBUF_MAX];
+	char *Newline;
+	int Input_Length = 0;
+	int Pending_Length = 0;
+	int Input_Eof = 0;
+	int Discard = 0;
+	int Failed = 0;
+	int Shut = 0;
+	int Length;
+	int Ret = 0;
+
+	Pending_Length = strlen(Request);
+	(void) memcpy(Pending, Request, Pending_Length);
+	FDs[0].events = POLLIN;
+	FDs[1].fd = Sock_FD;
+	while (1) {
+		/* Queue the complete lines of input, as long as there's room */
+		Input[Input_Length] = '\0';
+		while ((Pending_Length <= (sizeof(Pending) - SYSCMD_MAX - STRLEN_MAX)) &&
+		       (((Newline = strchr(Input, '\n')) != NULL) ||
+			(Input_Eof && (Input_Length > 0)) ||
+			(Input_Length == (SYSCMD_MAX - 1)))) {
+			if (Newline != NULL) {
+				*Newline = '\0';
+			}
+
+			if (Discard) {
+				/* The rest of a line that's too long */
+			} else if ((Newline == NULL) && !Input_Eof) {
+				fprintf(stderr, "ERROR: command is longer than %d "
+					"characters\n", (SYSCMD_MAX - 2));
+				Failed = 1;
+			} else if (Input[0] != '\0') {
+				Pending_Length += sprintf(&Pending[Pending_Length],
+							  "sc_app %s\n", Input);
+			}
+
+			Discard = ((Newline == NULL) && !Input_Eof);
+
+			Length = ((Newline != NULL) ?
+				  (Newline - Input + 1) : Input_Length);
+			Input_Length -= Length;
+			(void) memmove(Input, &Input[Length], Input_Length);
+			Input[Input_Length] = '\0';
+		}
+
+		/* Let sc_appd close the session once stdin is exhausted */
+		if (Input_Eof && (Input_Length == 0) && (Pending_Length == 0) &&
+		    !Shut) {
+			(void) shutdown(Sock_FD, SHUT_WR);
+			Shut = 1;
+		}
+
+		FDs[0].fd = ((!Input_Eof && (Input_Length < (SYSCMD_MAX - 1))) ?
+			     STDIN_FILENO : -1);
+		FDs[1].events = (POLLIN | ((Pending_Length > 0) ? POLLOUT : 0));
+		if (poll(FDs, 2, -1) == -1) {
+			fprintf(stderr, "ERROR: failed to call poll(2): %m\n");
+			return -1;
+		}
+
+		if (FDs[1].revents & ~POLLOUT) {
+			Length = recv(Sock_FD, InBuffer, (SOCKBUF_MAX - 1), 0);
+			if (Length == -1) {
+				fprintf(stderr, "ERROR: failed to receive output "
+					"from sc_appd: %m\n");
+				return -1;
+			}
+
+			if (Length == 0) {
+				break;
+			}
+
+			InBuffer[Length] = '\0';
+			Ret = Session_Output(InBuffer, Length);
+		}
+
+		if (FDs[1].revents & POLLOUT) {
+			Length = send(Sock_FD, Pending, Pending_Length, MSG_DONTWAIT);
+			if ((Length == -1) && (errno != EAGAIN) && (errno != EINTR)) {
+				fprintf(stderr, "ERROR: failed to send command to "
+					"sc_appd: %m\n");
+				return -1;
+			}
+
+			if (Length > 0) {
+				Pending_Length -= Length;
+				(void) memmove(Pending, &Pending[Length], Pending_Length);
+			}
+		}
+
+		if (FDs[0].revents != 0) {
+			Length = read(STDIN_FILENO, &Input[Input_Length],
+				      (SYSCMD_MAX - 1 - Input_Length));
+			if (Length > 0) {
+				Input_Length += Length;
+			} else if ((Length == 0) || (errno != EINTR)) {
+				Input_Eof = 1;
+			}
+		}
+	}
+
+	return (Failed ? -1 : Ret);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -59,6 +247,18 @@ main(int argc, char **argv)
 		}
 	}
 
+	/* A newline marks the end of the request */
+	OutBuffer[MIN(strlen(OutBuffer), (SYSCMD_MAX - 2))] = '\n';
+
+	for (int i = 1; i < (argc - 1); i++) {
+		if ((strcmp(argv[i], "-c") == 0) &&
+		    (strcmp(argv[i + 1], "session") == 0)) {
+			Ret = Session(Sock_FD, OutBuffer);
+			(void) close(Sock_FD);
+			return Ret;
+		}
+	}
+
 	if (send(Sock_FD, OutBuffer, strlen(OutBuffer), 0) == -1) {
 		fprintf(stderr, "ERROR: failed to send command to sc_appd: %m\n");
 		return -1;
@@ -76,6 +276,8 @@ main(int argc, char **argv)
 				Ret = 0;
 			}
 
+			/* Output may be streamed, e.g. by 'watch' */
+			(void) fflush(stdout);
 			continue;
 		} else if (Recv_Length == -1) {
 			fprintf(stderr, "ERROR: failed to receive output "
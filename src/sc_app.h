@@ -35,6 +35,7 @@
 #define IDT8A34001FILE	Appfile("8A34001")
 #define PDIFILE		Appfile("PDI")
 #define BITLOGFILE	Appfile("BIT.log")
+#define SIMFILE		Appfile("simulator")
 
 #define BIT_PATH	INSTALLDIR"/BIT/"
 #define BOARD_PATH	INSTALLDIR"/board/"
@@ -47,33 +48,65 @@
 
 #define SC_INFO(msg, ...) fprintf(stdout, msg "\n", ##__VA_ARGS__);
 #define SC_ERR(msg, ...) do { \
-		extern int Client_FD; \
-		extern char Sock_OutBuffer[]; \
 		fprintf(stderr, "ERROR: " msg "\n", ##__VA_ARGS__); \
-		if (Client_FD) { \
-			sprintf(Sock_OutBuffer, "ERROR: " msg "\n", ##__VA_ARGS__); \
-			send(Client_FD, Sock_OutBuffer, strlen(Sock_OutBuffer), MSG_NOSIGNAL); \
-		} \
+		Sink_Printf("ERROR: " msg "\n", ##__VA_ARGS__); \
 	} while (0)
 #define SC_PRINT(msg, ...) do { \
-		extern int Client_FD; \
-		extern char Sock_OutBuffer[]; \
 		fprintf(stdout, msg "\n", ##__VA_ARGS__); \
-		if (Client_FD) { \
-			sprintf(Sock_OutBuffer, msg "\n", ##__VA_ARGS__); \
-			send(Client_FD, Sock_OutBuffer, strlen(Sock_OutBuffer), MSG_NOSIGNAL); \
-		} \
+		Sink_Printf(msg "\n", ##__VA_ARGS__); \
 	} while (0)
 #define SC_PRINT_N(msg, ...) do { \
-		extern int Client_FD; \
-		extern char Sock_OutBuffer[]; \
 		fprintf(stdout, msg, ##__VA_ARGS__); \
-		if (Client_FD) { \
-			sprintf(Sock_OutBuffer, msg, ##__VA_ARGS__); \
-			send(Client_FD, Sock_OutBuffer, strlen(Sock_OutBuffer), MSG_NOSIGNAL); \
-		} \
+		Sink_Printf(msg, ##__VA_ARGS__); \
 	} while (0)
 
+/*
+ * Output Sinks
+ *
+ * Output of a request is buffered in the sink of its client, and is
+ * sent once the command completes or the buffer fills up.  The event
+ * loop doesn't wait for a client to take its output, which is then kept
+ * in the sink until the client is ready for more, and other threads wait
+ * for up to SINK_TIMEOUT before dropping the client, so that one that
+ * stops reading doesn't keep a worker and its resources forever.  A sink
+ * with a drain, e.g. that of a job, hands off its output as it's
+ * appended.
+ *
+ * A sink in JSON format wraps the output of a request in an object:
+ *
+ *	{"output":[<item>,...],"status":<status>}
+ *
+ * where an item is a record of typed fields emitted by Output_Begin(),
+ * Output_Float(), etc., a line of text printed by any other means as a
+ * string, or an error as {"error":"<message>"}.  Console output is text
+ * either way.
+ */
+#define SINK_FLUSH_SIZE	(16 * SOCKBUF_MAX)
+#define SINK_TIMEOUT	10000	/* In milliseconds */
+
+typedef enum {
+	OUTPUT_TEXT,
+	OUTPUT_JSON,
+} Output_Format_t;
+
+typedef struct Sink {
+	int	FD;
+	char	*Buffer;
+	size_t	Length;
+	size_t	Size;
+	void	(*Drain)(struct Sink *);
+	void	*Data;
+	Output_Format_t	Format;
+	int	Open;		/* The output object has been started */
+	int	Items;
+	int	In_Text;	/* In the middle of a line of text or an error */
+} Sink_t;
+
+extern __thread Sink_t *SC_Sink;
+extern __thread int Sink_No_Wait;
+
+void Sink_Printf(const char *, ...) __attribute__((format(printf, 1, 2)));
+
 /*
  * Feature List
  */
@@ -133,7 +166,22 @@ typedef struct {
 
 /*
  * INA226
+ *
+ * Calibration and Current_LSB are computed from Shunt_Resistor and
+ * Maximum_Current when the board is parsed, and Calibrated tells whether
+ * Calibration is known to be programmed, see Measure_INA226().
+ *
+ * Conversion_Time, of both shunt and bus voltage, and Averaging are those
+ * the INA226 is configured with for continuous sampling, see sc_energy.c,
+ * and may be given in the board JSON as one of the values below.
+ * Alert_Label, also optional, is the GPIO line of its ALERT pin, see
+ * sc_alert.c.
  */
+#define INA226_CONVERSION_TIMES	140, 204, 332, 588, 1100, 2116, 4156, 8244
+#define INA226_AVERAGES		1, 4, 16, 64, 128, 256, 512, 1024
+#define INA226_CONVERSION_TIME	1100	/* In microseconds */
+#define INA226_AVERAGING	64
+
 typedef struct {
 	char	*Name;
 	char	*I2C_Bus;
@@ -141,6 +189,12 @@ typedef struct {
 	int	Shunt_Resistor;
 	int	Maximum_Current;
 	int	Phase_Multiplier;
+	unsigned short	Calibration;
+	float	Current_LSB;	/* In Amps */
+	int	Calibrated;
+	int	Conversion_Time;	/* In microseconds */
+	int	Averaging;
+	char	*Alert_Label;
 } INA226_t;
 
 typedef struct INA226s {
@@ -246,6 +300,7 @@ typedef struct {
 	char	*I2C_Bus;
 	int	I2C_Address;
 	int	Presence_Boundary_Scan;
+	char	*Presence_Label;	/* Active low, optional */
 } SFP_t;
 
 typedef struct SFPs {
@@ -273,6 +328,25 @@ typedef struct FMCs {
 	FMC_t	FMC[ITEMS_MAX];
 } FMCs_t;
 
+/*
+ * I2C Buses
+ *
+ * Adapter settings of a bus, applied when it's first opened: the timeout
+ * of a transfer in milliseconds, which the adapter rounds up to 10 ms
+ * units, and how many times a transfer is retried when the device
+ * doesn't acknowledge.
+ */
+typedef struct {
+	char	*I2C_Bus;
+	int	Timeout;
+	int	Retries;
+} I2C_Config_t;
+
+typedef struct I2C_Configs {
+	int	Numbers;
+	I2C_Config_t	I2C_Config[ITEMS_MAX];
+} I2C_Configs_t;
+
 /*
  * Workarounds
  */
@@ -405,11 +479,149 @@ typedef struct {
 	Daughter_Card_t	*Daughter_Card;
 	SFPs_t		*SFPs;
 	FMCs_t		*FMCs;
+	I2C_Configs_t	*I2C_Configs;
 	Workarounds_t	*Workarounds;
 	BITs_t		*BITs;
 	Constraints_t	*Constraints;
 } Plat_Devs_t;
 
+/*
+ * Command Statistics
+ *
+ * Latencies are recorded per command and stage of a request.  Requests
+ * that don't name a valid command are recorded as STATS_INVALID, while
+ * STATS_NONE isn't recorded at all.
+ */
+#define STATS_INVALID	-1
+#define STATS_NONE	-2
+
+typedef enum {
+	STATS_PARSE,
+	STATS_PRE_OPS,
+	STATS_OPS,
+	STATS_SEND,
+	STATS_TOTAL,
+	STATS_STAGES,
+} Stats_Stage_t;
+
+/*
+ * Client Connections
+ *
+ * CmdId and Start are those of the request being served, for statistics,
+ * and Line is the request as it was received, while recording.  Pending
+ * is set while the client has yet to take output that's kept in Sink,
+ * and Discard while the rest of a request that's too long is dropped.
+ */
+typedef struct {
+	int	FD;
+	int	Session;
+	int	Eof;
+	int	Pending;
+	int	Discard;
+	int	Status;
+	int	CmdId;
+	long long	Start;
+	Output_Format_t	Format;	/* Default of the session */
+	Sink_t	Sink;
+	int	Length;
+	char	Buffer[SYSCMD_MAX];
+	char	Request[SYSCMD_MAX];
+	char	Line[SYSCMD_MAX];
+} Client_t;
+
+/*
+ * Requests
+ *
+ * Context of a command from the time it's parsed until it completes
+ * on a worker thread.  Resources name what the command may access, i.e.
+ * I2C bus device paths, the JTAG chain, GPIO lines, or config files.
+ * The output of the command goes to Sink, which is that of the client,
+ * or that of the job if the command runs in the background.  Priority
+ * orders the requests waiting for a worker, and Queued is when the
+ * request was queued, in Stats_Time().
+ */
+#define RESOURCES_MAX	32
+#define RESOURCE_ALL	"*"
+#define RESOURCE_JTAG	"jtag"
+#define RESOURCE_GPIO	"gpio"
+
+typedef enum {
+	PRIORITY_BULK = -1,	/* e.g. EEPROM dumps and clock programming */
+	PRIORITY_NORMAL,
+	PRIORITY_HIGH,		/* e.g. reading sensors */
+} Priority_t;
+
+#define PRIORITIES	3
+
+struct Job;
+
+typedef struct Request {
+	Client_t	*Client;
+	struct Job	*Job;
+	Sink_t	*Sink;
+	int	Status;
+	int	CmdId;
+	int	(*CmdOps)(struct Request *);
+	char	Command_Arg[STRLEN_MAX];
+	char	Target_Arg[STRLEN_MAX];
+	char	Value_Arg[LSTRLEN_MAX];
+	int	C_Flag;
+	int	T_Flag;
+	int	V_Flag;
+	int	A_Flag;
+	int	O_Flag;
+	Output_Format_t	Format;
+	Priority_t	Priority;
+	long long	Queued;
+	int	Held;
+	int	Yielded;
+	int	Resource_Numbers;
+	char	Resources[RESOURCES_MAX][STRLEN_MAX];
+	struct Request	*Next;
+} Request_t;
+
+/*
+ * Sensors
+ *
+ * A sensor is a device in Plat_Devs that is sampled periodically, e.g.
+ * by 'watch' or the telemetry publisher.  Sensor_Read() returns the
+ * readings of the sensor in Value, in this order:
+ *
+ *	SENSOR_POWER		voltage (V), current (A), power (W)
+ *	SENSOR_VOLTAGE		voltage (V)
+ *	SENSOR_TEMPERATURE	temperature (C)
+ *	SENSOR_DIMM		temperature (C)
+ *	SENSOR_SFP		temperature (C), supply voltage (V)
+ *
+ * A sensor the board reads through a 'Terminate' constraint, see
+ * Sensor_Constrained(), is left to that command and isn't sampled.
+ */
+#define SENSOR_VALUES_MAX	3
+
+typedef enum {
+	SENSOR_POWER,
+	SENSOR_VOLTAGE,
+	SENSOR_TEMPERATURE,
+	SENSOR_DIMM,
+	SENSOR_SFP,
+} Sensor_Type_t;
+
+typedef struct {
+	Sensor_Type_t	Type;
+	const char	*Name;
+	const char	*I2C_Bus;
+	void	*Device;
+	int	FD;
+	int	Exponent;	/* Regulator */
+	SFP_Type	Module;	/* SFP */
+} Sensor_t;
+
+/*
+ * In a session, each response is terminated by a record separator
+ * followed by the status of the command and a newline.
+ */
+#define SC_EOR		'\036'
+
 #define I2C_READ_BYTES(FD, Address, OutLen, InLen, Out, In, Return) \
 { \
 	struct i2c_msg Msgs[2]; \
@@ -424,7 +636,7 @@ typedef struct {
 	Msgs[1].buf = (__u8 *)(In); \
 	Msgset[0].msgs = Msgs; \
 	Msgset[0].nmsgs = 2; \
-	if (ioctl((FD), I2C_RDWR, &Msgset) < 0) { \
+	if (I2C_Transfer((FD), Msgset) < 0) { \
 		SC_ERR("unable to read from I2C device %#x: %m", (Address)); \
 		(Return) = -1; \
 	} \
@@ -437,16 +649,91 @@ typedef struct {
 
 #define I2C_WRITE(FD, Address, Len, Out, Return) \
 { \
-	if (ioctl((FD), I2C_SLAVE_FORCE, (Address)) < 0) { \
+	if (I2C_Set_Address((FD), (Address)) != 0) { \
 		SC_ERR("unable to access I2C device %#x: %m", (Address)); \
 		(Return) = -1; \
 	} \
-	if ((Return) == 0 && write((FD), (Out), (Len)) != (Len)) { \
+	if ((Return) == 0 && I2C_Write((FD), (Address), (Out), (Len)) != (Len)) { \
 		SC_ERR("unable to write to I2C device %#x: %m", (Address)); \
 		(Return) = -1; \
 	} \
 }
 
+/*
+ * I2C Transactions
+ *
+ * Register reads, i.e. a write of the register address followed by a
+ * read of its value, batched into a single I2C_RDWR ioctl.
+ */
+#define I2C_TRANSACTION_MAX	(I2C_RDWR_IOCTL_MAX_MSGS / 2)
+
+typedef struct {
+	int	Numbers;	/* Of messages */
+	struct i2c_msg	Msgs[2 * I2C_TRANSACTION_MAX];
+	unsigned char	Register[I2C_TRANSACTION_MAX];
+} I2C_Transaction_t;
+
+/*
+ * I2C Backends
+ *
+ * The system calls on I2C bus devices, which go to the kernel unless the
+ * devices are simulated, see sc_simulator.c.
+ */
+typedef struct {
+	int	(*Open)(const char *);
+	int	(*Close)(int);
+	int	(*Ioctl)(int, unsigned long, unsigned long);
+	ssize_t	(*Read)(int, void *, size_t);
+	ssize_t	(*Write)(int, const void *, size_t);
+} I2C_Backend_t;
+
+/* Location of the onboard EEPROM in simulation */
+#define SIM_EEPROM_BUS		"/dev/i2c-sim"
+#define SIM_EEPROM_ADDRESS	0x54
+
+/*
+ * Record and Replay
+ *
+ * Interactions other than I2C ones that are recorded, see sc_record.c.
+ */
+typedef enum {
+	RECORD_GPIO_GET,
+	RECORD_GPIO_SET,
+	RECORD_PROCESS,
+} Record_Event_t;
+
+/*
+ * Fan-out
+ *
+ * An operation on a device, to be run along with the operations on the
+ * devices of other I2C buses, see Fanout().  Ret is what Op returned.
+ */
+typedef struct {
+	const char	*Bus;
+	int	(*Op)(void *);
+	void	*Arg;
+	int	Ret;
+} Fanout_Op_t;
+
+/*
+ * Presence Map
+ *
+ * Whether a module is plugged into each SFP cage and FMC connector, as
+ * last seen by a probe of its I2C device or by its presence GPIO line.
+ */
+typedef enum {
+	PRESENCE_SFP,
+	PRESENCE_FMC,
+	PRESENCE_FAMILIES,
+} Presence_Family_t;
+
+typedef enum {
+	PRESENCE_UNKNOWN = -1,
+	PRESENCE_ABSENT,
+	PRESENCE_PRESENT,
+} Presence_t;
+
+#define PMBUS_PAGE			0x0
 #define PMBUS_OPERATION			0x1
 #define PMBUS_VOUT_MODE			0x20
 #define PMBUS_VOUT_COMMAND		0x21
@@ -477,6 +764,7 @@ typedef struct {
 
 #define MAX(x, y)	(((x) > (y)) ? (x) : (y))
 #define MIN(x, y)	(((x) < (y)) ? (x) : (y))
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
 
 /*
  * Function Declarations
@@ -484,10 +772,23 @@ typedef struct {
 char *Appfile(char *);
 int Access_IO_Exp(IO_Exp_t *, int, int, unsigned int *);
 int Access_Regulator(Voltage_t *, float *, int);
+void Add_Resource(Request_t *, const char *);
+int Alert_Init(void);
+int Alert_Line_State(const char *, int *);
+int Alert_Watch_Start(Request_t *);
 int Assert_Reset(void *, void *);
 int Board_Identification(char *);
 int Boot_Config_PDI(char *);
+int Calibrate_INA226(int, INA226_t *);
+void Calibrate_INA226s(void);
+int Capture_Start(Request_t *);
+int Capture_Stop(void);
+int Capture_Summary(void);
 int Check_Config_File(char *, char *, int *);
+const char *Command_Name(int);
+void Close_Client(Client_t *);
+void Complete_Request(Client_t *);
+int Constraint_Terminates(const char *, const char *);
 int Clocks_Check(void *, void *);
 int DDRMC_1_Test(void *, void *);
 int DDRMC_2_Test(void *, void *);
@@ -499,29 +800,121 @@ int EBM_EEPROM_Check(void *, void *);
 int EEPROM_Common(char *);
 int EEPROM_Board(char *, int);
 int EEPROM_MultiRecord(char *, int);
+int Energy_Init(void);
+int Energy_Print(const char *);
+void Energy_Reset(void);
+int Export_Init(void);
 int FMCAutoVadj_Op(void);
+int Fanout(Fanout_Op_t *, int);
 int Get_BootMode(int);
 int Get_GPIO(char *, int *);
 int Get_IDCODE(char *, int);
 int Get_IDT_8A34001(Clock_t *);
 int Get_Measured_Clock(char *, char *);
 int Get_Measured_IDT_8A34001(Clock_t *);
+int Get_Power(INA226_t *, int, float *, float *, float *);
 int Get_Temperature(Temperature_t *);
+int I2C_Add_Read(I2C_Transaction_t *, int, int, int, void *);
+void I2C_Begin(I2C_Transaction_t *);
+void I2C_Close(int);
+int I2C_Commit(int, I2C_Transaction_t *);
+void I2C_Count_Saved(const char **, int, const int *);
+void I2C_Export(void);
+void I2C_Init(void);
+int I2C_Open(const char *);
+void I2C_Order(const char **, int, int *);
+void I2C_Print_Stats(const char *);
+void I2C_Print_Trace(void);
+ssize_t I2C_Read(int, int, void *, size_t);
+void I2C_Reset_Stats(void);
+int I2C_Same_Root(const char *, const char *);
+int I2C_Set_Address(int, int);
+const I2C_Backend_t *I2C_Set_Backend(const I2C_Backend_t *);
+int I2C_Trace(int);
+int I2C_Transfer(int, struct i2c_rdwr_ioctl_data *);
+ssize_t I2C_Write(int, int, const void *, size_t);
+int Job_Cancel(const char *);
+int Job_Create(Request_t *);
+void Job_Finish(Request_t *);
+int Job_Pclose(FILE *, pid_t);
+FILE *Job_Popen(const char *, pid_t *);
+void Job_Progress(const char *);
+int Job_Start(Request_t *);
+int Job_Status(const char *);
+int Job_Wait(Request_t *);
 int JTAG_Op(int);
+int Measure_INA226(int, INA226_t *, int, float *, float *, float *);
+void Output_Begin(int);
+void Output_Close(Sink_t *, int);
+void Output_End(void);
+void Output_Float(const char *, const char *, int, double);
+void Output_Hex(const char *, const char *, unsigned int);
+void Output_Int(const char *, const char *, long long);
+void Output_Number(const char *, const char *, const char *);
+void Output_String(const char *, const char *, const char *);
+int PMBus_Get_Mode(Voltage_t *, unsigned char *);
+void PMBus_Invalidate(Voltage_t *);
+int PMBus_Select_Page(int, Voltage_t *, int);
+void PMBus_Set_Mode(Voltage_t *, unsigned char);
 int Parse_JSON(const char *, Plat_Devs_t *);
+Presence_t Presence_Get(Presence_Family_t, int);
+int Presence_Init(void);
+int Presence_Line_State(const char *, int *);
+void Presence_Set(Presence_Family_t, int, Presence_t);
+Presence_t Probe_FMC(int);
+Presence_t Probe_SFP(int);
+int Process_Request(Client_t *);
+int Publish_Init(void);
 int QSFP_ModuleSelect(SFP_t *, int);
+void Record_Command(Client_t *);
+void Record_Event(Record_Event_t, const char *, int, int, long long);
+int Record_Init(const char *);
+void Record_Request(Client_t *);
+int Replay_Active(void);
+int Replay_Event(Record_Event_t, const char *, int *);
+int Replay_Init(char *, OnBoard_EEPROM_t *);
+int Replay_Start(void);
 int Reset_IDT_8A34001(void);
 int Reset_Op(void);
 int Restore_IDT_8A34001(Clock_t *);
+void Run_Request(Request_t *);
+void Sensor_Close(Sensor_t *, int);
+int Sensor_Constrained(Sensor_Type_t, const char *);
+int Sensor_Open(Sensor_t *, int);
+int Sensor_Read(Sensor_t *, float *);
+int Sensor_Setup(Sensor_t *);
 int Set_AltBootMode(int);
 int Set_BootMode(BootMode_t *, int);
 int Set_GPIO(char *, int);
 int Set_IDT_8A34001(Clock_t *, char *, int);
 int Shell_Execute(char *);
+int Sink_Flush(Sink_t *, const char *);
+void Sink_Free(Sink_t *);
+void Sink_Init(Sink_t *, int);
+int Sink_Write(Sink_t *, const char *, size_t);
+int Server_Loop(int);
 int Silicon_Identification(char *, int);
+int Sim_Init(const char *);
+void Stats_Complete(int, int, long long);
+void Stats_Export(void);
+int Stats_Init(int);
+void Stats_Print(int, const char *, int);
+void Stats_Record(int, Stats_Stage_t, long long);
+void Stats_Reset(int);
+long long Stats_Time(void);
 int VCK190_ES1_Vccaux_Workaround(void *);
 int VCK190_QSFP_ModuleSelect(SFP_t *, int);
 int Voltages_Check(void *, void *);
+int Watch_Start(Request_t *);
+void Worker_Acquire(Request_t *);
+int Worker_Cancel(Request_t *);
+void Worker_Export(void);
+int Worker_Init(void);
+void Worker_Print(void);
+void Worker_Release(Request_t *);
+void Worker_Reset(void);
+void Worker_Submit(Request_t *);
+void Worker_Yield(void);
 int XSDB_BIT(void *, void *);
 int XSDB_Op(const char *, const char *, char *, int);
 
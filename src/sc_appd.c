@@ -46,40 +46,65 @@
  * 1.21 - Added support for BIT description.
  * 1.22 - Added 'get measuredclock' command to get frequency measured by a counter.
  * 1.23 - Added 'listFMCvoltage' command to list rail info providing power to FMCs.
+ * 1.24 - Serve multiple clients concurrently from an event loop.
+ * 1.25 - Added 'session' command for persistent, pipelined connections.
+ * 1.26 - Added '-a' option and 'job*' commands to run commands in the background.
+ * 1.27 - Added 'watch' command to stream sensor readings.
+ * 1.28 - Publish sensor telemetry in a shared memory segment.
+ * 1.29 - Added 'stats' command to get latency statistics of commands.
+ * 1.30 - Added optional OpenMetrics exporter of telemetry and statistics.
+ * 1.31 - Added '-o' option to get the output of commands in JSON.
+ * 1.32 - Added 'i2cstats' and 'i2ctrace' commands to profile I2C transfers.
+ * 1.33 - Added I2C bus timeouts and a presence map of modules.
+ * 1.34 - Added simulator of the devices of the board.
+ * 1.35 - Added recording and replay of device traffic.
+ * 1.36 - Added 'powerstats' command to get energy and power statistics of rails.
+ * 1.37 - Added 'getpower all' snapshot of every rail and power domain.
+ * 1.38 - Added 'starttrace', 'stoptrace', and 'tracesummary' commands to capture
+ *	  power traces to a file.
+ * 1.39 - Added 'watchalert' command to stream INA226 alerts.
  */
 #define MAJOR	1
-#define MINOR	23
+#define MINOR	39
 
 #define GPIOLINE	"ZU4_TRIGGER"
 
-int Client_FD;
-char Sock_OutBuffer[SOCKBUF_MAX];
 char Board_Name[LSTRLEN_MAX];
 char Silicon_Revision[STRLEN_MAX];
 extern Plat_Devs_t *Plat_Devs;
 
-int Parse_Options(int, char **);
-int Constraint_Pre_Ops(void);
-int Version_Ops(void);
-int Board_Ops(void);
-int BootMode_Ops(void);
-int Feature_Ops(void);
-int EEPROM_Ops(void);
-int Temperature_Ops(void);
-int Clock_Ops(void);
-int Voltage_Ops(void);
-int INA226_Ops(void);
-int Power_Ops(void);
-int Power_Domain_Ops(void);
-int Workaround_Ops(void);
-int BIT_Ops(void);
-int DDR_Ops(void);
-int GPIO_Ops(void);
-int IO_Exp_Ops(void);
-int SFP_Ops(void);
-int EBM_Ops(void);
-int FMC_Ops(void);
-int PDI_Ops(void);
+int Parse_Options(Request_t *, int, char **);
+int Constraint_Pre_Ops(Request_t *);
+int Reset_Ops(Request_t *);
+int Version_Ops(Request_t *);
+int Session_Ops(Request_t *);
+int Job_Ops(Request_t *);
+int Stats_Ops(Request_t *);
+int I2C_Stats_Ops(Request_t *);
+int I2C_Trace_Ops(Request_t *);
+int Board_Ops(Request_t *);
+int BootMode_Ops(Request_t *);
+int Feature_Ops(Request_t *);
+int EEPROM_Ops(Request_t *);
+int Temperature_Ops(Request_t *);
+int Clock_Ops(Request_t *);
+int Voltage_Ops(Request_t *);
+int INA226_Ops(Request_t *);
+int Power_Ops(Request_t *);
+int Power_Stats_Ops(Request_t *);
+int Power_Trace_Ops(Request_t *);
+int Power_Snapshot(void);
+int Power_Domain_Ops(Request_t *);
+int Watch_Ops(Request_t *);
+int Workaround_Ops(Request_t *);
+int BIT_Ops(Request_t *);
+int DDR_Ops(Request_t *);
+int GPIO_Ops(Request_t *);
+int IO_Exp_Ops(Request_t *);
+int SFP_Ops(Request_t *);
+int EBM_Ops(Request_t *);
+int FMC_Ops(Request_t *);
+int PDI_Ops(Request_t *);
 int (*Workaround_Op)(void *);
 int FMC_Autodetect_Vadj(void);
 int Boot_Set_Clocks(void);
@@ -88,13 +113,31 @@ int Boot_Load_PDI(void);
 int Apply_Workarounds(void);
 int IO_Exp_Initialized(void);
 static void String_2_Argv(char *, int *, char **);
+static Constraint_t *Find_Constraint(const char *, const char *, const char *);
 
 static char Usage[] = "\n\
-sc_app -c <command> [-t <target> [-v <value>]]\n\n\
+sc_app -c <command> [-t <target> [-v <value>]] [-a] [-o <format>]\n\n\
+	-a - run <command> in the background and return its job ID\n\
+	-o - output <format> of either 'text', the default, or 'json'; for\n\
+	     'session', the default of the commands that follow\n\n\
 <command>:\n\
 	version - version and build information\n\
 	board - name of the board\n\
 	reset - apply power-on-reset\n\
+	session - keep the connection open and run commands read from stdin\n\
+\n\
+	jobstatus - get the state and output so far of <target> job, or list all jobs\n\
+	jobwait - wait for <target> job to end while streaming its output\n\
+	jobcancel - cancel <target> job\n\
+\n\
+	stats - get latency statistics of all commands and of the request\n\
+		queues, or in detail of <target> command, or reset them with\n\
+		<value> of 'reset'\n\
+	i2cstats - get I2C transfer statistics of each device and switches of\n\
+		each mux, or of the devices on <target> bus, or reset them\n\
+		with <value> of 'reset'\n\
+	i2ctrace - get the trace of the last I2C transfers, or turn tracing\n\
+		on or off with <value> of 'on' or 'off'\n\
 \n\
 	listfeature - list the supported features for this board\n\
 \n\
@@ -123,14 +166,27 @@ sc_app -c <command> [-t <target> [-v <value>]]\n\n\
 	restorevoltage - restore <target> to default value\n\
 \n\
 	listpower - list the supported power targets\n\
-	getpower - get the voltage, current, and power of <target>\n\
+	getpower - get the voltage, current, and power of <target>, or of every\n\
+		   rail and power domain at once with <target> of 'all'\n\
 	getcalpower - get the voltage, current, and power of custom calibrated <target>\n\
 	getINA226 - get the content of <target> registers\n\
 	setINA226 - set the 'Configuration', 'Calibration', 'Mask/Enable', and \n\
 		    'Alert Limit' registers of <target> to <value>\n\
+	powerstats - get the minimum, maximum, and mean power and the energy of\n\
+		     each rail, or of <target> rail, from continuous sampling,\n\
+		     or reset them with <value> of 'reset'\n\
+	starttrace - capture the readings of <target>, a comma-separated list\n\
+		     of power targets or 'all', to a file every <value> us\n\
+		     (default: 1000), with ',realtime' for real-time priority\n\
+	stoptrace - stop the capture of the power trace\n\
+	tracesummary - get the statistics of each rail of the power trace\n\
 \n\
 	listpowerdomain - list the supported power domain targets\n\
 	powerdomain - get the power used by <target> power domain\n\
+\n\
+	watch - stream readings of <target>, a comma-separated list of power,\n\
+		voltage, temp, or ddr targets, every <value> ms (default: 1000)\n\
+	watchalert - stream the over/under-limit alerts of INA226s as they occur\n\
 \n\
 	listworkaround - list the applicable workaround targets\n\
 	workaround - apply <target> workaround (may requires <value>)\n\
@@ -175,6 +231,13 @@ typedef enum {
 	VERSION,
 	BOARD,
 	RESET,
+	SESSION,
+	JOBSTATUS,
+	JOBWAIT,
+	JOBCANCEL,
+	STATS,
+	I2CSTATS,
+	I2CTRACE,
 	LISTFEATURE,
 	LISTEEPROM,
 	GETEEPROM,
@@ -199,8 +262,14 @@ typedef enum {
 	GETCALPOWER,
 	GETINA226,
 	SETINA226,
+	POWERSTATS,
+	STARTTRACE,
+	STOPTRACE,
+	TRACESUMMARY,
 	LISTPOWERDOMAIN,
 	POWERDOMAIN,
+	WATCH,
+	WATCHALERT,
 	LISTWORKAROUND,
 	WORKAROUND,
 	LISTBIT,
@@ -232,13 +301,20 @@ typedef enum {
 typedef struct {
 	CmdId_t	CmdId;
 	char CmdStr[STRLEN_MAX];
-	int (*CmdOps)(void);
+	int (*CmdOps)(Request_t *);
 } Command_t;
 
 static Command_t Commands[] = {
 	{ .CmdId = VERSION, .CmdStr = "version", .CmdOps = Version_Ops, },
 	{ .CmdId = BOARD, .CmdStr = "board", .CmdOps = Board_Ops, },
-	{ .CmdId = RESET, .CmdStr = "reset", .CmdOps = Reset_Op, },
+	{ .CmdId = RESET, .CmdStr = "reset", .CmdOps = Reset_Ops, },
+	{ .CmdId = SESSION, .CmdStr = "session", .CmdOps = Session_Ops, },
+	{ .CmdId = JOBSTATUS, .CmdStr = "jobstatus", .CmdOps = Job_Ops, },
+	{ .CmdId = JOBWAIT, .CmdStr = "jobwait", .CmdOps = Job_Ops, },
+	{ .CmdId = JOBCANCEL, .CmdStr = "jobcancel", .CmdOps = Job_Ops, },
+	{ .CmdId = STATS, .CmdStr = "stats", .CmdOps = Stats_Ops, },
+	{ .CmdId = I2CSTATS, .CmdStr = "i2cstats", .CmdOps = I2C_Stats_Ops, },
+	{ .CmdId = I2CTRACE, .CmdStr = "i2ctrace", .CmdOps = I2C_Trace_Ops, },
 	{ .CmdId = LISTFEATURE, .CmdStr = "listfeature", .CmdOps = Feature_Ops, },
 	{ .CmdId = LISTEEPROM, .CmdStr = "listeeprom", .CmdOps = EEPROM_Ops, },
 	{ .CmdId = GETEEPROM, .CmdStr = "geteeprom", .CmdOps = EEPROM_Ops, },
@@ -263,8 +339,14 @@ static Command_t Commands[] = {
 	{ .CmdId = GETCALPOWER, .CmdStr = "getcalpower", .CmdOps = Power_Ops, },
 	{ .CmdId = GETINA226, .CmdStr = "getINA226", .CmdOps = Power_Ops, },
 	{ .CmdId = SETINA226, .CmdStr = "setINA226", .CmdOps = Power_Ops, },
+	{ .CmdId = POWERSTATS, .CmdStr = "powerstats", .CmdOps = Power_Stats_Ops, },
+	{ .CmdId = STARTTRACE, .CmdStr = "starttrace", .CmdOps = Power_Trace_Ops, },
+	{ .CmdId = STOPTRACE, .CmdStr = "stoptrace", .CmdOps = Power_Trace_Ops, },
+	{ .CmdId = TRACESUMMARY, .CmdStr = "tracesummary", .CmdOps = Power_Trace_Ops, },
 	{ .CmdId = LISTPOWERDOMAIN, .CmdStr = "listpowerdomain", .CmdOps = Power_Domain_Ops, },
 	{ .CmdId = POWERDOMAIN, .CmdStr = "powerdomain", .CmdOps = Power_Domain_Ops, },
+	{ .CmdId = WATCH, .CmdStr = "watch", .CmdOps = Watch_Ops, },
+	{ .CmdId = WATCHALERT, .CmdStr = "watchalert", .CmdOps = Watch_Ops, },
 	{ .CmdId = LISTWORKAROUND, .CmdStr = "listworkaround", .CmdOps = Workaround_Ops, },
 	{ .CmdId = WORKAROUND, .CmdStr = "workaround", .CmdOps = Workaround_Ops, },
 	{ .CmdId = LISTBIT, .CmdStr = "listBIT", .CmdOps = BIT_Ops, },
@@ -292,23 +374,13 @@ static Command_t Commands[] = {
 	{ .CmdId = RESETBOOTPDI, .CmdStr = "resetbootPDI", .CmdOps = PDI_Ops, },
 };
 
-char Command_Arg[STRLEN_MAX];
-char Target_Arg[STRLEN_MAX];
-char Value_Arg[LSTRLEN_MAX];
-int C_Flag, T_Flag, V_Flag;
-static Command_t Command;
-
 int
 main()
 {
 	int Sock_FD;
-	unsigned int Length, Recv_Length;
-	struct sockaddr_un Server, Client;
-	char InBuffer[SYSCMD_MAX];
-	int Argc;
-	char *Argv[ITEMS_MAX];
+	unsigned int Length;
+	struct sockaddr_un Server;
 	int Ret = -1;
-	int Valid_Command;
 
 	SC_INFO(">>> Begin");
 
@@ -326,6 +398,14 @@ main()
 		goto Out;
 	}
 
+	/* Record the session, if asked to */
+	if (Record_Init(Board_Name) != 0) {
+		goto Out;
+	}
+
+	/* Open the I2C buses of the board once for all accessors */
+	I2C_Init();
+
 	/*
 	 * Direction of IO Expander ports needs to be initialized
 	 * in order for FMC modules to be detected.
@@ -335,6 +415,14 @@ main()
 		goto Out;
 	}
 
+	/* Find out which SFP cages and FMC connectors are empty */
+	if (Presence_Init() != 0) {
+		SC_ERR("failed to track presence of modules");
+	}
+
+	/* Calibrate INA226s once, rather than on every read */
+	Calibrate_INA226s();
+
 	/* Detect FMC modules and auto adjust voltage */
 	if (FMC_Autodetect_Vadj() != 0) {
 		SC_ERR("failed to FMC autodetect vadj");
@@ -386,66 +474,529 @@ main()
 		goto Out;
 	}
 
-	while (1) {
-		Client_FD = 0;
-		memset(InBuffer, 0, SYSCMD_MAX);
-		if (listen(Sock_FD, 1) == -1) {
-			SC_ERR("failed to call listen(2): %m");
-			goto Out;
+	if (Stats_Init(COMMAND_MAX) != 0) {
+		goto Out;
+	}
+
+	if (Worker_Init() != 0) {
+		SC_ERR("failed to start worker threads");
+		goto Out;
+	}
+
+	if (Publish_Init() != 0) {
+		SC_ERR("failed to start publishing telemetry");
+	}
+
+	if (Export_Init() != 0) {
+		SC_ERR("failed to start the metrics exporter");
+	}
+
+	if (Energy_Init() != 0) {
+		SC_ERR("failed to start energy accounting");
+	}
+
+	if (Alert_Init() != 0) {
+		SC_ERR("failed to follow power alerts");
+	}
+
+	if (Replay_Start() != 0) {
+		goto Out;
+	}
+
+	Ret = Server_Loop(Sock_FD);
+
+Out:
+	SC_INFO("<<< End(%d)", Ret);
+	return Ret;
+}
+
+/*
+ * Run the command of the request on a worker thread, and set the status
+ * of the request to that of the command.
+ */
+void
+Run_Request(Request_t *Request)
+{
+	long long Start;
+	int Ret;
+
+	SC_Sink = Request->Sink;
+	if ((Request->Job != NULL) && (Job_Start(Request) != 0)) {
+		Ret = -1;
+		goto Out;
+	}
+
+	Start = Stats_Time();
+	Ret = Constraint_Pre_Ops(Request);
+	Stats_Record(Request->CmdId, STATS_PRE_OPS, Start);
+	if (Ret == 0) {
+		Start = Stats_Time();
+		Ret = (*Request->CmdOps)(Request);
+		Stats_Record(Request->CmdId, STATS_OPS, Start);
+	} else if (Ret == 1) {
+		/* A 'Terminate' constraint isn't a failure */
+		Ret = 0;
+	}
+
+Out:
+	Request->Status = Ret;
+	if (Request->Job != NULL) {
+		Output_Close(Request->Sink, Ret);
+	}
+
+	fflush(stdout);
+	SC_Sink = NULL;
+}
+
+/*
+ * A clock is either programmed over I2C or through its sysfs node.
+ */
+static const char *
+Clock_Resource(Clock_t *Clock)
+{
+	return ((Clock->I2C_Bus != NULL) ? Clock->I2C_Bus : Clock->Sysfs_Path);
+}
+
+/*
+ * Add the resources used by any of the levels of a BIT.
+ */
+static void
+BIT_Resources(Request_t *Request, BIT_t *BIT_p)
+{
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+	Clocks_t *Clocks = Plat_Devs->Clocks;
+	DIMMs_t *DIMMs = Plat_Devs->DIMMs;
+	int (*BIT_Op)(void *, void *);
+
+	for (int i = 0; i < BIT_p->Levels; i++) {
+		BIT_Op = BIT_p->Level[i].Plat_BIT_Op;
+		if (BIT_Op == Clocks_Check) {
+			for (int j = 0; (Clocks != NULL) && (j < Clocks->Numbers); j++) {
+				Add_Resource(Request, Clock_Resource(&Clocks->Clock[j]));
+			}
+		} else if (BIT_Op == Voltages_Check) {
+			for (int j = 0; (Voltages != NULL) && (j < Voltages->Numbers); j++) {
+				Add_Resource(Request, Voltages->Voltage[j].I2C_Bus);
+			}
+		} else if (BIT_Op == DIMM_EEPROM_Check) {
+			for (int j = 0; (DIMMs != NULL) && (j < DIMMs->Numbers); j++) {
+				Add_Resource(Request, DIMMs->DIMM[j].I2C_Bus);
+			}
+		} else if (BIT_Op == EBM_EEPROM_Check) {
+			if (Plat_Devs->Daughter_Card != NULL) {
+				Add_Resource(Request, Plat_Devs->Daughter_Card->I2C_Bus);
+			}
+		} else if (BIT_Op == Assert_Reset) {
+			Add_Resource(Request, RESOURCE_GPIO);
+		} else if (BIT_Op != Display_Instruction) {
+			/* XSDB_BIT() and the DDRMC tests use the JTAG chain */
+			Add_Resource(Request, RESOURCE_JTAG);
 		}
+	}
+}
 
-		Client_FD = accept(Sock_FD, (struct sockaddr *)&Client, &Length);
-		if (Client_FD == -1) {
-			SC_ERR("failed to call accept(2): %m");
-			goto Out;
+/*
+ * Add the resources of the I2C devices, GPIO lines, etc. that the command
+ * of the request may access, so that the worker pool only runs it once no
+ * running command holds any of them.  An invalid target simply adds no
+ * resources since the command fails without touching any device.
+ */
+static void
+Command_Resources(Request_t *Request)
+{
+	char Resource[STRLEN_MAX];
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Clocks_t *Clocks = Plat_Devs->Clocks;
+	GPIOs_t *GPIOs = Plat_Devs->GPIOs;
+	SFPs_t *SFPs = Plat_Devs->SFPs;
+	FMCs_t *FMCs = Plat_Devs->FMCs;
+	DIMMs_t *DIMMs = Plat_Devs->DIMMs;
+	BITs_t *BITs = Plat_Devs->BITs;
+	Power_Domains_t *Power_Domains = Plat_Devs->Power_Domains;
+	Power_Domain_t *Power_Domain;
+
+	switch (Request->CmdId) {
+	case RESET:
+	case WORKAROUND:
+		Add_Resource(Request, RESOURCE_ALL);
+		break;
+	case GETBOOTMODE:
+	case SETBOOTMODE:
+		Add_Resource(Request, RESOURCE_GPIO);
+		if ((strcmp(Request->Target_Arg, "alternate") == 0) ||
+		    (strcmp(Request->Value_Arg, "alternate") == 0)) {
+			Add_Resource(Request, RESOURCE_JTAG);
 		}
 
-		Recv_Length = recv(Client_FD, InBuffer, SYSCMD_MAX, 0);
-		if (Recv_Length == -1) {
-			SC_ERR("failed to call recv(2): %m");
-			goto Out;
+		break;
+	case GETEEPROM:
+		if (Plat_Devs->OnBoard_EEPROM != NULL) {
+			Add_Resource(Request, Plat_Devs->OnBoard_EEPROM->I2C_Bus);
+		}
+
+		break;
+	case GETMEASUREDCLOCK:
+		Add_Resource(Request, RESOURCE_JTAG);
+		break;
+	case SETBOOTCLOCK:
+	case RESTORECLOCK:
+		Add_Resource(Request, CLOCKFILE);
+		/* Fall through */
+	case GETCLOCK:
+	case SETCLOCK:
+		for (int i = 0; (Clocks != NULL) && (i < Clocks->Numbers); i++) {
+			if (strcmp(Request->Target_Arg, Clocks->Clock[i].Name) != 0) {
+				continue;
+			}
+
+			Add_Resource(Request, Clock_Resource(&Clocks->Clock[i]));
+		}
+
+		break;
+	case SETBOOTVOLTAGE:
+	case RESTOREVOLTAGE:
+		Add_Resource(Request, VOLTAGEFILE);
+		/* Fall through */
+	case GETVOLTAGE:
+	case SETVOLTAGE:
+		for (int i = 0; (Voltages != NULL) && (i < Voltages->Numbers); i++) {
+			if (strcmp(Request->Target_Arg, Voltages->Voltage[i].Name) == 0) {
+				Add_Resource(Request, Voltages->Voltage[i].I2C_Bus);
+			}
 		}
 
-		Valid_Command = 0;
-		if (strstr(InBuffer, Commands[GETTEMP].CmdStr) == NULL) {
-			SC_INFO(">>> Command: %s", InBuffer);
+		break;
+	case GETPOWER:
+	case GETCALPOWER:
+	case GETINA226:
+	case SETINA226:
+		for (int i = 0; (INA226s != NULL) && (i < INA226s->Numbers); i++) {
+			if ((strcmp(Request->Target_Arg, INA226s->INA226[i].Name) == 0) ||
+			    ((Request->CmdId == GETPOWER) &&
+			     (strcmp(Request->Target_Arg, "all") == 0))) {
+				Add_Resource(Request, INA226s->INA226[i].I2C_Bus);
+			}
 		}
 
-		String_2_Argv(InBuffer, &Argc, &Argv[0]);
+		break;
+	case POWERDOMAIN:
+		for (int i = 0; (Power_Domains != NULL) &&
+		     (i < Power_Domains->Numbers); i++) {
+			Power_Domain = &Power_Domains->Power_Domain[i];
+			if (strcmp(Request->Target_Arg, Power_Domain->Name) != 0) {
+				continue;
+			}
+
+			for (int j = 0; j < Power_Domain->Numbers; j++) {
+				Add_Resource(Request,
+				    INA226s->INA226[Power_Domain->Rails[j]].I2C_Bus);
+			}
+		}
 
-		if (Parse_Options(Argc, Argv) != 0) {
-			goto Next;
+		break;
+	case BIT:
+		for (int i = 0; (BITs != NULL) && (i < BITs->Numbers); i++) {
+			if (strcmp(Request->Target_Arg, BITs->BIT[i].Name) == 0) {
+				BIT_Resources(Request, &BITs->BIT[i]);
+			}
 		}
 
-		if ((Ret = Constraint_Pre_Ops()) != 0) {
-			goto Next;
+		break;
+	case GETDDR:
+		for (int i = 0; (DIMMs != NULL) && (i < DIMMs->Numbers); i++) {
+			if (strcmp(Request->Target_Arg, DIMMs->DIMM[i].Name) == 0) {
+				Add_Resource(Request, DIMMs->DIMM[i].I2C_Bus);
+			}
 		}
 
-		for (int i = 0; i < COMMAND_MAX; i++) {
-			if (strcmp(Command_Arg, (char *)Commands[i].CmdStr) == 0) {
-				Command = Commands[i];
-				Valid_Command = 1;
+		break;
+	case GETGPIO:
+	case SETGPIO:
+		for (int i = 0; (GPIOs != NULL) && (i < GPIOs->Numbers); i++) {
+			if ((strcmp(Request->Target_Arg, GPIOs->GPIO[i].Display_Name) == 0) ||
+			    (strcmp(Request->Target_Arg, GPIOs->GPIO[i].Internal_Name) == 0)) {
+				(void) snprintf(Resource, sizeof(Resource), "%s:%s",
+						RESOURCE_GPIO, GPIOs->GPIO[i].Internal_Name);
+				Add_Resource(Request, Resource);
 				break;
 			}
 		}
 
-		if (!Valid_Command) {
+		/* 'all' and GPIO groups */
+		if (Request->Resource_Numbers == 0) {
+			Add_Resource(Request, RESOURCE_GPIO);
+		}
+
+		break;
+	case GETIOEXP:
+	case SETDIRIOEXP:
+	case SETOUTIOEXP:
+	case RESTOREIOEXP:
+		if (Plat_Devs->IO_Exp != NULL) {
+			Add_Resource(Request, Plat_Devs->IO_Exp->I2C_Bus);
+		}
+
+		break;
+	case LISTSFP:
+	case GETSFP:
+		for (int i = 0; (SFPs != NULL) && (i < SFPs->Numbers); i++) {
+			if ((Request->CmdId == LISTSFP) ||
+			    (strcmp(Request->Target_Arg, SFPs->SFP[i].Name) == 0)) {
+				Add_Resource(Request, SFPs->SFP[i].I2C_Bus);
+			}
+		}
+
+		/* Module selection and presence detection */
+		if (Plat_Devs->IO_Exp != NULL) {
+			Add_Resource(Request, Plat_Devs->IO_Exp->I2C_Bus);
+		}
+
+		Add_Resource(Request, RESOURCE_JTAG);
+		break;
+	case LISTEBM:
+	case GETEBM:
+		if (Plat_Devs->Daughter_Card != NULL) {
+			Add_Resource(Request, Plat_Devs->Daughter_Card->I2C_Bus);
+		}
+
+		break;
+	case LISTFMC:
+	case GETFMC:
+		for (int i = 0; (FMCs != NULL) && (i < FMCs->Numbers); i++) {
+			if ((Request->CmdId == LISTFMC) ||
+			    (strcmp(Request->Target_Arg, FMCs->FMC[i].Name) == 0)) {
+				Add_Resource(Request, FMCs->FMC[i].I2C_Bus);
+			}
+		}
+
+		break;
+	case LOADPDI:
+		Add_Resource(Request, RESOURCE_JTAG);
+		break;
+	case SETBOOTPDI:
+	case RESETBOOTPDI:
+		Add_Resource(Request, PDIFILE);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * The priority of the request among those waiting for a worker.  Reading
+ * sensors goes ahead of other commands, and bulk transfers, e.g. dumping
+ * EEPROMs or programming clocks, go behind them.
+ */
+static Priority_t
+Command_Priority(Request_t *Request)
+{
+	switch (Request->CmdId) {
+	case GETTEMP:
+	case GETVOLTAGE:
+	case GETPOWER:
+	case GETCALPOWER:
+	case POWERDOMAIN:
+		return PRIORITY_HIGH;
+	case GETDDR:
+		if (strcmp(Request->Value_Arg, "temp") == 0) {
+			return PRIORITY_HIGH;
+		}
+
+		return PRIORITY_BULK;
+	case GETEEPROM:
+	case SETCLOCK:
+	case SETBOOTCLOCK:
+	case RESTORECLOCK:
+	case LISTFMC:
+	case GETFMC:
+	case GETEBM:
+	case BIT:
+	case LOADPDI:
+		return PRIORITY_BULK;
+	default:
+		return PRIORITY_NORMAL;
+	}
+}
+
+/*
+ * The name of the command, for statistics.
+ */
+const char *
+Command_Name(int CmdId)
+{
+	for (int i = 0; i < COMMAND_MAX; i++) {
+		if (Commands[i].CmdId == CmdId) {
+			return Commands[i].CmdStr;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * A command that isn't built in, once the constraints of the board are
+ * done with it.
+ */
+static int
+Invalid_Ops(__attribute__((unused)) Request_t *Request)
+{
+	SC_ERR("invalid command");
+	return -1;
+}
+
+/*
+ * Process a complete request received from a client.  Returns 1 if the
+ * request has been queued to the worker pool, or the client is waiting
+ * on a job, either of which completes the request once done, or 0 if the
+ * request has been completed here, in which case the status of the client
+ * is set to that of the request.
+ */
+int
+Process_Request(Client_t *Client)
+{
+	Request_t *Request;
+	int Argc = 0;
+	char *Argv[ITEMS_MAX];
+	int Valid_Command = 0;
+	int Ret = 0;
+
+	SC_Sink = &Client->Sink;
+	Client->Sink.Format = Client->Format;
+	Client->Status = -1;
+	Client->CmdId = STATS_INVALID;
+	Client->Start = Stats_Time();
+	Record_Request(Client);
+	if (strstr(Client->Request, Commands[GETTEMP].CmdStr) == NULL) {
+		SC_INFO(">>> Command: %s", Client->Request);
+	}
+
+	Request = calloc(1, sizeof(Request_t));
+	if (Request == NULL) {
+		SC_ERR("failed to allocate request: %m");
+		goto Out;
+	}
+
+	Request->Client = Client;
+	Request->Sink = &Client->Sink;
+	String_2_Argv(Client->Request, &Argc, &Argv[0]);
+
+	Ret = Parse_Options(Request, Argc, Argv);
+	if (Ret != 0) {
+		Stats_Record(STATS_INVALID, STATS_PARSE, Client->Start);
+		/* Asking for help isn't a failure */
+		Client->Status = ((Ret == 1) ? 0 : Ret);
+		Ret = 0;
+		goto Out;
+	}
+
+	/* Nothing has been output yet, so the format can still be changed */
+	if (Request->O_Flag) {
+		Client->Sink.Format = Request->Format;
+	}
+
+	for (int i = 0; i < COMMAND_MAX; i++) {
+		if (strcmp(Request->Command_Arg, (char *)Commands[i].CmdStr) == 0) {
+			Request->CmdId = Commands[i].CmdId;
+			Request->CmdOps = Commands[i].CmdOps;
+			Client->CmdId = Request->CmdId;
+			Valid_Command = 1;
+			break;
+		}
+	}
+
+	Stats_Record(Client->CmdId, STATS_PARSE, Client->Start);
+
+	/*
+	 * A command that isn't built in is only served by the constraints of
+	 * the board, whose scripts and devices are anyone's, so it runs on a
+	 * worker thread on its own.
+	 */
+	if (!Valid_Command) {
+		if (Find_Constraint(Request->Command_Arg,
+				    (Request->T_Flag ? Request->Target_Arg : NULL),
+				    (Request->V_Flag ? Request->Value_Arg : NULL)) == NULL) {
 			SC_ERR("invalid command");
-			goto Next;
+			goto Out;
+		}
+
+		Request->CmdId = STATS_INVALID;
+		Request->CmdOps = Invalid_Ops;
+		Add_Resource(Request, RESOURCE_ALL);
+		Request->Priority = PRIORITY_NORMAL;
+		Worker_Submit(Request);
+		Request = NULL;
+		Ret = 1;
+		goto Out;
+	}
+
+	if (Request->A_Flag) {
+		switch (Request->CmdId) {
+		case SESSION:
+		case JOBSTATUS:
+		case JOBWAIT:
+		case JOBCANCEL:
+		case WATCH:
+		case WATCHALERT:
+			SC_ERR("%s can't run in the background", Request->Command_Arg);
+			goto Out;
+		default:
+			break;
+		}
+
+		if (Job_Create(Request) != 0) {
+			goto Out;
+		}
+
+		/*
+		 * The request is now that of the job, and the client is done.
+		 * Only the stages the job runs are recorded for the command.
+		 */
+		Client->Status = 0;
+		Client->CmdId = STATS_NONE;
+		Command_Resources(Request);
+		Request->Priority = Command_Priority(Request);
+		Worker_Submit(Request);
+		Request = NULL;
+		goto Out;
+	}
+
+	if (Request->CmdId == SESSION) {
+		Client->Session = 1;
+		if (Request->O_Flag) {
+			Client->Format = Request->Format;
 		}
+	}
+
+	/* Waiting on a job doesn't tie up a worker thread */
+	if (Request->CmdId == JOBWAIT) {
+		Ret = Job_Wait(Request);
+		goto Out;
+	}
 
-		(void) (*Command.CmdOps)();
-		fflush(stdout);
-Next:
-		for (int i = 0; i < Argc; i++) {
-			free(Argv[i]);
+	/* Neither does a subscription, which is served by its own thread */
+	if ((Request->CmdId == WATCH) || (Request->CmdId == WATCHALERT)) {
+		Ret = ((Request->CmdId == WATCH) ? Watch_Start(Request) :
+		       Alert_Watch_Start(Request));
+		if (Ret == 1) {
+			Request = NULL;
 		}
 
-		(void) close(Client_FD);
+		goto Out;
 	}
 
+	Command_Resources(Request);
+	Request->Priority = Command_Priority(Request);
+	Worker_Submit(Request);
+	Request = NULL;
+	Ret = 1;
 Out:
-	SC_INFO("<<< End(%d)", Ret);
+	for (int i = 0; i < Argc; i++) {
+		free(Argv[i]);
+	}
+
+	free(Request);
+	SC_Sink = NULL;
 	return Ret;
 }
 
@@ -490,35 +1041,51 @@ String_2_Argv(char *Buffer, int *Argc, char *Argv[])
  * Parse the command line.
  */
 int
-Parse_Options(int argc, char **argv)
+Parse_Options(Request_t *Request, int argc, char **argv)
 {
 	int Options = 0;
 	int c;
 
 	opterr = 0;
 	optind = 0;
-	C_Flag = T_Flag = V_Flag = 0;
-	memset(Command_Arg, 0, STRLEN_MAX);
-	memset(Target_Arg, 0, STRLEN_MAX);
-	memset(Value_Arg, 0, LSTRLEN_MAX);
-	while ((c = getopt(argc, argv, "hc:t:v:")) != -1) {
+	Request->C_Flag = Request->T_Flag = Request->V_Flag = Request->A_Flag = 0;
+	Request->O_Flag = 0;
+	memset(Request->Command_Arg, 0, STRLEN_MAX);
+	memset(Request->Target_Arg, 0, STRLEN_MAX);
+	memset(Request->Value_Arg, 0, LSTRLEN_MAX);
+	while ((c = getopt(argc, argv, "hac:t:v:o:")) != -1) {
 		Options++;
 		switch (c) {
 		case 'h':
 			SC_PRINT("%s", Usage);
 			return 1;
 			break;
+		case 'a':
+			Request->A_Flag = 1;
+			break;
 		case 'c':
-			C_Flag = 1;
-			(void) strncpy(Command_Arg, optarg, (sizeof(Command_Arg) - 1));
+			Request->C_Flag = 1;
+			(void) strncpy(Request->Command_Arg, optarg, (sizeof(Request->Command_Arg) - 1));
 			break;
 		case 't':
-			T_Flag = 1;
-			(void) strncpy(Target_Arg, optarg, (sizeof(Target_Arg) - 1));
+			Request->T_Flag = 1;
+			(void) strncpy(Request->Target_Arg, optarg, (sizeof(Request->Target_Arg) - 1));
 			break;
 		case 'v':
-			V_Flag = 1;
-			(void) strncpy(Value_Arg, optarg, (sizeof(Value_Arg) - 1));
+			Request->V_Flag = 1;
+			(void) strncpy(Request->Value_Arg, optarg, (sizeof(Request->Value_Arg) - 1));
+			break;
+		case 'o':
+			if (strcmp(optarg, "text") == 0) {
+				Request->Format = OUTPUT_TEXT;
+			} else if (strcmp(optarg, "json") == 0) {
+				Request->Format = OUTPUT_JSON;
+			} else {
+				SC_ERR("invalid output format");
+				return -1;
+			}
+
+			Request->O_Flag = 1;
 			break;
 		case '?':
 			SC_ERR("invalid argument");
@@ -539,57 +1106,83 @@ Parse_Options(int argc, char **argv)
 }
 
 /*
- * Process commands with pre_phase constraints
+ * Find the constraint of the command with the given target and value,
+ * either of which is NULL if the command doesn't have it.
  */
-int
-Constraint_Pre_Ops()
+static Constraint_t *
+Find_Constraint(const char *Command, const char *Target, const char *Value)
 {
-	int Target_Index = -1;
 	Constraints_t *Constraints;
 	Constraint_t *Constraint;
-	Constraint_Phases_t *Pre_Phases;
-	FILE *FP;
-	char Output[STRLEN_MAX] = { 0 };
-	char System_Cmd[SYSCMD_MAX];
 
 	Constraints = Plat_Devs->Constraints;
 	if (Constraints == NULL) {
-		return 0;
+		return NULL;
 	}
 
 	for (int i = 0; i < Constraints->Numbers; i++) {
-		if (strcmp(Command_Arg, Constraints->Constraint[i].Command) != 0) {
+		Constraint = &Constraints->Constraint[i];
+		if (strcmp(Command, Constraint->Command) != 0) {
 			continue;
 		}
 
-		if ((!T_Flag && (Constraints->Constraint[i].Target != NULL)) ||
-		    (T_Flag && (Constraints->Constraint[i].Target == NULL))) {
+		if (((Target == NULL) && (Constraint->Target != NULL)) ||
+		    ((Target != NULL) && (Constraint->Target == NULL))) {
 			continue;
 		}
 
-		if (T_Flag &&
-		    ((strcmp(Target_Arg, Constraints->Constraint[i].Target) != 0) &&
-		     (strcmp("$ANY", Constraints->Constraint[i].Target) != 0))) {
+		if ((Target != NULL) &&
+		    ((strcmp(Target, Constraint->Target) != 0) &&
+		     (strcmp("$ANY", Constraint->Target) != 0))) {
 			continue;
 		}
 
-		if ((!V_Flag && (Constraints->Constraint[i].Value != NULL)) ||
-		    (V_Flag && (Constraints->Constraint[i].Value == NULL))) {
+		if (((Value == NULL) && (Constraint->Value != NULL)) ||
+		    ((Value != NULL) && (Constraint->Value == NULL))) {
 			continue;
 		}
 
-		if (V_Flag &&
-		    ((strcmp(Value_Arg, Constraints->Constraint[i].Value) != 0) &&
-		     (strcmp("$ANY", Constraints->Constraint[i].Value) != 0))) {
+		if ((Value != NULL) &&
+		    ((strcmp(Value, Constraint->Value) != 0) &&
+		     (strcmp("$ANY", Constraint->Value) != 0))) {
 			continue;
 		}
 
-		Target_Index = i;
-		Constraint = &Constraints->Constraint[Target_Index];
-		break;
+		return Constraint;
 	}
 
-	if (Target_Index == -1) {
+	return NULL;
+}
+
+/*
+ * Whether the command on the target is served by a 'Terminate'
+ * constraint, i.e. the board replaces the command with its pre-phases.
+ */
+int
+Constraint_Terminates(const char *Command, const char *Target)
+{
+	Constraint_t *Constraint;
+
+	Constraint = Find_Constraint(Command, Target, NULL);
+	return ((Constraint != NULL) && (strcmp(Constraint->Type, "Terminate") == 0));
+}
+
+/*
+ * Process commands with pre_phase constraints
+ */
+int
+Constraint_Pre_Ops(Request_t *Request)
+{
+	Constraint_t *Constraint;
+	Constraint_Phases_t *Pre_Phases;
+	FILE *FP;
+	char Output[STRLEN_MAX] = { 0 };
+	char System_Cmd[SYSCMD_MAX];
+
+	Constraint = Find_Constraint(Request->Command_Arg,
+				     (Request->T_Flag ? Request->Target_Arg : NULL),
+				     (Request->V_Flag ? Request->Value_Arg : NULL));
+	if (Constraint == NULL) {
 		return 0;
 	}
 
@@ -611,7 +1204,7 @@ Constraint_Pre_Ops()
 				(void) sprintf(System_Cmd, "%s%s/%s %s %s",
 					       SCRIPT_PATH, Board_Name,
 					       Pre_Phases->Phase[i].Command,
-					       Target_Arg, Value_Arg);
+					       Request->Target_Arg, Request->Value_Arg);
 			} else {
 				(void) sprintf(System_Cmd, "%s%s/%s %s",
 					       SCRIPT_PATH, Board_Name,
@@ -630,13 +1223,18 @@ Constraint_Pre_Ops()
 			while (fgets(Output, sizeof(Output), FP) != NULL) {
 				SC_PRINT_N("%s", Output);
 				if (strstr(Output, "ERROR: ") != NULL) {
-					(void) pclose(FP);
-					return -1;
+					break;
 				}
 			}
 
 			(void) pclose(FP);
 
+			/* The script may have changed the page of regulators */
+			PMBus_Invalidate(NULL);
+			if (strstr(Output, "ERROR: ") != NULL) {
+				return -1;
+			}
+
 		} else if (strcmp(Pre_Phases->Phase[i].Type, "Internal") == 0) {
 			SC_INFO("Executing internal command: %s",
 				Pre_Phases->Phase[i].Command);
@@ -662,7 +1260,7 @@ Constraint_Pre_Ops()
  * Version Operations
  */
 int
-Version_Ops(void)
+Version_Ops(Request_t *Request)
 {
 	SC_PRINT("Version:\t%d.%d", MAJOR, MINOR);
 	SC_PRINT("Built:\t\t%s %s", __DATE__, __TIME__);
@@ -676,7 +1274,145 @@ Version_Ops(void)
 }
 
 int
-Board_Ops(void)
+Reset_Ops(Request_t *Request)
+{
+	return Reset_Op();
+}
+
+/*
+ * Session Operations
+ *
+ * The connection has already been marked persistent by Process_Request(),
+ * so there is nothing left to do here.
+ */
+int
+Session_Ops(Request_t *Request)
+{
+	return 0;
+}
+
+/*
+ * Statistics Operations
+ */
+int
+Stats_Ops(Request_t *Request)
+{
+	int Reset = 0;
+
+	if (Request->V_Flag) {
+		if (strcmp(Request->Value_Arg, "reset") != 0) {
+			SC_ERR("invalid stats value");
+			return -1;
+		}
+
+		Reset = 1;
+	}
+
+	if (Request->T_Flag) {
+		for (int i = 0; i < COMMAND_MAX; i++) {
+			if (strcmp(Request->Target_Arg, Commands[i].CmdStr) == 0) {
+				if (Reset) {
+					Stats_Reset(Commands[i].CmdId);
+				} else {
+					Stats_Print(Commands[i].CmdId, Commands[i].CmdStr, 1);
+				}
+
+				return 0;
+			}
+		}
+
+		SC_ERR("invalid stats target");
+		return -1;
+	}
+
+	for (int i = 0; i < COMMAND_MAX; i++) {
+		if (Reset) {
+			Stats_Reset(Commands[i].CmdId);
+		} else {
+			Stats_Print(Commands[i].CmdId, Commands[i].CmdStr, 0);
+		}
+	}
+
+	if (Reset) {
+		Stats_Reset(STATS_INVALID);
+		Worker_Reset();
+	} else {
+		Stats_Print(STATS_INVALID, "(invalid)", 0);
+		Worker_Print();
+	}
+
+	return 0;
+}
+
+/*
+ * I2C Statistics Operations
+ */
+int
+I2C_Stats_Ops(Request_t *Request)
+{
+	if (Request->V_Flag) {
+		if (strcmp(Request->Value_Arg, "reset") != 0) {
+			SC_ERR("invalid i2cstats value");
+			return -1;
+		}
+
+		I2C_Reset_Stats();
+		return 0;
+	}
+
+	I2C_Print_Stats(Request->T_Flag ? Request->Target_Arg : NULL);
+	return 0;
+}
+
+/*
+ * I2C Trace Operations
+ */
+int
+I2C_Trace_Ops(Request_t *Request)
+{
+	if (!Request->V_Flag) {
+		I2C_Print_Trace();
+		return 0;
+	}
+
+	if (strcmp(Request->Value_Arg, "on") == 0) {
+		return I2C_Trace(1);
+	} else if (strcmp(Request->Value_Arg, "off") == 0) {
+		return I2C_Trace(0);
+	}
+
+	SC_ERR("invalid i2ctrace value");
+	return -1;
+}
+
+/*
+ * Job Operations
+ *
+ * 'jobwait' is handled by Process_Request() so that it doesn't hold up
+ * a worker thread while the job is running.
+ */
+int
+Job_Ops(Request_t *Request)
+{
+	if (Request->CmdId == JOBSTATUS) {
+		return Job_Status(Request->T_Flag ? Request->Target_Arg : NULL);
+	}
+
+	if (Request->T_Flag == 0) {
+		SC_ERR("no job target");
+		return -1;
+	}
+
+	if (Request->CmdId == JOBCANCEL) {
+		return Job_Cancel(Request->Target_Arg);
+	}
+
+	SC_ERR("invalid job operation");
+	return -1;
+}
+
+int
+Board_Ops(Request_t *Request)
 {
 	if (Board_Name[0] == 0) {
 		if (Board_Identification(Board_Name) != 0) {
@@ -692,7 +1428,7 @@ Board_Ops(void)
  * Boot Mode Operations
  */
 int
-BootMode_Ops(void)
+BootMode_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	BootModes_t *BootModes;
@@ -704,7 +1440,7 @@ BootMode_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTBOOTMODE) {
+	if (Request->CmdId == LISTBOOTMODE) {
 		for (int i = 0; i < BootModes->Numbers; i++) {
 			SC_PRINT("%s\t0x%x", BootModes->BootMode[i].Name,
 				 BootModes->BootMode[i].Value);
@@ -713,13 +1449,13 @@ BootMode_Ops(void)
 		return 0;
 	}
 
-	if (Command.CmdId == GETBOOTMODE) {
-		if ((T_Flag == 0) && (V_Flag == 0)) {
+	if (Request->CmdId == GETBOOTMODE) {
+		if ((Request->T_Flag == 0) && (Request->V_Flag == 0)) {
 			return Get_BootMode(0);
 		}
 
-		if ((strcmp(Target_Arg, "alternate") != 0) &&
-		    (strcmp(Value_Arg, "alternate") != 0)) {
+		if ((strcmp(Request->Target_Arg, "alternate") != 0) &&
+		    (strcmp(Request->Value_Arg, "alternate") != 0)) {
 			SC_ERR("invalid get boot mode value");
 			return -1;
 		}
@@ -727,19 +1463,19 @@ BootMode_Ops(void)
 		return Get_BootMode(1);
 	}
 
-	if (Command.CmdId != SETBOOTMODE) {
+	if (Request->CmdId != SETBOOTMODE) {
 		SC_ERR("invalid boot mode command");
 		return -1;
 	}
 
 	/* Validate the bootmode target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no set boot mode target");
 		return -1;
 	}
 
 	for (int i = 0; i < BootModes->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)BootModes->BootMode[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)BootModes->BootMode[i].Name) == 0) {
 			Target_Index = i;
 			BootMode = &BootModes->BootMode[Target_Index];
 			break;
@@ -751,11 +1487,11 @@ BootMode_Ops(void)
 		return -1;
 	}
 
-	if (V_Flag == 0) {
+	if (Request->V_Flag == 0) {
 		return Set_BootMode(BootMode, 0);
 	}
 
-	if (strcmp(Value_Arg, "alternate") != 0) {
+	if (strcmp(Request->Value_Arg, "alternate") != 0) {
 		SC_ERR("invalid set boot mode value");
 		return -1;
 	}
@@ -764,7 +1500,7 @@ BootMode_Ops(void)
 }
 
 int
-Feature_Ops(void)
+Feature_Ops(Request_t *Request)
 {
 	FeatureList_t *FeatureList;
 
@@ -808,7 +1544,7 @@ EEPROM_Print_All(char *Buffer, int Size, int Partition)
  * EEPROM Operations
  */
 int
-EEPROM_Ops(void)
+EEPROM_Ops(Request_t *Request)
 {
 	EEPROM_Targets Target;
 	OnBoard_EEPROM_t *OnBoard_EEPROM;
@@ -826,72 +1562,72 @@ EEPROM_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTEEPROM) {
+	if (Request->CmdId == LISTEEPROM) {
 		SC_PRINT("%s", OnBoard_EEPROM->Name);
 		return 0;
 	}
 
 	/* Validate the target for geteeprom command */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no geteeprom target");
 		return -1;
 	}
 
-	if (strcmp(Target_Arg, OnBoard_EEPROM->Name) != 0) {
+	if (strcmp(Request->Target_Arg, OnBoard_EEPROM->Name) != 0) {
 		SC_ERR("invalid geteeprom target");
 		return -1;
 	}
 
-	if (V_Flag == 0) {
+	if (Request->V_Flag == 0) {
 		SC_ERR("no value is provided for geteeprom");
 		return -1;
 	}
 
-	if (strcmp(Value_Arg, "summary") == 0) {
+	if (strcmp(Request->Value_Arg, "summary") == 0) {
 		Target = EEPROM_SUMMARY;
-	} else if (strcmp(Value_Arg, "all") == 0) {
+	} else if (strcmp(Request->Value_Arg, "all") == 0) {
 		Target = EEPROM_ALL;
-	} else if (strcmp(Value_Arg, "common") == 0) {
+	} else if (strcmp(Request->Value_Arg, "common") == 0) {
 		Target = EEPROM_COMMON;
-	} else if (strcmp(Value_Arg, "board") == 0) {
+	} else if (strcmp(Request->Value_Arg, "board") == 0) {
 		Target = EEPROM_BOARD;
-	} else if (strcmp(Value_Arg, "multirecord") == 0) {
+	} else if (strcmp(Request->Value_Arg, "multirecord") == 0) {
 		Target = EEPROM_MULTIRECORD;
 	} else {
 		SC_ERR("invalid geteeprom value");
 		return -1;
 	}
 
-	FD = open(OnBoard_EEPROM->I2C_Bus, O_RDWR);
+	FD = I2C_Open(OnBoard_EEPROM->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", OnBoard_EEPROM->I2C_Bus);
 		return -1;
 	}
 
-	if (ioctl(FD, I2C_SLAVE_FORCE, OnBoard_EEPROM->I2C_Address) < 0) {
+	if (I2C_Set_Address(FD, OnBoard_EEPROM->I2C_Address) != 0) {
 		SC_ERR("unable to access onboard EEPROM address %#x",
 		       OnBoard_EEPROM->I2C_Address);
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
 	Out_Buffer[0] = 0x0;
 	Out_Buffer[1] = 0x0;
 	SC_INFO("Write offset address 0x%.2x%.2x", Out_Buffer[0], Out_Buffer[1]);
-	if (write(FD, Out_Buffer, 2) != 2) {
+	if (I2C_Write(FD, OnBoard_EEPROM->I2C_Address, Out_Buffer, 2) != 2) {
 		SC_ERR("unable to set the offset address on onboard EEPROM");
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
 	(void) memset(In_Buffer, 0, SYSCMD_MAX);
-	if (read(FD, In_Buffer, 256) != 256) {
+	if (I2C_Read(FD, OnBoard_EEPROM->I2C_Address, In_Buffer, 256) != 256) {
 		SC_ERR("unable to read onboard EEPROM");
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	switch (Target) {
 	case EEPROM_SUMMARY:
 		SC_PRINT("Language: %d", In_Buffer[0xA]);
@@ -954,7 +1690,7 @@ EEPROM_Ops(void)
 }
 
 int
-Temperature_Ops(void)
+Temperature_Ops(Request_t *Request)
 {
 	Temperature_t *Temperature;
 
@@ -964,18 +1700,18 @@ Temperature_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTTEMP) {
+	if (Request->CmdId == LISTTEMP) {
 		SC_PRINT("%s", Temperature->Name);
 		return 0;
 	}
 
 	/* Validate the target for gettemp command */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no gettemp target");
 		return -1;
 	}
 
-	if (strcmp(Target_Arg, Temperature->Name) != 0) {
+	if (strcmp(Request->Target_Arg, Temperature->Name) != 0) {
 		SC_ERR("invalid gettemp target");
 		return -1;
 	}
@@ -987,7 +1723,7 @@ Temperature_Ops(void)
  * Clock Operations
  */
 int
-Clock_Ops(void)
+Clock_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	Clocks_t *Clocks;
@@ -1004,7 +1740,7 @@ Clock_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTCLOCK) {
+	if (Request->CmdId == LISTCLOCK) {
 		for (int i = 0; i < Clocks->Numbers; i++) {
 			if (Clocks->Clock[i].Type == IDT_8A34001) {
 				SC_PRINT("%s", Clocks->Clock[i].Name);
@@ -1025,13 +1761,13 @@ Clock_Ops(void)
 	}
 
 	/* Validate the clock target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no clock target");
 		return -1;
 	}
 
 	for (int i = 0; i < Clocks->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)Clocks->Clock[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)Clocks->Clock[i].Name) == 0) {
 			Target_Index = i;
 			Clock = &Clocks->Clock[Target_Index];
 			break;
@@ -1043,7 +1779,7 @@ Clock_Ops(void)
 		return -1;
 	}
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case GETCLOCK:
 		if (Clock->Type == IDT_8A34001) {
 			return Get_IDT_8A34001(Clock);
@@ -1088,20 +1824,20 @@ Clock_Ops(void)
 	case SETCLOCK:
 	case SETBOOTCLOCK:
 		/* Validate the frequency */
-		if (V_Flag == 0) {
+		if (Request->V_Flag == 0) {
 			SC_ERR("no value is provided for clock");
 			return -1;
 		}
 
 		if (Clock->Type == IDT_8A34001) {
-			if (Command.CmdId == SETCLOCK) {
-				return Set_IDT_8A34001(Clock, Value_Arg, 0);
+			if (Request->CmdId == SETCLOCK) {
+				return Set_IDT_8A34001(Clock, Request->Value_Arg, 0);
 			} else {
-				return Set_IDT_8A34001(Clock, Value_Arg, 1);
+				return Set_IDT_8A34001(Clock, Request->Value_Arg, 1);
 			}
 		}
 
-		Frequency = strtod(Value_Arg, NULL);
+		Frequency = strtod(Request->Value_Arg, NULL);
 		Upper = Clock->Upper_Freq;
 		Lower = Clock->Lower_Freq;
 
@@ -1124,7 +1860,7 @@ Clock_Ops(void)
 			return -1;
 		}
 
-		if (Command.CmdId == SETBOOTCLOCK) {
+		if (Request->CmdId == SETBOOTCLOCK) {
 			/* Remove the old value, if any */
 			(void) sprintf(System_Cmd, "sed -i -e \'/^%s:/d\' %s 2> /dev/NULL",
 				       Clock->Name, CLOCKFILE);
@@ -1182,7 +1918,7 @@ Clock_Ops(void)
 /*
  * Voltage Operations
  */
-int Voltage_Ops(void)
+int Voltage_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	Voltages_t *Voltages;
@@ -1197,7 +1933,7 @@ int Voltage_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTVOLTAGE) {
+	if (Request->CmdId == LISTVOLTAGE) {
 		for (int i = 0; i < Voltages->Numbers; i++) {
 			if (Voltages->Voltage[i].Voltage_Multiplier != 0) {
 				SC_PRINT("%s - (%.2f V)", Voltages->Voltage[i].Name,
@@ -1213,13 +1949,13 @@ int Voltage_Ops(void)
 	}
 
 	/* Validate the voltage target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no voltage target");
 		return -1;
 	}
 
 	for (int i = 0; i < Voltages->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)Voltages->Voltage[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)Voltages->Voltage[i].Name) == 0) {
 			Target_Index = i;
 			Regulator = &Voltages->Voltage[Target_Index];
 			break;
@@ -1231,7 +1967,7 @@ int Voltage_Ops(void)
 		return -1;
 	}
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case GETVOLTAGE:
 		if (Access_Regulator(Regulator, &Voltage, 0) != 0) {
 			SC_ERR("failed to get voltage from regulator");
@@ -1242,11 +1978,13 @@ int Voltage_Ops(void)
 			Voltage *= Regulator->Voltage_Multiplier;
 		}
 
-		SC_PRINT("Voltage(V):\t%.2f", Voltage);
+		Output_Begin(0);
+		Output_Float("voltage", "Voltage(V)", 2, Voltage);
+		Output_End();
 
-		if (V_Flag != 0) {
-			if (strcmp(Value_Arg, "all") != 0) {
-				SC_ERR("invalid value argument %s", Value_Arg);
+		if (Request->V_Flag != 0) {
+			if (strcmp(Request->Value_Arg, "all") != 0) {
+				SC_ERR("invalid value argument %s", Request->Value_Arg);
 				return -1;
 			}
 
@@ -1256,18 +1994,18 @@ int Voltage_Ops(void)
 		break;
 	case SETVOLTAGE:
 	case SETBOOTVOLTAGE:
-		if (V_Flag == 0) {
+		if (Request->V_Flag == 0) {
 			SC_ERR("no voltage value");
 			return -1;
 		}
 
-		Voltage = strtof(Value_Arg, NULL);
+		Voltage = strtof(Request->Value_Arg, NULL);
 		if (Access_Regulator(Regulator, &Voltage, 1) != 0) {
 			SC_ERR("failed to set voltage of regulator");
 			return -1;
 		}
 
-		if (Command.CmdId == SETBOOTVOLTAGE) {
+		if (Request->CmdId == SETBOOTVOLTAGE) {
 			/* Remove the old value, if any */
 			(void) sprintf(System_Cmd, "sed -i -e \'/^%s:/d\' %s 2> /dev/NULL",
 				       Regulator->Name, VOLTAGEFILE);
@@ -1335,144 +2073,48 @@ typedef enum {
 int
 Read_INA226(INA226_t *INA226, INA226_Regs_t *Regs)
 {
+	static const int Registers[] = {
+		0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xFF,
+	};
+	static const char *Names[] = {
+		"Configuration", "Shunt Voltage", "Bus Voltage", "Power",
+		"Current", "Calibration", "Mask/Enable", "Alert Limit", "Die ID",
+	};
+	unsigned short *Values[] = {
+		&Regs->Configuration, &Regs->Shunt_Voltage, &Regs->Bus_Voltage,
+		&Regs->Power, &Regs->Current, &Regs->Calibration,
+		&Regs->Mask_Enable, &Regs->Alert_Limit, &Regs->Die_ID,
+	};
+	I2C_Transaction_t Transaction;
+	unsigned char In_Buffer[ARRAY_SIZE(Registers)][2] = { 0 };
 	int FD;
-	char In_Buffer[STRLEN_MAX];
-	char Out_Buffer[STRLEN_MAX];
-	int Ret = 0;
+	int Ret;
 
-	FD = open(INA226->I2C_Bus, O_RDWR);
+	FD = I2C_Open(INA226->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", INA226->I2C_Bus);
 		return -1;
 	}
 
-	/* Read 'Configuration' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x0;	// Configuration Register(00h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
-	}
-
-	SC_INFO("Configuration Register(00h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Configuration = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Shunt Voltage' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x1;	// Shunt Voltage Register(01h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
-	}
-
-	SC_INFO("Shunt Voltage Register(01h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Shunt_Voltage = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Bus Voltage' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x2;	// Bus Voltage Register(02h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
-	}
-
-	SC_INFO("Bus Voltage Register(02h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Bus_Voltage = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Power' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x3;	// Power Register(03h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
-	}
-
-	SC_INFO("Power Register(03h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Power = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Current' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x4;	// Current Register(04h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
-	}
-
-	SC_INFO("Current Register(04h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Current = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Calibration' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x5;	// Calibration Register(05h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
-	}
-
-	SC_INFO("Calibration Register(05h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Calibration = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Mask/Enable' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x6;	// Mask/Enable Register(06h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
+	/* Read all the registers in one go */
+	I2C_Begin(&Transaction);
+	for (int i = 0; i < ARRAY_SIZE(Registers); i++) {
+		(void) I2C_Add_Read(&Transaction, INA226->I2C_Address,
+				    Registers[i], 2, In_Buffer[i]);
 	}
 
-	SC_INFO("Mask/Enable Register(06h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Mask_Enable = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Alert Limit' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0x7;	// Alert Limit Register(07h)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
+	Ret = I2C_Commit(FD, &Transaction);
+	I2C_Close(FD);
 	if (Ret != 0) {
-		(void) close(FD);
 		return Ret;
 	}
 
-	SC_INFO("Alert Limit Register(07h): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Alert_Limit = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	/* Read 'Die ID' register */
-	(void) memset(Out_Buffer, 0, STRLEN_MAX);
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	Out_Buffer[0] = 0xFF;	// Die ID Register(FFh)
-	I2C_READ(FD, INA226->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
+	for (int i = 0; i < ARRAY_SIZE(Registers); i++) {
+		SC_INFO("%s Register(%02Xh): %#x %#x", Names[i], Registers[i],
+			In_Buffer[i][0], In_Buffer[i][1]);
+		*Values[i] = ((In_Buffer[i][0] << 8) | In_Buffer[i][1]);
 	}
 
-	SC_INFO("Die ID Register(FFh): %#x %#x", In_Buffer[0],
-		In_Buffer[1]);
-	Regs->Die_ID = ((In_Buffer[0] << 8) | In_Buffer[1]);
-
-	(void) close(FD);
 	return 0;
 }
 
@@ -1483,7 +2125,7 @@ Write_INA226(INA226_t *INA226, INA226_Regs_t *Regs)
 	char Out_Buffer[STRLEN_MAX];
 	int Ret = 0;
 
-	FD = open(INA226->I2C_Bus, O_RDWR);
+	FD = I2C_Open(INA226->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", INA226->I2C_Bus);
 		return -1;
@@ -1499,7 +2141,7 @@ Write_INA226(INA226_t *INA226, INA226_Regs_t *Regs)
 			Out_Buffer[2]);
 		I2C_WRITE(FD, INA226->I2C_Address, 3, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 	}
@@ -1514,7 +2156,7 @@ Write_INA226(INA226_t *INA226, INA226_Regs_t *Regs)
 			Out_Buffer[2]);
 		I2C_WRITE(FD, INA226->I2C_Address, 3, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 	}
@@ -1529,7 +2171,7 @@ Write_INA226(INA226_t *INA226, INA226_Regs_t *Regs)
 			Out_Buffer[2]);
 		I2C_WRITE(FD, INA226->I2C_Address, 3, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 	}
@@ -1544,119 +2186,236 @@ Write_INA226(INA226_t *INA226, INA226_Regs_t *Regs)
 			Out_Buffer[2]);
 		I2C_WRITE(FD, INA226->I2C_Address, 3, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	return 0;
 }
 
+/*
+ * Program the Calibration register of the INA226 with the value computed
+ * when the board was parsed.  The caller must hold the bus.
+ */
 int
-Get_Power(INA226_t *INA226, int Mode, float *Voltage, float *Current, float *Power)
+Calibrate_INA226(int FD, INA226_t *INA226)
 {
-	int FD;
-	INA226_Regs_t Regs;
 	char Out_Buffer[STRLEN_MAX];
-	float Current_LSB;
-	float Calibration;
 	int Ret = 0;
 
-	if (Mode != 0 && Mode != 1) {
-		SC_ERR("invalid mode for getting power");
+	if (INA226->Calibration == 0) {
+		SC_ERR("invalid calibration register value of 0");
 		return -1;
 	}
 
-	if (Mode == 0) {
-		FD = open(INA226->I2C_Bus, O_RDWR);
+	/* Write 'Calibration' register */
+	(void) memset(Out_Buffer, 0, STRLEN_MAX);
+	Out_Buffer[0] = 0x5;   // Calibration Register(05h)
+	Out_Buffer[1] = (INA226->Calibration >> 8);
+	Out_Buffer[2] = (INA226->Calibration & 0xFF);
+	SC_INFO("Calibration Register(05h): %#x %#x", Out_Buffer[1],
+		 Out_Buffer[2]);
+	I2C_WRITE(FD, INA226->I2C_Address, 3, Out_Buffer, Ret);
+	INA226->Calibrated = (Ret == 0);
+	return Ret;
+}
+
+/*
+ * Calibrate every INA226 of the board, so that reading them doesn't
+ * need to.  Those that fail are calibrated when they're first read.
+ */
+void
+Calibrate_INA226s(void)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	INA226_t *INA226;
+	int FD;
+
+	for (int i = 0; (INA226s != NULL) && (i < INA226s->Numbers); i++) {
+		INA226 = &INA226s->INA226[i];
+		FD = I2C_Open(INA226->I2C_Bus);
 		if (FD < 0) {
-			SC_ERR("unable to access I2C bus %s: %m", INA226->I2C_Bus);
-			return -1;
+			continue;
 		}
 
-		/*
-		 * The per bit value for current is determined by
-		 * following equation.  The 'Maximum Expected Current'
-		 * unit is in Amps:
-		 * 	Current_LSB = Maximum Expected Current / 2^15
-		 * The unit of 'INA226->Maximum_Current' is in milli-Amps.
-		 */
-		Current_LSB = (float)INA226->Maximum_Current / (32768 * 1000);
+		if (Calibrate_INA226(FD, INA226) != 0) {
+			SC_INFO("INA226 %s is calibrated on first read", INA226->Name);
+		}
 
-		/*
-		 * The value of Calibration register is determined by:
-		 * 	Calibration = 0.00512 / (Current_LSB * R shunt)
-		 * The unit of 'INA226->Shunt_Resistor' is in micro-Ohms,
-		 * and the unit of 'R shunt' is in Ohms.
-		 */
-		Calibration = (0.00512 * 1000000) /
-			      (Current_LSB * INA226->Shunt_Resistor);
+		I2C_Close(FD);
+	}
+}
+
+#define INA226_SETTLE_MAX	1000000	/* In microseconds */
+
+static const int Conversion_Times[] = { INA226_CONVERSION_TIMES };
+static const int Averages[] = { INA226_AVERAGES };
+
+/*
+ * Wait for the INA226 to complete a conversion after its Calibration is
+ * programmed, since its Current and Power registers are only scaled by
+ * it from then on.  The period is read from the Configuration register,
+ * and one longer than INA226_SETTLE_MAX fails rather than holding the
+ * bus.
+ */
+static int
+Settle_INA226(int FD, INA226_t *INA226)
+{
+	I2C_Transaction_t Transaction;
+	unsigned char Value[2];
+	unsigned short Configuration;
+	long Period;
+
+	I2C_Begin(&Transaction);
+	(void) I2C_Add_Read(&Transaction, INA226->I2C_Address, 0x0, 2, Value);
+	if (I2C_Commit(FD, &Transaction) != 0) {
+		return -1;
+	}
+
+	/* AVG(11:9), VBUSCT(8:6), and VSHCT(5:3) */
+	Configuration = ((Value[0] << 8) | Value[1]);
+	Period = ((long)Averages[(Configuration >> 9) & 0x7] *
+		  (Conversion_Times[(Configuration >> 6) & 0x7] +
+		   Conversion_Times[(Configuration >> 3) & 0x7]));
+	if (Period > INA226_SETTLE_MAX) {
+		SC_ERR("INA226 %s has just been calibrated, its readings aren't "
+		       "ready yet", INA226->Name);
+		return -1;
+	}
+
+	(void) usleep(Period);
+	return 0;
+}
+
+/*
+ * Read Bus Voltage, Power, and Current of the INA226 in one go.  With
+ * Mode 0, the readings are scaled by the calibration computed from the
+ * board, which is programmed first if it isn't known to be, and is read
+ * back along with the readings, since it's reset to 0 when the INA226
+ * loses power.  If it doesn't match, it's programmed again and the
+ * readings are taken once more.  Either way, readings are only taken
+ * a conversion after the calibration is programmed, see Settle_INA226().
+ * With Mode 1, they're scaled by whatever the Calibration register holds.
+ * The caller must hold the bus.
+ */
+int
+Measure_INA226(int FD, INA226_t *INA226, int Mode, float *Voltage,
+	       float *Current, float *Power)
+{
+	I2C_Transaction_t Transaction;
+	unsigned char In_Buffer[4][2];
+	unsigned short Bus_Voltage, Power_Reg, Current_Reg, Calibration;
+	float Current_LSB;
+	int Ret;
+
+	if (Mode != 0 && Mode != 1) {
+		SC_ERR("invalid mode for getting power");
+		return -1;
+	}
+
+	if ((Mode == 0) && !INA226->Calibrated &&
+	    ((Calibrate_INA226(FD, INA226) != 0) ||
+	     (Settle_INA226(FD, INA226) != 0))) {
+		return -1;
+	}
 
-		/* Prevent the overflow of Calibration register[14:0] */
-		if (Calibration > 32767) {
-			Calibration = 32767;
+	for (int Attempt = 0; ; Attempt++) {
+		/* Bus Voltage(02h), Power(03h), Current(04h), and Calibration(05h) */
+		I2C_Begin(&Transaction);
+		for (int i = 0; i < 4; i++) {
+			(void) I2C_Add_Read(&Transaction, INA226->I2C_Address,
+					    (0x2 + i), 2, In_Buffer[i]);
 		}
 
-		/* Write 'Calibration' register */
-		(void) memset(Out_Buffer, 0, STRLEN_MAX);
-		Out_Buffer[0] = 0x5;   // Calibration Register(05h)
-		Out_Buffer[1] = ((unsigned short)Calibration >> 8);
-		Out_Buffer[2] = ((unsigned short)Calibration & 0xFF);
-		SC_INFO("Calibration Register(05h): %#x %#x", Out_Buffer[1],
-			 Out_Buffer[2]);
-		I2C_WRITE(FD, INA226->I2C_Address, 3, Out_Buffer, Ret);
+		Ret = I2C_Commit(FD, &Transaction);
 		if (Ret != 0) {
-			(void) close(FD);
 			return Ret;
 		}
 
-		(void) close(FD);
-	}
+		Calibration = ((In_Buffer[3][0] << 8) | In_Buffer[3][1]);
+		if ((Mode == 1) || (Calibration == INA226->Calibration)) {
+			break;
+		}
 
-	if (Read_INA226(INA226, &Regs) != 0) {
-		SC_ERR("failed to read INA226 registers");
-		return -1;
+		if (Attempt == 1) {
+			SC_ERR("calibration of INA226 %s doesn't hold", INA226->Name);
+			INA226->Calibrated = 0;
+			return -1;
+		}
+
+		SC_INFO("INA226 %s lost its calibration of %#x, it has %#x",
+			INA226->Name, INA226->Calibration, Calibration);
+		if ((Calibrate_INA226(FD, INA226) != 0) ||
+		    (Settle_INA226(FD, INA226) != 0)) {
+			return -1;
+		}
 	}
 
-	if (Regs.Calibration == 0) {
+	if (Calibration == 0) {
 		SC_ERR("invalid calibration register value of 0");
 		return -1;
 	}
 
-	Current_LSB = (0.00512 * 1000000) /
-		      (float)(Regs.Calibration * INA226->Shunt_Resistor);
-	SC_INFO("Calculating Current_LSB = %f", Current_LSB);
+	if (Mode == 0) {
+		Current_LSB = INA226->Current_LSB;
+	} else {
+		Current_LSB = (0.00512 * 1000000) /
+			      (float)(Calibration * INA226->Shunt_Resistor);
+	}
 
+	Bus_Voltage = ((In_Buffer[0][0] << 8) | In_Buffer[0][1]);
+	Power_Reg = ((In_Buffer[1][0] << 8) | In_Buffer[1][1]);
+	Current_Reg = ((In_Buffer[2][0] << 8) | In_Buffer[2][1]);
 	/* if Current is negative, use its absolute value */
-	*Current = (float)Regs.Current;
+	*Current = (float)Current_Reg;
 	if (*Current > 0x7FFF) {
 		*Current -= 0x10000;
 		*Current = abs(*Current);
 	}
 
-	SC_INFO("Current before LSB scaling %f", *Current);
 	*Current = ((*Current) * Current_LSB);
-	SC_INFO("Current before phase multiplier scaling %f", *Current);
 	*Current *= INA226->Phase_Multiplier;
 
-	*Voltage = (float)Regs.Bus_Voltage;
-	SC_INFO("Voltage before LSB scaling %f", *Voltage);
+	*Voltage = (float)Bus_Voltage;
 	*Voltage *= 1.25;       // 1.25 mV per bit
 	*Voltage /= 1000;
 
 	/* The power LSB has a fixed ratio to the Current_LSB of 25 */
-	*Power = ((float)Regs.Power * Current_LSB * 25);
-	SC_INFO("Power before phase multiplier scaling %f", *Power);
+	*Power = ((float)Power_Reg * Current_LSB * 25);
 	*Power *= INA226->Phase_Multiplier;
 
 	return 0;
 }
 
+int
+Get_Power(INA226_t *INA226, int Mode, float *Voltage, float *Current, float *Power)
+{
+	int FD;
+	int Ret;
+
+	FD = I2C_Open(INA226->I2C_Bus);
+	if (FD < 0) {
+		SC_ERR("unable to access I2C bus %s: %m", INA226->I2C_Bus);
+		return -1;
+	}
+
+	Ret = Measure_INA226(FD, INA226, Mode, Voltage, Current, Power);
+	I2C_Close(FD);
+	if (Ret != 0) {
+		SC_ERR("failed to read INA226 registers");
+		return Ret;
+	}
+
+	SC_INFO("Voltage: %f, Current: %f, Power: %f", *Voltage, *Current, *Power);
+	return 0;
+}
+
 /*
  * Power Operations
  */
-int Power_Ops(void)
+int Power_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	INA226s_t *INA226s;
@@ -1664,6 +2423,7 @@ int Power_Ops(void)
 	INA226_Regs_t Regs = { 0 };
 	unsigned long int Value;
 	char *Next_Token;
+	char *Save_Ptr;
 	float Voltage;
 	float Current;
 	float Power;
@@ -1674,7 +2434,7 @@ int Power_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTPOWER) {
+	if (Request->CmdId == LISTPOWER) {
 		for (int i = 0; i < INA226s->Numbers; i++) {
 			SC_PRINT("%s", INA226s->INA226[i].Name);
 		}
@@ -1683,13 +2443,18 @@ int Power_Ops(void)
 	}
 
 	/* Validate the power target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no power target");
 		return -1;
 	}
 
+	if ((Request->CmdId == GETPOWER) &&
+	    (strcmp(Request->Target_Arg, "all") == 0)) {
+		return Power_Snapshot();
+	}
+
 	for (int i = 0; i < INA226s->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)INA226s->INA226[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)INA226s->INA226[i].Name) == 0) {
 			Target_Index = i;
 			INA226 = &INA226s->INA226[Target_Index];
 			break;
@@ -1701,16 +2466,18 @@ int Power_Ops(void)
 		return -1;
 	}
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case GETPOWER:
 		if (Get_Power(INA226, 0, &Voltage, &Current, &Power) != 0) {
 			SC_ERR("failed to get power");
 			return -1;
 		}
 
-		SC_PRINT("Voltage(V):\t%.4f", Voltage);
-		SC_PRINT("Current(A):\t%.4f", Current);
-		SC_PRINT("Power(W):\t%.4f", Power);
+		Output_Begin(0);
+		Output_Float("voltage", "Voltage(V)", 4, Voltage);
+		Output_Float("current", "Current(A)", 4, Current);
+		Output_Float("power", "Power(W)", 4, Power);
+		Output_End();
 		break;
 
 	case GETCALPOWER:
@@ -1719,9 +2486,11 @@ int Power_Ops(void)
 			return -1;
 		}
 
-		SC_PRINT("Voltage(V):\t%.4f", Voltage);
-		SC_PRINT("Current(A):\t%.4f", Current);
-		SC_PRINT("Power(W):\t%.4f", Power);
+		Output_Begin(0);
+		Output_Float("voltage", "Voltage(V)", 4, Voltage);
+		Output_Float("current", "Current(A)", 4, Current);
+		Output_Float("power", "Power(W)", 4, Power);
+		Output_End();
 		break;
 
 	case GETINA226:
@@ -1730,24 +2499,26 @@ int Power_Ops(void)
 			return -1;
 		}
 
-		SC_PRINT("Configuration:\t%#x", Regs.Configuration);
-		SC_PRINT("Shunt Voltage:\t%#x", Regs.Shunt_Voltage);
-		SC_PRINT("Bus Voltage:\t%#x", Regs.Bus_Voltage);
-		SC_PRINT("Power:\t%#x", Regs.Power);
-		SC_PRINT("Current:\t%#x", Regs.Current);
-		SC_PRINT("Calibration:\t%#x", Regs.Calibration);
-		SC_PRINT("Mask/Enable:\t%#x", Regs.Mask_Enable);
-		SC_PRINT("Alert Limit:\t%#x", Regs.Alert_Limit);
-		SC_PRINT("Die ID:\t%#x", Regs.Die_ID);
+		Output_Begin(0);
+		Output_Hex("configuration", "Configuration", Regs.Configuration);
+		Output_Hex("shunt_voltage", "Shunt Voltage", Regs.Shunt_Voltage);
+		Output_Hex("bus_voltage", "Bus Voltage", Regs.Bus_Voltage);
+		Output_Hex("power", "Power", Regs.Power);
+		Output_Hex("current", "Current", Regs.Current);
+		Output_Hex("calibration", "Calibration", Regs.Calibration);
+		Output_Hex("mask_enable", "Mask/Enable", Regs.Mask_Enable);
+		Output_Hex("alert_limit", "Alert Limit", Regs.Alert_Limit);
+		Output_Hex("die_id", "Die ID", Regs.Die_ID);
+		Output_End();
 		break;
 
 	case SETINA226:
-		if (V_Flag == 0) {
+		if (Request->V_Flag == 0) {
 			SC_ERR("no INA226 value");
 			return -1;
 		}
 
-		Next_Token = strtok(Value_Arg, " ");
+		Next_Token = strtok_r(Request->Value_Arg, " ", &Save_Ptr);
 		if (Next_Token == NULL) {
 			SC_ERR("no value given for 'Configuration' register");
 			return -1;
@@ -1767,7 +2538,7 @@ int Power_Ops(void)
 			Regs.Set_Registers |= INA226_Configuration;
 		}
 
-		Next_Token = strtok(NULL, " ");
+		Next_Token = strtok_r(NULL, " ", &Save_Ptr);
 		if (Next_Token == NULL) {
 			SC_ERR("no value given for 'Calibration' register");
 			return -1;
@@ -1793,7 +2564,7 @@ int Power_Ops(void)
 			Regs.Set_Registers |= INA226_Calibration;
 		}
 
-		Next_Token = strtok(NULL, " ");
+		Next_Token = strtok_r(NULL, " ", &Save_Ptr);
 		if (Next_Token == NULL) {
 			SC_ERR("no value given for 'Mask/Enable' register");
 			return -1;
@@ -1813,7 +2584,7 @@ int Power_Ops(void)
 			Regs.Set_Registers |= INA226_Mask_Enable;
 		}
 
-		Next_Token = strtok(NULL, "\n");
+		Next_Token = strtok_r(NULL, "\n", &Save_Ptr);
 		if (Next_Token == NULL) {
 			SC_ERR("no value given for 'Alert Limit' register");
 			return -1;
@@ -1833,6 +2604,11 @@ int Power_Ops(void)
 			Regs.Set_Registers |= INA226_Alert_Limit;
 		}
 
+		/*
+		 * A new Calibration, or a reset through Configuration, undoes
+		 * the one 'getpower' relies on, so have it programmed again.
+		 */
+		INA226->Calibrated = 0;
 		if (Write_INA226(INA226, &Regs) != 0) {
 			SC_ERR("failed to write to INA226 registers");
 			return -1;
@@ -1848,19 +2624,235 @@ int Power_Ops(void)
 	return 0;
 }
 
+/*
+ * Power Statistics Operations
+ */
+int
+Power_Stats_Ops(Request_t *Request)
+{
+	if (Request->V_Flag) {
+		if (strcmp(Request->Value_Arg, "reset") != 0) {
+			SC_ERR("invalid powerstats value");
+			return -1;
+		}
+
+		Energy_Reset();
+		return 0;
+	}
+
+	return Energy_Print(Request->T_Flag ? Request->Target_Arg : NULL);
+}
+
+/*
+ * Power Trace Operations
+ */
+int
+Power_Trace_Ops(Request_t *Request)
+{
+	switch (Request->CmdId) {
+	case STARTTRACE:
+		return Capture_Start(Request);
+	case STOPTRACE:
+		return Capture_Stop();
+	case TRACESUMMARY:
+		return Capture_Summary();
+	default:
+		SC_ERR("invalid trace command");
+		return -1;
+	}
+}
+
+/*
+ * Watch Operations
+ *
+ * 'watch' and 'watchalert' are handled by Process_Request(), which hands
+ * them to Watch_Start() and Alert_Watch_Start().
+ */
+int
+Watch_Ops(Request_t *Request)
+{
+	SC_ERR("invalid watch operation");
+	return -1;
+}
+
 /*
  * Power Domain Operations
  */
-int Power_Domain_Ops(void)
+typedef struct {
+	INA226_t	*INA226;
+	int	Constrained;	/* Read through a 'Terminate' constraint */
+	int	Ret;
+	float	Voltage;
+	float	Current;
+	float	Power;
+	long long	Time;	/* Stats_Time() half way through the read */
+} Rail_Power_t;
+
+static int
+Rail_Power(void *Arg)
+{
+	Rail_Power_t *Rail = Arg;
+	long long Start = Stats_Time();
+	int Ret;
+
+	Ret = Get_Power(Rail->INA226, 0, &Rail->Voltage, &Rail->Current,
+			&Rail->Power);
+	Rail->Time = Start + ((Stats_Time() - Start) / 2);
+	return Ret;
+}
+
+/*
+ * Read every rail, with rails on different buses read at the same time,
+ * and print each along with when it was sampled relative to the first,
+ * followed by the total of each power domain and the spread of the
+ * samples it's made of.  Skew is the spread of all of the samples.
+ * Rails the board reads through a 'Terminate' constraint of 'getpower',
+ * and the power domains that include them, aren't read but flagged as
+ * constrained, so the snapshot doesn't disagree with 'getpower'.
+ */
+int
+Power_Snapshot(void)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Power_Domains_t *Power_Domains = Plat_Devs->Power_Domains;
+	Power_Domain_t *Power_Domain;
+	Rail_Power_t *Rails, *Rail;
+	Fanout_Op_t *Ops;
+	long long First = 0, Last = 0;
+	long long Domain_First, Domain_Last;
+	float Total_Power;
+	int Constrained;
+	int Numbers = 0;
+	int Ret = 0;
+
+	Rails = calloc(INA226s->Numbers, sizeof(Rail_Power_t));
+	Ops = calloc(INA226s->Numbers, sizeof(Fanout_Op_t));
+	if ((Rails == NULL) || (Ops == NULL)) {
+		SC_ERR("failed to allocate power snapshot: %m");
+		Ret = -1;
+		goto Out;
+	}
+
+	for (int i = 0; i < INA226s->Numbers; i++) {
+		Rails[i].INA226 = &INA226s->INA226[i];
+		Rails[i].Ret = -1;
+		if (Constraint_Terminates("getpower", INA226s->INA226[i].Name)) {
+			Rails[i].Constrained = 1;
+			continue;
+		}
+
+		Ops[Numbers].Bus = INA226s->INA226[i].I2C_Bus;
+		Ops[Numbers].Op = Rail_Power;
+		Ops[Numbers++].Arg = &Rails[i];
+	}
+
+	if ((Numbers > 0) && (Fanout(Ops, Numbers) != 0)) {
+		Ret = -1;
+	}
+
+	for (int i = 0; i < Numbers; i++) {
+		((Rail_Power_t *)Ops[i].Arg)->Ret = Ops[i].Ret;
+	}
+
+	for (int i = 0; i < INA226s->Numbers; i++) {
+		if (Rails[i].Ret != 0) {
+			continue;
+		}
+
+		if ((First == 0) || (Rails[i].Time < First)) {
+			First = Rails[i].Time;
+		}
+
+		Last = MAX(Last, Rails[i].Time);
+	}
+
+	for (int i = 0; i < INA226s->Numbers; i++) {
+		if (Rails[i].Constrained) {
+			Output_Begin(1);
+			Output_String("rail", NULL, Rails[i].INA226->Name);
+			Output_String("status", "Status", "constrained");
+			Output_End();
+			continue;
+		}
+
+		if (Rails[i].Ret != 0) {
+			continue;
+		}
+
+		Output_Begin(1);
+		Output_String("rail", NULL, Rails[i].INA226->Name);
+		Output_Float("voltage", "Voltage(V)", 4, Rails[i].Voltage);
+		Output_Float("current", "Current(A)", 4, Rails[i].Current);
+		Output_Float("power", "Power(W)", 4, Rails[i].Power);
+		Output_Int("offset_us", "Offset(us)", ((Rails[i].Time - First) / 1000));
+		Output_End();
+	}
+
+	for (int i = 0; (Power_Domains != NULL) && (i < Power_Domains->Numbers); i++) {
+		Power_Domain = &Power_Domains->Power_Domain[i];
+		Total_Power = 0;
+		Domain_First = 0;
+		Domain_Last = 0;
+		Constrained = 0;
+		for (int j = 0; j < Power_Domain->Numbers; j++) {
+			Rail = &Rails[Power_Domain->Rails[j]];
+			if (Rail->Constrained) {
+				Constrained = 1;
+				break;
+			}
+
+			if (Rail->Ret != 0) {
+				Total_Power = -1;
+				break;
+			}
+
+			Total_Power += Rail->Power;
+			if ((Domain_First == 0) || (Rail->Time < Domain_First)) {
+				Domain_First = Rail->Time;
+			}
+
+			Domain_Last = MAX(Domain_Last, Rail->Time);
+		}
+
+		if (Constrained) {
+			Output_Begin(1);
+			Output_String("domain", NULL, Power_Domain->Name);
+			Output_String("status", "Status", "constrained");
+			Output_End();
+			continue;
+		}
+
+		if (Total_Power < 0) {
+			SC_ERR("failed to get total power of %s", Power_Domain->Name);
+			continue;
+		}
+
+		Output_Begin(1);
+		Output_String("domain", NULL, Power_Domain->Name);
+		Output_Float("power", "Power(W)", 4, Total_Power);
+		Output_Int("skew_us", "Skew(us)", ((Domain_Last - Domain_First) / 1000));
+		Output_End();
+	}
+
+	Output_Begin(0);
+	Output_Int("skew_us", "Skew(us)", ((Last - First) / 1000));
+	Output_End();
+
+Out:
+	free(Rails);
+	free(Ops);
+	return Ret;
+}
+
+int Power_Domain_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	Power_Domains_t *Power_Domains;
 	Power_Domain_t *Power_Domain;
 	INA226s_t *INA226s;
 	INA226_t *INA226;
-	float Voltage;
-	float Current;
-	float Power;
+	Rail_Power_t Rails[ITEMS_MAX];
+	Fanout_Op_t Ops[ITEMS_MAX];
 	float Total_Power = 0;
 
 	Power_Domains = Plat_Devs->Power_Domains;
@@ -1869,7 +2861,7 @@ int Power_Domain_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTPOWERDOMAIN) {
+	if (Request->CmdId == LISTPOWERDOMAIN) {
 		for (int i = 0; i < Power_Domains->Numbers; i++) {
 			SC_PRINT("%s", Power_Domains->Power_Domain[i].Name);
 		}
@@ -1878,13 +2870,13 @@ int Power_Domain_Ops(void)
 	}
 
 	/* Validate the power domain target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no power domain target");
 		return -1;
 	}
 
 	for (int i = 0; i < Power_Domains->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)Power_Domains->Power_Domain[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)Power_Domains->Power_Domain[i].Name) == 0) {
 			Target_Index = i;
 			Power_Domain = &Power_Domains->Power_Domain[Target_Index];
 			break;
@@ -1896,20 +2888,30 @@ int Power_Domain_Ops(void)
 		return -1;
 	}
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case POWERDOMAIN:
+		/* Rails on different buses are read at the same time */
 		INA226s = Plat_Devs->INA226s;
 		for (int i = 0; i < Power_Domain->Numbers; i++) {
 			INA226 = &INA226s->INA226[Power_Domain->Rails[i]];
-			if (Get_Power(INA226, 0, &Voltage, &Current, &Power) == -1) {
-				SC_ERR("failed to get total power");
-				return -1;
-			}
+			Rails[i].INA226 = INA226;
+			Ops[i].Bus = INA226->I2C_Bus;
+			Ops[i].Op = Rail_Power;
+			Ops[i].Arg = &Rails[i];
+		}
+
+		if (Fanout(Ops, Power_Domain->Numbers) != 0) {
+			SC_ERR("failed to get total power");
+			return -1;
+		}
 
-			Total_Power += Power;
+		for (int i = 0; i < Power_Domain->Numbers; i++) {
+			Total_Power += Rails[i].Power;
 		}
 
-		SC_PRINT("Power(W):\t%.4f", Total_Power);
+		Output_Begin(0);
+		Output_Float("power", "Power(W)", 4, Total_Power);
+		Output_End();
 		break;
 
 	default:
@@ -1923,7 +2925,7 @@ int Power_Domain_Ops(void)
 /*
  * Workaround Operations
  */
-int Workaround_Ops(void)
+int Workaround_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	Workarounds_t *Workarounds;
@@ -1936,7 +2938,7 @@ int Workaround_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTWORKAROUND) {
+	if (Request->CmdId == LISTWORKAROUND) {
 		for (int i = 0; i < Workarounds->Numbers; i++) {
 			SC_PRINT("%s", Workarounds->Workaround[i].Name);
 		}
@@ -1945,13 +2947,13 @@ int Workaround_Ops(void)
 	}
 
 	/* Validate the workaround target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no workaround target");
 		return -1;
 	}
 
 	for (int i = 0; i < Workarounds->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)Workarounds->Workaround[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)Workarounds->Workaround[i].Name) == 0) {
 			Target_Index = i;
 			break;
 		}
@@ -1963,15 +2965,15 @@ int Workaround_Ops(void)
 	}
 
 	/* Does the workaround need argument? */
-	if (Workarounds->Workaround[Target_Index].Arg_Needed == 1 && V_Flag == 0) {
+	if (Workarounds->Workaround[Target_Index].Arg_Needed == 1 && Request->V_Flag == 0) {
 		SC_ERR("no workaround value");
 		return -1;
 	}
 
-	if (V_Flag == 0) {
+	if (Request->V_Flag == 0) {
 		Return = (*Workarounds->Workaround[Target_Index].Plat_Workaround_Op)(NULL);
 	} else {
-		Value = atol(Value_Arg);
+		Value = atol(Request->Value_Arg);
 		if (Value != 0 && Value != 1) {
 			SC_ERR("invalid value");
 			return -1;
@@ -1991,7 +2993,7 @@ int Workaround_Ops(void)
 /*
  * BIT Operations
  */
-int BIT_Ops(void)
+int BIT_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	BITs_t *BITs;
@@ -2005,7 +3007,7 @@ int BIT_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTBIT) {
+	if (Request->CmdId == LISTBIT) {
 		for (int i = 0; i < BITs->Numbers; i++) {
 			if (BITs->BIT[i].Manual) {
 				SC_PRINT("%s - Manual Test(%d)", BITs->BIT[i].Name,
@@ -2018,9 +3020,9 @@ int BIT_Ops(void)
 		return 0;
 	}
 
-	if (Command.CmdId == DESCRIBEBIT) {
+	if (Request->CmdId == DESCRIBEBIT) {
 		for (int i = 0; i < BITs->Numbers; i++) {
-			if (strcmp(Target_Arg, BITs->BIT[i].Name) == 0) {
+			if (strcmp(Request->Target_Arg, BITs->BIT[i].Name) == 0) {
 				SC_PRINT("%s", BITs->BIT[i].Description);
 				break;
 			}
@@ -2030,13 +3032,13 @@ int BIT_Ops(void)
 	}
 
 	/* Validate the BIT target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no BIT target");
 		return -1;
 	}
 
 	for (int i = 0; i < BITs->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)BITs->BIT[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)BITs->BIT[i].Name) == 0) {
 			Target_Index = i;
 			BIT = &BITs->BIT[Target_Index];
 			break;
@@ -2052,12 +3054,12 @@ int BIT_Ops(void)
 		return BIT->Level[0].Plat_BIT_Op(BIT, &Level);
 	}
 
-	if (V_Flag == 0) {
+	if (Request->V_Flag == 0) {
 		SC_ERR("no value is provided for multi-level BIT");
 		return -1;
 	}
 
-	Value = strtol(Value_Arg, NULL, 16);
+	Value = strtol(Request->Value_Arg, NULL, 16);
 	if (Value == 0 || Value > BIT->Levels) {
 		SC_ERR("invalid value for multi-level BIT");
 		return -1;
@@ -2108,7 +3110,7 @@ int DDR5_DIE_Per_Package[] = { 1, 2, 2, 4, 8, 16};
 /*
  * DDR Operations
  */
-int DDR_Ops(void)
+int DDR_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	DIMMs_t	*DIMMs;
@@ -2143,7 +3145,7 @@ int DDR_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTDDR) {
+	if (Request->CmdId == LISTDDR) {
 		for (int i = 0; i < DIMMs->Numbers; i++) {
 			SC_PRINT("%s", DIMMs->DIMM[i].Name);
 		}
@@ -2151,13 +3153,13 @@ int DDR_Ops(void)
 		return 0;
 	}
 
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no target is provided for getddr command");
 		return -1;
 	}
 
 	for (int i = 0; i < DIMMs->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)DIMMs->DIMM[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)DIMMs->DIMM[i].Name) == 0) {
 			Target_Index = i;
 			DIMM = &DIMMs->DIMM[Target_Index];
 			break;
@@ -2169,18 +3171,18 @@ int DDR_Ops(void)
 		return -1;
 	}
 
-	if (V_Flag == 0) {
+	if (Request->V_Flag == 0) {
 		SC_ERR("no value is provided for getddr command");
 		return -1;
 	}
 
-	FD = open(DIMM->I2C_Bus, O_RDWR);
+	FD = I2C_Open(DIMM->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("failed to open I2C bus %s: %m", DIMM->I2C_Bus);
 		return -1;
 	}
 
-	if (strcmp(Value_Arg, "temp") == 0) {
+	if (strcmp(Request->Value_Arg, "temp") == 0) {
 		/*
 		 * From SE98A datasheet:
 		 *	Temperature register (address 0x5, 16-bit value)
@@ -2197,7 +3199,7 @@ int DDR_Ops(void)
 		Out_Buffer[0] = 0x5;
 		I2C_READ(FD, DIMM->I2C_Address_Thermal, 2, Out_Buffer, In_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
@@ -2205,9 +3207,11 @@ int DDR_Ops(void)
 		Temp = ((In_Buffer[0] << 8) | In_Buffer[1]);
 		Temp <<= 3;
 		Temp /= 16;
-		SC_PRINT("Temperature(C):\t%.2f", ((float)Temp) * 0.125);
+		Output_Begin(0);
+		Output_Float("temperature", "Temperature(C)", 2, (((float)Temp) * 0.125));
+		Output_End();
 
-	} else if (strcmp(Value_Arg, "spd") == 0) {
+	} else if (strcmp(Request->Value_Arg, "spd") == 0) {
 		/*
 		 * Reading first 3 bytes to determine DDR type before reading SPD. Layout
 		 * of information differs between types.
@@ -2215,7 +3219,7 @@ int DDR_Ops(void)
 		Out_Buffer[0] = 0x0;
 		I2C_READ(FD, DIMM->I2C_Address_SPD, 0x3, Out_Buffer, In_Buffer, Ret);
 		if (Ret < 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
@@ -2244,7 +3248,7 @@ int DDR_Ops(void)
 			Out_Buffer[0] = 0x0;
 			I2C_WRITE(FD, 0x36, 1, Out_Buffer, Ret);
 			if (Ret < 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 
@@ -2259,7 +3263,7 @@ int DDR_Ops(void)
 			/* Last address offset with information in page 0 is byte 125 (0x7D). */
 			I2C_READ(FD, DIMM->I2C_Address_SPD, 0x7D, Out_Buffer, In_Buffer, Ret);
 			if (Ret < 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 
@@ -2277,7 +3281,7 @@ int DDR_Ops(void)
 			Out_Buffer[1] = 0x08;
 			I2C_WRITE(FD, DIMM->I2C_Address_SPD, 2, Out_Buffer, Ret);
 			if (Ret < 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 
@@ -2295,7 +3299,7 @@ int DDR_Ops(void)
 			/* Last address offset with information is byte 550 (0x226). */
 			I2C_READ_BYTES(FD, DIMM->I2C_Address_SPD, 2, 0x226, Out_Buffer, In_Buffer, Ret);
 			if (Ret < 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 		}
@@ -2473,14 +3477,14 @@ int DDR_Ops(void)
 			Out_Buffer[0] = 0x0;
 			I2C_WRITE(FD, 0x37, 1, Out_Buffer, Ret);
 			if (Ret < 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 
 			/* Last address offset with information in page 1 is byte 92 (0x5C). */
 			I2C_READ(FD, DIMM->I2C_Address_SPD, 0x5C, Out_Buffer, In_Buffer, Ret);
 			if (Ret < 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 
@@ -2518,18 +3522,18 @@ int DDR_Ops(void)
 			Out_Buffer[0] = 0x0;
 			I2C_WRITE(FD, 0x36, 1, Out_Buffer, Ret);
 			if (Ret < 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 		}
 
 
 	} else {
-		SC_ERR("%s is not a valid value", Value_Arg);
+		SC_ERR("%s is not a valid value", Request->Value_Arg);
 		Ret = -1;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	return Ret;
 }
 
@@ -2540,6 +3544,7 @@ static int GPIO_Get_All(void)
 	char Buffer[SYSCMD_MAX];
 	char Label[STRLEN_MAX];
 	char Usage[STRLEN_MAX];
+	char *Save_Ptr;
 
 	(void) strcpy(Buffer, "/usr/bin/gpioinfo");
 	FP = popen(Buffer, "r");
@@ -2554,10 +3559,10 @@ static int GPIO_Get_All(void)
 			continue;
 		}
 
-		(void) strtok(Buffer, " :\"");
-		(void) strtok(NULL, " :\"");
-		(void) strcpy(Label, strtok(NULL, " :\""));
-		(void) strcpy(Usage, strtok(NULL, " :\""));
+		(void) strtok_r(Buffer, " :\"", &Save_Ptr);
+		(void) strtok_r(NULL, " :\"", &Save_Ptr);
+		(void) strcpy(Label, strtok_r(NULL, " :\"", &Save_Ptr));
+		(void) strcpy(Usage, strtok_r(NULL, " :\"", &Save_Ptr));
 		if (strcmp(Usage, "unused") != 0) {
 			SC_PRINT("%s:\tbusy, used by %s", Label, Usage);
 			continue;
@@ -2579,7 +3584,7 @@ static int GPIO_Get_All(void)
 /*
  * GPIO Operations
  */
-int GPIO_Ops(void)
+int GPIO_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	GPIOs_t *GPIOs;
@@ -2596,7 +3601,7 @@ int GPIO_Ops(void)
 	}
 
 	GPIO_Groups = Plat_Devs->GPIO_Groups;
-	if (Command.CmdId == LISTGPIO) {
+	if (Request->CmdId == LISTGPIO) {
 		if (GPIO_Groups != NULL) {
 			for (int i = 0; i < GPIO_Groups->Numbers; i++) {
 				SC_PRINT("%s", GPIO_Groups->GPIO_Group[i].Name);
@@ -2611,13 +3616,13 @@ int GPIO_Ops(void)
 	}
 
 	/* A target argument is required */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no gpio target");
 		return -1;
 	}
 
 	/* Process '-c getgpio -t all' command here */
-	if ((Command.CmdId == GETGPIO) && (strcmp(Target_Arg, "all") == 0)) {
+	if ((Request->CmdId == GETGPIO) && (strcmp(Request->Target_Arg, "all") == 0)) {
 		if (GPIO_Get_All() != 0) {
 			SC_ERR("failed to get all GPIO lines");
 			return -1;
@@ -2627,8 +3632,8 @@ int GPIO_Ops(void)
 	}
 
 	for (int i = 0; i < GPIOs->Numbers; i++) {
-		if (!strncmp(GPIOs->GPIO[i].Display_Name, Target_Arg, STRLEN_MAX) ||
-		    !strncmp(GPIOs->GPIO[i].Internal_Name, Target_Arg, STRLEN_MAX)) {
+		if (!strncmp(GPIOs->GPIO[i].Display_Name, Request->Target_Arg, STRLEN_MAX) ||
+		    !strncmp(GPIOs->GPIO[i].Internal_Name, Request->Target_Arg, STRLEN_MAX)) {
 			Target_Index = i;
 			GPIO = &GPIOs->GPIO[Target_Index];
 			break;
@@ -2637,7 +3642,7 @@ int GPIO_Ops(void)
 
 	if (GPIO_Groups != NULL) {
 		for (int i = 0; i < GPIO_Groups->Numbers; i++) {
-			if (!strncmp(GPIO_Groups->GPIO_Group[i].Name, Target_Arg,
+			if (!strncmp(GPIO_Groups->GPIO_Group[i].Name, Request->Target_Arg,
 				     STRLEN_MAX)) {
 				Target_Index = i;
 				GPIO_Group = &GPIO_Groups->GPIO_Group[Target_Index];
@@ -2651,7 +3656,7 @@ int GPIO_Ops(void)
 		return -1;
 	}
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case GETGPIO:
 		if (GPIO_Group != NULL) {
 			for (int i = 0; i < GPIO_Group->Numbers; i++) {
@@ -2679,12 +3684,12 @@ int GPIO_Ops(void)
 		break;
 
 	case SETGPIO:
-		if (V_Flag == 0) {
+		if (Request->V_Flag == 0) {
 			SC_ERR("no gpio value");
 			return -1;
 		}
 
-		State = strtol(Value_Arg, NULL, 16);
+		State = strtol(Request->Value_Arg, NULL, 16);
 
 		if (GPIO_Group != NULL) {
 			if (GPIO_Group->Type == RW) {
@@ -2798,7 +3803,7 @@ int IO_Exp_Initialized(void)
 /*
  * IO Expander Operations
  */
-int IO_Exp_Ops(void)
+int IO_Exp_Ops(Request_t *Request)
 {
 	IO_Exp_t *IO_Exp;
 	unsigned long int Value;
@@ -2809,30 +3814,30 @@ int IO_Exp_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTIOEXP) {
+	if (Request->CmdId == LISTIOEXP) {
 		SC_PRINT("%s", IO_Exp->Name);
 		return 0;
 	}
 
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no IO expander target");
 		return -1;
 	}
 
-	if (strcmp(Target_Arg, IO_Exp->Name) != 0) {
+	if (strcmp(Request->Target_Arg, IO_Exp->Name) != 0) {
 		SC_ERR("invalid IO expander target");
 		return -1;
 	}
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case GETIOEXP:
 		/* A value argument is required */
-		if (V_Flag == 0) {
+		if (Request->V_Flag == 0) {
 			SC_ERR("no IO expander value");
 			return -1;
 		}
 
-		if (strcmp(Value_Arg, "all") == 0) {
+		if (strcmp(Request->Value_Arg, "all") == 0) {
 			if (Access_IO_Exp(IO_Exp, 0, 0x0,
 					  (unsigned int *)&Value) != 0) {
 				SC_ERR("failed to read input");
@@ -2857,7 +3862,7 @@ int IO_Exp_Ops(void)
 
 			SC_PRINT("Direction:\t%#x", (unsigned short) Value);
 
-		} else if (strcmp(Value_Arg, "input") == 0) {
+		} else if (strcmp(Request->Value_Arg, "input") == 0) {
 			if (Access_IO_Exp(IO_Exp, 0, 0x0,
 					  (unsigned int *)&Value) != 0) {
 				SC_ERR("failed to read input");
@@ -2871,7 +3876,7 @@ int IO_Exp_Ops(void)
 				}
 			}
 
-		} else if (strcmp(Value_Arg, "output") == 0) {
+		} else if (strcmp(Request->Value_Arg, "output") == 0) {
 			if (Access_IO_Exp(IO_Exp, 0, 0x2,
 					  (unsigned int *)&Value) != 0) {
 				SC_ERR("failed to read output");
@@ -2894,12 +3899,12 @@ int IO_Exp_Ops(void)
 
 	case SETDIRIOEXP:
 		/* Validate the value argument */
-		if (V_Flag == 0) {
+		if (Request->V_Flag == 0) {
 			SC_ERR("no IO expander value");
 			return -1;
 		}
 
-		Value = strtol(Value_Arg, NULL, 16);
+		Value = strtol(Request->Value_Arg, NULL, 16);
 		if (Access_IO_Exp(IO_Exp, 1, 0x6, (unsigned int *)&Value) != 0) {
 			SC_ERR("failed to set direction");
 			return -1;
@@ -2909,12 +3914,12 @@ int IO_Exp_Ops(void)
 
 	case SETOUTIOEXP:
 		/* Validate the value argument */
-		if (V_Flag == 0) {
+		if (Request->V_Flag == 0) {
 			SC_ERR("no IO expander value");
 			return -1;
 		}
 
-		Value = strtol(Value_Arg, NULL, 16);
+		Value = strtol(Request->Value_Arg, NULL, 16);
 		if (Access_IO_Exp(IO_Exp, 1, 0x2, (unsigned int *)&Value) != 0) {
 			SC_ERR("failed to set output");
 			return -1;
@@ -2934,11 +3939,33 @@ int IO_Exp_Ops(void)
 	return 0;
 }
 
+typedef struct {
+	int	Index;
+	Presence_t	Presence;
+} Probe_t;
+
+static int
+Probe_SFP_Op(void *Arg)
+{
+	Probe_t *Probe = Arg;
+
+	Probe->Presence = Probe_SFP(Probe->Index);
+	return ((Probe->Presence == PRESENCE_UNKNOWN) ? -1 : 0);
+}
+
+/*
+ * The modules of type 'sfp' and 'osfp' whose presence isn't known are
+ * probed at the same time, those on different buses in parallel, while
+ * the rest need the JTAG chain or the IO expander and are probed in turn.
+ */
 int SFP_List(void)
 {
 	SFPs_t *SFPs;
 	SFP_t *SFP;
-	int FD;
+	Presence_t Presence[ITEMS_MAX];
+	Probe_t Probes[ITEMS_MAX];
+	Fanout_Op_t Ops[ITEMS_MAX];
+	int Op_Numbers = 0;
 	char TCL_Path[SYSCMD_MAX];
 	char TCL_Args[STRLEN_MAX];
 	char Buffer[STRLEN_MAX];
@@ -2954,45 +3981,44 @@ int SFP_List(void)
 				return -1;
 			}
 
-			SC_PRINT("%s%s", SFP->Name, (atoi(Buffer) ?
-				 " - Not connected" : ""));
+			Presence[i] = (atoi(Buffer) ? PRESENCE_ABSENT : PRESENCE_PRESENT);
 			continue;
 		}
 
-		if (QSFP_ModuleSelect(SFP, 1) != 0) {
-			return -1;
-		}
-
-		FD = open(SFP->I2C_Bus, O_RDWR);
-		if (FD < 0) {
-			SC_ERR("failed to access I2C bus %s: %m", SFP->I2C_Bus);
-			(void) QSFP_ModuleSelect(SFP, 0);
-			return -1;
+		/* An empty cage known from the presence map isn't probed */
+		Presence[i] = Presence_Get(PRESENCE_SFP, i);
+		if (Presence[i] != PRESENCE_UNKNOWN) {
+			continue;
 		}
 
-		if (ioctl(FD, I2C_SLAVE_FORCE, SFP->I2C_Address) < 0) {
-			SC_ERR("failed to configure I2C bus for access to "
-			       "device address %#x: %m", SFP->I2C_Address);
-			(void) QSFP_ModuleSelect(SFP, 0);
-			(void) close(FD);
-			return -1;
-		}
+		if ((SFP->Type != sfp) && (SFP->Type != osfp)) {
+			Presence[i] = Probe_SFP(i);
+			if (Presence[i] == PRESENCE_UNKNOWN) {
+				return -1;
+			}
 
-		/*
-		 * If the read operation fails, it indicates that there is
-		 * no SFP device plugged into the connector referenced by
-		 * the I2C device address.
-		 */
-		if (read(FD, Buffer, 1) != 1) {
-			SC_PRINT("%s - Not connected", SFP->Name);
-			(void) QSFP_ModuleSelect(SFP, 0);
-			(void) close(FD);
 			continue;
 		}
 
-		SC_PRINT("%s", SFP->Name);
-		(void) QSFP_ModuleSelect(SFP, 0);
-		(void) close(FD);
+		Probes[Op_Numbers].Index = i;
+		Ops[Op_Numbers].Bus = SFP->I2C_Bus;
+		Ops[Op_Numbers].Op = Probe_SFP_Op;
+		Ops[Op_Numbers].Arg = &Probes[Op_Numbers];
+		Op_Numbers++;
+	}
+
+	if (Fanout(Ops, Op_Numbers) != 0) {
+		return -1;
+	}
+
+	for (int i = 0; i < Op_Numbers; i++) {
+		Presence[Probes[i].Index] = Probes[i].Presence;
+	}
+
+	for (int i = 0; i < SFPs->Numbers; i++) {
+		SFP = &SFPs->SFP[i];
+		SC_PRINT("%s%s", SFP->Name, ((Presence[i] == PRESENCE_ABSENT) ?
+			 " - Not connected" : ""));
 	}
 
 	return 0;
@@ -3001,7 +4027,7 @@ int SFP_List(void)
 /*
  * SFP Operations
  */
-int SFP_Ops(void)
+int SFP_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	unsigned long int Value;
@@ -3020,18 +4046,18 @@ int SFP_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTSFP) {
+	if (Request->CmdId == LISTSFP) {
 		return SFP_List();
 	}
 
 	/* Validate the SFP target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no SFP target");
 		return -1;
 	}
 
 	for (int i = 0; i < SFPs->Numbers; i++) {
-		if (strcmp(Target_Arg, (char *)SFPs->SFP[i].Name) == 0) {
+		if (strcmp(Request->Target_Arg, (char *)SFPs->SFP[i].Name) == 0) {
 			Target_Index = i;
 			SFP = &SFPs->SFP[Target_Index];
 			break;
@@ -3047,14 +4073,14 @@ int SFP_Ops(void)
 		return -1;
 	}
 
-	FD = open(SFP->I2C_Bus, O_RDWR);
+	FD = I2C_Open(SFP->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", SFP->I2C_Bus);
 		Ret = -1;
 		goto Out;
 	}
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case GETSFP:
 		/*
 		 * Reading offset 0x0 returns a value that identifies which type of
@@ -3334,7 +4360,7 @@ int SFP_Ops(void)
 
 Out:
 	(void) QSFP_ModuleSelect(SFP, 0);
-	(void) close(FD);
+	I2C_Close(FD);
 	return Ret;
 }
 
@@ -3345,13 +4371,13 @@ int EBM_List(void)
 	char Buffer[STRLEN_MAX];
 
 	Daughter_Card = Plat_Devs->Daughter_Card;
-	FD = open(Daughter_Card->I2C_Bus, O_RDWR);
+	FD = I2C_Open(Daughter_Card->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("failed to access I2C bus %s: %m", Daughter_Card->I2C_Bus);
 		return -1;
 	}
 
-	if (ioctl(FD, I2C_SLAVE_FORCE, Daughter_Card->I2C_Address) < 0) {
+	if (I2C_Set_Address(FD, Daughter_Card->I2C_Address) != 0) {
 		SC_ERR("failed to configure I2C bus for access to "
 		       "device address %#x: %m", Daughter_Card->I2C_Address);
 		return -1;
@@ -3362,9 +4388,9 @@ int EBM_List(void)
 	 * no daughter card plugged into the motherboard referenced by
 	 * the I2C device address.
 	 */
-	if (read(FD, Buffer, 1) != 1) {
+	if (I2C_Read(FD, Daughter_Card->I2C_Address, Buffer, 1) != 1) {
 		SC_PRINT("%s - Not connected", Daughter_Card->Name);
-		(void) close(FD);
+		I2C_Close(FD);
 		return 0;
 	}
 
@@ -3375,7 +4401,7 @@ int EBM_List(void)
 /*
  * EBM Operations
  */
-int EBM_Ops(void)
+int EBM_Ops(Request_t *Request)
 {
 	EEPROM_Targets Target;
 	Daughter_Card_t *Daughter_Card;
@@ -3390,40 +4416,40 @@ int EBM_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTEBM) {
+	if (Request->CmdId == LISTEBM) {
 		return EBM_List();
 	}
 
 	/* Validate the EBM target */
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no EBM target");
 		return -1;
 	}
 
-	if (strcmp(Target_Arg, Daughter_Card->Name) != 0) {
+	if (strcmp(Request->Target_Arg, Daughter_Card->Name) != 0) {
 		SC_ERR("invalid getEBM target");
 		return -1;
 	}
 
-	if (V_Flag == 0) {
+	if (Request->V_Flag == 0) {
 		SC_ERR("no value is provided for getEBM");
 		return -1;
 	}
 
-	if (strcmp(Value_Arg, "all") == 0) {
+	if (strcmp(Request->Value_Arg, "all") == 0) {
 		Target = EEPROM_ALL;
-	} else if (strcmp(Value_Arg, "common") == 0) {
+	} else if (strcmp(Request->Value_Arg, "common") == 0) {
 		Target = EEPROM_COMMON;
-	} else if (strcmp(Value_Arg, "board") == 0) {
+	} else if (strcmp(Request->Value_Arg, "board") == 0) {
 		Target = EEPROM_BOARD;
-	} else if (strcmp(Value_Arg, "multirecord") == 0) {
+	} else if (strcmp(Request->Value_Arg, "multirecord") == 0) {
 		Target = EEPROM_MULTIRECORD;
 	} else {
 		SC_ERR("invalid getEBM value");
 		return -1;
 	}
 
-	FD = open(Daughter_Card->I2C_Bus, O_RDWR);
+	FD = I2C_Open(Daughter_Card->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", Daughter_Card->I2C_Bus);
 		return -1;
@@ -3434,11 +4460,11 @@ int EBM_Ops(void)
 	Out_Buffer[0] = 0x0;
 	I2C_READ(FD, Daughter_Card->I2C_Address, 256, Out_Buffer, In_Buffer, Ret);
 	if (Ret != 0) {
-		(void) close(FD);
+		I2C_Close(FD);
 		return Ret;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	switch (Target) {
 	case EEPROM_ALL:
 		EEPROM_Print_All(In_Buffer, 256, 16);
@@ -3457,67 +4483,99 @@ int EBM_Ops(void)
 	return 0;
 }
 
-int FMC_List(void)
+typedef struct {
+	int	Index;
+	Presence_t	Presence;
+	char	Manufacturer[STRLEN_MAX];
+	char	Product[STRLEN_MAX];
+} FMC_Entry_t;
+
+/*
+ * If the FMC isn't known to be present, probe it, and if it's there,
+ * read its Manufacturer and its Product Name.
+ */
+static int
+Read_FMC_Entry(void *Arg)
 {
-	FMCs_t *FMCs;
-	FMC_t *FMC;
+	FMC_Entry_t *Entry = Arg;
+	FMC_t *FMC = &Plat_Devs->FMCs->FMC[Entry->Index];
 	int FD;
 	char In_Buffer[SYSCMD_MAX];
 	char Out_Buffer[SYSCMD_MAX];
-	char Buffer[STRLEN_MAX];
 	int Ret = 0;
 	int Offset, Length;
 
-	FMCs = Plat_Devs->FMCs;
-	for (int i = 0; i < FMCs->Numbers; i++) {
-		FMC = &FMCs->FMC[i];
-		FD = open(FMC->I2C_Bus, O_RDWR);
-		if (FD < 0) {
-			SC_ERR("unable to access I2C bus %s: %m", FMC->I2C_Bus);
+	/*
+	 * The probe fails if there is no FMC plugged into the connector
+	 * referenced by the I2C device address.
+	 */
+	Entry->Presence = Presence_Get(PRESENCE_FMC, Entry->Index);
+	if (Entry->Presence == PRESENCE_UNKNOWN) {
+		Entry->Presence = Probe_FMC(Entry->Index);
+		if (Entry->Presence == PRESENCE_UNKNOWN) {
 			return -1;
 		}
+	}
 
-		if (ioctl(FD, I2C_SLAVE_FORCE, FMC->I2C_Address) < 0) {
-			SC_ERR("unable to access I2C device address %#x",
-			       FMC->I2C_Address);
-			(void) close(FD);
-			return -1;
-		}
+	if (Entry->Presence == PRESENCE_ABSENT) {
+		return 0;
+	}
 
-		/*
-		 * If write fails, it indicates that there is no FMC plugged into
-		 * the connector referenced by the I2C device address.
-		 */
-		Out_Buffer[0] = 0x0;
-		if (write(FD, Out_Buffer, 1) != 1) {
-			SC_PRINT("%s - Not connected", FMC->Name);
-			(void) close(FD);
-			continue;
-		}
+	FD = I2C_Open(FMC->I2C_Bus);
+	if (FD < 0) {
+		SC_ERR("unable to access I2C bus %s: %m", FMC->I2C_Bus);
+		return -1;
+	}
 
-		/*
-		 * Since there is a FMC on this connector, read its Manufacturer
-		 * and its Product Name.
-		 */
-		(void) memset(Out_Buffer, 0, SYSCMD_MAX);
-		(void) memset(In_Buffer, 0, SYSCMD_MAX);
-		Out_Buffer[0] = 0x0;    // EEPROM offset 0
-		I2C_READ(FD, FMC->I2C_Address, 0xFF, Out_Buffer, In_Buffer, Ret);
-		if (Ret != 0) {
-			(void) close(FD);
-			return -1;
+	(void) memset(Out_Buffer, 0, SYSCMD_MAX);
+	(void) memset(In_Buffer, 0, SYSCMD_MAX);
+	Out_Buffer[0] = 0x0;    // EEPROM offset 0
+	I2C_READ(FD, FMC->I2C_Address, 0xFF, Out_Buffer, In_Buffer, Ret);
+	if (Ret != 0) {
+		I2C_Close(FD);
+		return -1;
+	}
+
+	I2C_Close(FD);
+	Offset = 0xE;
+	Length = (In_Buffer[Offset] & 0x3F);
+	snprintf(Entry->Manufacturer, Length + 1, "%s", &In_Buffer[Offset + 1]);
+	Offset = Offset + Length + 1;
+	Length = (In_Buffer[Offset] & 0x3F);
+	snprintf(Entry->Product, Length + 1, "%s", &In_Buffer[Offset + 1]);
+	return 0;
+}
+
+/*
+ * FMCs on different buses are read at the same time.
+ */
+int FMC_List(void)
+{
+	FMCs_t *FMCs;
+	FMC_Entry_t Entries[ITEMS_MAX];
+	Fanout_Op_t Ops[ITEMS_MAX];
+
+	FMCs = Plat_Devs->FMCs;
+	for (int i = 0; i < FMCs->Numbers; i++) {
+		Entries[i].Index = i;
+		Ops[i].Bus = FMCs->FMC[i].I2C_Bus;
+		Ops[i].Op = Read_FMC_Entry;
+		Ops[i].Arg = &Entries[i];
+	}
+
+	if (Fanout(Ops, FMCs->Numbers) != 0) {
+		return -1;
+	}
+
+	for (int i = 0; i < FMCs->Numbers; i++) {
+		if (Entries[i].Presence == PRESENCE_ABSENT) {
+			SC_PRINT("%s - Not connected", FMCs->FMC[i].Name);
+			continue;
 		}
 
-		(void) close(FD);
-		Offset = 0xE;
-		Length = (In_Buffer[Offset] & 0x3F);
-		snprintf(Buffer, Length + 1, "%s", &In_Buffer[Offset + 1]);
-		SC_INFO("%s - %s ", FMC->Name, Buffer);
-		SC_PRINT_N("%s - %s ", FMC->Name, Buffer);
-		Offset = Offset + Length + 1;
-		Length = (In_Buffer[Offset] & 0x3F);
-		snprintf(Buffer, Length + 1, "%s", &In_Buffer[Offset + 1]);
-		SC_PRINT("%s", Buffer);
+		SC_INFO("%s - %s ", FMCs->FMC[i].Name, Entries[i].Manufacturer);
+		SC_PRINT("%s - %s %s", FMCs->FMC[i].Name, Entries[i].Manufacturer,
+			 Entries[i].Product);
 	}
 
 	return 0;
@@ -3526,7 +4584,7 @@ int FMC_List(void)
 /*
  * FMC Operations
  */
-int FMC_Ops(void)
+int FMC_Ops(Request_t *Request)
 {
 	int Target_Index = -1;
 	FMCs_t *FMCs;
@@ -3535,6 +4593,7 @@ int FMC_Ops(void)
 	int FD;
 	char In_Buffer[SYSCMD_MAX];
 	char Out_Buffer[SYSCMD_MAX];
+	char *Save_Ptr;
 	int Ret = 0;
 
 	FMCs = Plat_Devs->FMCs;
@@ -3543,11 +4602,11 @@ int FMC_Ops(void)
 		return -1;
 	}
 
-	if (Command.CmdId == LISTFMC) {
+	if (Request->CmdId == LISTFMC) {
 		return FMC_List();
 	}
 
-	if (Command.CmdId == LISTFMCVOLTAGE) {
+	if (Request->CmdId == LISTFMCVOLTAGE) {
 		for (int i = 0; i < FMCs->Numbers; i++) {
 			FMC = &FMCs->FMC[i];
 			SC_PRINT_N("%s: %s - (", FMC->Name, FMC->Voltage_Regulator);
@@ -3564,12 +4623,12 @@ int FMC_Ops(void)
 		return 0;
 	}
 
-	if (T_Flag == 0) {
+	if (Request->T_Flag == 0) {
 		SC_ERR("no FMC target");
 		return -1;
 	}
 
-	(void) strcpy(Out_Buffer, strtok(Target_Arg, " - "));
+	(void) strcpy(Out_Buffer, strtok_r(Request->Target_Arg, " - ", &Save_Ptr));
 	for (int i = 0; i < FMCs->Numbers; i++) {
 		if (strcmp(Out_Buffer, FMCs->FMC[i].Name) == 0) {
 			Target_Index = i;
@@ -3583,25 +4642,25 @@ int FMC_Ops(void)
 		return -1;
 	}
 
-	if (V_Flag == 0) {
+	if (Request->V_Flag == 0) {
 		SC_ERR("no FMC value");
 		return -1;
 	}
 
-	if (strcmp(Value_Arg, "all") == 0) {
+	if (strcmp(Request->Value_Arg, "all") == 0) {
 		Area = EEPROM_ALL;
-	} else if (strcmp(Value_Arg, "common") == 0) {
+	} else if (strcmp(Request->Value_Arg, "common") == 0) {
 		Area = EEPROM_COMMON;
-	} else if (strcmp(Value_Arg, "board") == 0) {
+	} else if (strcmp(Request->Value_Arg, "board") == 0) {
 		Area = EEPROM_BOARD;
-	} else if (strcmp(Value_Arg, "multirecord") == 0) {
+	} else if (strcmp(Request->Value_Arg, "multirecord") == 0) {
 		Area = EEPROM_MULTIRECORD;
 	} else {
 		SC_ERR("invalid FMC value");
 		return -1;
 	}
 
-	FD = open(FMC->I2C_Bus, O_RDWR);
+	FD = I2C_Open(FMC->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", FMC->I2C_Bus);
 		return -1;
@@ -3612,11 +4671,11 @@ int FMC_Ops(void)
 	Out_Buffer[0] = 0x0;
 	I2C_READ(FD, FMC->I2C_Address, 256, Out_Buffer, In_Buffer, Ret);
 	if (Ret != 0) {
-		(void) close(FD);
+		I2C_Close(FD);
 		return Ret;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	switch (Area) {
 	case EEPROM_ALL:
 		EEPROM_Print_All(In_Buffer, 256, 16);
@@ -3679,19 +4738,19 @@ Validate_PDI(const char *PDI_File, char *Full_Path)
 }
 
 int
-PDI_Ops(void)
+PDI_Ops(Request_t *Request)
 {
 	char PDI_Path[SYSCMD_MAX], TCL_Path[SYSCMD_MAX];
 	char Output[SYSCMD_MAX] = { 0 };
 
-	switch (Command.CmdId) {
+	switch (Request->CmdId) {
 	case LOADPDI:
-		if (T_Flag == 0) {
+		if (Request->T_Flag == 0) {
 			SC_ERR("no target for PDI command");
 			return -1;
 		}
 
-		if (Validate_PDI(Target_Arg, PDI_Path) != 0) {
+		if (Validate_PDI(Request->Target_Arg, PDI_Path) != 0) {
 			return -1;
 		}
 
@@ -3709,16 +4768,16 @@ PDI_Ops(void)
 		break;
 
 	case SETBOOTPDI:
-		if (T_Flag == 0) {
+		if (Request->T_Flag == 0) {
 			SC_ERR("no target for PDI command");
 			return -1;
 		}
 
-		if (Validate_PDI(Target_Arg, PDI_Path) != 0) {
+		if (Validate_PDI(Request->Target_Arg, PDI_Path) != 0) {
 			return -1;
 		}
 
-		(void) sprintf(Output, "echo '%s' > %s; sync", Target_Arg, PDIFILE);
+		(void) sprintf(Output, "echo '%s' > %s; sync", Request->Target_Arg, PDIFILE);
 		if (Shell_Execute(Output) != 0) {
 			SC_ERR("failed to set boot PDI: %m");
 			return -1;
@@ -3964,6 +5023,7 @@ Boot_Set_Clocks(void)
 	Clock_t *Clock = NULL;
 	char Buffer[SYSCMD_MAX];
 	char Value[SYSCMD_MAX];
+	char *Save_Ptr;
 
 	/* Remove '8A34001' file, if there is one */
 	(void) remove(IDT8A34001FILE);
@@ -3982,8 +5042,8 @@ Boot_Set_Clocks(void)
 	Clocks = Plat_Devs->Clocks;
 	while (fgets(Buffer, SYSCMD_MAX, FP)) {
 		SC_INFO("%s: %s", CLOCKFILE, Buffer);
-		(void) strtok(Buffer, ":");
-		(void) strcpy(Value, strtok(NULL, "\n"));
+		(void) strtok_r(Buffer, ":", &Save_Ptr);
+		(void) strcpy(Value, strtok_r(NULL, "\n", &Save_Ptr));
 		for (int i = 0; i < Clocks->Numbers; i++) {
 			if (strcmp(Buffer, (char *)Clocks->Clock[i].Name) == 0) {
 				Clock = &Clocks->Clock[i];
@@ -4041,6 +5101,7 @@ Boot_Set_Voltages(void)
 	Voltage_t *Regulator = NULL;
 	char Buffer[SYSCMD_MAX];
 	char Value[STRLEN_MAX];
+	char *Save_Ptr;
 	float Voltage;
 
 	/* If there is no voltage file, there is nothing to do */
@@ -4057,8 +5118,8 @@ Boot_Set_Voltages(void)
 	Voltages = Plat_Devs->Voltages;
 	while (fgets(Buffer, SYSCMD_MAX, FP)) {
 		SC_INFO("%s: %s", VOLTAGEFILE, Buffer);
-		(void) strtok(Buffer, ":");
-		(void) strcpy(Value, strtok(NULL, "\n"));
+		(void) strtok_r(Buffer, ":", &Save_Ptr);
+		(void) strcpy(Value, strtok_r(NULL, "\n", &Save_Ptr));
 		for (int i = 0; i < Voltages->Numbers; i++) {
 			if (strcmp(Buffer, (char *)Voltages->Voltage[i].Name) == 0) {
 				Regulator = &Voltages->Voltage[i];
@@ -4085,6 +5146,7 @@ Boot_Load_PDI(void)
 	FILE *FP;
 	char PDI_Path[SYSCMD_MAX], TCL_Path[SYSCMD_MAX];
 	char Buffer[SYSCMD_MAX] = { 0 };
+	char *Save_Ptr;
 
 	/* If there is no PDIFILE, there is nothing to do */
 	if (access(PDIFILE, F_OK) != 0) {
@@ -4104,7 +5166,7 @@ Boot_Load_PDI(void)
 	}
 
 	/* Strip the new line character */
-	(void) strtok(Buffer, "\n");
+	(void) strtok_r(Buffer, "\n", &Save_Ptr);
 	SC_INFO("Load PDI file: %s", Buffer);
 	if (Validate_PDI(Buffer, PDI_Path) != 0) {
 		fclose(FP);
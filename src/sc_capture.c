@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <float.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Power Trace Capture
+ *
+ * 'starttrace' starts a thread that reads a set of INA226s every <value>
+ * microseconds, optionally at real-time priority, into CAPTURE_FILE until
+ * 'stoptrace' or until the file is full, and 'tracesummary' computes the
+ * statistics of each rail from the file, whether the capture is still
+ * running or not.
+ *
+ * The file is a Capture_Header_t followed by CAPTURE_RECORDS fixed-width
+ * Capture_Record_t.  It's allocated, mapped, and faulted in up front, so
+ * that the loop only reads the rails and stores their registers as they
+ * are, and Records in the header, which is updated after every round, is
+ * the number of valid records.  Power is the Power register times 25
+ * times Current_LSB times Phase_Multiplier of the rail in the header, and
+ * the file is truncated to the records that were taken when the capture
+ * stops.  The rails are calibrated when the capture starts, and every
+ * round holds the buses of all of them, so rounds are serialized with
+ * commands that access the same devices and are as coherent as can be.
+ */
+#define CAPTURE_FILE		DATADIR"/power_trace"
+#define CAPTURE_MAGIC		0x54504353	/* "SCPT" */
+#define CAPTURE_VERSION		2
+#define CAPTURE_RAILS_MAX	32
+#define CAPTURE_RECORDS		(1 << 20)
+#define CAPTURE_INTERVAL	1000	/* In microseconds */
+#define CAPTURE_INTERVAL_MIN	100
+
+typedef struct {
+	char	Name[STRLEN_MAX];
+	float	Current_LSB;	/* In Amps */
+	int32_t	Phase_Multiplier;
+} Capture_Rail_t;
+
+typedef struct {
+	uint32_t	Magic;
+	uint16_t	Version;
+	uint16_t	Header_Size;
+	uint16_t	Record_Size;
+	uint16_t	Rail_Numbers;
+	uint32_t	Interval;	/* In microseconds */
+	uint64_t	Start;		/* CLOCK_REALTIME in nanoseconds */
+	uint64_t	Capacity;	/* In records */
+	uint64_t	Records;
+	Capture_Rail_t	Rail[CAPTURE_RAILS_MAX];
+} Capture_Header_t;
+
+typedef struct {
+	uint64_t	Time;		/* In microseconds since the capture started */
+	uint8_t	Rail;
+	uint8_t	Status;		/* 0, or 1 if the rail couldn't be read */
+	uint16_t	Bus_Voltage;	/* Registers 02h, 03h, and 04h */
+	uint16_t	Power;
+	uint16_t	Current;
+} Capture_Record_t;
+
+typedef struct {
+	INA226_t	*INA226[CAPTURE_RAILS_MAX];
+	int	FD[CAPTURE_RAILS_MAX];
+	const char	*Buses[CAPTURE_RAILS_MAX];
+	int	Order[CAPTURE_RAILS_MAX];
+	int	Numbers;
+	long long	Interval;	/* In nanoseconds */
+	int	Realtime;
+	Request_t	*Request;
+	Capture_Header_t	*Header;
+	size_t	Size;
+	pthread_t	Thread;
+	int	Stop;
+} Capture_t;
+
+static pthread_mutex_t Capture_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Capture_t *Capture;
+
+/*
+ * Read the registers of the rail into the record.  The caller must hold
+ * the bus.
+ */
+static void
+Capture_Read(Capture_t *Trace, int Rail, Capture_Record_t *Record)
+{
+	INA226_t *INA226 = Trace->INA226[Rail];
+	I2C_Transaction_t Transaction;
+	unsigned char Buffer[3][2];
+
+	I2C_Begin(&Transaction);
+	for (int i = 0; i < 3; i++) {
+		(void) I2C_Add_Read(&Transaction, INA226->I2C_Address, (0x2 + i), 2,
+				    Buffer[i]);
+	}
+
+	Record->Rail = Rail;
+	Record->Status = (I2C_Commit(Trace->FD[Rail], &Transaction) != 0);
+	Record->Bus_Voltage = ((Buffer[0][0] << 8) | Buffer[0][1]);
+	Record->Power = ((Buffer[1][0] << 8) | Buffer[1][1]);
+	Record->Current = ((Buffer[2][0] << 8) | Buffer[2][1]);
+}
+
+static void *
+Capture_Thread(void *Arg)
+{
+	Capture_t *Trace = Arg;
+	Capture_Header_t *Header = Trace->Header;
+	Capture_Record_t *Records = (Capture_Record_t *)(Header + 1);
+	struct timespec Next;
+	long long Start = Stats_Time();
+	uint64_t Count = 0;
+	int Rail;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &Next);
+	while (!__atomic_load_n(&Trace->Stop, __ATOMIC_ACQUIRE) &&
+	       ((Count + Trace->Numbers) <= Header->Capacity)) {
+		Worker_Acquire(Trace->Request);
+		for (int i = 0; i < Trace->Numbers; i++) {
+			Rail = Trace->Order[i];
+			Records[Count].Time = (Stats_Time() - Start) / 1000;
+			Capture_Read(Trace, Rail, &Records[Count]);
+			Count++;
+		}
+
+		Worker_Release(Trace->Request);
+		__atomic_store_n(&Header->Records, Count, __ATOMIC_RELEASE);
+
+		Next.tv_nsec += Trace->Interval;
+		Next.tv_sec += Next.tv_nsec / 1000000000;
+		Next.tv_nsec %= 1000000000;
+		(void) clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Next, NULL);
+	}
+
+	return NULL;
+}
+
+/*
+ * Create the file and map it, faulting it in so that the loop doesn't.
+ */
+static int
+Capture_Map(Capture_t *Trace)
+{
+	Capture_Header_t *Header;
+	struct timespec Time;
+	void *Map;
+	int FD;
+	int Ret;
+
+	Trace->Size = sizeof(Capture_Header_t) +
+		      ((size_t)CAPTURE_RECORDS * sizeof(Capture_Record_t));
+	FD = open(CAPTURE_FILE, (O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC), 0644);
+	if (FD == -1) {
+		SC_ERR("failed to create %s: %m", CAPTURE_FILE);
+		return -1;
+	}
+
+	Ret = posix_fallocate(FD, 0, Trace->Size);
+	if (Ret != 0) {
+		SC_ERR("failed to allocate %s: %s", CAPTURE_FILE, strerror(Ret));
+		(void) close(FD);
+		return -1;
+	}
+
+	Map = mmap(NULL, Trace->Size, (PROT_READ | PROT_WRITE),
+		   (MAP_SHARED | MAP_POPULATE), FD, 0);
+	(void) close(FD);
+	if (Map == MAP_FAILED) {
+		SC_ERR("failed to map %s: %m", CAPTURE_FILE);
+		return -1;
+	}
+
+	Header = Map;
+	Header->Magic = CAPTURE_MAGIC;
+	Header->Version = CAPTURE_VERSION;
+	Header->Header_Size = sizeof(Capture_Header_t);
+	Header->Record_Size = sizeof(Capture_Record_t);
+	Header->Rail_Numbers = Trace->Numbers;
+	Header->Interval = Trace->Interval / 1000;
+	(void) clock_gettime(CLOCK_REALTIME, &Time);
+	Header->Start = ((uint64_t)Time.tv_sec * 1000000000) + Time.tv_nsec;
+	Header->Capacity = CAPTURE_RECORDS;
+	Header->Records = 0;
+	for (int i = 0; i < Trace->Numbers; i++) {
+		(void) strncpy(Header->Rail[i].Name, Trace->INA226[i]->Name,
+			       (STRLEN_MAX - 1));
+		Header->Rail[i].Current_LSB = Trace->INA226[i]->Current_LSB;
+		Header->Rail[i].Phase_Multiplier = Trace->INA226[i]->Phase_Multiplier;
+	}
+
+	Trace->Header = Header;
+	return 0;
+}
+
+/*
+ * Add the rails named by the comma-separated list, or every rail for
+ * 'all'.  Rails the board reads through a 'Terminate' constraint of
+ * 'getpower' can't be traced, so they're refused by name and left out of
+ * 'all'.
+ */
+static int
+Capture_Targets(Capture_t *Trace, char *Targets)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	char *Token, *Save_Ptr;
+	int Found;
+
+	for (Token = strtok_r(Targets, ",", &Save_Ptr); Token != NULL;
+	     Token = strtok_r(NULL, ",", &Save_Ptr)) {
+		Found = 0;
+		for (int i = 0; i < INA226s->Numbers; i++) {
+			if ((strcmp(Token, "all") != 0) &&
+			    (strcmp(Token, INA226s->INA226[i].Name) != 0)) {
+				continue;
+			}
+
+			if (Sensor_Constrained(SENSOR_POWER, INA226s->INA226[i].Name)) {
+				if (strcmp(Token, "all") != 0) {
+					SC_ERR("%s is read through a board constraint, "
+					       "it can't be traced", Token);
+					return -1;
+				}
+
+				continue;
+			}
+
+			Found = 1;
+			for (int j = 0; j < Trace->Numbers; j++) {
+				if (Trace->INA226[j] == &INA226s->INA226[i]) {
+					Found = 2;
+					break;
+				}
+			}
+
+			if (Found == 2) {
+				continue;
+			}
+
+			if (Trace->Numbers == CAPTURE_RAILS_MAX) {
+				SC_ERR("no more than %d rails can be traced",
+				       CAPTURE_RAILS_MAX);
+				return -1;
+			}
+
+			Trace->INA226[Trace->Numbers] = &INA226s->INA226[i];
+			Trace->Buses[Trace->Numbers] = INA226s->INA226[i].I2C_Bus;
+			Trace->FD[Trace->Numbers] = -1;
+			Add_Resource(Trace->Request, INA226s->INA226[i].I2C_Bus);
+			Trace->Numbers++;
+		}
+
+		if (!Found) {
+			SC_ERR("invalid trace target '%s'", Token);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Parse '<interval>[,realtime]'.
+ */
+static int
+Capture_Options(Capture_t *Trace, char *Value)
+{
+	char *End;
+	long Interval;
+
+	Interval = strtol(Value, &End, 10);
+	if ((End == Value) || (Interval < CAPTURE_INTERVAL_MIN) ||
+	    ((*End != '\0') && (strcmp(End, ",realtime") != 0))) {
+		SC_ERR("invalid trace value, expected <microseconds>[,realtime] "
+		       "of at least %d microseconds", CAPTURE_INTERVAL_MIN);
+		return -1;
+	}
+
+	Trace->Interval = Interval * 1000;
+	Trace->Realtime = (*End != '\0');
+	return 0;
+}
+
+static void
+Capture_Free(Capture_t *Trace)
+{
+	for (int i = 0; i < Trace->Numbers; i++) {
+		I2C_Close(Trace->FD[i]);
+	}
+
+	if (Trace->Header != NULL) {
+		(void) munmap(Trace->Header, Trace->Size);
+	}
+
+	free(Trace->Request);
+	free(Trace);
+}
+
+/*
+ * Start the capture of the rails of the request.
+ */
+int
+Capture_Start(Request_t *Request)
+{
+	Capture_t *Trace;
+	pthread_attr_t Attr;
+	struct sched_param Param = { 0 };
+	int Ret = -1;
+
+	if (Request->T_Flag == 0) {
+		SC_ERR("no trace target");
+		return -1;
+	}
+
+	if (Plat_Devs->INA226s == NULL) {
+		SC_ERR("power operation is not supported");
+		return -1;
+	}
+
+	(void) pthread_mutex_lock(&Capture_Lock);
+	if (Capture != NULL) {
+		SC_ERR("a trace is already being captured");
+		goto Out;
+	}
+
+	Trace = calloc(1, sizeof(Capture_t));
+	if (Trace != NULL) {
+		Trace->Request = calloc(1, sizeof(Request_t));
+	}
+
+	if ((Trace == NULL) || (Trace->Request == NULL)) {
+		SC_ERR("failed to allocate trace: %m");
+		free(Trace);
+		goto Out;
+	}
+
+	Trace->Request->Priority = PRIORITY_HIGH;
+	Trace->Interval = CAPTURE_INTERVAL * 1000;
+	if ((Request->V_Flag && (Capture_Options(Trace, Request->Value_Arg) != 0)) ||
+	    (Capture_Targets(Trace, Request->Target_Arg) != 0)) {
+		Capture_Free(Trace);
+		goto Out;
+	}
+
+	/* Calibrate the rails, as the power is scaled by their Current_LSB */
+	Worker_Acquire(Trace->Request);
+	for (int i = 0; i < Trace->Numbers; i++) {
+		Trace->FD[i] = I2C_Open(Trace->Buses[i]);
+		if ((Trace->FD[i] < 0) ||
+		    (Calibrate_INA226(Trace->FD[i], Trace->INA226[i]) != 0)) {
+			SC_ERR("failed to access %s", Trace->INA226[i]->Name);
+			Worker_Release(Trace->Request);
+			Capture_Free(Trace);
+			goto Out;
+		}
+	}
+
+	Worker_Release(Trace->Request);
+	I2C_Order(Trace->Buses, Trace->Numbers, Trace->Order);
+	if (Capture_Map(Trace) != 0) {
+		Capture_Free(Trace);
+		goto Out;
+	}
+
+	(void) pthread_attr_init(&Attr);
+	if (Trace->Realtime) {
+		Param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+		(void) pthread_attr_setinheritsched(&Attr, PTHREAD_EXPLICIT_SCHED);
+		(void) pthread_attr_setschedpolicy(&Attr, SCHED_FIFO);
+		(void) pthread_attr_setschedparam(&Attr, &Param);
+	}
+
+	Ret = pthread_create(&Trace->Thread, &Attr, Capture_Thread, Trace);
+	(void) pthread_attr_destroy(&Attr);
+	if (Ret != 0) {
+		SC_ERR("failed to create trace thread: %s", strerror(Ret));
+		Capture_Free(Trace);
+		Ret = -1;
+		goto Out;
+	}
+
+	Capture = Trace;
+	SC_PRINT("Tracing %d rails every %lld us to %s", Trace->Numbers,
+		 (Trace->Interval / 1000), CAPTURE_FILE);
+
+Out:
+	(void) pthread_mutex_unlock(&Capture_Lock);
+	return Ret;
+}
+
+/*
+ * Stop the capture, and truncate the file to the records that were taken.
+ */
+int
+Capture_Stop(void)
+{
+	Capture_t *Trace;
+	uint64_t Records;
+
+	(void) pthread_mutex_lock(&Capture_Lock);
+	Trace = Capture;
+	Capture = NULL;
+	(void) pthread_mutex_unlock(&Capture_Lock);
+	if (Trace == NULL) {
+		SC_ERR("no trace is being captured");
+		return -1;
+	}
+
+	__atomic_store_n(&Trace->Stop, 1, __ATOMIC_RELEASE);
+	(void) pthread_join(Trace->Thread, NULL);
+	Records = Trace->Header->Records;
+	(void) msync(Trace->Header, Trace->Size, MS_SYNC);
+	if (truncate(CAPTURE_FILE, (sizeof(Capture_Header_t) +
+				    (Records * sizeof(Capture_Record_t)))) == -1) {
+		SC_ERR("failed to truncate %s: %m", CAPTURE_FILE);
+	}
+
+	SC_PRINT("Captured %llu records to %s", (unsigned long long)Records,
+		 CAPTURE_FILE);
+	Capture_Free(Trace);
+	return 0;
+}
+
+/*
+ * Print the statistics of each rail of the capture, going over the
+ * records in place.  Time is that covered by the readings of the rail,
+ * and Interval the mean and maximum time between them.
+ */
+int
+Capture_Summary(void)
+{
+	Capture_Header_t *Header;
+	Capture_Record_t *Record;
+	Capture_Rail_t *Rail;
+	struct stat Stat;
+	uint64_t Records;
+	struct {
+		unsigned long long	Samples;
+		unsigned long long	Errors;
+		float	Min, Max;
+		double	Energy;
+		uint64_t	First, Last, Gap;
+	} Stats[CAPTURE_RAILS_MAX] = { 0 };
+	float Power;
+	int FD;
+
+	FD = open(CAPTURE_FILE, (O_RDONLY | O_CLOEXEC));
+	if (FD == -1) {
+		SC_ERR("failed to open %s: %m", CAPTURE_FILE);
+		return -1;
+	}
+
+	if ((fstat(FD, &Stat) == -1) || (Stat.st_size < sizeof(Capture_Header_t))) {
+		SC_ERR("invalid trace file %s", CAPTURE_FILE);
+		(void) close(FD);
+		return -1;
+	}
+
+	Header = mmap(NULL, Stat.st_size, PROT_READ, MAP_SHARED, FD, 0);
+	(void) close(FD);
+	if (Header == MAP_FAILED) {
+		SC_ERR("failed to map %s: %m", CAPTURE_FILE);
+		return -1;
+	}
+
+	Records = __atomic_load_n(&Header->Records, __ATOMIC_ACQUIRE);
+	if ((Header->Magic != CAPTURE_MAGIC) || (Header->Version != CAPTURE_VERSION) ||
+	    (Header->Rail_Numbers > CAPTURE_RAILS_MAX) ||
+	    (Stat.st_size < (sizeof(Capture_Header_t) +
+			     (Records * sizeof(Capture_Record_t))))) {
+		SC_ERR("invalid trace file %s", CAPTURE_FILE);
+		(void) munmap(Header, Stat.st_size);
+		return -1;
+	}
+
+	for (int i = 0; i < Header->Rail_Numbers; i++) {
+		Stats[i].Min = FLT_MAX;
+	}
+
+	Record = (Capture_Record_t *)(Header + 1);
+	for (uint64_t i = 0; i < Records; i++, Record++) {
+		if (Record->Rail >= Header->Rail_Numbers) {
+			continue;
+		}
+
+		if (Record->Status != 0) {
+			Stats[Record->Rail].Errors++;
+			continue;
+		}
+
+		/* Each reading is the power since the previous one */
+		Rail = &Header->Rail[Record->Rail];
+		Power = (float)Record->Power * Rail->Current_LSB * 25 *
+			Rail->Phase_Multiplier;
+		if (Stats[Record->Rail].Samples > 0) {
+			Stats[Record->Rail].Energy += Power *
+			    ((Record->Time - Stats[Record->Rail].Last) / 1e6);
+			Stats[Record->Rail].Gap = MAX(Stats[Record->Rail].Gap,
+			    (Record->Time - Stats[Record->Rail].Last));
+		} else {
+			Stats[Record->Rail].First = Record->Time;
+		}
+
+		Stats[Record->Rail].Last = Record->Time;
+		Stats[Record->Rail].Samples++;
+		Stats[Record->Rail].Min = MIN(Stats[Record->Rail].Min, Power);
+		Stats[Record->Rail].Max = MAX(Stats[Record->Rail].Max, Power);
+	}
+
+	for (int i = 0; i < Header->Rail_Numbers; i++) {
+		Output_Begin(1);
+		Output_String("rail", NULL, Header->Rail[i].Name);
+		Output_Int("samples", "Samples", Stats[i].Samples);
+		Output_Int("errors", "Errors", Stats[i].Errors);
+		if (Stats[i].Samples > 1) {
+			Output_Float("min_w", "Min(W)", 4, Stats[i].Min);
+			Output_Float("max_w", "Max(W)", 4, Stats[i].Max);
+			Output_Float("mean_w", "Mean(W)", 4, (Stats[i].Energy /
+				     ((Stats[i].Last - Stats[i].First) / 1e6)));
+			Output_Float("energy_j", "Energy(J)", 6, Stats[i].Energy);
+			Output_Float("time_s", "Time(s)", 6,
+				     ((Stats[i].Last - Stats[i].First) / 1e6));
+			Output_Int("interval_us", "Interval(us)",
+				   ((Stats[i].Last - Stats[i].First) / (Stats[i].Samples - 1)));
+			Output_Int("max_interval_us", "Max Interval(us)", Stats[i].Gap);
+		}
+
+		Output_End();
+	}
+
+	(void) munmap(Header, Stat.st_size);
+	return 0;
+}
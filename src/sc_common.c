@@ -22,7 +22,7 @@
 
 Plat_Devs_t *Plat_Devs;
 
-char SC_APP_File[SYSCMD_MAX];
+__thread char SC_APP_File[SYSCMD_MAX];
 extern char Board_Name[];
 extern char Silicon_Revision[];
 
@@ -65,35 +65,35 @@ Get_Product_Name(OnBoard_EEPROM_t *EEPROM, char *Product_Name)
 		return 0;
 	}
 
-	FD = open(EEPROM->I2C_Bus, O_RDWR);
+	FD = I2C_Open(EEPROM->I2C_Bus);
 	if (FD < 0) {
 		SC_INFO("unable to access I2C bus %s: %m", EEPROM->I2C_Bus);
 		return -1;
 	}
 
-	if (ioctl(FD, I2C_SLAVE_FORCE, EEPROM->I2C_Address) < 0) {
+	if (I2C_Set_Address(FD, EEPROM->I2C_Address) != 0) {
 		SC_INFO("unable to access onboard EEPROM address %#x",
 			EEPROM->I2C_Address);
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
 	Out_Buffer[0] = 0x0;
 	Out_Buffer[1] = 0x0;
-	if (write(FD, Out_Buffer, 2) != 2) {
+	if (I2C_Write(FD, EEPROM->I2C_Address, Out_Buffer, 2) != 2) {
 		SC_INFO("unable to set the offset address on onboard EEPROM");
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
 	(void) memset(In_Buffer, 0, SYSCMD_MAX);
-	if (read(FD, In_Buffer, 256) != 256) {
+	if (I2C_Read(FD, EEPROM->I2C_Address, In_Buffer, 256) != 256) {
 		SC_INFO("unable to read onboard EEPROM");
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 
 	Offset = 0x15;
 	Length = (In_Buffer[Offset] & 0x3F);
@@ -108,6 +108,7 @@ Find_OnBoard_EEPROM(OnBoard_EEPROM_t *OnBoard)
 {
 	glob_t Glob_Buffer;
 	char *Path, *Node, *CP;
+	char *Save_Ptr;
 
 	if (glob(ONBOARD_EEPROM_PATH, 0, NULL, &Glob_Buffer) != 0) {
 		SC_ERR("failed to find onboard EEPROM");
@@ -126,10 +127,10 @@ Find_OnBoard_EEPROM(OnBoard_EEPROM_t *OnBoard)
 	Node = strrchr(Path, '/');
 	Node++;
 	SC_INFO("Find EEPROM 1: %s", Node);
-	CP = strtok(Node, "-");
+	CP = strtok_r(Node, "-", &Save_Ptr);
 	SC_INFO("Find EEPROM 2: %s", CP);
 	(void) sprintf(OnBoard->I2C_Bus, "/dev/i2c-%d", (int)strtoul(CP, NULL, 10));
-	CP = strtok(NULL, "-");
+	CP = strtok_r(NULL, "-", &Save_Ptr);
 	SC_INFO("Find EEPROM 3: %s", CP);
 	OnBoard->I2C_Address = strtoul(CP, NULL, 16);
 
@@ -154,15 +155,46 @@ Board_Identification(char *Board_Name)
 	char Board_Path[LSTRLEN_MAX];
 	char Value[LSTRLEN_MAX];
 	char Config_Var[STRLEN_MAX];
+	int Simulated = 0;
+	int Replayed;
 	int Found = 0;
 
 	Plat_Devs = (Plat_Devs_t *)calloc(1, sizeof(Plat_Devs_t));
 
-	if (Find_OnBoard_EEPROM(&OnBoard_EEPROM) != 0) {
+	/*
+	 * If a recorded session is replayed, the board and its onboard EEPROM
+	 * are those of the recording, see sc_record.c.
+	 */
+	Replayed = Replay_Init(Board_Name, &OnBoard_EEPROM);
+	if (Replayed < 0) {
+		return -1;
+	}
+
+	/*
+	 * The devices of the board are simulated, rather than accessed, if
+	 * 'Simulator: 1' entry is in CONFIGFILE.  The board is then named by
+	 * 'Board' parameter, and its onboard EEPROM is a simulated one.
+	 */
+	if (Check_Config_File("Simulator", Config_Var, &Found) != 0) {
 		return -1;
 	}
 
-	if (Get_Product_Name(&OnBoard_EEPROM, Board_Name) != 0) {
+	if (!Replayed && Found && (atoi(Config_Var) >= 1)) {
+		if ((Check_Config_File("Board", Value, &Found) != 0) || !Found) {
+			SC_ERR("simulator needs 'Board' parameter in %s", CONFIGFILE);
+			return -1;
+		}
+
+		Simulated = 1;
+		(void) strcpy(Board_Name, Value);
+		(void) strcpy(OnBoard_EEPROM.I2C_Bus, SIM_EEPROM_BUS);
+		OnBoard_EEPROM.I2C_Address = SIM_EEPROM_ADDRESS;
+	} else if (!Replayed && (Find_OnBoard_EEPROM(&OnBoard_EEPROM) != 0)) {
+		return -1;
+	}
+
+	if (!Simulated && !Replayed &&
+	    (Get_Product_Name(&OnBoard_EEPROM, Board_Name) != 0)) {
 		SC_ERR("failed to identify the board");
 		return -1;
 	}
@@ -187,6 +219,17 @@ Board_Identification(char *Board_Name)
 			return -1;
 		}
 
+		Plat_Devs->OnBoard_EEPROM = &OnBoard_EEPROM;
+		if (Simulated) {
+			/* Silicon identification needs JTAG, which isn't simulated */
+			return Sim_Init(Board_Name);
+		}
+
+		if (Replayed) {
+			/* Nor is it recorded */
+			return 0;
+		}
+
 		/*
 		 * If silicon revision has not been identified during parsing of
 		 * JSON file, identify it now.
@@ -208,8 +251,9 @@ Board_Identification(char *Board_Name)
 				}
 			}
 		}
-
-		Plat_Devs->OnBoard_EEPROM = &OnBoard_EEPROM;
+	} else if (Simulated) {
+		SC_ERR("no board file to simulate '%s'", Board_Name);
+		return -1;
 	} else {
 		(void) strcpy(Board_Name, "Unknown");
 	}
@@ -275,13 +319,15 @@ Identify_PDI(char *Revision)
 int
 Silicon_Identification(char *Revision, int Length)
 {
+	char *Save_Ptr;
+
 	if (Revision[0] == 0) {
 		if (Get_IDCODE(Revision, Length) != 0) {
 			SC_ERR("failed to get silicon revision");
 			return -1;
 		}
 
-		(void) strtok(Revision, "\n");
+		(void) strtok_r(Revision, "\n", &Save_Ptr);
 		SC_INFO("Silicon Revision: %s", Revision);
 	}
 
@@ -296,27 +342,47 @@ Silicon_Identification(char *Revision, int Length)
 int
 Shell_Execute(char *Command)
 {
+	long long Start = Stats_Time();
 	FILE *FP;
+	int Ret;
+
+	if (Replay_Active()) {
+		return Replay_Event(RECORD_PROCESS, Command, NULL);
+	}
 
 	FP = popen(Command, "r");
 	if (FP == NULL) {
 		SC_ERR("failed to invoke '%s': %m", Command);
+		Record_Event(RECORD_PROCESS, Command, 0, -1, Start);
 		return -1;
 	}
 
 	SC_INFO("Shell Command: %s", Command);
-	return pclose(FP);
+	Ret = pclose(FP);
+	Record_Event(RECORD_PROCESS, Command, 0, Ret, Start);
+	return Ret;
 }
 
 int
 Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 {
+	static const int Limit_Registers[] = {
+		PMBUS_VOUT_OV_FAULT_LIMIT, PMBUS_VOUT_OV_WARN_LIMIT,
+		PMBUS_VOUT_UV_WARN_LIMIT, PMBUS_VOUT_UV_FAULT_LIMIT,
+	};
+	static const char *Limit_Names[] = {
+		"Overvoltage Fault", "Overvoltage Warning",
+		"Undervoltage Warning", "Undervoltage Fault",
+	};
+	I2C_Transaction_t Transaction;
+	unsigned char Limit_Buffer[ARRAY_SIZE(Limit_Registers)][2] = { 0 };
 	int FD;
 	char In_Buffer[STRLEN_MAX];
 	char Out_Buffer[STRLEN_MAX];
 	signed int Exponent;
 	short Mantissa;
 	int Get_Vout_Mode = 1;
+	unsigned char Vout_Mode = 0;
 	int Ret = 0;
 	float Current_Voltage, New_Voltage;
 	int Direction, Register;
@@ -339,23 +405,17 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 		}
 	}
 
-	FD = open(Regulator->I2C_Bus, O_RDWR);
+	FD = I2C_Open(Regulator->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access the I2C bus %s: %m", Regulator->I2C_Bus);
 		return -1;
 	}
 
 	/* Select the page, if the voltage regulator supports it */
-	if (Regulator->Page_Select != -1) {
-		Out_Buffer[0] = 0x0;
-		Out_Buffer[1] = Regulator->Page_Select;
-		SC_INFO("Write to select page: 0x%x%x", Out_Buffer[0],
-			Out_Buffer[1]);
-		I2C_WRITE(FD, Regulator->I2C_Address, 2, Out_Buffer, Ret);
-		if (Ret != 0) {
-			(void) close(FD);
-			return Ret;
-		}
+	Ret = PMBus_Select_Page(FD, Regulator, Access);
+	if (Ret != 0) {
+		I2C_Close(FD);
+		return Ret;
 	}
 
 	/*
@@ -365,38 +425,45 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 	 * Voltage =  Mantissa * 2 ^ -(Exponent)
 	 */
 
-	/* Regulators that don't support VOUT_MODE PMBus command */
-	if (!Regulator->PMBus_VOUT_MODE) {
+	/*
+	 * Regulators that don't support VOUT_MODE PMBus command, or whose
+	 * VOUT_MODE is known from an earlier access
+	 */
+	if (!Regulator->PMBus_VOUT_MODE ||
+	    (PMBus_Get_Mode(Regulator, &Vout_Mode) == 0)) {
 		Get_Vout_Mode = 0;
 	}
 
+	/* Get VOUT_MODE, if supported, along with the current VOUT */
+	(void) memset(In_Buffer, 0, STRLEN_MAX);
+	I2C_Begin(&Transaction);
 	if (1 == Get_Vout_Mode) {
-		Out_Buffer[0] = PMBUS_VOUT_MODE;
-		(void) memset(In_Buffer, 0, STRLEN_MAX);
-		I2C_READ(FD, Regulator->I2C_Address, 1, Out_Buffer, In_Buffer, Ret);
-		if (Ret != 0) {
-			(void) close(FD);
-			return Ret;
-		}
+		(void) I2C_Add_Read(&Transaction, Regulator->I2C_Address,
+				    PMBUS_VOUT_MODE, 1, &In_Buffer[2]);
+	}
+
+	(void) I2C_Add_Read(&Transaction, Regulator->I2C_Address,
+			    PMBUS_READ_VOUT, 2, &In_Buffer[0]);
+	Ret = I2C_Commit(FD, &Transaction);
+	if (Ret != 0) {
+		I2C_Close(FD);
+		return Ret;
+	}
 
-		SC_INFO("VOUT_MODE: %#x", In_Buffer[0]);
-		Data_Format = ((In_Buffer[0] & 0x80) >> 7);
-		Exponent = (In_Buffer[0] & 0x1F) - (sizeof(int) * 8);
+	if (1 == Get_Vout_Mode) {
+		Vout_Mode = In_Buffer[2];
+		PMBus_Set_Mode(Regulator, Vout_Mode);
+	}
 
+	if (Regulator->PMBus_VOUT_MODE) {
+		SC_INFO("VOUT_MODE: %#x", Vout_Mode);
+		Data_Format = ((Vout_Mode & 0x80) >> 7);
+		Exponent = (Vout_Mode & 0x1F) - (sizeof(int) * 8);
 	} else {
 		/* For non-compliant regulators, use exponent value -8 */
 		Exponent = -8;
 	}
 
-	/* Get the current VOUT */
-	Out_Buffer[0] = PMBUS_READ_VOUT;
-	(void) memset(In_Buffer, 0, STRLEN_MAX);
-	I2C_READ(FD, Regulator->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-	if (Ret != 0) {
-		(void) close(FD);
-		return Ret;
-	}
-
 	Mantissa = ((unsigned char)In_Buffer[1] << 8) | (unsigned char)In_Buffer[0];
 	Current_Voltage = Mantissa * pow(2, Exponent);
 	SC_INFO("Current Voltage(V): %.2f, Mantissa: %#x, Exponent: %#x",
@@ -409,6 +476,7 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 	case 1:
 		/* 1: voltage is increasing, 0: voltage is decreasing */
 		Direction = (*Voltage > Current_Voltage) ? 1 : 0;
+		PMBus_Invalidate(Regulator);
 
 		/* Disable VOUT */
 		Out_Buffer[0] = PMBUS_OPERATION;
@@ -416,7 +484,7 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 		SC_INFO("OPERATION: %#x %#x", Out_Buffer[0], Out_Buffer[1]);
 		I2C_WRITE(FD, Regulator->I2C_Address, 2, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
@@ -444,7 +512,7 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 			(void) memset(In_Buffer, 0, STRLEN_MAX);
 			I2C_READ(FD, Regulator->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
 			if (Ret != 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 
@@ -470,7 +538,7 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 					Out_Buffer[1], Out_Buffer[2]);
 				I2C_WRITE(FD, Regulator->I2C_Address, 3, Out_Buffer, Ret);
 				if (Ret != 0) {
-					(void) close(FD);
+					I2C_Close(FD);
 					return Ret;
 				}
 			}
@@ -493,7 +561,7 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 			(void) memset(In_Buffer, 0, STRLEN_MAX);
 			I2C_READ(FD, Regulator->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
 			if (Ret != 0) {
-				(void) close(FD);
+				I2C_Close(FD);
 				return Ret;
 			}
 
@@ -519,7 +587,7 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 					Out_Buffer[1], Out_Buffer[2]);
 				I2C_WRITE(FD, Regulator->I2C_Address, 3, Out_Buffer, Ret);
 				if (Ret != 0) {
-					(void) close(FD);
+					I2C_Close(FD);
 					return Ret;
 				}
 			}
@@ -536,7 +604,7 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 			Out_Buffer[1], Out_Buffer[2]);
 		I2C_WRITE(FD, Regulator->I2C_Address, 3, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
@@ -547,96 +615,49 @@ Access_Regulator(Voltage_t *Regulator, float *Voltage, int Access)
 		SC_INFO("OPERATION: %#x %#x", Out_Buffer[0], Out_Buffer[1]);
 		I2C_WRITE(FD, Regulator->I2C_Address, 2, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
 		break;
 	case 2:
-		/* Get Overvoltage Fault Limit */
-		Out_Buffer[0] = PMBUS_VOUT_OV_FAULT_LIMIT;
-		(void) memset(In_Buffer, 0, STRLEN_MAX);
-		I2C_READ(FD, Regulator->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-		if (Ret != 0) {
-			(void) close(FD);
-			return Ret;
+		/* Get all the limits in one go */
+		I2C_Begin(&Transaction);
+		for (int i = 0; i < ARRAY_SIZE(Limit_Registers); i++) {
+			(void) I2C_Add_Read(&Transaction, Regulator->I2C_Address,
+					    Limit_Registers[i], 2, Limit_Buffer[i]);
 		}
 
-		Mantissa = ((unsigned char)In_Buffer[1] << 8) | (unsigned char)In_Buffer[0];
-		*Voltage = Mantissa * pow(2, Exponent);
-		if (1 == Data_Format) {
-			/*
-			 * In relative data format, value calculated from mantissa is the
-			 * ratio of the voltage limit to the VOUT value. For actual voltage,
-			 * multiply ratio with VOUT value.
-			 */
-			*Voltage = *Voltage * Current_Voltage;
-		}
-
-		SC_PRINT("Overvoltage Fault Limit(V):\t%.2f\t(Reg 0x%x:\t0x%x)",
-		       *Voltage, PMBUS_VOUT_OV_FAULT_LIMIT, Mantissa);
-
-		/* Get Overvoltage Warning Limit */
-		Out_Buffer[0] = PMBUS_VOUT_OV_WARN_LIMIT;
-		(void) memset(In_Buffer, 0, STRLEN_MAX);
-		I2C_READ(FD, Regulator->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
+		Ret = I2C_Commit(FD, &Transaction);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
-		Mantissa = ((unsigned char)In_Buffer[1] << 8) | (unsigned char)In_Buffer[0];
-		*Voltage = Mantissa * pow(2, Exponent);
-		if (1 == Data_Format) {
-			*Voltage = *Voltage * Current_Voltage;
-		}
-
-		SC_PRINT("Overvoltage Warning Limit(V):\t%.2f\t(Reg 0x%x:\t0x%x)",
-		       *Voltage, PMBUS_VOUT_OV_WARN_LIMIT, Mantissa);
-
-		/* Get Undervoltage Warning Limit */
-		Out_Buffer[0] = PMBUS_VOUT_UV_WARN_LIMIT;
-		(void) memset(In_Buffer, 0, STRLEN_MAX);
-		I2C_READ(FD, Regulator->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-		if (Ret != 0) {
-			(void) close(FD);
-			return Ret;
-		}
-
-		Mantissa = ((unsigned char)In_Buffer[1] << 8) | (unsigned char)In_Buffer[0];
-		*Voltage = Mantissa * pow(2, Exponent);
-		if (1 == Data_Format) {
-			*Voltage = *Voltage * Current_Voltage;
-		}
-
-		SC_PRINT("Undervoltage Warning Limit(V):\t%.2f\t(Reg 0x%x:\t0x%x)",
-		       *Voltage, PMBUS_VOUT_UV_WARN_LIMIT, Mantissa);
-
-		/* Get Undervoltage Fault Limit */
-		Out_Buffer[0] = PMBUS_VOUT_UV_FAULT_LIMIT;
-		(void) memset(In_Buffer, 0, STRLEN_MAX);
-		I2C_READ(FD, Regulator->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
-		if (Ret != 0) {
-			(void) close(FD);
-			return Ret;
-		}
+		for (int i = 0; i < ARRAY_SIZE(Limit_Registers); i++) {
+			Mantissa = (Limit_Buffer[i][1] << 8) | Limit_Buffer[i][0];
+			*Voltage = Mantissa * pow(2, Exponent);
+			if (1 == Data_Format) {
+				/*
+				 * In relative data format, value calculated from mantissa is the
+				 * ratio of the voltage limit to the VOUT value. For actual voltage,
+				 * multiply ratio with VOUT value.
+				 */
+				*Voltage = *Voltage * Current_Voltage;
+			}
 
-		Mantissa = ((unsigned char)In_Buffer[1] << 8) | (unsigned char)In_Buffer[0];
-		*Voltage = Mantissa * pow(2, Exponent);
-		if (1 == Data_Format) {
-			*Voltage = *Voltage * Current_Voltage;
+			SC_PRINT("%s Limit(V):\t%.2f\t(Reg 0x%x:\t0x%x)",
+				 Limit_Names[i], *Voltage, Limit_Registers[i], Mantissa);
 		}
 
-		SC_PRINT("Undervoltage Fault Limit(V):\t%.2f\t(Reg 0x%x:\t0x%x)",
-		       *Voltage, PMBUS_VOUT_UV_FAULT_LIMIT, Mantissa);
 		break;
 	default:
 		SC_ERR("invalid regulator access");
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	return 0;
 }
 
@@ -665,7 +686,7 @@ Access_IO_Exp(IO_Exp_t *IO_Exp, int Op, int Offset, unsigned int *Data)
 		return -1;
 	}
 
-	FD = open(IO_Exp->I2C_Bus, O_RDWR);
+	FD = I2C_Open(IO_Exp->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", IO_Exp->I2C_Bus);
 		return -1;
@@ -677,7 +698,7 @@ Access_IO_Exp(IO_Exp_t *IO_Exp, int Op, int Offset, unsigned int *Data)
 		Out_Buffer[0] = Offset;
 		I2C_READ(FD, IO_Exp->I2C_Address, 2, Out_Buffer, In_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
@@ -693,17 +714,17 @@ Access_IO_Exp(IO_Exp_t *IO_Exp, int Op, int Offset, unsigned int *Data)
 			Out_Buffer[2]);
 		I2C_WRITE(FD, IO_Exp->I2C_Address, 3, Out_Buffer, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
 
 	} else {
 		SC_ERR("invalid access operation");
-		(void) close(FD);
+		I2C_Close(FD);
 		return -1;
 	}
 
-	(void) close(FD);
+	I2C_Close(FD);
 	return 0;
 }
 
@@ -718,7 +739,7 @@ FMC_Vadj_Range(FMC_t *FMC, float *Min_Voltage, float *Max_Voltage)
 	int Ret = 0;
 
 	/* Read FMC's EEPROM */
-	FD = open(FMC->I2C_Bus, O_RDWR);
+	FD = I2C_Open(FMC->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", FMC->I2C_Bus);
 		return -1;
@@ -729,7 +750,7 @@ FMC_Vadj_Range(FMC_t *FMC, float *Min_Voltage, float *Max_Voltage)
 	Out_Buffer[0] = 0x0;    // EEPROM offset 0
 	I2C_READ(FD, FMC->I2C_Address, 0xFF, Out_Buffer, In_Buffer, Ret);
 	if (Ret != 0) {
-		(void) close(FD);
+		I2C_Close(FD);
 		return Ret;
 	}
 
@@ -824,6 +845,11 @@ FMCAutoVadj_Op(void)
 	if (Legacy_Approach == 1) {
 		SC_INFO("Read IO Expander to determine FMC presence");
 		IO_Exp = Plat_Devs->IO_Exp;
+		if (IO_Exp == NULL) {
+			SC_ERR("no IO Expander to determine FMC presence");
+			return -1;
+		}
+
 		if (Access_IO_Exp(IO_Exp, 0, 0x0, &Value) != 0) {
 			SC_ERR("failed to read input of IO Expander");
 			return -1;
@@ -936,14 +962,25 @@ FMCAutoVadj_Op(void)
 	return 0;
 }
 
-int
-Get_GPIO(char *Label, int *State)
+static int
+Read_GPIO(char *Label, int *State)
 {
 	FILE *FP;
 	char Chip_Name[STRLEN_MAX];
 	char Buffer[SYSCMD_MAX];
 	char Output[STRLEN_MAX] = {'\0'};
 	unsigned int Line_Offset;
+	int Ret;
+
+	/* Lines held for events are read through their holder */
+	Ret = Presence_Line_State(Label, State);
+	if (Ret == 1) {
+		Ret = Alert_Line_State(Label, State);
+	}
+
+	if (Ret != 1) {
+		return Ret;
+	}
 
 	if (gpiod_ctxless_find_line(Label, Chip_Name, STRLEN_MAX,
 	    &Line_Offset) != 1) {
@@ -981,7 +1018,22 @@ Get_GPIO(char *Label, int *State)
 }
 
 int
-Set_GPIO(char *Label, int State)
+Get_GPIO(char *Label, int *State)
+{
+	long long Start = Stats_Time();
+	int Ret;
+
+	if (Replay_Active()) {
+		return Replay_Event(RECORD_GPIO_GET, Label, State);
+	}
+
+	Ret = Read_GPIO(Label, State);
+	Record_Event(RECORD_GPIO_GET, Label, ((Ret == 0) ? *State : -1), Ret, Start);
+	return Ret;
+}
+
+static int
+Write_GPIO(char *Label, int State)
 {
 	char Chip_Name[STRLEN_MAX];
 	char Buffer[SYSCMD_MAX];
@@ -1003,6 +1055,21 @@ Set_GPIO(char *Label, int State)
 	return 0;
 }
 
+int
+Set_GPIO(char *Label, int State)
+{
+	long long Start = Stats_Time();
+	int Ret;
+
+	if (Replay_Active()) {
+		return Replay_Event(RECORD_GPIO_SET, Label, &State);
+	}
+
+	Ret = Write_GPIO(Label, State);
+	Record_Event(RECORD_GPIO_SET, Label, State, Ret, Start);
+	return Ret;
+}
+
 int
 EEPROM_Common(char *Buffer)
 {
@@ -1111,7 +1178,7 @@ EEPROM_Board(char *Buffer, int PCIe)
 	return 0;
 }
 
-int Print_Filter;
+__thread int Print_Filter;
 
 #define DC_OUTPUT	0x1
 #define DC_LOAD		0x2
@@ -1364,14 +1431,15 @@ Check_Clock_Files(char *Clock_Files, char *TCS_File, char *TXT_File, char *BIN_F
 	char BIN[SYSCMD_MAX] = { 0 };
 	char Buffer[SYSCMD_MAX];
 	char Temp_Buffer[SYSCMD_MAX];
+	char *Save_Ptr;
 
 	/* If there is any Carriage Return at the end, remove it */
-	(void) strcpy(Temp_Buffer, strtok(Clock_Files, "\n"));
+	(void) strcpy(Temp_Buffer, strtok_r(Clock_Files, "\n", &Save_Ptr));
 
-	(void) strcpy(Buffer, strtok(Temp_Buffer, " "));
+	(void) strcpy(Buffer, strtok_r(Temp_Buffer, " ", &Save_Ptr));
 	if (strstr(Buffer, ".tcs") != NULL) {
 		(void) strcpy(TCS, Buffer);
-		(void) strcpy(Buffer, strtok(NULL, " "));
+		(void) strcpy(Buffer, strtok_r(NULL, " ", &Save_Ptr));
 		if (strstr(Buffer, ".txt") != NULL) {
 			(void) strcpy(TXT, Buffer);
 		} else {
@@ -1430,10 +1498,12 @@ int
 EEPROM_IDT_8A34001(Clock_t *Clock, char *BIN_File, int Verify)
 {
 	FILE *FP;
+	pid_t PID;
 	char Buffer[SYSCMD_MAX];
 	char Arg[STRLEN_MAX];
 	char Message[STRLEN_MAX];
 	char *Bus;
+	char *Save_Ptr;
 
 	(void) sprintf(Buffer, "%s%s", SCRIPT_PATH, PROGRAM_8A34001);
 	if (access(Buffer, F_OK) != 0) {
@@ -1449,24 +1519,25 @@ EEPROM_IDT_8A34001(Clock_t *Clock, char *BIN_File, int Verify)
 		(void) strcpy(Message, "Programming Complete");
 	}
 
-	Bus = strtok(Clock->I2C_Bus, "/dev/i2c-");
+	Bus = strtok_r(Clock->I2C_Bus, "/dev/i2c-", &Save_Ptr);
 	(void) sprintf(Buffer, "cd %s; python3 %s -f %s -b %i -d %i %s",
 		       SCRIPT_PATH, PROGRAM_8A34001, BIN_File, atoi(Bus),
 		       Clock->I2C_Address, Arg);
 	SC_INFO("Command: %s", Buffer);
-	FP = popen(Buffer, "r");
+	FP = Job_Popen(Buffer, &PID);
 	if (FP == NULL) {
 		SC_ERR("failed to invoke %s: %m", Buffer);
 		return -1;
 	}
 
 	while (fgets(Buffer, sizeof(Buffer), FP)) {
+		Job_Progress(Buffer);
 		if (strstr(Buffer, Message) != NULL) {
 			SC_INFO("Got '%s' output for '%s'", Message, BIN_File);
 		}
 	}
 
-	return pclose(FP);
+	return Job_Pclose(FP, PID);
 }
 
 int
@@ -1479,6 +1550,7 @@ Get_IDT_8A34001(Clock_t *Clock)
 	char Frequency[SYSCMD_MAX];
 	IDT_8A34001_Data_t *Clock_Data;
 	char Clock_File[LSTRLEN_MAX];
+	char *Save_Ptr;
 	char TCS_File[SYSCMD_MAX];
 	char TXT_File[SYSCMD_MAX];
 	char BIN_File[SYSCMD_MAX] = { 0 };
@@ -1530,7 +1602,7 @@ Get_IDT_8A34001(Clock_t *Clock)
 				if (strstr(File->d_name, ".bin") != NULL) {
 					(void) sprintf(BIN_File, "%s%s", CFS_Dirs[i], File->d_name);
 					if (EEPROM_IDT_8A34001_Verify(Clock, BIN_File) == 0) {
-						(void) sprintf(Clock_File, "%s", strtok(File->d_name, ".bin"));
+						(void) sprintf(Clock_File, "%s", strtok_r(File->d_name, ".bin", &Save_Ptr));
 						if (Set_IDT_8A34001(Clock, Clock_File, 0) != 0) {
 							SC_ERR("failed to configure 8A34001");
 							(void) closedir(DP);
@@ -1585,8 +1657,8 @@ Get_IDT_8A34001(Clock_t *Clock)
 			continue;
 		}
 
-		(void) strncpy(Label, strtok(Buffer, ":"), (sizeof(Label) - 1));
-		(void) strncpy(Frequency, strtok(NULL, "|"), (sizeof(Frequency) - 1));
+		(void) strncpy(Label, strtok_r(Buffer, ":", &Save_Ptr), (sizeof(Label) - 1));
+		(void) strncpy(Frequency, strtok_r(NULL, "|", &Save_Ptr), (sizeof(Frequency) - 1));
 		for (int i = 0; i < Clock_Data->Number_Label; i++) {
 			if (strcmp(Label, Clock_Data->Internal_Label[i]) == 0) {
 				if ((strcmp(Frequency, " ") != 0) &&
@@ -1648,6 +1720,7 @@ Set_IDT_8A34001(Clock_t *Clock, char *Clock_Files, int Mode)
 	char Data_String[SYSCMD_MAX];
 	char Data[SYSCMD_MAX];
 	char TCS_File[SYSCMD_MAX];
+	char *Save_Ptr;
 	char TXT_File[SYSCMD_MAX];
 	char BIN_File[SYSCMD_MAX] = { 0 };
 	char *Walk;
@@ -1662,7 +1735,7 @@ Set_IDT_8A34001(Clock_t *Clock, char *Clock_Files, int Mode)
 		return -1;
 	}
 
-	FD = open(Clock->I2C_Bus, O_RDWR);
+	FD = I2C_Open(Clock->I2C_Bus);
 	if (FD < 0) {
 		SC_ERR("unable to access I2C bus %s: %m", Clock->I2C_Bus);
 		return -1;
@@ -1677,7 +1750,7 @@ Set_IDT_8A34001(Clock_t *Clock, char *Clock_Files, int Mode)
 	Buffer[4] = 0x20;
 	I2C_WRITE(FD, Clock->I2C_Address, 5, Buffer, Ret);
 	if (Ret != 0) {
-		(void) close(FD);
+		I2C_Close(FD);
 		return Ret;
 	}
 
@@ -1706,10 +1779,10 @@ Set_IDT_8A34001(Clock_t *Clock, char *Clock_Files, int Mode)
 			Walk++;
 		}
 
-		(void) strtok(Buffer, ":");
-		(void) sscanf(strtok(NULL, ":"), "%x", &Size);
-		(void) sscanf(strtok(NULL, ":"), "%hhx", &Offset);
-		(void) strcpy(Data_String, strtok(NULL, "\n"));
+		(void) strtok_r(Buffer, ":", &Save_Ptr);
+		(void) sscanf(strtok_r(NULL, ":", &Save_Ptr), "%x", &Size);
+		(void) sscanf(strtok_r(NULL, ":", &Save_Ptr), "%hhx", &Offset);
+		(void) strcpy(Data_String, strtok_r(NULL, "\n", &Save_Ptr));
 
 		j = 0;
 		Data[j++] = Offset;
@@ -1744,9 +1817,12 @@ Set_IDT_8A34001(Clock_t *Clock, char *Clock_Files, int Mode)
 
 		I2C_WRITE(FD, Clock->I2C_Address, (Size + 1), Data, Ret);
 		if (Ret != 0) {
-			(void) close(FD);
+			I2C_Close(FD);
 			return Ret;
 		}
+
+		/* Sensor reads on the bus may go ahead between the writes */
+		Worker_Yield();
 	}
 
 	(void) fclose(FP);
@@ -1909,6 +1985,9 @@ Reset_Op(void)
 		return -1;
 	}
 
+	/* Regulators may come back with their defaults */
+	PMBus_Invalidate(NULL);
+
 	sleep(1);
 
 	/* De-assert POR */
@@ -1998,6 +2077,7 @@ int
 XSDB_Op(const char *TCL_File, const char *TCL_Args, char *Output, int Length)
 {
 	FILE *FP;
+	pid_t PID;
 	char System_Cmd[SYSCMD_MAX];
 	char Buffer[LSTRLEN_MAX];
 	char *Directory, *Filename;
@@ -2026,7 +2106,7 @@ XSDB_Op(const char *TCL_File, const char *TCL_Args, char *Output, int Length)
 	}
 
 	SC_INFO("Command: %s", System_Cmd);
-	FP = popen(System_Cmd, "r");
+	FP = Job_Popen(System_Cmd, &PID);
 	if (FP == NULL) {
 		SC_ERR("failed to invoke xsdb");
 		Ret = -1;
@@ -2035,10 +2115,11 @@ XSDB_Op(const char *TCL_File, const char *TCL_Args, char *Output, int Length)
 
 	while (fgets(Buffer, sizeof(Buffer), FP) != NULL) {
 		SC_INFO("XSDB Output: %s", Buffer);
+		Job_Progress(Buffer);
 		(void) strncpy(Output, Buffer, Length);
 	}
 
-	if (pclose(FP) != 0) {
+	if (Job_Pclose(FP, PID) != 0) {
 		SC_INFO("Command: %s failed!", System_Cmd);
 		Ret = -1;
 	}
@@ -2067,6 +2148,7 @@ Get_Temperature(Temperature_t *Temperature)
 	FILE *FP;
 	char Buffer[SYSCMD_MAX];
 	char *Temp;
+	char *Save_Ptr;
 	float Float_Temp;
 
 	(void) sprintf(Buffer, "/usr/bin/sensors %s 2>&1", Temperature->Sensor);
@@ -2087,10 +2169,12 @@ Get_Temperature(Temperature_t *Temperature)
 			continue;
 		}
 
-		(void) strtok(Buffer, " ");
-		Temp = strtok(NULL, " ");
+		(void) strtok_r(Buffer, " ", &Save_Ptr);
+		Temp = strtok_r(NULL, " ", &Save_Ptr);
 		Float_Temp = strtof(Temp, NULL);
-		SC_PRINT("Temperature(C):\t%3.1f", Float_Temp);
+		Output_Begin(0);
+		Output_Float("temperature", "Temperature(C)", 1, Float_Temp);
+		Output_End();
 	}
 
 	(void) pclose(FP);
@@ -2386,6 +2470,7 @@ Check_Config_File(char *Name, char *Value, int *Found)
 	FILE *FP;
 	char Name_String[STRLEN_MAX];
 	char Buffer[LSTRLEN_MAX];
+	char *Save_Ptr;
 
 	*Found = 0;
 	if (access(CONFIGFILE, F_OK) == 0) {
@@ -2399,12 +2484,12 @@ Check_Config_File(char *Name, char *Value, int *Found)
 		while (fgets(Buffer, LSTRLEN_MAX, FP)) {
 			if (strstr(Buffer, Name_String) != NULL) {
 				SC_INFO("%s: %s", CONFIGFILE, Buffer);
-				(void) strtok(Buffer, ":");
+				(void) strtok_r(Buffer, ":", &Save_Ptr);
 				if (strcmp(Buffer, Name) != 0) {
 					continue;
 				}
 
-				(void) strcpy(Value, strtok(NULL, " \n"));
+				(void) strcpy(Value, strtok_r(NULL, " \n", &Save_Ptr));
 				*Found = 1;
 				break;
 			}
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <float.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Energy Accounting
+ *
+ * A thread configures every INA226 for continuous conversion of shunt
+ * and bus voltage, with the Conversion_Time and Averaging of its rail,
+ * and reads each rail once per conversion period, i.e. when the INA226
+ * has a new average:
+ *
+ *	Period = 2 * Conversion_Time * Averaging
+ *
+ * Since a reading is the average over the period that precedes it, the
+ * energy of a rail is integrated as the power read times the time since
+ * the previous reading, so transients between readings are accounted
+ * for.  Rails are read on an absolute schedule, so that the period doesn't
+ * drift with the time reads take, and a rail that falls more than a period
+ * behind, e.g. as its bus was held by a long command, is rescheduled and
+ * the miss counted.  A failed read leaves a gap in the integration, which
+ * Time of the rail doesn't include, so Mean, i.e. Energy over Time, is
+ * still that of the power over the time covered.
+ *
+ * A rail that fails, e.g. as its bus can't be opened, is tried again every
+ * ENERGY_RETRY seconds rather than every period, so it doesn't flood the
+ * log.  Each rail is read while holding its I2C bus, the same way
+ * telemetry is published, and the statistics are kept from when sc_appd
+ * started or they were last reset.  Resetting them also configures the
+ * INA226s again, e.g. if setINA226 changed their Configuration meanwhile.
+ *
+ * Rails the board reads through a 'Terminate' constraint of 'getpower'
+ * are left alone, neither reconfigured nor accounted, since only the
+ * script of the constraint knows how to read them.
+ */
+#define ENERGY_RETRY	60
+
+static const int Conversion_Times[] = { INA226_CONVERSION_TIMES };
+static const int Averages[] = { INA226_AVERAGES };
+
+typedef struct {
+	INA226_t	*INA226;
+	int	FD;		/* -1 until the bus is opened */
+	int	Conversion_Time;	/* Codes in the Configuration */
+	int	Averaging;
+	int	Ready;		/* Configured for continuous sampling */
+	long long	Period;		/* In nanoseconds */
+	long long	Next;		/* Stats_Time() the rail is due */
+	long long	Last;		/* Stats_Time() of the last reading, or 0 */
+	unsigned long long	Samples;
+	unsigned long long	Errors;
+	unsigned long long	Misses;
+	float	Min;
+	float	Max;
+	double	Energy;		/* In Joules */
+	double	Time;		/* In seconds */
+} Energy_Rail_t;
+
+typedef struct {
+	Energy_Rail_t	*Rail;
+	int	Numbers;
+	const char	**Buses;
+	int	*Order;
+	Request_t	*Request;
+} Energy_t;
+
+static pthread_mutex_t Energy_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Energy_t *Energy;
+
+/*
+ * The code of the Conversion_Time or Averaging of the INA226.  A value
+ * the INA226 doesn't support is logged, and the first one is used.
+ */
+static int
+Energy_Code(INA226_t *INA226, const char *Field, int Value, const int *Values)
+{
+	for (int i = 0; i < 8; i++) {
+		if (Values[i] == Value) {
+			return i;
+		}
+	}
+
+	SC_ERR("invalid %s %d of %s, using %d", Field, Value, INA226->Name,
+	       Values[0]);
+	return 0;
+}
+
+/*
+ * Configure the INA226 of the rail for continuous sampling.  The caller
+ * must hold the bus.
+ */
+static int
+Energy_Configure(Energy_Rail_t *Rail)
+{
+	INA226_t *INA226 = Rail->INA226;
+	unsigned short Configuration;
+	char Out_Buffer[3];
+	int Ret = 0;
+
+	/* AVG(11:9), VBUSCT(8:6), VSHCT(5:3), and shunt and bus, continuous */
+	Configuration = (0x4000 | (Rail->Averaging << 9) |
+			 (Rail->Conversion_Time << 6) |
+			 (Rail->Conversion_Time << 3) | 0x7);
+	Out_Buffer[0] = 0x0;   // Configuration Register(00h)
+	Out_Buffer[1] = (Configuration >> 8);
+	Out_Buffer[2] = (Configuration & 0xFF);
+	SC_INFO("Configuration Register(00h): %#x %#x", Out_Buffer[1],
+		Out_Buffer[2]);
+	I2C_WRITE(Rail->FD, INA226->I2C_Address, 3, Out_Buffer, Ret);
+	return Ret;
+}
+
+/*
+ * Read the rail and account for it, opening its bus first if it isn't
+ * yet.  Returns -1 if it failed.
+ */
+static int
+Energy_Sample(Energy_Rail_t *Rail, long long Now)
+{
+	Request_t *Request = Energy->Request;
+	float Voltage, Current, Power;
+	int Ready;
+	int Ret = 0;
+
+	if (Rail->FD < 0) {
+		Rail->FD = I2C_Open(Rail->INA226->I2C_Bus);
+		if (Rail->FD < 0) {
+			SC_ERR("failed to access I2C bus %s: %m",
+			       Rail->INA226->I2C_Bus);
+			(void) pthread_mutex_lock(&Energy_Lock);
+			Rail->Errors++;
+			(void) pthread_mutex_unlock(&Energy_Lock);
+			return -1;
+		}
+	}
+
+	(void) pthread_mutex_lock(&Energy_Lock);
+	Ready = Rail->Ready;
+	(void) pthread_mutex_unlock(&Energy_Lock);
+
+	Request->Resource_Numbers = 0;
+	Add_Resource(Request, Rail->INA226->I2C_Bus);
+	Worker_Acquire(Request);
+	if (!Ready) {
+		Ret = Energy_Configure(Rail);
+	}
+
+	if (Ret == 0) {
+		Ret = Measure_INA226(Rail->FD, Rail->INA226, 0, &Voltage, &Current,
+				     &Power);
+	}
+
+	Worker_Release(Request);
+	(void) pthread_mutex_lock(&Energy_Lock);
+	if (Ret != 0) {
+		Rail->Errors++;
+		Rail->Ready = 0;
+		Rail->Last = 0;
+	} else {
+		Rail->Ready = 1;
+		if (Rail->Last != 0) {
+			Rail->Energy += Power * ((Now - Rail->Last) / 1e9);
+			Rail->Time += (Now - Rail->Last) / 1e9;
+		}
+
+		Rail->Last = Now;
+		Rail->Samples++;
+		Rail->Min = MIN(Rail->Min, Power);
+		Rail->Max = MAX(Rail->Max, Power);
+	}
+
+	(void) pthread_mutex_unlock(&Energy_Lock);
+	return Ret;
+}
+
+static void *
+Energy_Thread(__attribute__((unused)) void *Arg)
+{
+	Energy_Rail_t *Rail;
+	struct timespec Wake;
+	long long Now, Next;
+
+	while (1) {
+		Next = 0;
+		for (int i = 0; i < Energy->Numbers; i++) {
+			Rail = &Energy->Rail[Energy->Order[i]];
+			Now = Stats_Time();
+			if (Rail->Next <= Now) {
+				if (Energy_Sample(Rail, Now) != 0) {
+					Rail->Next = Now + (ENERGY_RETRY * 1000000000LL);
+				} else {
+					Rail->Next += Rail->Period;
+				}
+
+				if (Rail->Next <= Stats_Time()) {
+					Rail->Next = Stats_Time() + Rail->Period;
+					(void) pthread_mutex_lock(&Energy_Lock);
+					Rail->Misses++;
+					(void) pthread_mutex_unlock(&Energy_Lock);
+				}
+			}
+
+			if ((Next == 0) || (Rail->Next < Next)) {
+				Next = Rail->Next;
+			}
+		}
+
+		Wake.tv_sec = Next / 1000000000;
+		Wake.tv_nsec = Next % 1000000000;
+		(void) clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Wake, NULL);
+	}
+
+	return NULL;
+}
+
+static void
+Energy_Clear(Energy_Rail_t *Rail)
+{
+	Rail->Ready = 0;
+	Rail->Last = 0;
+	Rail->Samples = 0;
+	Rail->Errors = 0;
+	Rail->Misses = 0;
+	Rail->Min = FLT_MAX;
+	Rail->Max = 0;
+	Rail->Energy = 0;
+	Rail->Time = 0;
+}
+
+/*
+ * Start sampling the INA226s.  Failing to do so isn't fatal to sc_appd,
+ * which still serves commands.
+ */
+int
+Energy_Init(void)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Energy_Rail_t *Rail;
+	INA226_t *INA226;
+	pthread_t Thread;
+	long long Now;
+	int Ret = -1;
+
+	if ((INA226s == NULL) || (INA226s->Numbers == 0)) {
+		return 0;
+	}
+
+	Energy = calloc(1, sizeof(Energy_t));
+	if (Energy == NULL) {
+		SC_ERR("failed to allocate energy accounting: %m");
+		return -1;
+	}
+
+	Energy->Rail = calloc(INA226s->Numbers, sizeof(Energy_Rail_t));
+	Energy->Buses = calloc(INA226s->Numbers, sizeof(char *));
+	Energy->Order = calloc(INA226s->Numbers, sizeof(int));
+	Energy->Request = calloc(1, sizeof(Request_t));
+	if ((Energy->Rail == NULL) || (Energy->Buses == NULL) ||
+	    (Energy->Order == NULL) || (Energy->Request == NULL)) {
+		SC_ERR("failed to allocate energy accounting: %m");
+		goto Out;
+	}
+
+	Energy->Request->Priority = PRIORITY_HIGH;
+	Now = Stats_Time();
+	for (int i = 0; i < INA226s->Numbers; i++) {
+		INA226 = &INA226s->INA226[i];
+		if (Sensor_Constrained(SENSOR_POWER, INA226->Name)) {
+			continue;
+		}
+
+		Rail = &Energy->Rail[Energy->Numbers];
+		Rail->INA226 = INA226;
+		Rail->Conversion_Time = Energy_Code(Rail->INA226, "Conversion_Time",
+						    Rail->INA226->Conversion_Time,
+						    Conversion_Times);
+		Rail->Averaging = Energy_Code(Rail->INA226, "Averaging",
+					      Rail->INA226->Averaging, Averages);
+		Rail->Period = (2LL * Conversion_Times[Rail->Conversion_Time] *
+				Averages[Rail->Averaging] * 1000);
+		Rail->Next = Now;
+		Rail->FD = I2C_Open(Rail->INA226->I2C_Bus);
+		Energy_Clear(Rail);
+		Energy->Buses[Energy->Numbers++] = Rail->INA226->I2C_Bus;
+	}
+
+	if (Energy->Numbers == 0) {
+		Ret = 0;
+		goto Out;
+	}
+
+	/* Rails on a bus that can't be opened yet are opened when due */
+	I2C_Order(Energy->Buses, Energy->Numbers, Energy->Order);
+	Ret = pthread_create(&Thread, NULL, Energy_Thread, NULL);
+	if (Ret != 0) {
+		SC_ERR("failed to create energy accounting thread: %s", strerror(Ret));
+		Ret = -1;
+		goto Out;
+	}
+
+	(void) pthread_detach(Thread);
+	return 0;
+
+Out:
+	for (int i = 0; i < Energy->Numbers; i++) {
+		I2C_Close(Energy->Rail[i].FD);
+	}
+
+	free(Energy->Rail);
+	free(Energy->Buses);
+	free(Energy->Order);
+	free(Energy->Request);
+	free(Energy);
+	Energy = NULL;
+	return Ret;
+}
+
+/*
+ * Print the statistics of every rail, or of the one named Name.  Returns
+ * -1 if there is no such rail.
+ */
+int
+Energy_Print(const char *Name)
+{
+	Energy_Rail_t *Copy;
+	INA226_t *INA226;
+	int Found = 0;
+
+	if (Energy == NULL) {
+		SC_ERR("energy accounting is not running");
+		return -1;
+	}
+
+	Copy = malloc(Energy->Numbers * sizeof(Energy_Rail_t));
+	if (Copy == NULL) {
+		SC_ERR("failed to allocate energy statistics: %m");
+		return -1;
+	}
+
+	(void) pthread_mutex_lock(&Energy_Lock);
+	for (int i = 0; i < Energy->Numbers; i++) {
+		Copy[i] = Energy->Rail[Energy->Order[i]];
+	}
+
+	(void) pthread_mutex_unlock(&Energy_Lock);
+	for (int i = 0; i < Energy->Numbers; i++) {
+		INA226 = Copy[i].INA226;
+		if ((Name != NULL) && (strcmp(Name, INA226->Name) != 0)) {
+			continue;
+		}
+
+		Found = 1;
+		Output_Begin(1);
+		Output_String("rail", NULL, INA226->Name);
+		Output_Int("samples", "Samples", Copy[i].Samples);
+		Output_Int("errors", "Errors", Copy[i].Errors);
+		Output_Int("misses", "Misses", Copy[i].Misses);
+		Output_Int("period_us", "Period(us)", (Copy[i].Period / 1000));
+		Output_Float("min_w", "Min(W)", 4, ((Copy[i].Samples == 0) ? 0 : Copy[i].Min));
+		Output_Float("max_w", "Max(W)", 4, Copy[i].Max);
+		Output_Float("mean_w", "Mean(W)", 4,
+			     ((Copy[i].Time == 0) ? 0 : (Copy[i].Energy / Copy[i].Time)));
+		Output_Float("energy_j", "Energy(J)", 4, Copy[i].Energy);
+		Output_Float("time_s", "Time(s)", 3, Copy[i].Time);
+		Output_End();
+	}
+
+	free(Copy);
+	if ((Name != NULL) && !Found) {
+		SC_ERR("invalid powerstats target");
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+Energy_Reset(void)
+{
+	if (Energy == NULL) {
+		return;
+	}
+
+	(void) pthread_mutex_lock(&Energy_Lock);
+	for (int i = 0; i < Energy->Numbers; i++) {
+		Energy_Clear(&Energy->Rail[Energy->Order[i]]);
+	}
+
+	(void) pthread_mutex_unlock(&Energy_Lock);
+}
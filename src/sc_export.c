@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include "sc_app.h"
+#include "sc_telemetry.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Metrics Exporter
+ *
+ * An optional HTTP endpoint serving the readings of the sensors and the
+ * statistics of commands in the OpenMetrics text format, for Prometheus
+ * and the like.  It's enabled by an 'Exporter' entry in CONFIGFILE, set
+ * to either a TCP port, which is bound to the loopback address so that
+ * it has to be proxied to be reachable from the network, or the path of
+ * a Unix socket:
+ *
+ *	Exporter: 9100
+ *	Exporter: /run/sc_exporter.socket
+ *
+ * Readings are taken from the telemetry segment, see sc_telemetry.h, so
+ * scrapes never access a device, and scraping as often as the sensors
+ * are sampled adds no I2C traffic.  Scrapes are served one at a time.
+ * Names of sensors and power domains come from the board JSON, so they're
+ * escaped as label values.
+ */
+#define EXPORT_TIMEOUT	2	/* In seconds */
+#define LABEL_MAX	(2 * TELEMETRY_NAME_MAX)
+
+typedef struct {
+	Telemetry_Type_t	Type;
+	int	Value;
+	const char	*Family;
+	const char	*Help;
+	const char	*Label;
+} Gauge_t;
+
+static const Gauge_t Gauges[] = {
+	{ TELEMETRY_POWER, 0, "sc_rail_voltage_volts", "Bus voltage of power rails.", "rail" },
+	{ TELEMETRY_POWER, 1, "sc_rail_current_amperes", "Current of power rails.", "rail" },
+	{ TELEMETRY_POWER, 2, "sc_rail_power_watts", "Power of power rails.", "rail" },
+	{ TELEMETRY_VOLTAGE, 0, "sc_regulator_voltage_volts", "Output voltage of regulators.", "regulator" },
+	{ TELEMETRY_TEMPERATURE, 0, "sc_temperature_celsius", "Temperature of the board.", "sensor" },
+	{ TELEMETRY_DIMM, 0, "sc_dimm_temperature_celsius", "Temperature of DDR DIMMs.", "dimm" },
+	{ TELEMETRY_SFP, 0, "sc_sfp_temperature_celsius", "Temperature of SFP modules.", "sfp" },
+	{ TELEMETRY_SFP, 1, "sc_sfp_supply_voltage_volts", "Supply voltage of SFP modules.", "sfp" },
+};
+
+static const char *Type_Names[] = {
+	"power", "voltage", "temperature", "dimm", "sfp",
+};
+
+static int Export_FD = -1;
+
+/*
+ * Escape the backslashes, double quotes, and newlines of a label value,
+ * as the text format requires.  A value that doesn't fit in LABEL_MAX is
+ * truncated.
+ */
+static const char *
+Escape_Label(const char *Value, char *Label)
+{
+	int Length = 0;
+
+	for (; (*Value != '\0') && (Length < (LABEL_MAX - 2)); Value++) {
+		if ((*Value == '\\') || (*Value == '"')) {
+			Label[Length++] = '\\';
+			Label[Length++] = *Value;
+		} else if (*Value == '\n') {
+			Label[Length++] = '\\';
+			Label[Length++] = 'n';
+		} else {
+			Label[Length++] = *Value;
+		}
+	}
+
+	Label[Length] = '\0';
+	return Label;
+}
+
+/*
+ * Latest sample of every sensor, with a Status of -1 for sensors that
+ * have none.
+ */
+static Telemetry_Sample_t *
+Latest_Samples(Telemetry_t *Telemetry)
+{
+	Telemetry_Sample_t *Samples;
+	int Numbers = Telemetry->Header->Sensor_Numbers;
+
+	Samples = calloc(Numbers, sizeof(Telemetry_Sample_t));
+	if (Samples == NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < Numbers; i++) {
+		if (Telemetry_Latest(Telemetry, Telemetry_Sensor(Telemetry, i),
+				     &Samples[i]) != 1) {
+			Samples[i].Status = -1;
+		}
+	}
+
+	return Samples;
+}
+
+static void
+Export_Sensors(Telemetry_t *Telemetry, Telemetry_Sample_t *Samples)
+{
+	const Telemetry_Sensor_t *Sensor;
+	const Gauge_t *Gauge;
+	char Label[LABEL_MAX];
+	int Numbers = Telemetry->Header->Sensor_Numbers;
+
+	for (int i = 0; i < (sizeof(Gauges) / sizeof(Gauges[0])); i++) {
+		Gauge = &Gauges[i];
+		Sink_Printf("# TYPE %s gauge\n", Gauge->Family);
+		Sink_Printf("# HELP %s %s\n", Gauge->Family, Gauge->Help);
+		for (int j = 0; j < Numbers; j++) {
+			Sensor = Telemetry_Sensor(Telemetry, j);
+			if ((Sensor->Type == Gauge->Type) && (Samples[j].Status == 0)) {
+				Sink_Printf("%s{%s=\"%s\"} %f\n", Gauge->Family,
+					    Gauge->Label, Escape_Label(Sensor->Name, Label),
+					    Samples[j].Value[Gauge->Value]);
+			}
+		}
+	}
+
+	Sink_Printf("# TYPE sc_sensor_up gauge\n");
+	Sink_Printf("# HELP sc_sensor_up Whether the last sample of the sensor succeeded.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sensor = Telemetry_Sensor(Telemetry, i);
+		Sink_Printf("sc_sensor_up{sensor=\"%s\",type=\"%s\"} %d\n",
+			    Escape_Label(Sensor->Name, Label),
+			    Type_Names[Sensor->Type], (Samples[i].Status == 0));
+	}
+
+	Sink_Printf("# TYPE sc_sensor_samples counter\n");
+	Sink_Printf("# HELP sc_sensor_samples Samples taken of the sensor.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sensor = Telemetry_Sensor(Telemetry, i);
+		Sink_Printf("sc_sensor_samples_total{sensor=\"%s\",type=\"%s\"} %llu\n",
+			    Escape_Label(Sensor->Name, Label), Type_Names[Sensor->Type],
+			    (unsigned long long)Sensor->Count);
+	}
+}
+
+/*
+ * Total power of each power domain, the same as 'powerdomain' reports,
+ * skipping domains with any rail that has no reading.
+ */
+static void
+Export_Power_Domains(Telemetry_t *Telemetry, Telemetry_Sample_t *Samples)
+{
+	Power_Domains_t *Power_Domains = Plat_Devs->Power_Domains;
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Power_Domain_t *Power_Domain;
+	const Telemetry_Sensor_t *Sensor;
+	const char *Name;
+	char Label[LABEL_MAX];
+	float Total_Power;
+	int Found;
+
+	if ((Power_Domains == NULL) || (INA226s == NULL)) {
+		return;
+	}
+
+	Sink_Printf("# TYPE sc_power_domain_watts gauge\n");
+	Sink_Printf("# HELP sc_power_domain_watts Total power of power domains.\n");
+	for (int i = 0; i < Power_Domains->Numbers; i++) {
+		Power_Domain = &Power_Domains->Power_Domain[i];
+		Total_Power = 0;
+		Found = 1;
+		for (int j = 0; j < Power_Domain->Numbers; j++) {
+			Name = INA226s->INA226[Power_Domain->Rails[j]].Name;
+			Found = 0;
+			for (int k = 0; k < Telemetry->Header->Sensor_Numbers; k++) {
+				Sensor = Telemetry_Sensor(Telemetry, k);
+				if ((Sensor->Type == TELEMETRY_POWER) &&
+				    (strcmp(Sensor->Name, Name) == 0) &&
+				    (Samples[k].Status == 0)) {
+					Total_Power += Samples[k].Value[2];
+					Found = 1;
+					break;
+				}
+			}
+
+			if (!Found) {
+				break;
+			}
+		}
+
+		if (Found) {
+			Sink_Printf("sc_power_domain_watts{domain=\"%s\"} %f\n",
+				    Escape_Label(Power_Domain->Name, Label),
+				    Total_Power);
+		}
+	}
+}
+
+/*
+ * Read the HTTP request, which only needs to be a GET of '/metrics' or
+ * '/', and respond with the metrics.
+ */
+static void
+Serve_Scrape(int FD, Telemetry_t *Telemetry)
+{
+	Telemetry_Sample_t *Samples;
+	char Buffer[SYSCMD_MAX] = { 0 };
+	char Path[STRLEN_MAX];
+	Sink_t Sink;
+	int Length = 0;
+	int Ret;
+
+	while ((Length < (sizeof(Buffer) - 1)) &&
+	       (strstr(Buffer, "\r\n\r\n") == NULL)) {
+		Ret = recv(FD, &Buffer[Length], (sizeof(Buffer) - 1 - Length), 0);
+		if (Ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return;
+		}
+
+		if (Ret == 0) {
+			break;
+		}
+
+		Length += Ret;
+		Buffer[Length] = '\0';
+	}
+
+	Buffer[Length] = '\0';
+	Sink_Init(&Sink, FD);
+	SC_Sink = &Sink;
+	if ((sscanf(Buffer, "GET %63s ", Path) != 1) ||
+	    ((strcmp(Path, "/metrics") != 0) && (strcmp(Path, "/") != 0))) {
+		Sink_Printf("HTTP/1.0 404 Not Found\r\n"
+			    "Content-Type: text/plain\r\n\r\n"
+			    "Metrics are at /metrics\n");
+		goto Out;
+	}
+
+	Sink_Printf("HTTP/1.0 200 OK\r\n"
+		    "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n\r\n");
+
+	/* The publisher may not have created the segment by the first scrape */
+	if ((Telemetry->Header == NULL) && (Telemetry_Open(Telemetry) != 0)) {
+		Telemetry->Header = NULL;
+	}
+
+	if (Telemetry->Header != NULL) {
+		Samples = Latest_Samples(Telemetry);
+		if (Samples != NULL) {
+			Export_Sensors(Telemetry, Samples);
+			Export_Power_Domains(Telemetry, Samples);
+			free(Samples);
+		}
+	}
+
+	Stats_Export();
+	Worker_Export();
+	I2C_Export();
+	Sink_Printf("# EOF\n");
+Out:
+	(void) Sink_Flush(&Sink, NULL);
+	SC_Sink = NULL;
+	Sink_Free(&Sink);
+}
+
+static void *
+Export_Thread(void *Arg)
+{
+	Telemetry_t Telemetry = { 0 };
+	struct timeval Timeout = { .tv_sec = EXPORT_TIMEOUT };
+	int FD;
+
+	while (1) {
+		FD = accept(Export_FD, NULL, NULL);
+		if (FD == -1) {
+			if (errno != EINTR) {
+				SC_ERR("failed to accept scrape: %m");
+				(void) sleep(1);
+			}
+
+			continue;
+		}
+
+		/* A stalled scraper mustn't hold up the next one for long */
+		(void) setsockopt(FD, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+		(void) setsockopt(FD, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+		Serve_Scrape(FD, &Telemetry);
+		(void) close(FD);
+	}
+
+	return NULL;
+}
+
+static int
+Export_Socket(const char *Address)
+{
+	struct sockaddr_in Server_In = { 0 };
+	struct sockaddr_un Server_Un = { 0 };
+	const char *Char_p;
+	int Option = 1;
+
+	for (Char_p = Address; isdigit(*Char_p); Char_p++);
+	if (*Char_p == '\0') {
+		Export_FD = socket(AF_INET, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+		if (Export_FD == -1) {
+			SC_ERR("failed to call socket(2): %m");
+			return -1;
+		}
+
+		(void) setsockopt(Export_FD, SOL_SOCKET, SO_REUSEADDR, &Option,
+				  sizeof(Option));
+		Server_In.sin_family = AF_INET;
+		Server_In.sin_port = htons(atoi(Address));
+		Server_In.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (bind(Export_FD, (struct sockaddr *)&Server_In,
+			 sizeof(Server_In)) == -1) {
+			SC_ERR("failed to bind exporter to port %s: %m", Address);
+			return -1;
+		}
+	} else {
+		if (strlen(Address) >= sizeof(Server_Un.sun_path)) {
+			SC_ERR("exporter socket path %s is too long", Address);
+			return -1;
+		}
+
+		Export_FD = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+		if (Export_FD == -1) {
+			SC_ERR("failed to call socket(2): %m");
+			return -1;
+		}
+
+		Server_Un.sun_family = AF_UNIX;
+		(void) strcpy(Server_Un.sun_path, Address);
+		(void) unlink(Address);
+		if (bind(Export_FD, (struct sockaddr *)&Server_Un,
+			 sizeof(Server_Un)) == -1) {
+			SC_ERR("failed to bind exporter to %s: %m", Address);
+			return -1;
+		}
+
+		if (chmod(Address, (S_IRWXU|S_IRWXG|S_IRWXO)) == -1) {
+			SC_ERR("failed to change exporter socket permission: %m");
+			return -1;
+		}
+	}
+
+	if (listen(Export_FD, SOMAXCONN) == -1) {
+		SC_ERR("failed to call listen(2): %m");
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+Export_Init(void)
+{
+	char Address[LSTRLEN_MAX];
+	pthread_t Thread;
+	int Found = 0;
+	int Ret;
+
+	if (Check_Config_File("Exporter", Address, &Found) != 0) {
+		return -1;
+	}
+
+	if (!Found) {
+		return 0;
+	}
+
+	if (Export_Socket(Address) != 0) {
+		goto Out;
+	}
+
+	Ret = pthread_create(&Thread, NULL, Export_Thread, NULL);
+	if (Ret != 0) {
+		SC_ERR("failed to create exporter thread: %s", strerror(Ret));
+		goto Out;
+	}
+
+	(void) pthread_detach(Thread);
+	SC_INFO("Exporting metrics on %s", Address);
+	return 0;
+
+Out:
+	if (Export_FD != -1) {
+		(void) close(Export_FD);
+		Export_FD = -1;
+	}
+
+	return -1;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+/*
+ * Fan-out
+ *
+ * Commands that go over many devices, e.g. to list the FMCs or to check
+ * every regulator, may run the operation on each device through Fanout(),
+ * which groups the operations by I2C bus and runs the groups at the same
+ * time, each on a thread of its own.  Channels of a mux are one group, as
+ * their transfers go over the same wires, and the operations of a group
+ * run channel by channel, otherwise in the order they're given.  So a
+ * bus is never accessed by two threads at once, the mux is switched as
+ * little as it can be, and the command takes about as long as its
+ * slowest bus.
+ *
+ * The request must hold the buses of all of the operations.  Since they
+ * don't run on the thread of the request, operations must not call
+ * Worker_Yield() or run programs through Job_Popen().  What operations
+ * print is kept aside, and appended to the output of the request in the
+ * order of the operations once they're all done, so the output is the
+ * same as if they had run one after another.
+ */
+#define FANOUT_THREADS_MAX	16
+
+typedef struct {
+	Fanout_Op_t	*Ops;
+	Sink_t	*Sinks;
+	int	*Groups;
+	int	*Order;
+	int	Numbers;
+	int	Group;
+	int	Threaded;
+	pthread_t	Thread;
+} Fanout_Group_t;
+
+/*
+ * Output of operations is kept in their sink until it's appended to that
+ * of the request.
+ */
+static void
+Fanout_Keep(__attribute__((unused)) Sink_t *Sink)
+{
+}
+
+static void *
+Fanout_Run(void *Arg)
+{
+	Fanout_Group_t *Group = Arg;
+	Sink_t *Saved_Sink = SC_Sink;
+	int Index;
+
+	for (int i = 0; i < Group->Numbers; i++) {
+		Index = Group->Order[i];
+		if (Group->Groups[Index] != Group->Group) {
+			continue;
+		}
+
+		SC_Sink = &Group->Sinks[Index];
+		Group->Ops[Index].Ret = Group->Ops[Index].Op(Group->Ops[Index].Arg);
+	}
+
+	SC_Sink = Saved_Sink;
+	return NULL;
+}
+
+/*
+ * Run the operations, grouped by their bus or mux, and wait for all of them.
+ * Returns 0 if they all succeeded, or -1 if any of them failed, in which
+ * case the Ret of each operation tells which.
+ */
+int
+Fanout(Fanout_Op_t *Ops, int Numbers)
+{
+	Fanout_Group_t *Group;
+	const char **Buses;
+	Sink_t *Sinks;
+	int *Groups, *Order;
+	int Group_Numbers = 0;
+	int Threads = 0;
+	int Ret = 0;
+
+	Sinks = calloc(Numbers, sizeof(Sink_t));
+	Groups = calloc(Numbers, sizeof(int));
+	Group = calloc(Numbers, sizeof(Fanout_Group_t));
+	Buses = calloc(Numbers, sizeof(char *));
+	Order = calloc(Numbers, sizeof(int));
+	if ((Sinks == NULL) || (Groups == NULL) || (Group == NULL) ||
+	    (Buses == NULL) || (Order == NULL)) {
+		SC_ERR("failed to allocate memory for fan-out: %m");
+		Ret = -1;
+		goto Out;
+	}
+
+	/* Operations without a bus are a group of their own */
+	for (int i = 0; i < Numbers; i++) {
+		Groups[i] = Group_Numbers;
+		Buses[i] = Ops[i].Bus;
+		for (int j = 0; j < i; j++) {
+			if (I2C_Same_Root(Ops[i].Bus, Ops[j].Bus)) {
+				Groups[i] = Groups[j];
+				break;
+			}
+		}
+
+		if (Groups[i] == Group_Numbers) {
+			Group_Numbers++;
+		}
+
+		Sink_Init(&Sinks[i], -1);
+		Sinks[i].Drain = Fanout_Keep;
+		Ops[i].Ret = -1;
+	}
+
+	I2C_Order(Buses, Numbers, Order);
+	I2C_Count_Saved(Buses, Numbers, Order);
+
+	/* The first group, and any for which there is no thread, run here */
+	for (int i = 0; i < Group_Numbers; i++) {
+		Group[i].Ops = Ops;
+		Group[i].Sinks = Sinks;
+		Group[i].Groups = Groups;
+		Group[i].Order = Order;
+		Group[i].Numbers = Numbers;
+		Group[i].Group = i;
+		if ((i > 0) && (Threads < FANOUT_THREADS_MAX) &&
+		    (pthread_create(&Group[i].Thread, NULL, Fanout_Run, &Group[i]) == 0)) {
+			Group[i].Threaded = 1;
+			Threads++;
+		}
+	}
+
+	for (int i = 0; i < Group_Numbers; i++) {
+		if (!Group[i].Threaded) {
+			(void) Fanout_Run(&Group[i]);
+		}
+	}
+
+	for (int i = 0; i < Group_Numbers; i++) {
+		if (Group[i].Threaded) {
+			(void) pthread_join(Group[i].Thread, NULL);
+		}
+	}
+
+	for (int i = 0; i < Numbers; i++) {
+		if (Sinks[i].Length > 0) {
+			Sink_Printf("%s", Sinks[i].Buffer);
+		}
+
+		if (Ops[i].Ret != 0) {
+			Ret = -1;
+		}
+	}
+
+Out:
+	for (int i = 0; (Sinks != NULL) && (i < Numbers); i++) {
+		Sink_Free(&Sinks[i]);
+	}
+
+	free(Sinks);
+	free(Groups);
+	free(Group);
+	free(Buses);
+	free(Order);
+	return Ret;
+}
@@ -0,0 +1,1110 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * I2C Bus Registry
+ *
+ * Each I2C bus device is opened once and its descriptor is handed out to
+ * every accessor of the bus, rather than opening and closing the bus on
+ * every access.  The registry also keeps the slave address that was last
+ * set on each descriptor, so that setting it again for the same device
+ * is skipped.  Accessors hold the bus through the worker locks while
+ * they use it, which also serializes setting the address.
+ *
+ * The address is set per open file, so it must only be set through
+ * I2C_Set_Address() on descriptors from I2C_Open().
+ *
+ * The timeout and retries of the adapter of a bus, if given in the 'I2C'
+ * section of the board, are set when the bus is first opened, so that
+ * probing a device that isn't there fails within a bounded time.
+ *
+ * Buses are accessed through the backend, which is the kernel unless it's
+ * replaced, e.g. by the simulator, before any bus is opened.
+ */
+#define I2C_BUSES_MAX	32
+
+typedef struct {
+	char	Bus[STRLEN_MAX];
+	int	FD;
+	int	Address;	/* -1 if unknown */
+	int	Mux;		/* Index in I2C_Muxes, or -1 */
+	int	Channel;	/* Adapter number of the mux channel */
+} I2C_Bus_t;
+
+/*
+ * Mux Topology
+ *
+ * A bus may be a channel of an I2C mux, and switching a mux to another
+ * channel takes a write to the mux before the transfer.  When a bus is
+ * registered, sysfs tells whether it's a mux channel: the adapter of a
+ * channel has a 'mux_device' link, its parent directory is the mux, and
+ * the parent of that is the adapter the mux is on.  Muxes behind muxes
+ * are followed up to the root adapter, and all the channels under a root
+ * adapter are taken as one mux, as their transfers go over the same wires
+ * and the kernel serializes them anyway.
+ *
+ * I2C_Order() orders accesses to a set of buses so that those behind one
+ * channel are done before switching to the next, and I2C_Same_Root()
+ * tells which buses can't be accessed at the same time.  The switches are
+ * counted for each mux, as a transfer on another channel than the last
+ * one, along with those saved by ordering accesses.
+ */
+#define I2C_SYSFS	"/sys/bus/i2c/devices"
+#define I2C_MUX_DEPTH	8
+
+typedef struct {
+	char	Root[STRLEN_MAX];
+	int	Channel;	/* Last used, or -1 */
+	unsigned long long	Switches;
+	unsigned long long	Saved;
+} I2C_Mux_t;
+
+/*
+ * Transfer Statistics
+ *
+ * Every transfer that goes through I2C_Transfer(), I2C_Read(), or
+ * I2C_Write(), i.e. also the I2C_READ*() and I2C_WRITE() macros and
+ * I2C_Commit(), is counted for the device it addresses on its bus, along
+ * with the bytes it moved and its latency.  A batched transfer is counted
+ * once, for the device of its first message.  Failures where the device
+ * didn't acknowledge, which I2C adapters report as ENXIO or EREMOTEIO,
+ * are counted as NACKs, and any other failure, e.g. a timeout while the
+ * device stretches the clock, as an error.  Latencies are kept in a
+ * histogram with a bucket per power of two microseconds.
+ *
+ * While tracing is on, each transfer is also logged to a ring of the last
+ * I2C_TRACE_MAX transfers.
+ */
+#define I2C_DEVICES_MAX	128
+#define I2C_BUCKETS	33
+#define I2C_TRACE_MAX	1024
+
+typedef struct {
+	int	Bus;		/* Index in I2C_Buses, or -1 */
+	int	Address;
+	unsigned long long	Transfers;
+	unsigned long long	Bytes;
+	unsigned long long	NACKs;
+	unsigned long long	Errors;
+	unsigned long long	Sum;	/* In microseconds */
+	unsigned int	Max;
+	unsigned int	Bucket[I2C_BUCKETS];
+} I2C_Device_Stats_t;
+
+typedef struct {
+	long long	Time;	/* CLOCK_REALTIME in nanoseconds */
+	int	Bus;
+	int	Address;
+	int	Read;
+	int	Bytes;
+	int	Error;	/* errno, or 0 */
+	unsigned int	Latency;	/* In microseconds */
+} I2C_Trace_t;
+
+static pthread_mutex_t I2C_Lock = PTHREAD_MUTEX_INITIALIZER;
+static I2C_Bus_t I2C_Buses[I2C_BUSES_MAX];
+static int I2C_Bus_Numbers;
+static I2C_Mux_t I2C_Muxes[I2C_BUSES_MAX];
+static int I2C_Mux_Numbers;
+static I2C_Device_Stats_t I2C_Devices[I2C_DEVICES_MAX];
+static int I2C_Device_Numbers;
+static I2C_Trace_t *I2C_Trace_Ring;
+static unsigned long long I2C_Trace_Count;
+static int I2C_Tracing;
+
+static int
+Kernel_Open(const char *Bus)
+{
+	return open(Bus, (O_RDWR | O_CLOEXEC));
+}
+
+static int
+Kernel_Ioctl(int FD, unsigned long Request, unsigned long Arg)
+{
+	return ioctl(FD, Request, Arg);
+}
+
+static const I2C_Backend_t Kernel_Backend = {
+	.Open = Kernel_Open,
+	.Close = close,
+	.Ioctl = Kernel_Ioctl,
+	.Read = read,
+	.Write = write,
+};
+
+static const I2C_Backend_t *I2C_Backend = &Kernel_Backend;
+
+/*
+ * Replace the backend, returning the one it replaces, e.g. for a backend
+ * that passes calls on to it.
+ */
+const I2C_Backend_t *
+I2C_Set_Backend(const I2C_Backend_t *Backend)
+{
+	const I2C_Backend_t *Previous = I2C_Backend;
+
+	I2C_Backend = Backend;
+	return Previous;
+}
+
+/*
+ * The entry of the descriptor, or NULL if it isn't in the registry.
+ */
+static I2C_Bus_t *
+I2C_Find(int FD)
+{
+	I2C_Bus_t *Entry = NULL;
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	for (int i = 0; i < I2C_Bus_Numbers; i++) {
+		if (I2C_Buses[i].FD == FD) {
+			Entry = &I2C_Buses[i];
+			break;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+	return Entry;
+}
+
+static void
+I2C_Configure(const char *Bus, int FD)
+{
+	I2C_Configs_t *I2C_Configs = Plat_Devs->I2C_Configs;
+	I2C_Config_t *I2C_Config;
+
+	for (int i = 0; (I2C_Configs != NULL) && (i < I2C_Configs->Numbers); i++) {
+		I2C_Config = &I2C_Configs->I2C_Config[i];
+		if (strcmp(I2C_Config->I2C_Bus, Bus) != 0) {
+			continue;
+		}
+
+		/* The adapter takes the timeout in units of 10 ms */
+		if ((I2C_Config->Timeout >= 0) &&
+		    (I2C_Backend->Ioctl(FD, I2C_TIMEOUT,
+					((I2C_Config->Timeout + 9) / 10)) < 0)) {
+			SC_INFO("Unable to set timeout of I2C bus %s: %m", Bus);
+		}
+
+		if ((I2C_Config->Retries >= 0) &&
+		    (I2C_Backend->Ioctl(FD, I2C_RETRIES, I2C_Config->Retries) < 0)) {
+			SC_INFO("Unable to set retries of I2C bus %s: %m", Bus);
+		}
+
+		break;
+	}
+}
+
+/*
+ * Find out whether the bus is a mux channel, and of which mux.  Must be
+ * called with I2C_Lock held.
+ */
+static void
+I2C_Topology(I2C_Bus_t *Entry)
+{
+	char Adapter[STRLEN_MAX], Root[STRLEN_MAX];
+	char Path[PATH_MAX], Real_Path[PATH_MAX];
+	const char *Name;
+	char *Slash;
+	int Channel;
+
+	Entry->Mux = -1;
+	Entry->Channel = -1;
+	Name = strrchr(Entry->Bus, '/');
+	Name = ((Name == NULL) ? Entry->Bus : (Name + 1));
+	if (sscanf(Name, "i2c-%d", &Channel) != 1) {
+		return;
+	}
+
+	(void) strcpy(Adapter, Name);
+	for (int Depth = 0; Depth < I2C_MUX_DEPTH; Depth++) {
+		(void) snprintf(Path, sizeof(Path), "%s/%s/mux_device", I2C_SYSFS, Adapter);
+		if (access(Path, F_OK) != 0) {
+			break;
+		}
+
+		(void) snprintf(Path, sizeof(Path), "%s/%s", I2C_SYSFS, Adapter);
+		if (realpath(Path, Real_Path) == NULL) {
+			break;
+		}
+
+		/* Up from the channel to the mux, and then to its adapter */
+		for (int i = 0; i < 2; i++) {
+			Slash = strrchr(Real_Path, '/');
+			if (Slash != NULL) {
+				*Slash = '\0';
+			}
+		}
+
+		Slash = strrchr(Real_Path, '/');
+		if ((Slash == NULL) || (strncmp((Slash + 1), "i2c-", 4) != 0) ||
+		    (strlen(Slash + 1) >= STRLEN_MAX)) {
+			break;
+		}
+
+		(void) strcpy(Adapter, (Slash + 1));
+	}
+
+	if (strcmp(Adapter, Name) == 0) {
+		return;
+	}
+
+	(void) snprintf(Root, sizeof(Root), "/dev/%s", Adapter);
+	for (int i = 0; i < I2C_Mux_Numbers; i++) {
+		if (strcmp(I2C_Muxes[i].Root, Root) == 0) {
+			Entry->Mux = i;
+			break;
+		}
+	}
+
+	if (Entry->Mux == -1) {
+		Entry->Mux = I2C_Mux_Numbers++;
+		(void) strcpy(I2C_Muxes[Entry->Mux].Root, Root);
+		I2C_Muxes[Entry->Mux].Channel = -1;
+	}
+
+	Entry->Channel = Channel;
+	SC_INFO("I2C bus %s is channel of mux on %s", Entry->Bus, Root);
+}
+
+/*
+ * Get the descriptor of the bus, opening it on first use.  Returns -1
+ * with errno set if the bus can't be opened.  Once the registry is full,
+ * the bus is opened for the caller only.
+ */
+int
+I2C_Open(const char *Bus)
+{
+	I2C_Bus_t *Entry;
+	int FD = -1;
+	int Saved_Errno;
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	for (int i = 0; i < I2C_Bus_Numbers; i++) {
+		if (strcmp(I2C_Buses[i].Bus, Bus) == 0) {
+			FD = I2C_Buses[i].FD;
+			break;
+		}
+	}
+
+	if (FD == -1) {
+		FD = I2C_Backend->Open(Bus);
+		if ((FD >= 0) && (Plat_Devs != NULL)) {
+			I2C_Configure(Bus, FD);
+		}
+
+		if ((FD >= 0) && (I2C_Bus_Numbers < I2C_BUSES_MAX) &&
+		    (strlen(Bus) < STRLEN_MAX)) {
+			Entry = &I2C_Buses[I2C_Bus_Numbers++];
+			(void) strcpy(Entry->Bus, Bus);
+			Entry->FD = FD;
+			Entry->Address = -1;
+			I2C_Topology(Entry);
+		}
+	}
+
+	Saved_Errno = errno;
+	(void) pthread_mutex_unlock(&I2C_Lock);
+	errno = Saved_Errno;
+	return FD;
+}
+
+/*
+ * Release a descriptor from I2C_Open().  Those in the registry stay open.
+ */
+void
+I2C_Close(int FD)
+{
+	if ((FD >= 0) && (I2C_Find(FD) == NULL)) {
+		(void) I2C_Backend->Close(FD);
+	}
+}
+
+/*
+ * Set the slave address of the descriptor with I2C_SLAVE_FORCE, unless
+ * it's already set to it.  Returns -1 with errno set on failure.
+ */
+int
+I2C_Set_Address(int FD, int Address)
+{
+	I2C_Bus_t *Entry;
+
+	Entry = I2C_Find(FD);
+	if ((Entry != NULL) && (Entry->Address == Address)) {
+		return 0;
+	}
+
+	if (I2C_Backend->Ioctl(FD, I2C_SLAVE_FORCE, Address) < 0) {
+		if (Entry != NULL) {
+			Entry->Address = -1;
+		}
+
+		return -1;
+	}
+
+	if (Entry != NULL) {
+		Entry->Address = Address;
+	}
+
+	return 0;
+}
+
+/*
+ * The mux of the bus and its channel, or -1 for both if it isn't a mux
+ * channel, either of which may be NULL.
+ */
+static void
+Mux_Key(const char *Bus, int *Mux, int *Channel)
+{
+	*Mux = -1;
+	*Channel = -1;
+	if (Bus == NULL) {
+		return;
+	}
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	for (int i = 0; i < I2C_Bus_Numbers; i++) {
+		if (strcmp(I2C_Buses[i].Bus, Bus) == 0) {
+			*Mux = I2C_Buses[i].Mux;
+			*Channel = I2C_Buses[i].Channel;
+			break;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+}
+
+/*
+ * Whether the buses, either of which may be NULL, are the same or behind
+ * the same root adapter.
+ */
+int
+I2C_Same_Root(const char *Bus_A, const char *Bus_B)
+{
+	int Mux_A, Mux_B, Channel;
+
+	if ((Bus_A == NULL) || (Bus_B == NULL)) {
+		return (Bus_A == Bus_B);
+	}
+
+	if (strcmp(Bus_A, Bus_B) == 0) {
+		return 1;
+	}
+
+	Mux_Key(Bus_A, &Mux_A, &Channel);
+	Mux_Key(Bus_B, &Mux_B, &Channel);
+	return ((Mux_A != -1) && (Mux_A == Mux_B));
+}
+
+/*
+ * Order accesses to the buses so that those behind the same mux, and
+ * then those on the same channel of it, are next to each other, while
+ * keeping the order they're given in otherwise.  Order gets the indexes
+ * of the buses, which may be NULL, in the order to access them.
+ */
+void
+I2C_Order(const char **Buses, int Numbers, int *Order)
+{
+	int *Group, *Channel, *First;
+	int Mux, Index, j;
+
+	for (int i = 0; i < Numbers; i++) {
+		Order[i] = i;
+	}
+
+	Group = malloc(Numbers * sizeof(int));
+	Channel = malloc(Numbers * sizeof(int));
+	First = malloc(Numbers * sizeof(int));
+	if ((Numbers == 0) || (Group == NULL) || (Channel == NULL) || (First == NULL)) {
+		goto Out;
+	}
+
+	/* Groups and channels are ranked by the first access to them */
+	for (int i = 0; i < Numbers; i++) {
+		Mux_Key(Buses[i], &Mux, &Channel[i]);
+		Group[i] = i;
+		First[i] = i;
+		for (j = 0; j < i; j++) {
+			if (I2C_Same_Root(Buses[i], Buses[j])) {
+				Group[i] = Group[j];
+				break;
+			}
+		}
+
+		for (; j < i; j++) {
+			if ((Group[j] == Group[i]) && (Channel[j] == Channel[i])) {
+				First[i] = First[j];
+				break;
+			}
+		}
+	}
+
+	for (int i = 1; i < Numbers; i++) {
+		Index = Order[i];
+		for (j = i; j > 0; j--) {
+			Mux = Order[j - 1];
+			if ((Group[Mux] < Group[Index]) ||
+			    ((Group[Mux] == Group[Index]) && (First[Mux] <= First[Index]))) {
+				break;
+			}
+
+			Order[j] = Mux;
+		}
+
+		Order[j] = Index;
+	}
+
+Out:
+	free(Group);
+	free(Channel);
+	free(First);
+}
+
+/*
+ * Count the mux switches saved by accessing the buses in Order rather
+ * than in the order they're given in.
+ */
+void
+I2C_Count_Saved(const char **Buses, int Numbers, const int *Order)
+{
+	long long Saved[I2C_BUSES_MAX] = { 0 };
+	int Given[I2C_BUSES_MAX], Ordered[I2C_BUSES_MAX];
+	int Mux, Channel;
+
+	for (int i = 0; i < I2C_BUSES_MAX; i++) {
+		Given[i] = -1;
+		Ordered[i] = -1;
+	}
+
+	for (int i = 0; i < Numbers; i++) {
+		Mux_Key(Buses[i], &Mux, &Channel);
+		if ((Mux != -1) && (Given[Mux] != Channel)) {
+			Given[Mux] = Channel;
+			Saved[Mux]++;
+		}
+
+		Mux_Key(Buses[Order[i]], &Mux, &Channel);
+		if ((Mux != -1) && (Ordered[Mux] != Channel)) {
+			Ordered[Mux] = Channel;
+			Saved[Mux]--;
+		}
+	}
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	for (int i = 0; i < I2C_Mux_Numbers; i++) {
+		if (Saved[i] > 0) {
+			I2C_Muxes[i].Saved += Saved[i];
+		}
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+}
+
+static const char *
+Bus_Name(int Bus)
+{
+	return ((Bus < 0) ? "(unregistered)" : I2C_Buses[Bus].Bus);
+}
+
+/*
+ * The statistics of the device on the bus, by its index in I2C_Buses or
+ * -1 if it isn't registered, which are added on first use.  Returns NULL
+ * once the table is full.  Must be called with I2C_Lock held.
+ */
+static I2C_Device_Stats_t *
+Device_Stats(int Bus, int Address)
+{
+	I2C_Device_Stats_t *Device;
+
+	for (int i = 0; i < I2C_Device_Numbers; i++) {
+		Device = &I2C_Devices[i];
+		if ((Device->Bus == Bus) && (Device->Address == Address)) {
+			return Device;
+		}
+	}
+
+	if (I2C_Device_Numbers == I2C_DEVICES_MAX) {
+		return NULL;
+	}
+
+	Device = &I2C_Devices[I2C_Device_Numbers++];
+	Device->Bus = Bus;
+	Device->Address = Address;
+	return Device;
+}
+
+/*
+ * Account for a transfer that started at Start, in Stats_Time(), and
+ * returned Ret with errno set as of Error.
+ */
+static void
+I2C_Record(int FD, int Address, int Read, int Bytes, long long Start, int Ret,
+	   int Error)
+{
+	I2C_Device_Stats_t *Device;
+	I2C_Trace_t *Trace;
+	struct timespec Time;
+	long long Latency;
+	unsigned int Value;
+
+	I2C_Mux_t *Mux;
+	int Bus = -1;
+
+	Latency = (Stats_Time() - Start) / 1000;
+	Value = ((Latency > 0xFFFFFFFF) ? 0xFFFFFFFF : (Latency < 0) ? 0 : Latency);
+	(void) pthread_mutex_lock(&I2C_Lock);
+	for (int i = 0; i < I2C_Bus_Numbers; i++) {
+		if (I2C_Buses[i].FD == FD) {
+			Bus = i;
+			break;
+		}
+	}
+
+	if ((Bus != -1) && (I2C_Buses[Bus].Mux != -1)) {
+		Mux = &I2C_Muxes[I2C_Buses[Bus].Mux];
+		if (Mux->Channel != I2C_Buses[Bus].Channel) {
+			Mux->Channel = I2C_Buses[Bus].Channel;
+			Mux->Switches++;
+		}
+	}
+
+	Device = Device_Stats(Bus, Address);
+	if (Device != NULL) {
+		Device->Transfers++;
+		if (Ret < 0) {
+			if ((Error == ENXIO) || (Error == EREMOTEIO)) {
+				Device->NACKs++;
+			} else {
+				Device->Errors++;
+			}
+		} else {
+			Device->Bytes += Bytes;
+		}
+
+		Device->Sum += Value;
+		if (Value > Device->Max) {
+			Device->Max = Value;
+		}
+
+		Device->Bucket[(Value == 0) ? 0 : (32 - __builtin_clz(Value))]++;
+	}
+
+	if (I2C_Tracing && (I2C_Trace_Ring != NULL)) {
+		(void) clock_gettime(CLOCK_REALTIME, &Time);
+		Trace = &I2C_Trace_Ring[I2C_Trace_Count++ % I2C_TRACE_MAX];
+		Trace->Time = ((long long)Time.tv_sec * 1000000000) + Time.tv_nsec;
+		Trace->Bus = ((Device != NULL) ? Device->Bus : -1);
+		Trace->Address = Address;
+		Trace->Read = Read;
+		Trace->Bytes = Bytes;
+		Trace->Error = ((Ret < 0) ? Error : 0);
+		Trace->Latency = Value;
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+}
+
+/*
+ * Issue the messages with an I2C_RDWR ioctl and account for them.  Same
+ * return value and errno as the ioctl.
+ */
+int
+I2C_Transfer(int FD, struct i2c_rdwr_ioctl_data *Msgset)
+{
+	long long Start = Stats_Time();
+	int Bytes = 0;
+	int Read = 0;
+	int Saved_Errno;
+	int Ret;
+
+	Ret = I2C_Backend->Ioctl(FD, I2C_RDWR, (unsigned long)Msgset);
+	Saved_Errno = errno;
+	for (int i = 0; i < Msgset->nmsgs; i++) {
+		Bytes += Msgset->msgs[i].len;
+		if (Msgset->msgs[i].flags & I2C_M_RD) {
+			Read = 1;
+		}
+	}
+
+	I2C_Record(FD, Msgset->msgs[0].addr, Read, Bytes, Start, Ret, Saved_Errno);
+	errno = Saved_Errno;
+	return Ret;
+}
+
+/*
+ * Read from the device whose address is set on the descriptor, and
+ * account for it.  Same return value and errno as read().
+ */
+ssize_t
+I2C_Read(int FD, int Address, void *Buffer, size_t Length)
+{
+	long long Start = Stats_Time();
+	int Saved_Errno;
+	ssize_t Ret;
+
+	Ret = I2C_Backend->Read(FD, Buffer, Length);
+	Saved_Errno = errno;
+	I2C_Record(FD, Address, 1, Length, Start, ((Ret < 0) ? -1 : 0), Saved_Errno);
+	errno = Saved_Errno;
+	return Ret;
+}
+
+/*
+ * Write to the device whose address is set on the descriptor, and
+ * account for it.  Same return value and errno as write().
+ */
+ssize_t
+I2C_Write(int FD, int Address, const void *Buffer, size_t Length)
+{
+	long long Start = Stats_Time();
+	int Saved_Errno;
+	ssize_t Ret;
+
+	Ret = I2C_Backend->Write(FD, Buffer, Length);
+	Saved_Errno = errno;
+	I2C_Record(FD, Address, 0, Length, Start, ((Ret < 0) ? -1 : 0), Saved_Errno);
+	errno = Saved_Errno;
+	return Ret;
+}
+
+/*
+ * The upper bound of the bucket the percentile falls in.
+ */
+static unsigned int
+I2C_Percentile(I2C_Device_Stats_t *Device, int Percent)
+{
+	unsigned long long Rank, Count = 0;
+	unsigned long long Bound;
+
+	Rank = ((Device->Transfers * Percent) + 99) / 100;
+	for (int i = 0; i < I2C_BUCKETS; i++) {
+		Count += Device->Bucket[i];
+		if (Count >= Rank) {
+			Bound = ((i == 0) ? 0 : (1ULL << i));
+			return ((Bound < Device->Max) ? Bound : Device->Max);
+		}
+	}
+
+	return Device->Max;
+}
+
+/*
+ * Copy the statistics of the devices, in the order they were first
+ * accessed, and their bus names.  Returns the number of devices, or -1 if
+ * the copy can't be allocated.
+ */
+static int
+I2C_Copy_Stats(I2C_Device_Stats_t **Copy, char (**Buses)[STRLEN_MAX])
+{
+	int Numbers;
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	Numbers = I2C_Device_Numbers;
+	*Copy = malloc((Numbers + 1) * sizeof(I2C_Device_Stats_t));
+	*Buses = malloc((Numbers + 1) * STRLEN_MAX);
+	if ((*Copy == NULL) || (*Buses == NULL)) {
+		(void) pthread_mutex_unlock(&I2C_Lock);
+		free(*Copy);
+		free(*Buses);
+		return -1;
+	}
+
+	(void) memcpy(*Copy, I2C_Devices, (Numbers * sizeof(I2C_Device_Stats_t)));
+	for (int i = 0; i < Numbers; i++) {
+		(void) strcpy((*Buses)[i], Bus_Name(I2C_Devices[i].Bus));
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+	return Numbers;
+}
+
+static int
+I2C_Copy_Muxes(I2C_Mux_t *Copy)
+{
+	int Numbers;
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	Numbers = I2C_Mux_Numbers;
+	(void) memcpy(Copy, I2C_Muxes, (Numbers * sizeof(I2C_Mux_t)));
+	(void) pthread_mutex_unlock(&I2C_Lock);
+	return Numbers;
+}
+
+/*
+ * Print the statistics of each device on one line, optionally only of
+ * those on the given bus, followed by those of each mux if not.
+ */
+void
+I2C_Print_Stats(const char *Bus)
+{
+	I2C_Device_Stats_t *Copy, *Device;
+	I2C_Mux_t Muxes[I2C_BUSES_MAX];
+	char (*Buses)[STRLEN_MAX];
+	int Numbers;
+
+	Numbers = I2C_Copy_Stats(&Copy, &Buses);
+	if (Numbers < 0) {
+		SC_ERR("failed to allocate I2C statistics: %m");
+		return;
+	}
+
+	for (int i = 0; i < Numbers; i++) {
+		Device = &Copy[i];
+		if ((Bus != NULL) && (strcmp(Bus, Buses[i]) != 0)) {
+			continue;
+		}
+
+		Output_Begin(1);
+		Output_String("bus", NULL, Buses[i]);
+		Output_Hex("address", NULL, Device->Address);
+		Output_Int("transfers", "Transfers", Device->Transfers);
+		Output_Int("bytes", "Bytes", Device->Bytes);
+		Output_Int("nacks", "NACKs", Device->NACKs);
+		Output_Int("errors", "Errors", Device->Errors);
+		Output_Int("busy_us", "Busy(us)", Device->Sum);
+		Output_Int("p50_us", "p50(us)", I2C_Percentile(Device, 50));
+		Output_Int("p99_us", "p99(us)", I2C_Percentile(Device, 99));
+		Output_Int("max_us", "Max(us)", Device->Max);
+		Output_End();
+	}
+
+	free(Copy);
+	free(Buses);
+	Numbers = I2C_Copy_Muxes(Muxes);
+	for (int i = 0; (Bus == NULL) && (i < Numbers); i++) {
+		Output_Begin(1);
+		Output_String("mux", NULL, Muxes[i].Root);
+		Output_Int("switches", "Switches", Muxes[i].Switches);
+		Output_Int("switches_saved", "Saved", Muxes[i].Saved);
+		Output_End();
+	}
+}
+
+void
+I2C_Reset_Stats(void)
+{
+	(void) pthread_mutex_lock(&I2C_Lock);
+	(void) memset(I2C_Devices, 0, sizeof(I2C_Devices));
+	I2C_Device_Numbers = 0;
+	for (int i = 0; i < I2C_Mux_Numbers; i++) {
+		I2C_Muxes[i].Switches = 0;
+		I2C_Muxes[i].Saved = 0;
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+}
+
+/*
+ * Append the statistics of the devices to the sink of this thread in the
+ * OpenMetrics text format.
+ */
+void
+I2C_Export(void)
+{
+	I2C_Device_Stats_t *Copy, *Device;
+	I2C_Mux_t Muxes[I2C_BUSES_MAX];
+	char (*Buses)[STRLEN_MAX];
+	unsigned long long Count, Bound;
+	int Numbers;
+
+	Numbers = I2C_Copy_Stats(&Copy, &Buses);
+	if (Numbers < 0) {
+		return;
+	}
+
+	Sink_Printf("# TYPE sc_i2c_transfers counter\n");
+	Sink_Printf("# HELP sc_i2c_transfers I2C transfers to the device.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sink_Printf("sc_i2c_transfers_total{bus=\"%s\",address=\"%#x\"} %llu\n",
+			    Buses[i], Copy[i].Address, Copy[i].Transfers);
+	}
+
+	Sink_Printf("# TYPE sc_i2c_bytes counter\n");
+	Sink_Printf("# HELP sc_i2c_bytes Bytes moved by successful transfers.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sink_Printf("sc_i2c_bytes_total{bus=\"%s\",address=\"%#x\"} %llu\n",
+			    Buses[i], Copy[i].Address, Copy[i].Bytes);
+	}
+
+	Sink_Printf("# TYPE sc_i2c_nacks counter\n");
+	Sink_Printf("# HELP sc_i2c_nacks Transfers the device didn't acknowledge.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sink_Printf("sc_i2c_nacks_total{bus=\"%s\",address=\"%#x\"} %llu\n",
+			    Buses[i], Copy[i].Address, Copy[i].NACKs);
+	}
+
+	Sink_Printf("# TYPE sc_i2c_errors counter\n");
+	Sink_Printf("# HELP sc_i2c_errors Transfers that failed otherwise.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sink_Printf("sc_i2c_errors_total{bus=\"%s\",address=\"%#x\"} %llu\n",
+			    Buses[i], Copy[i].Address, Copy[i].Errors);
+	}
+
+	Sink_Printf("# TYPE sc_i2c_latency_seconds histogram\n");
+	Sink_Printf("# HELP sc_i2c_latency_seconds Latency of I2C transfers.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Device = &Copy[i];
+		Count = 0;
+		for (int j = 0; (j < I2C_BUCKETS) && (Count < Device->Transfers); j++) {
+			Count += Device->Bucket[j];
+			Bound = ((j == 0) ? 0 : (1ULL << j));
+			Sink_Printf("sc_i2c_latency_seconds_bucket{bus=\"%s\",address=\"%#x\",le=\"%.6f\"} %llu\n",
+				    Buses[i], Device->Address, (Bound / 1000000.0), Count);
+		}
+
+		Sink_Printf("sc_i2c_latency_seconds_bucket{bus=\"%s\",address=\"%#x\",le=\"+Inf\"} %llu\n",
+			    Buses[i], Device->Address, Device->Transfers);
+		Sink_Printf("sc_i2c_latency_seconds_count{bus=\"%s\",address=\"%#x\"} %llu\n",
+			    Buses[i], Device->Address, Device->Transfers);
+		Sink_Printf("sc_i2c_latency_seconds_sum{bus=\"%s\",address=\"%#x\"} %.6f\n",
+			    Buses[i], Device->Address, (Device->Sum / 1000000.0));
+	}
+
+	free(Copy);
+	free(Buses);
+	Numbers = I2C_Copy_Muxes(Muxes);
+	if (Numbers == 0) {
+		return;
+	}
+
+	Sink_Printf("# TYPE sc_i2c_mux_switches counter\n");
+	Sink_Printf("# HELP sc_i2c_mux_switches Transfers on another channel of the mux than the last one.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sink_Printf("sc_i2c_mux_switches_total{mux=\"%s\"} %llu\n",
+			    Muxes[i].Root, Muxes[i].Switches);
+	}
+
+	Sink_Printf("# TYPE sc_i2c_mux_switches_saved counter\n");
+	Sink_Printf("# HELP sc_i2c_mux_switches_saved Mux switches saved by ordering accesses by channel.\n");
+	for (int i = 0; i < Numbers; i++) {
+		Sink_Printf("sc_i2c_mux_switches_saved_total{mux=\"%s\"} %llu\n",
+			    Muxes[i].Root, Muxes[i].Saved);
+	}
+}
+
+/*
+ * Turn tracing of transfers on or off.  Turning it on starts a new trace.
+ */
+int
+I2C_Trace(int Enable)
+{
+	int Ret = 0;
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	if (Enable && (I2C_Trace_Ring == NULL)) {
+		I2C_Trace_Ring = calloc(I2C_TRACE_MAX, sizeof(I2C_Trace_t));
+		if (I2C_Trace_Ring == NULL) {
+			SC_ERR("failed to allocate I2C trace: %m");
+			Ret = -1;
+		}
+	}
+
+	if (Ret == 0) {
+		if (Enable) {
+			I2C_Trace_Count = 0;
+		}
+
+		I2C_Tracing = Enable;
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+	return Ret;
+}
+
+/*
+ * Print the transfers in the trace ring, oldest first.
+ */
+void
+I2C_Print_Trace(void)
+{
+	I2C_Trace_t *Copy, *Trace;
+	unsigned long long Count;
+	char (*Buses)[STRLEN_MAX];
+	char Time[STRLEN_MAX];
+	int Numbers, First;
+
+	Copy = malloc(I2C_TRACE_MAX * sizeof(I2C_Trace_t));
+	Buses = malloc(I2C_BUSES_MAX * STRLEN_MAX);
+	if ((Copy == NULL) || (Buses == NULL)) {
+		SC_ERR("failed to allocate I2C trace: %m");
+		goto Out;
+	}
+
+	(void) pthread_mutex_lock(&I2C_Lock);
+	Count = I2C_Trace_Count;
+	if (I2C_Trace_Ring != NULL) {
+		(void) memcpy(Copy, I2C_Trace_Ring, (I2C_TRACE_MAX * sizeof(I2C_Trace_t)));
+	}
+
+	for (int i = 0; i < I2C_Bus_Numbers; i++) {
+		(void) strcpy(Buses[i], I2C_Buses[i].Bus);
+	}
+
+	(void) pthread_mutex_unlock(&I2C_Lock);
+	Numbers = ((Count < I2C_TRACE_MAX) ? Count : I2C_TRACE_MAX);
+	First = ((Count < I2C_TRACE_MAX) ? 0 : (Count % I2C_TRACE_MAX));
+	for (int i = 0; i < Numbers; i++) {
+		Trace = &Copy[(First + i) % I2C_TRACE_MAX];
+		(void) snprintf(Time, sizeof(Time), "%lld.%06lld", (Trace->Time / 1000000000),
+				((Trace->Time % 1000000000) / 1000));
+		Output_Begin(1);
+		Output_Number("time", NULL, Time);
+		Output_String("bus", NULL, ((Trace->Bus < 0) ? "(unregistered)" : Buses[Trace->Bus]));
+		Output_Hex("address", NULL, Trace->Address);
+		Output_String("op", NULL, (Trace->Read ? "read" : "write"));
+		Output_Int("bytes", "Bytes", Trace->Bytes);
+		Output_Int("latency_us", "Latency(us)", Trace->Latency);
+		if (Trace->Error != 0) {
+			Output_String("error", "Error", strerror(Trace->Error));
+		}
+
+		Output_End();
+	}
+
+Out:
+	free(Copy);
+	free(Buses);
+}
+
+void
+I2C_Begin(I2C_Transaction_t *Transaction)
+{
+	Transaction->Numbers = 0;
+}
+
+/*
+ * Add a read of Length bytes from the register of the device to the
+ * transaction, with the same messages as I2C_READ_BYTES.  Value must stay
+ * valid until the transaction is committed.  Returns -1 if the
+ * transaction is full.
+ */
+int
+I2C_Add_Read(I2C_Transaction_t *Transaction, int Address, int Register,
+	     int Length, void *Value)
+{
+	struct i2c_msg *Msgs = &Transaction->Msgs[Transaction->Numbers];
+	unsigned char *Pointer;
+
+	if (Transaction->Numbers >= (2 * I2C_TRANSACTION_MAX)) {
+		return -1;
+	}
+
+	Pointer = &Transaction->Register[Transaction->Numbers / 2];
+	*Pointer = Register;
+	Msgs[0].addr = Address;
+	Msgs[0].flags = 0;
+	Msgs[0].len = 1;
+	Msgs[0].buf = Pointer;
+	Msgs[1].addr = Address;
+	Msgs[1].flags = (I2C_M_RD | I2C_M_NOSTART);
+	Msgs[1].len = Length;
+	Msgs[1].buf = Value;
+	Transaction->Numbers += 2;
+	return 0;
+}
+
+/*
+ * Issue all the reads of the transaction with a single ioctl, and empty
+ * it for reuse.
+ */
+int
+I2C_Commit(int FD, I2C_Transaction_t *Transaction)
+{
+	struct i2c_rdwr_ioctl_data Msgset;
+	int Ret = 0;
+
+	if (Transaction->Numbers == 0) {
+		return 0;
+	}
+
+	Msgset.msgs = Transaction->Msgs;
+	Msgset.nmsgs = Transaction->Numbers;
+	if (I2C_Transfer(FD, &Msgset) < 0) {
+		SC_ERR("unable to read from I2C device %#x: %m",
+		       Transaction->Msgs[0].addr);
+		Ret = -1;
+	}
+
+	Transaction->Numbers = 0;
+	return Ret;
+}
+
+static void
+I2C_Add(const char *Bus)
+{
+	if ((Bus == NULL) || (Bus[0] == '\0')) {
+		return;
+	}
+
+	if (I2C_Open(Bus) < 0) {
+		SC_INFO("Unable to access I2C bus %s: %m", Bus);
+	}
+}
+
+/*
+ * Open every bus of the board up front.  A bus that can't be opened,
+ * e.g. that of a device that isn't plugged in, is left to be opened on
+ * first use.
+ */
+void
+I2C_Init(void)
+{
+	Clocks_t *Clocks = Plat_Devs->Clocks;
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+	DIMMs_t *DIMMs = Plat_Devs->DIMMs;
+	SFPs_t *SFPs = Plat_Devs->SFPs;
+	FMCs_t *FMCs = Plat_Devs->FMCs;
+
+	for (int i = 0; (Clocks != NULL) && (i < Clocks->Numbers); i++) {
+		I2C_Add(Clocks->Clock[i].I2C_Bus);
+	}
+
+	for (int i = 0; (INA226s != NULL) && (i < INA226s->Numbers); i++) {
+		I2C_Add(INA226s->INA226[i].I2C_Bus);
+	}
+
+	for (int i = 0; (Voltages != NULL) && (i < Voltages->Numbers); i++) {
+		I2C_Add(Voltages->Voltage[i].I2C_Bus);
+	}
+
+	for (int i = 0; (DIMMs != NULL) && (i < DIMMs->Numbers); i++) {
+		I2C_Add(DIMMs->DIMM[i].I2C_Bus);
+	}
+
+	for (int i = 0; (SFPs != NULL) && (i < SFPs->Numbers); i++) {
+		I2C_Add(SFPs->SFP[i].I2C_Bus);
+	}
+
+	for (int i = 0; (FMCs != NULL) && (i < FMCs->Numbers); i++) {
+		I2C_Add(FMCs->FMC[i].I2C_Bus);
+	}
+
+	if (Plat_Devs->IO_Exp != NULL) {
+		I2C_Add(Plat_Devs->IO_Exp->I2C_Bus);
+	}
+
+	if (Plat_Devs->OnBoard_EEPROM != NULL) {
+		I2C_Add(Plat_Devs->OnBoard_EEPROM->I2C_Bus);
+	}
+
+	if (Plat_Devs->Daughter_Card != NULL) {
+		I2C_Add(Plat_Devs->Daughter_Card->I2C_Bus);
+	}
+}
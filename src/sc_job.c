@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "sc_app.h"
+
+/*
+ * Background Jobs
+ *
+ * A command given the '-a' option is run as a job: the client gets the
+ * job ID back right away, while the command is queued to the worker pool
+ * like any other.  The output of the command, along with that of any
+ * program it runs through Job_Popen(), is kept in the log of the job.
+ *
+ * 'jobstatus' reports the state of a job and its log so far, 'jobwait'
+ * streams the log to the client as it grows and completes with the status
+ * of the job, and 'jobcancel' dequeues a job that hasn't started yet, or
+ * terminates the programs run by one that has.
+ *
+ * The last JOBS_MAX jobs are kept; once they are all taken, the oldest
+ * completed job is dropped to make room for a new one.
+ */
+#define JOBS_MAX	32
+#define WAITERS_MAX	8
+
+typedef enum {
+	JOB_QUEUED,
+	JOB_RUNNING,
+	JOB_DONE,
+	JOB_CANCELED,
+} Job_State_t;
+
+static const char *Job_States[] = {
+	"queued",
+	"running",
+	"done",
+	"canceled",
+};
+
+typedef struct Job {
+	int	ID;
+	Job_State_t	State;
+	int	Status;
+	int	Canceled;
+	pid_t	PID;		/* Process group being run, if any */
+	time_t	Start_Time;
+	time_t	End_Time;
+	char	Command[SYSCMD_MAX];
+	Request_t	*Request;	/* Until a worker picks it up */
+	Sink_t	Sink;		/* Output of the command, drained to Log */
+	Sink_t	Log;
+	int	Waiter_Numbers;
+	Client_t	*Waiter[WAITERS_MAX];
+} Job_t;
+
+static pthread_mutex_t Job_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Job_t *Jobs[JOBS_MAX];
+static int Next_ID = 1;
+
+/* The job being run by this thread, if any */
+static __thread Job_t *Current_Job;
+
+static void
+Free_Job(Job_t *Job)
+{
+	Sink_Free(&Job->Sink);
+	Sink_Free(&Job->Log);
+	free(Job);
+}
+
+/*
+ * Look up a job by its ID.  Must be called with Job_Lock held.
+ */
+static Job_t *
+Find_Job(const char *Target)
+{
+	char *End;
+	long ID;
+
+	ID = strtol(Target, &End, 10);
+	if ((End == Target) || (*End != '\0')) {
+		return NULL;
+	}
+
+	for (int i = 0; i < JOBS_MAX; i++) {
+		if ((Jobs[i] != NULL) && (Jobs[i]->ID == ID)) {
+			return Jobs[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Move what the command has printed to the log of the job, and send it
+ * to the clients waiting on the job.  The output is added to the sinks of
+ * the waiters under Job_Lock, but sent after it's released, so that a
+ * waiter that is slow to take it holds up only the job, not those that
+ * take the lock, e.g. the event loop.  Only the thread running the job
+ * touches the sinks of its waiters until it completes them, see End_Job().
+ */
+static void
+Job_Drain(Sink_t *Sink)
+{
+	Job_t *Job = Sink->Data;
+	Client_t *Waiter[WAITERS_MAX];
+	int Waiter_Numbers;
+
+	(void) pthread_mutex_lock(&Job_Lock);
+	(void) Sink_Write(&Job->Log, Sink->Buffer, Sink->Length);
+	Waiter_Numbers = Job->Waiter_Numbers;
+	for (int i = 0; i < Waiter_Numbers; i++) {
+		Waiter[i] = Job->Waiter[i];
+		(void) Sink_Write(&Waiter[i]->Sink, Sink->Buffer, Sink->Length);
+	}
+
+	Sink->Length = 0;
+	(void) pthread_mutex_unlock(&Job_Lock);
+
+	for (int i = 0; i < Waiter_Numbers; i++) {
+		(void) Sink_Flush(&Waiter[i]->Sink, NULL);
+	}
+}
+
+/*
+ * Complete the clients waiting on the job.  Must be called with Job_Lock
+ * held.
+ */
+static void
+End_Job(Job_t *Job, Job_State_t State, int Status)
+{
+	Job->State = State;
+	Job->Status = Status;
+	Job->End_Time = time(NULL);
+	Job->Request = NULL;
+	for (int i = 0; i < Job->Waiter_Numbers; i++) {
+		Job->Waiter[i]->Status = Status;
+		Complete_Request(Job->Waiter[i]);
+	}
+
+	Job->Waiter_Numbers = 0;
+}
+
+/*
+ * Turn the request into a job and print its ID.  The output of the
+ * command then goes to the job rather than the client.
+ */
+int
+Job_Create(Request_t *Request)
+{
+	Job_t *Job;
+	int Slot = -1;
+
+	Job = calloc(1, sizeof(Job_t));
+	if (Job == NULL) {
+		SC_ERR("failed to allocate job: %m");
+		return -1;
+	}
+
+	(void) pthread_mutex_lock(&Job_Lock);
+	for (int i = 0; i < JOBS_MAX; i++) {
+		if (Jobs[i] == NULL) {
+			Slot = i;
+			break;
+		}
+
+		if ((Jobs[i]->State >= JOB_DONE) &&
+		    ((Slot == -1) || (Jobs[i]->ID < Jobs[Slot]->ID))) {
+			Slot = i;
+		}
+	}
+
+	if (Slot == -1) {
+		(void) pthread_mutex_unlock(&Job_Lock);
+		SC_ERR("too many jobs in progress");
+		free(Job);
+		return -1;
+	}
+
+	if (Jobs[Slot] != NULL) {
+		Free_Job(Jobs[Slot]);
+	}
+
+	Job->ID = Next_ID++;
+	Job->State = JOB_QUEUED;
+	Job->Status = -1;
+	Job->Request = Request;
+	(void) strcpy(Job->Command, Request->Client->Request);
+	Sink_Init(&Job->Sink, -1);
+	Job->Sink.Format = Request->Sink->Format;
+	Job->Sink.Drain = Job_Drain;
+	Job->Sink.Data = Job;
+	Sink_Init(&Job->Log, -1);
+	Jobs[Slot] = Job;
+	(void) pthread_mutex_unlock(&Job_Lock);
+
+	Request->Job = Job;
+	Request->Sink = &Job->Sink;
+	Request->Client = NULL;
+	SC_PRINT("Job:\t%d", Job->ID);
+	return 0;
+}
+
+/*
+ * Called by the worker thread before running the command of the job.
+ * Returns -1 if the job has been canceled in the meantime.
+ */
+int
+Job_Start(Request_t *Request)
+{
+	Job_t *Job = Request->Job;
+	int Ret = 0;
+
+	(void) pthread_mutex_lock(&Job_Lock);
+	Job->State = JOB_RUNNING;
+	Job->Start_Time = time(NULL);
+	Job->Request = NULL;
+	if (Job->Canceled) {
+		Ret = -1;
+	} else {
+		Current_Job = Job;
+	}
+
+	(void) pthread_mutex_unlock(&Job_Lock);
+	return Ret;
+}
+
+/*
+ * Called by the worker thread once it is done with the job.
+ */
+void
+Job_Finish(Request_t *Request)
+{
+	Job_t *Job = Request->Job;
+
+	Current_Job = NULL;
+	(void) pthread_mutex_lock(&Job_Lock);
+	End_Job(Job, (Job->Canceled ? JOB_CANCELED : JOB_DONE), Request->Status);
+	(void) pthread_mutex_unlock(&Job_Lock);
+}
+
+/*
+ * Print the state of the given job along with its log so far, or the
+ * state of all the jobs if no job is given.
+ */
+int
+Job_Status(const char *Target)
+{
+	Job_t *Job;
+	time_t End_Time;
+
+	(void) pthread_mutex_lock(&Job_Lock);
+	if (Target == NULL) {
+		for (int ID = 1; ID < Next_ID; ID++) {
+			for (int i = 0; i < JOBS_MAX; i++) {
+				Job = Jobs[i];
+				if ((Job != NULL) && (Job->ID == ID)) {
+					SC_PRINT("%d\t%s\t%s", Job->ID,
+						 Job_States[Job->State], Job->Command);
+				}
+			}
+		}
+
+		(void) pthread_mutex_unlock(&Job_Lock);
+		return 0;
+	}
+
+	Job = Find_Job(Target);
+	if (Job == NULL) {
+		(void) pthread_mutex_unlock(&Job_Lock);
+		SC_ERR("invalid job target");
+		return -1;
+	}
+
+	SC_PRINT("State:\t\t%s", Job_States[Job->State]);
+	SC_PRINT("Command:\t%s", Job->Command);
+	if (Job->Start_Time != 0) {
+		End_Time = ((Job->State == JOB_RUNNING) ? time(NULL) : Job->End_Time);
+		SC_PRINT("Elapsed(s):\t%ld", (long)(End_Time - Job->Start_Time));
+	}
+
+	if (Job->State >= JOB_DONE) {
+		SC_PRINT("Status:\t\t%d", Job->Status);
+	}
+
+	SC_PRINT("Output:");
+	if (Job->Log.Length > 0) {
+		SC_PRINT_N("%s", Job->Log.Buffer);
+	}
+
+	(void) pthread_mutex_unlock(&Job_Lock);
+	return 0;
+}
+
+/*
+ * Called by the event loop for 'jobwait'.  The log of the job so far is
+ * sent to the client, and unless the job has already ended, the client
+ * is handed over to the job, which streams the rest of the log to it and
+ * completes it with the status of the job.  Returns 1 if the job now owns
+ * the client, or 0 if the request has been completed here.
+ */
+int
+Job_Wait(Request_t *Request)
+{
+	Client_t *Client = Request->Client;
+	Job_t *Job;
+	int Ret = 0;
+
+	if (!Request->T_Flag) {
+		SC_ERR("no job target");
+		return 0;
+	}
+
+	(void) pthread_mutex_lock(&Job_Lock);
+	Job = Find_Job(Request->Target_Arg);
+	if (Job == NULL) {
+		(void) pthread_mutex_unlock(&Job_Lock);
+		SC_ERR("invalid job target");
+		return 0;
+	}
+
+	if (Job->State >= JOB_DONE) {
+		(void) Sink_Write(&Client->Sink, Job->Log.Buffer, Job->Log.Length);
+		Client->Status = Job->Status;
+	} else if (Job->Waiter_Numbers == WAITERS_MAX) {
+		SC_ERR("too many clients waiting on job %d", Job->ID);
+	} else {
+		(void) Sink_Write(&Client->Sink, Job->Log.Buffer, Job->Log.Length);
+		(void) Sink_Flush(&Client->Sink, NULL);
+		Job->Waiter[Job->Waiter_Numbers++] = Client;
+		Ret = 1;
+	}
+
+	(void) pthread_mutex_unlock(&Job_Lock);
+	return Ret;
+}
+
+/*
+ * Cancel the job.  A queued job is simply dropped.  A running job is
+ * flagged as canceled, and the program it's running, if any, is sent
+ * SIGTERM; a command that is programming a device without the help of
+ * such a program is left to complete, so the device isn't left half
+ * configured.
+ */
+int
+Job_Cancel(const char *Target)
+{
+	Request_t *Request;
+	Job_t *Job;
+	int Ret = 0;
+
+	(void) pthread_mutex_lock(&Job_Lock);
+	Job = Find_Job(Target);
+	if (Job == NULL) {
+		SC_ERR("invalid job target");
+		Ret = -1;
+		goto Out;
+	}
+
+	if (Job->State >= JOB_DONE) {
+		SC_ERR("job %d has already ended", Job->ID);
+		Ret = -1;
+		goto Out;
+	}
+
+	Job->Canceled = 1;
+	Request = Job->Request;
+	if ((Request != NULL) && (Worker_Cancel(Request) == 0)) {
+		free(Request);
+		End_Job(Job, JOB_CANCELED, -1);
+		goto Out;
+	}
+
+	if (Job->PID > 0) {
+		(void) kill(-Job->PID, SIGTERM);
+	}
+
+Out:
+	(void) pthread_mutex_unlock(&Job_Lock);
+	return Ret;
+}
+
+/*
+ * Like popen(3) for reading, except that the command is run in its own
+ * process group, which 'jobcancel' terminates if the command is run by
+ * a job.  The PID of the command is returned for Job_Pclose().
+ */
+FILE *
+Job_Popen(const char *Command, pid_t *PID)
+{
+	int Pipe[2];
+	FILE *FP;
+
+	(void) pthread_mutex_lock(&Job_Lock);
+	if ((Current_Job != NULL) && Current_Job->Canceled) {
+		(void) pthread_mutex_unlock(&Job_Lock);
+		errno = ECANCELED;
+		return NULL;
+	}
+
+	(void) pthread_mutex_unlock(&Job_Lock);
+	if (pipe(Pipe) == -1) {
+		return NULL;
+	}
+
+	(void) fcntl(Pipe[0], F_SETFD, FD_CLOEXEC);
+	*PID = fork();
+	if (*PID == -1) {
+		(void) close(Pipe[0]);
+		(void) close(Pipe[1]);
+		return NULL;
+	}
+
+	if (*PID == 0) {
+		(void) setpgid(0, 0);
+		(void) dup2(Pipe[1], STDOUT_FILENO);
+		(void) close(Pipe[0]);
+		(void) close(Pipe[1]);
+		(void) execl("/bin/sh", "sh", "-c", Command, (char *)NULL);
+		_exit(127);
+	}
+
+	/* Also set it here so that it's in place before kill(2) may be called */
+	(void) setpgid(*PID, *PID);
+	(void) close(Pipe[1]);
+	FP = fdopen(Pipe[0], "r");
+	if (FP == NULL) {
+		(void) close(Pipe[0]);
+		(void) kill(-*PID, SIGTERM);
+		(void) waitpid(*PID, NULL, 0);
+		return NULL;
+	}
+
+	if (Current_Job != NULL) {
+		(void) pthread_mutex_lock(&Job_Lock);
+		Current_Job->PID = *PID;
+		if (Current_Job->Canceled) {
+			(void) kill(-*PID, SIGTERM);
+		}
+
+		(void) pthread_mutex_unlock(&Job_Lock);
+	}
+
+	return FP;
+}
+
+/*
+ * Like pclose(3), returns the wait status of the command.
+ */
+int
+Job_Pclose(FILE *FP, pid_t PID)
+{
+	int Status;
+
+	(void) fclose(FP);
+	while (waitpid(PID, &Status, 0) == -1) {
+		if (errno != EINTR) {
+			Status = -1;
+			break;
+		}
+	}
+
+	if (Current_Job != NULL) {
+		(void) pthread_mutex_lock(&Job_Lock);
+		Current_Job->PID = 0;
+		(void) pthread_mutex_unlock(&Job_Lock);
+	}
+
+	return Status;
+}
+
+/*
+ * Add a line of progress, e.g. the output of a program being run, to the
+ * log of the job run by this thread.  Does nothing outside of jobs.
+ */
+void
+Job_Progress(const char *Line)
+{
+	if (Current_Job != NULL) {
+		Sink_Printf("%s", Line);
+	}
+}
@@ -0,0 +1,535 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include "sc_app.h"
+
+/*
+ * The sink of the request being processed by this thread, if any.
+ * SC_PRINT(), SC_PRINT_N(), and SC_ERR() append their output to it.
+ */
+__thread Sink_t *SC_Sink;
+
+/*
+ * Set on the thread of the event loop, which must not wait for a client
+ * to take its output, see Sink_Flush().
+ */
+__thread int Sink_No_Wait;
+
+/*
+ * The record being emitted by this thread, see Output_Begin().
+ */
+static __thread int Record_Line;
+static __thread int Record_Fields;
+
+void
+Sink_Init(Sink_t *Sink, int FD)
+{
+	Sink->FD = FD;
+	Sink->Buffer = NULL;
+	Sink->Length = 0;
+	Sink->Size = 0;
+	Sink->Drain = NULL;
+	Sink->Data = NULL;
+	Sink->Format = OUTPUT_TEXT;
+	Sink->Open = 0;
+	Sink->Items = 0;
+	Sink->In_Text = 0;
+}
+
+void
+Sink_Free(Sink_t *Sink)
+{
+	free(Sink->Buffer);
+	Sink_Init(Sink, -1);
+}
+
+/*
+ * Grow the sink so that it has room for at least Length more bytes.
+ */
+static int
+Sink_Reserve(Sink_t *Sink, size_t Length)
+{
+	size_t Size;
+	char *Buffer;
+
+	if ((Sink->Length + Length) < Sink->Size) {
+		return 0;
+	}
+
+	Size = MAX((2 * Sink->Size), SOCKBUF_MAX);
+	while (Size <= (Sink->Length + Length)) {
+		Size *= 2;
+	}
+
+	Buffer = realloc(Sink->Buffer, Size);
+	if (Buffer == NULL) {
+		return -1;
+	}
+
+	Sink->Buffer = Buffer;
+	Sink->Size = Size;
+	return 0;
+}
+
+/*
+ * Append to the buffer of the sink as is.
+ */
+static int
+Sink_Append(Sink_t *Sink, const char *Data, size_t Length)
+{
+	if (Sink_Reserve(Sink, Length) != 0) {
+		return -1;
+	}
+
+	(void) memcpy((Sink->Buffer + Sink->Length), Data, Length);
+	Sink->Length += Length;
+	Sink->Buffer[Sink->Length] = '\0';
+	return 0;
+}
+
+/*
+ * Send the buffered output, followed by an optional trailer, to the
+ * client.  Client sockets are non-blocking, so this waits for the client
+ * to take the output, except on a thread with Sink_No_Wait set, where
+ * what the client doesn't take right away is kept in the sink to be sent
+ * by a later call.  A client that takes nothing for SINK_TIMEOUT is shut
+ * down, for the event loop to drop it.  Returns 1 if output is left in
+ * the sink, -1 if the client is gone, in which case the output is
+ * dropped, or 0 otherwise.
+ */
+int
+Sink_Flush(Sink_t *Sink, const char *Trailer)
+{
+	struct pollfd Poll_FD;
+	size_t Sent = 0;
+	ssize_t Length;
+	int Ret = 0;
+
+	if ((Trailer != NULL) && (Trailer[0] != '\0')) {
+		(void) Sink_Append(Sink, Trailer, strlen(Trailer));
+	}
+
+	Poll_FD.fd = Sink->FD;
+	Poll_FD.events = POLLOUT;
+	while (Sent < Sink->Length) {
+		/* MSG_NOSIGNAL so that a client that is gone doesn't raise SIGPIPE */
+		Length = send(Sink->FD, (Sink->Buffer + Sent), (Sink->Length - Sent),
+			      MSG_NOSIGNAL);
+		if (Length == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno != EAGAIN) {
+				Sent = Sink->Length;
+				Ret = -1;
+				break;
+			}
+
+			if (Sink_No_Wait) {
+				Ret = 1;
+				break;
+			}
+
+			if (poll(&Poll_FD, 1, SINK_TIMEOUT) == 0) {
+				SC_INFO("client stopped reading, dropping it");
+				(void) shutdown(Sink->FD, SHUT_RDWR);
+				Sent = Sink->Length;
+				Ret = -1;
+				break;
+			}
+
+			continue;
+		}
+
+		Sent += Length;
+	}
+
+	if (Sent > 0) {
+		Sink->Length -= Sent;
+		(void) memmove(Sink->Buffer, (Sink->Buffer + Sent), Sink->Length);
+		Sink->Buffer[Sink->Length] = '\0';
+	}
+
+	return Ret;
+}
+
+/*
+ * Hand off what has been appended to the sink, see Sink_Printf().
+ */
+static void
+Sink_Hand_Off(Sink_t *Sink)
+{
+	if (Sink->Drain != NULL) {
+		Sink->Drain(Sink);
+	} else if (Sink->Length >= SINK_FLUSH_SIZE) {
+		(void) Sink_Flush(Sink, NULL);
+	}
+}
+
+/*
+ * Start the output object of a sink in JSON format, unless it's been
+ * started already.  This is done on the first item, so that the format
+ * can still be changed until the request has been parsed.
+ */
+static void
+Output_Open(Sink_t *Sink)
+{
+	if ((Sink->Format != OUTPUT_JSON) || Sink->Open) {
+		return;
+	}
+
+	(void) Sink_Append(Sink, "{\"output\":[", strlen("{\"output\":["));
+	Sink->Open = 1;
+	Sink->Items = 0;
+	Sink->In_Text = 0;
+}
+
+static void
+Output_Item(Sink_t *Sink)
+{
+	Output_Open(Sink);
+	if (Sink->Items++ > 0) {
+		(void) Sink_Append(Sink, ",", 1);
+	}
+}
+
+/*
+ * Append the data as the contents of a JSON string.
+ */
+static void
+Output_Escape(Sink_t *Sink, const char *Data, size_t Length)
+{
+	char Escape[8];
+
+	for (size_t i = 0; i < Length; i++) {
+		switch (Data[i]) {
+		case '"':
+			(void) Sink_Append(Sink, "\\\"", 2);
+			break;
+		case '\\':
+			(void) Sink_Append(Sink, "\\\\", 2);
+			break;
+		case '\t':
+			(void) Sink_Append(Sink, "\\t", 2);
+			break;
+		case '\r':
+			(void) Sink_Append(Sink, "\\r", 2);
+			break;
+		case '\n':
+			(void) Sink_Append(Sink, "\\n", 2);
+			break;
+		default:
+			if ((unsigned char)Data[i] < 0x20) {
+				(void) sprintf(Escape, "\\u%04x", Data[i]);
+				(void) Sink_Append(Sink, Escape, strlen(Escape));
+			} else {
+				(void) Sink_Append(Sink, &Data[i], 1);
+			}
+
+			break;
+		}
+	}
+}
+
+static void
+Output_End_Text(Sink_t *Sink)
+{
+	if (Sink->In_Text == 1) {
+		(void) Sink_Append(Sink, "\"", 1);
+	} else if (Sink->In_Text == 2) {
+		(void) Sink_Append(Sink, "\"}", 2);
+	}
+
+	Sink->In_Text = 0;
+}
+
+/*
+ * Append text to a sink in JSON format as a string item per line, which
+ * may be printed in pieces.  A line that starts with "ERROR: ", i.e. one
+ * printed by SC_ERR(), is an error item instead.
+ */
+static void
+Output_Text(Sink_t *Sink, const char *Data, size_t Length)
+{
+	const char *End = Data + Length;
+	const char *Line;
+	size_t Prefix = strlen("ERROR: ");
+
+	while (Data < End) {
+		if (!Sink->In_Text) {
+			Output_Item(Sink);
+			if (((End - Data) >= Prefix) &&
+			    (strncmp(Data, "ERROR: ", Prefix) == 0)) {
+				(void) Sink_Append(Sink, "{\"error\":\"", strlen("{\"error\":\""));
+				Data += Prefix;
+				Sink->In_Text = 2;
+			} else {
+				(void) Sink_Append(Sink, "\"", 1);
+				Sink->In_Text = 1;
+			}
+		}
+
+		Line = Data;
+		while ((Data < End) && (*Data != '\n')) {
+			Data++;
+		}
+
+		Output_Escape(Sink, Line, (Data - Line));
+		if (Data < End) {
+			Output_End_Text(Sink);
+			Data++;
+		}
+	}
+}
+
+/*
+ * End the output object of a sink in JSON format with the status of the
+ * request.  Nothing is appended to a sink in text format, whose status,
+ * if any, is sent by the caller.
+ */
+void
+Output_Close(Sink_t *Sink, int Status)
+{
+	char Trailer[STRLEN_MAX];
+
+	if (Sink->Format != OUTPUT_JSON) {
+		return;
+	}
+
+	Output_Open(Sink);
+	Output_End_Text(Sink);
+	(void) sprintf(Trailer, "],\"status\":%d}\n", Status);
+	(void) Sink_Append(Sink, Trailer, strlen(Trailer));
+	Sink->Open = 0;
+	Sink_Hand_Off(Sink);
+}
+
+/*
+ * Start a record of typed fields in the sink of the current request.
+ * In text format, each field is printed on a line of its own as
+ * "Label:<tab>Value", or if Line is set, the fields are printed on a
+ * single line separated by tabs.  In JSON format, the record is an object
+ * with a member per field, and numbers keep all the precision of the
+ * value rather than that of the text.
+ */
+void
+Output_Begin(int Line)
+{
+	Sink_t *Sink = SC_Sink;
+
+	Record_Line = Line;
+	Record_Fields = 0;
+	if ((Sink != NULL) && (Sink->Format == OUTPUT_JSON)) {
+		Output_End_Text(Sink);
+		Output_Item(Sink);
+		(void) Sink_Append(Sink, "{", 1);
+	}
+}
+
+void
+Output_End(void)
+{
+	Sink_t *Sink = SC_Sink;
+
+	if (Record_Line && (Record_Fields > 0)) {
+		(void) fputs("\n", stdout);
+	}
+
+	if (Sink == NULL) {
+		return;
+	}
+
+	if (Sink->Format == OUTPUT_JSON) {
+		(void) Sink_Append(Sink, "}", 1);
+		Sink_Hand_Off(Sink);
+	} else if (Record_Line && (Record_Fields > 0)) {
+		Sink_Printf("\n");
+	}
+}
+
+/*
+ * Emit a field of the record, given as the text to print with Label,
+ * which may be NULL for a field that is printed as is, and as the JSON
+ * value of member Key, which is a string of Text if Json is NULL.
+ */
+static void
+Output_Field(const char *Key, const char *Label, const char *Text, const char *Json)
+{
+	Sink_t *Sink = SC_Sink;
+	char Line[SYSCMD_MAX];
+
+	(void) snprintf(Line, sizeof(Line), "%s%s%s%s%s",
+			((Record_Line && (Record_Fields > 0)) ? "\t" : ""),
+			((Label != NULL) ? Label : ""), ((Label != NULL) ? ":\t" : ""),
+			Text, (Record_Line ? "" : "\n"));
+	(void) fputs(Line, stdout);
+	Record_Fields++;
+	if (Sink == NULL) {
+		return;
+	}
+
+	if (Sink->Format != OUTPUT_JSON) {
+		Sink_Printf("%s", Line);
+		return;
+	}
+
+	(void) snprintf(Line, sizeof(Line), "%s\"%s\":", ((Record_Fields > 1) ? "," : ""),
+			Key);
+	(void) Sink_Append(Sink, Line, strlen(Line));
+	if (Json != NULL) {
+		(void) Sink_Append(Sink, Json, strlen(Json));
+	} else {
+		(void) Sink_Append(Sink, "\"", 1);
+		Output_Escape(Sink, Text, strlen(Text));
+		(void) Sink_Append(Sink, "\"", 1);
+	}
+}
+
+/*
+ * A number printed with the given number of decimals.
+ */
+void
+Output_Float(const char *Key, const char *Label, int Precision, double Value)
+{
+	char Text[STRLEN_MAX];
+	char Json[STRLEN_MAX];
+
+	(void) snprintf(Text, sizeof(Text), "%.*f", Precision, Value);
+	if (isfinite(Value)) {
+		(void) snprintf(Json, sizeof(Json), "%.9g", Value);
+	} else {
+		(void) strcpy(Json, "null");
+	}
+
+	Output_Field(Key, Label, Text, Json);
+}
+
+void
+Output_Int(const char *Key, const char *Label, long long Value)
+{
+	char Text[STRLEN_MAX];
+
+	(void) snprintf(Text, sizeof(Text), "%lld", Value);
+	Output_Field(Key, Label, Text, Text);
+}
+
+/*
+ * A number printed in hex, e.g. a register value.
+ */
+void
+Output_Hex(const char *Key, const char *Label, unsigned int Value)
+{
+	char Text[STRLEN_MAX];
+	char Json[STRLEN_MAX];
+
+	(void) snprintf(Text, sizeof(Text), "%#x", Value);
+	(void) snprintf(Json, sizeof(Json), "%u", Value);
+	Output_Field(Key, Label, Text, Json);
+}
+
+/*
+ * A number that has been formatted already, e.g. a timestamp with more
+ * digits than a reading.
+ */
+void
+Output_Number(const char *Key, const char *Label, const char *Value)
+{
+	Output_Field(Key, Label, Value, Value);
+}
+
+void
+Output_String(const char *Key, const char *Label, const char *Value)
+{
+	Output_Field(Key, Label, Value, NULL);
+}
+
+/*
+ * Append raw output to the sink, which in JSON format is text.
+ */
+int
+Sink_Write(Sink_t *Sink, const char *Data, size_t Length)
+{
+	if (Sink->Format == OUTPUT_JSON) {
+		Output_Text(Sink, Data, Length);
+		return 0;
+	}
+
+	return Sink_Append(Sink, Data, Length);
+}
+
+/*
+ * Append formatted output to the sink of the current request.  The sink
+ * grows as needed, and is flushed once it holds SINK_FLUSH_SIZE bytes,
+ * unless it has its own drain which is then called on every append.
+ */
+void
+Sink_Printf(const char *Format, ...)
+{
+	Sink_t *Sink = SC_Sink;
+	va_list Args;
+	int Saved_Errno = errno;
+	char *Text;
+	int Length;
+
+	if (Sink == NULL) {
+		return;
+	}
+
+	if (Sink->Format == OUTPUT_JSON) {
+		errno = Saved_Errno;
+		va_start(Args, Format);
+		Length = vsnprintf(NULL, 0, Format, Args);
+		va_end(Args);
+		if (Length < 0) {
+			return;
+		}
+
+		Text = malloc(Length + 1);
+		if (Text == NULL) {
+			return;
+		}
+
+		errno = Saved_Errno;
+		va_start(Args, Format);
+		(void) vsnprintf(Text, (Length + 1), Format, Args);
+		va_end(Args);
+		Output_Text(Sink, Text, Length);
+		free(Text);
+		Sink_Hand_Off(Sink);
+		return;
+	}
+
+	while (1) {
+		/* Preserve errno for any '%m' in the format */
+		errno = Saved_Errno;
+		va_start(Args, Format);
+		Length = vsnprintf((Sink->Buffer + Sink->Length),
+				   (Sink->Size - Sink->Length), Format, Args);
+		va_end(Args);
+		if (Length < 0) {
+			return;
+		}
+
+		if ((Sink->Length + Length) < Sink->Size) {
+			break;
+		}
+
+		if (Sink_Reserve(Sink, Length) != 0) {
+			return;
+		}
+	}
+
+	Sink->Length += Length;
+	Sink_Hand_Off(Sink);
+}
@@ -29,6 +29,7 @@ int Parse_IO_EXP(const char *, jsmntok_t *, int *, IO_Exp_t **);
 int Parse_DaughterCard(const char *, jsmntok_t *, int *, Daughter_Card_t **);
 int Parse_SFP(const char *, jsmntok_t *, int *, SFPs_t **);
 int Parse_FMC(const char *, jsmntok_t *, int *, FMCs_t **);
+int Parse_I2C(const char *, jsmntok_t *, int *, I2C_Configs_t **);
 int Parse_Workaround(const char *, jsmntok_t *, int *, Workarounds_t **);
 int Parse_BIT(const char *, jsmntok_t *, int *, BITs_t **);
 int Parse_Constraint(const char *, jsmntok_t *, int *, Constraints_t **);
@@ -181,6 +182,10 @@ Parse_JSON(const char *Board_File, Plat_Devs_t *Dev_Parse) {
 			if (Parse_FMC(Json_File, Tokens, &i, &Dev_Parse->FMCs) != 0) {
 				return -1;
 			}
+		} else if (jsoneq(Json_File, &Tokens[i], "I2C") == 0) {
+			if (Parse_I2C(Json_File, Tokens, &i, &Dev_Parse->I2C_Configs) != 0) {
+				return -1;
+			}
 		} else if (jsoneq(Json_File, &Tokens[i], "WORKAROUND") == 0) {
 			if (Parse_Workaround(Json_File, Tokens, &i,
 					     &Dev_Parse->Workarounds) != 0) {
@@ -477,6 +482,65 @@ Parse_Clock(const char *Json_File, jsmntok_t *Tokens, int *Index, Clocks_t **CLK
 	return 0;
 }
 
+static const int Conversion_Times[] = { INA226_CONVERSION_TIMES };
+static const int Averages[] = { INA226_AVERAGES };
+
+/*
+ * Check that the value is one of the 8 the INA226 supports.
+ */
+static int
+Validate_INA226_Value(int Value, const int *Values)
+{
+	for (int i = 0; i < 8; i++) {
+		if (Values[i] == Value) {
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Compute the value of Calibration register of the INA226, and the
+ * per bit value of its Current register that results from it.
+ */
+static void
+Compute_INA226(INA226_t *INA226)
+{
+	float Current_LSB;
+	float Calibration;
+
+	/*
+	 * The per bit value for current is determined by following
+	 * equation.  The 'Maximum Expected Current' unit is in Amps:
+	 * 	Current_LSB = Maximum Expected Current / 2^15
+	 * The unit of 'INA226->Maximum_Current' is in milli-Amps.
+	 */
+	Current_LSB = (float)INA226->Maximum_Current / (32768 * 1000);
+
+	/*
+	 * The value of Calibration register is determined by:
+	 * 	Calibration = 0.00512 / (Current_LSB * R shunt)
+	 * The unit of 'INA226->Shunt_Resistor' is in micro-Ohms,
+	 * and the unit of 'R shunt' is in Ohms.
+	 */
+	Calibration = (0.00512 * 1000000) /
+		      (Current_LSB * INA226->Shunt_Resistor);
+
+	/* Prevent the overflow of Calibration register[14:0] */
+	if (Calibration > 32767) {
+		Calibration = 32767;
+	}
+
+	/* The register holds an integer, so derive the LSB back from it */
+	INA226->Calibration = (unsigned short)Calibration;
+	INA226->Current_LSB = (0.00512 * 1000000) /
+			      (float)(INA226->Calibration * INA226->Shunt_Resistor);
+	INA226->Calibrated = 0;
+	SC_INFO("Calibration: %#x, Current_LSB: %f", INA226->Calibration,
+		INA226->Current_LSB);
+}
+
 int
 Parse_INA226(const char *Json_File, jsmntok_t *Tokens, int *Index, INA226s_t **INAs)
 {
@@ -540,6 +604,61 @@ Parse_INA226(const char *Json_File, jsmntok_t *Tokens, int *Index, INA226s_t **I
 		SC_INFO("Phase_Multiplier: %i\n",
 		        (*INAs)->INA226[INA226_Items].Phase_Multiplier);
 
+		/* Optional sampling configuration */
+		(*INAs)->INA226[INA226_Items].Conversion_Time = INA226_CONVERSION_TIME;
+		(*INAs)->INA226[INA226_Items].Averaging = INA226_AVERAGING;
+		(*INAs)->INA226[INA226_Items].Alert_Label = NULL;
+		while (1) {
+			(*Index)++;
+			Value_Str = strndup(Json_File + Tokens[*Index].start,
+					    Tokens[*Index].end - Tokens[*Index].start);
+			if (strcmp(Value_Str, "Conversion_Time") == 0) {
+				free(Value_Str);
+				(*Index)++;
+				Value_Str = strndup(Json_File + Tokens[*Index].start,
+						    Tokens[*Index].end - Tokens[*Index].start);
+				(*INAs)->INA226[INA226_Items].Conversion_Time = atoi(Value_Str);
+				free(Value_Str);
+				if (Validate_INA226_Value((*INAs)->INA226[INA226_Items].Conversion_Time,
+							  Conversion_Times) != 0) {
+					SC_ERR("INA226: Conversion_Time: invalid value %d",
+					       (*INAs)->INA226[INA226_Items].Conversion_Time);
+					return -1;
+				}
+
+				SC_INFO("Conversion Time: %i",
+					(*INAs)->INA226[INA226_Items].Conversion_Time);
+			} else if (strcmp(Value_Str, "Averaging") == 0) {
+				free(Value_Str);
+				(*Index)++;
+				Value_Str = strndup(Json_File + Tokens[*Index].start,
+						    Tokens[*Index].end - Tokens[*Index].start);
+				(*INAs)->INA226[INA226_Items].Averaging = atoi(Value_Str);
+				free(Value_Str);
+				if (Validate_INA226_Value((*INAs)->INA226[INA226_Items].Averaging,
+							  Averages) != 0) {
+					SC_ERR("INA226: Averaging: invalid value %d",
+					       (*INAs)->INA226[INA226_Items].Averaging);
+					return -1;
+				}
+
+				SC_INFO("Averaging: %i", (*INAs)->INA226[INA226_Items].Averaging);
+			} else if (strcmp(Value_Str, "Alert_Label") == 0) {
+				free(Value_Str);
+				(*Index)++;
+				Value_Str = strndup(Json_File + Tokens[*Index].start,
+						    Tokens[*Index].end - Tokens[*Index].start);
+				Validate_Str_Size(Value_Str, "INA226", "Alert_Label", STRLEN_MAX);
+				(*INAs)->INA226[INA226_Items].Alert_Label = Value_Str;
+				SC_INFO("Alert Label: %s", (*INAs)->INA226[INA226_Items].Alert_Label);
+			} else {
+				free(Value_Str);
+				(*Index)--;
+				break;
+			}
+		}
+
+		Compute_INA226(&(*INAs)->INA226[INA226_Items]);
 		INA226_Items++;
 	}
 
@@ -1019,6 +1138,7 @@ Parse_SFP(const char *Json_File, jsmntok_t *Tokens, int *Index, SFPs_t **SFPs)
 {
 	char *Value_Str;
 	int Item = 0;
+	int Attributes;
 
 	SC_INFO("******************** SFPs ********************");
 	*SFPs = (SFPs_t *)calloc(1, sizeof(SFPs_t));
@@ -1029,6 +1149,7 @@ Parse_SFP(const char *Json_File, jsmntok_t *Tokens, int *Index, SFPs_t **SFPs)
 	SC_INFO("Number of SFPs: %i", (*SFPs)->Numbers);
 	while (Item < (*SFPs)->Numbers) {
 		*Index += 3;
+		Attributes = Tokens[*Index - 1].size;
 		Check_Attribute("Name", "SFPs");
 		Value_Str = strndup(Json_File + Tokens[*Index].start,
 				    Tokens[*Index].end - Tokens[*Index].start);
@@ -1070,21 +1191,28 @@ Parse_SFP(const char *Json_File, jsmntok_t *Tokens, int *Index, SFPs_t **SFPs)
 		(*SFPs)->SFP[Item].I2C_Address = (int)strtol(Value_Str, NULL, 0);
 		free(Value_Str);
 
-		(*Index)++;
-		Value_Str = strndup(Json_File + Tokens[*Index].start,
-				    Tokens[*Index].end - Tokens[*Index].start);
-		if (strcmp(Value_Str, "Presence_Boundary_Scan") == 0) {
-			free(Value_Str);
+		/* Optional attributes */
+		for (int i = 4; i < Attributes; i++) {
 			(*Index)++;
-			Value_Str = strndup(Json_File + Tokens[*Index].start,
-					    Tokens[*Index].end - Tokens[*Index].start);
-			(*SFPs)->SFP[Item].Presence_Boundary_Scan = atoi(Value_Str);
-			free(Value_Str);
-			SC_INFO("Presence Boundary Scan: %i",
-				(*SFPs)->SFP[Item].Presence_Boundary_Scan);
-		} else {
-			free(Value_Str);
-			(*Index)--;
+			if (jsoneq(Json_File, &Tokens[*Index], "Presence_Boundary_Scan") == 0) {
+				(*Index)++;
+				Value_Str = strndup(Json_File + Tokens[*Index].start,
+						    Tokens[*Index].end - Tokens[*Index].start);
+				(*SFPs)->SFP[Item].Presence_Boundary_Scan = atoi(Value_Str);
+				free(Value_Str);
+				SC_INFO("Presence Boundary Scan: %i",
+					(*SFPs)->SFP[Item].Presence_Boundary_Scan);
+			} else if (jsoneq(Json_File, &Tokens[*Index], "Presence_Label") == 0) {
+				(*Index)++;
+				Value_Str = strndup(Json_File + Tokens[*Index].start,
+						    Tokens[*Index].end - Tokens[*Index].start);
+				Validate_Str_Size(Value_Str, "SFPs", "Presence_Label", STRLEN_MAX);
+				(*SFPs)->SFP[Item].Presence_Label = Value_Str;
+				SC_INFO("Presence Label: %s", (*SFPs)->SFP[Item].Presence_Label);
+			} else {
+				SC_ERR("unsupported attribute for 'SFPs'");
+				return -1;
+			}
 		}
 
 		Item++;
@@ -1194,6 +1322,64 @@ Parse_FMC(const char *Json_File, jsmntok_t *Tokens, int *Index, FMCs_t **FMCs)
 	return 0;
 }
 
+/*
+ * Adapter settings of I2C buses, e.g.
+ *
+ *	"I2C": {
+ *		"Bus_0": {
+ *			"I2C_Bus": "/dev/i2c-18",
+ *			"I2C_Timeout": 20,
+ *			"I2C_Retries": 0
+ *		}
+ *	}
+ *
+ * where the timeout is in milliseconds, and -1 leaves either as is.
+ */
+int
+Parse_I2C(const char *Json_File, jsmntok_t *Tokens, int *Index,
+	  I2C_Configs_t **I2Cs)
+{
+	char *Value_Str;
+	int Item = 0;
+
+	SC_INFO("********************* I2C ********************");
+	*I2Cs = (I2C_Configs_t *)calloc(1, sizeof(I2C_Configs_t));
+
+	(*Index)++;
+	(*I2Cs)->Numbers = Tokens[*Index].size;
+	Validate_Item_Size((*I2Cs)->Numbers, "I2C", "I2C", ITEMS_MAX);
+	SC_INFO("Number of I2C Buses: %i", (*I2Cs)->Numbers);
+	while (Item < (*I2Cs)->Numbers) {
+		*Index += 3;
+		Check_Attribute("I2C_Bus", "I2C");
+		Value_Str = strndup(Json_File + Tokens[*Index].start,
+				    Tokens[*Index].end - Tokens[*Index].start);
+		Validate_Str_Size(Value_Str, "I2C", "I2C_Bus", STRLEN_MAX);
+		(*I2Cs)->I2C_Config[Item].I2C_Bus = Value_Str;
+		SC_INFO("I2C Bus: %s", (*I2Cs)->I2C_Config[Item].I2C_Bus);
+
+		(*Index)++;
+		Check_Attribute("I2C_Timeout", "I2C");
+		Value_Str = strndup(Json_File + Tokens[*Index].start,
+				    Tokens[*Index].end - Tokens[*Index].start);
+		(*I2Cs)->I2C_Config[Item].Timeout = atoi(Value_Str);
+		free(Value_Str);
+		SC_INFO("I2C Timeout: %i", (*I2Cs)->I2C_Config[Item].Timeout);
+
+		(*Index)++;
+		Check_Attribute("I2C_Retries", "I2C");
+		Value_Str = strndup(Json_File + Tokens[*Index].start,
+				    Tokens[*Index].end - Tokens[*Index].start);
+		(*I2Cs)->I2C_Config[Item].Retries = atoi(Value_Str);
+		free(Value_Str);
+		SC_INFO("I2C Retries: %i", (*I2Cs)->I2C_Config[Item].Retries);
+
+		Item++;
+	}
+
+	return 0;
+}
+
 int
 Parse_Workaround(const char *Json_File, jsmntok_t *Tokens, int *Index,
                  Workarounds_t **WAs)
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+/*
+ * PMBus State Cache
+ *
+ * A regulator device may have several rails, each behind a page, and the
+ * page stays selected until it's changed.  The cache keeps the page that
+ * was last selected on each device, i.e. bus and address, so that PAGE is
+ * only written for a read when another rail of the device was accessed
+ * last.  A write always selects the page, so that it can't land on the
+ * wrong rail if the cache is stale.  It also keeps VOUT_MODE of each
+ * page, which tells the format and exponent of VOUT and only changes if
+ * the regulator is reconfigured.
+ *
+ * The page of a device becomes unknown when selecting it fails, and the
+ * VOUT_MODE of a page when VOUT of its rail is set.  Everything is dropped
+ * when the board is reset, and after the script of an 'External'
+ * constraint phase runs, since scripts such as get_tps53681.py write PAGE
+ * of the devices they access themselves.  Pages beyond PMBUS_PAGES_MAX
+ * are accessed as if there were no cache.
+ */
+#define PMBUS_DEVICES_MAX	64
+#define PMBUS_PAGES_MAX		32
+
+typedef struct {
+	char	Bus[STRLEN_MAX];
+	int	Address;
+	int	Page;		/* -1 if unknown */
+	unsigned int	Mode_Valid;	/* Bitmap by page */
+	unsigned char	Mode[PMBUS_PAGES_MAX];
+} PMBus_Device_t;
+
+static pthread_mutex_t PMBus_Lock = PTHREAD_MUTEX_INITIALIZER;
+static PMBus_Device_t PMBus_Devices[PMBUS_DEVICES_MAX];
+static int PMBus_Device_Numbers;
+
+/*
+ * The device of the regulator, adding it if there is room.  Must be
+ * called with PMBus_Lock held.
+ */
+static PMBus_Device_t *
+PMBus_Device(Voltage_t *Regulator)
+{
+	PMBus_Device_t *Device;
+
+	for (int i = 0; i < PMBus_Device_Numbers; i++) {
+		Device = &PMBus_Devices[i];
+		if ((Device->Address == Regulator->I2C_Address) &&
+		    (strcmp(Device->Bus, Regulator->I2C_Bus) == 0)) {
+			return Device;
+		}
+	}
+
+	if (PMBus_Device_Numbers == PMBUS_DEVICES_MAX) {
+		return NULL;
+	}
+
+	Device = &PMBus_Devices[PMBus_Device_Numbers++];
+	(void) strncpy(Device->Bus, Regulator->I2C_Bus, (STRLEN_MAX - 1));
+	Device->Address = Regulator->I2C_Address;
+	Device->Page = -1;
+	Device->Mode_Valid = 0;
+	return Device;
+}
+
+static int
+PMBus_Page(Voltage_t *Regulator)
+{
+	return ((Regulator->Page_Select == -1) ? 0 : Regulator->Page_Select);
+}
+
+/*
+ * Select the page of the regulator, if it has one, to read from it (Access
+ * 0) or write to it (Access 1).  For a read, the page isn't selected again
+ * if it's selected already.  The caller must hold the bus.
+ */
+int
+PMBus_Select_Page(int FD, Voltage_t *Regulator, int Access)
+{
+	PMBus_Device_t *Device;
+	char Out_Buffer[2];
+	int Ret = 0;
+
+	if (Regulator->Page_Select == -1) {
+		return 0;
+	}
+
+	(void) pthread_mutex_lock(&PMBus_Lock);
+	Device = PMBus_Device(Regulator);
+	if ((Access == 0) && (Device != NULL) &&
+	    (Device->Page == Regulator->Page_Select)) {
+		(void) pthread_mutex_unlock(&PMBus_Lock);
+		return 0;
+	}
+
+	(void) pthread_mutex_unlock(&PMBus_Lock);
+	Out_Buffer[0] = PMBUS_PAGE;
+	Out_Buffer[1] = Regulator->Page_Select;
+	SC_INFO("Write to select page: 0x%x%x", Out_Buffer[0], Out_Buffer[1]);
+	I2C_WRITE(FD, Regulator->I2C_Address, 2, Out_Buffer, Ret);
+	if (Device != NULL) {
+		(void) pthread_mutex_lock(&PMBus_Lock);
+		Device->Page = ((Ret == 0) ? Regulator->Page_Select : -1);
+		(void) pthread_mutex_unlock(&PMBus_Lock);
+	}
+
+	return Ret;
+}
+
+/*
+ * Get the cached VOUT_MODE of the page of the regulator.  Returns -1 if
+ * it isn't known.
+ */
+int
+PMBus_Get_Mode(Voltage_t *Regulator, unsigned char *Mode)
+{
+	PMBus_Device_t *Device;
+	int Page = PMBus_Page(Regulator);
+	int Ret = -1;
+
+	if (Page >= PMBUS_PAGES_MAX) {
+		return -1;
+	}
+
+	(void) pthread_mutex_lock(&PMBus_Lock);
+	Device = PMBus_Device(Regulator);
+	if ((Device != NULL) && (Device->Mode_Valid & (1U << Page))) {
+		*Mode = Device->Mode[Page];
+		Ret = 0;
+	}
+
+	(void) pthread_mutex_unlock(&PMBus_Lock);
+	return Ret;
+}
+
+void
+PMBus_Set_Mode(Voltage_t *Regulator, unsigned char Mode)
+{
+	PMBus_Device_t *Device;
+	int Page = PMBus_Page(Regulator);
+
+	if (Page >= PMBUS_PAGES_MAX) {
+		return;
+	}
+
+	(void) pthread_mutex_lock(&PMBus_Lock);
+	Device = PMBus_Device(Regulator);
+	if (Device != NULL) {
+		Device->Mode[Page] = Mode;
+		Device->Mode_Valid |= (1U << Page);
+	}
+
+	(void) pthread_mutex_unlock(&PMBus_Lock);
+}
+
+/*
+ * Forget the VOUT_MODE of the page of the regulator, or with NULL,
+ * everything about every device.
+ */
+void
+PMBus_Invalidate(Voltage_t *Regulator)
+{
+	PMBus_Device_t *Device;
+	int Page;
+
+	(void) pthread_mutex_lock(&PMBus_Lock);
+	if (Regulator == NULL) {
+		for (int i = 0; i < PMBus_Device_Numbers; i++) {
+			PMBus_Devices[i].Page = -1;
+			PMBus_Devices[i].Mode_Valid = 0;
+		}
+	} else {
+		Device = PMBus_Device(Regulator);
+		Page = PMBus_Page(Regulator);
+		if ((Device != NULL) && (Page < PMBUS_PAGES_MAX)) {
+			Device->Mode_Valid &= ~(1U << Page);
+		}
+	}
+
+	(void) pthread_mutex_unlock(&PMBus_Lock);
+}
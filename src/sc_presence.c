@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <gpiod.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Presence Map
+ *
+ * Probing an empty SFP cage or FMC connector waits for the I2C adapter
+ * to time out, possibly more than once with retries, so the map keeps
+ * what was last seen of each module for 'listSFP' and 'listFMC' to
+ * report empty ones right away.  It's filled in by a scan at startup.
+ *
+ * Modules with a presence GPIO line, i.e. 'Presence_Label' of SFPs and
+ * the first of 'Presence_Labels' of FMCs, both active low, are tracked
+ * by the events of the line, and the map is taken as is for them.  For
+ * the others, the map is updated by every probe, and only absence is
+ * taken from it, for PRESENCE_TTL, so that a module plugged in later is
+ * still found.
+ *
+ * SFPs whose presence is detected through boundary scan, and 'qsfp'
+ * modules, which need a PDI loaded to be selected, are left out of the
+ * scan.
+ */
+#define PRESENCE_TTL	60	/* In seconds */
+#define PRESENCE_LINES_MAX	(PRESENCE_FAMILIES * ITEMS_MAX)
+
+typedef struct {
+	unsigned int	Known;		/* Bitmaps by the index of the module */
+	unsigned int	Present;
+	unsigned int	Tracked;
+	time_t	Probed[ITEMS_MAX];
+} Presence_Map_t;
+
+typedef struct {
+	Presence_Family_t	Family;
+	int	Index;
+	const char	*Label;
+	struct gpiod_line	*Line;
+} Presence_Line_t;
+
+static pthread_mutex_t Presence_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Presence_Map_t Presence_Maps[PRESENCE_FAMILIES];
+static Presence_Line_t Presence_Lines[PRESENCE_LINES_MAX];
+static int Presence_Line_Numbers;
+
+static time_t
+Presence_Time(void)
+{
+	struct timespec Time;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &Time);
+	return Time.tv_sec;
+}
+
+static void
+Presence_Update(Presence_Family_t Family, int Index, Presence_t Presence,
+		int Tracked)
+{
+	Presence_Map_t *Map = &Presence_Maps[Family];
+	unsigned int Bit = (1U << Index);
+
+	(void) pthread_mutex_lock(&Presence_Lock);
+	if (Tracked || !(Map->Tracked & Bit)) {
+		Map->Known |= Bit;
+		Map->Present &= ~Bit;
+		if (Presence == PRESENCE_PRESENT) {
+			Map->Present |= Bit;
+		}
+
+		if (Tracked) {
+			Map->Tracked |= Bit;
+		}
+
+		Map->Probed[Index] = Presence_Time();
+	}
+
+	(void) pthread_mutex_unlock(&Presence_Lock);
+}
+
+/*
+ * The presence of the module as far as the map can tell without probing
+ * it, or PRESENCE_UNKNOWN if it needs to be probed.
+ */
+Presence_t
+Presence_Get(Presence_Family_t Family, int Index)
+{
+	Presence_Map_t *Map = &Presence_Maps[Family];
+	unsigned int Bit = (1U << Index);
+	Presence_t Presence = PRESENCE_UNKNOWN;
+
+	(void) pthread_mutex_lock(&Presence_Lock);
+	if (Map->Known & Bit) {
+		if (Map->Tracked & Bit) {
+			Presence = ((Map->Present & Bit) ? PRESENCE_PRESENT : PRESENCE_ABSENT);
+		} else if (!(Map->Present & Bit) &&
+			   ((Presence_Time() - Map->Probed[Index]) < PRESENCE_TTL)) {
+			Presence = PRESENCE_ABSENT;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&Presence_Lock);
+	return Presence;
+}
+
+/*
+ * Record the result of probing the module.  Modules that are tracked by
+ * their presence line are left alone.
+ */
+void
+Presence_Set(Presence_Family_t Family, int Index, Presence_t Presence)
+{
+	if (Presence != PRESENCE_UNKNOWN) {
+		Presence_Update(Family, Index, Presence, 0);
+	}
+}
+
+/*
+ * Probe the SFP module by reading from it, which fails if the cage is
+ * empty, and record the result.  Returns PRESENCE_UNKNOWN if the module
+ * can't be probed.
+ */
+Presence_t
+Probe_SFP(int Index)
+{
+	SFP_t *SFP = &Plat_Devs->SFPs->SFP[Index];
+	Presence_t Presence = PRESENCE_PRESENT;
+	char Buffer[1];
+	int FD;
+
+	if (QSFP_ModuleSelect(SFP, 1) != 0) {
+		return PRESENCE_UNKNOWN;
+	}
+
+	FD = I2C_Open(SFP->I2C_Bus);
+	if (FD < 0) {
+		SC_ERR("failed to access I2C bus %s: %m", SFP->I2C_Bus);
+		(void) QSFP_ModuleSelect(SFP, 0);
+		return PRESENCE_UNKNOWN;
+	}
+
+	if (I2C_Set_Address(FD, SFP->I2C_Address) != 0) {
+		SC_ERR("failed to configure I2C bus for access to "
+		       "device address %#x: %m", SFP->I2C_Address);
+		(void) QSFP_ModuleSelect(SFP, 0);
+		I2C_Close(FD);
+		return PRESENCE_UNKNOWN;
+	}
+
+	if (I2C_Read(FD, SFP->I2C_Address, Buffer, 1) != 1) {
+		Presence = PRESENCE_ABSENT;
+	}
+
+	(void) QSFP_ModuleSelect(SFP, 0);
+	I2C_Close(FD);
+	Presence_Set(PRESENCE_SFP, Index, Presence);
+	return Presence;
+}
+
+/*
+ * Probe the FMC by setting the offset of its EEPROM, which fails if the
+ * connector is empty, and record the result.  Returns PRESENCE_UNKNOWN if
+ * the FMC can't be probed.
+ */
+Presence_t
+Probe_FMC(int Index)
+{
+	FMC_t *FMC = &Plat_Devs->FMCs->FMC[Index];
+	Presence_t Presence = PRESENCE_PRESENT;
+	char Buffer[1] = { 0x0 };
+	int FD;
+
+	FD = I2C_Open(FMC->I2C_Bus);
+	if (FD < 0) {
+		SC_ERR("unable to access I2C bus %s: %m", FMC->I2C_Bus);
+		return PRESENCE_UNKNOWN;
+	}
+
+	if (I2C_Set_Address(FD, FMC->I2C_Address) != 0) {
+		SC_ERR("unable to access I2C device %#x: %m", FMC->I2C_Address);
+		I2C_Close(FD);
+		return PRESENCE_UNKNOWN;
+	}
+
+	if (I2C_Write(FD, FMC->I2C_Address, Buffer, 1) != 1) {
+		Presence = PRESENCE_ABSENT;
+	}
+
+	I2C_Close(FD);
+	Presence_Set(PRESENCE_FMC, Index, Presence);
+	return Presence;
+}
+
+/*
+ * Request events of the presence line of the module, and take its
+ * current state.  A line that gpiod doesn't know about is skipped, which
+ * leaves the module to be probed.
+ */
+static void
+Track_Line(Presence_Family_t Family, int Index, const char *Label)
+{
+	Presence_Line_t *Presence_Line;
+	struct gpiod_chip *Chip;
+	struct gpiod_line *Line;
+	char Chip_Name[STRLEN_MAX];
+	unsigned int Offset;
+	int State;
+
+	if ((Label == NULL) || (Presence_Line_Numbers == PRESENCE_LINES_MAX) ||
+	    (gpiod_ctxless_find_line(Label, Chip_Name, STRLEN_MAX, &Offset) != 1)) {
+		return;
+	}
+
+	Chip = gpiod_chip_open_by_name(Chip_Name);
+	if (Chip == NULL) {
+		SC_ERR("failed to open gpio chip %s", Chip_Name);
+		return;
+	}
+
+	Line = gpiod_chip_get_line(Chip, Offset);
+	if ((Line == NULL) ||
+	    (gpiod_line_request_both_edges_events(Line, "sc_appd") == -1)) {
+		SC_ERR("failed to request events of gpio line %s", Label);
+		gpiod_chip_close(Chip);
+		return;
+	}
+
+	State = gpiod_line_get_value(Line);
+	if (State == -1) {
+		SC_ERR("failed to get state of gpio line %s", Label);
+		gpiod_chip_close(Chip);
+		return;
+	}
+
+	Presence_Line = &Presence_Lines[Presence_Line_Numbers++];
+	Presence_Line->Family = Family;
+	Presence_Line->Index = Index;
+	Presence_Line->Label = Label;
+	Presence_Line->Line = Line;
+	Presence_Update(Family, Index, (State ? PRESENCE_ABSENT : PRESENCE_PRESENT), 1);
+}
+
+/*
+ * Get the state of the line if it's one of the presence lines being
+ * tracked, which can't be requested again, e.g. by 'gpioget', while held
+ * for events.  Returns 1 if the line isn't tracked.
+ */
+int
+Presence_Line_State(const char *Label, int *State)
+{
+	for (int i = 0; i < Presence_Line_Numbers; i++) {
+		if (strcmp(Presence_Lines[i].Label, Label) == 0) {
+			*State = gpiod_line_get_value(Presence_Lines[i].Line);
+			if (*State == -1) {
+				SC_ERR("failed to get state of gpio line %s", Label);
+				return -1;
+			}
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void *
+Presence_Thread(void *Arg)
+{
+	struct pollfd FDs[PRESENCE_LINES_MAX];
+	struct gpiod_line_event Event;
+	Presence_Line_t *Presence_Line;
+
+	for (int i = 0; i < Presence_Line_Numbers; i++) {
+		FDs[i].fd = gpiod_line_event_get_fd(Presence_Lines[i].Line);
+		FDs[i].events = POLLIN;
+	}
+
+	while (1) {
+		if (poll(FDs, Presence_Line_Numbers, -1) < 0) {
+			continue;
+		}
+
+		for (int i = 0; i < Presence_Line_Numbers; i++) {
+			if (!(FDs[i].revents & POLLIN)) {
+				continue;
+			}
+
+			Presence_Line = &Presence_Lines[i];
+			if (gpiod_line_event_read(Presence_Line->Line, &Event) < 0) {
+				SC_ERR("failed to read presence line event");
+				continue;
+			}
+
+			/* Presence lines are active low */
+			Presence_Update(Presence_Line->Family, Presence_Line->Index,
+					((Event.event_type == GPIOD_LINE_EVENT_FALLING_EDGE) ?
+					 PRESENCE_PRESENT : PRESENCE_ABSENT), 1);
+			SC_INFO("%s module %d is %s",
+				((Presence_Line->Family == PRESENCE_SFP) ? "SFP" : "FMC"),
+				Presence_Line->Index,
+				((Event.event_type == GPIOD_LINE_EVENT_FALLING_EDGE) ?
+				 "plugged in" : "removed"));
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Scan the SFPs and FMCs of the board, and follow the presence lines of
+ * those that have them.  The scan is done before any command is served,
+ * so nothing else is accessing the buses.
+ */
+int
+Presence_Init(void)
+{
+	SFPs_t *SFPs = Plat_Devs->SFPs;
+	FMCs_t *FMCs = Plat_Devs->FMCs;
+	SFP_t *SFP;
+	pthread_t Thread;
+	int Ret;
+
+	for (int i = 0; (SFPs != NULL) && (i < SFPs->Numbers); i++) {
+		SFP = &SFPs->SFP[i];
+		Track_Line(PRESENCE_SFP, i, SFP->Presence_Label);
+		if ((Presence_Get(PRESENCE_SFP, i) == PRESENCE_UNKNOWN) &&
+		    (SFP->Presence_Boundary_Scan == 0) && (SFP->Type != qsfp)) {
+			(void) Probe_SFP(i);
+		}
+	}
+
+	for (int i = 0; (FMCs != NULL) && (i < FMCs->Numbers); i++) {
+		if (FMCs->FMC[i].Label_Numbers > 0) {
+			Track_Line(PRESENCE_FMC, i, FMCs->FMC[i].Presence_Labels[0]);
+		}
+
+		if (Presence_Get(PRESENCE_FMC, i) == PRESENCE_UNKNOWN) {
+			(void) Probe_FMC(i);
+		}
+	}
+
+	if (Presence_Line_Numbers == 0) {
+		return 0;
+	}
+
+	Ret = pthread_create(&Thread, NULL, Presence_Thread, NULL);
+	if (Ret != 0) {
+		SC_ERR("failed to create presence thread: %s", strerror(Ret));
+
+		/* Without events, the lines no longer tell the presence */
+		for (int i = 0; i < PRESENCE_FAMILIES; i++) {
+			Presence_Maps[i].Known &= ~Presence_Maps[i].Tracked;
+			Presence_Maps[i].Tracked = 0;
+		}
+
+		return -1;
+	}
+
+	(void) pthread_detach(Thread);
+	return 0;
+}
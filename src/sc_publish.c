@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "sc_app.h"
+#include "sc_telemetry.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Telemetry Publisher
+ *
+ * A thread samples every sensor of the board once per PUBLISH_INTERVAL
+ * and writes the readings to the shared memory segment described in
+ * sc_telemetry.h.  Each sensor is read while holding its I2C bus, so
+ * sampling is serialized with commands that access the same bus, the
+ * same way 'watch' is.  A sensor that fails, e.g. an SFP cage with no
+ * module in it, is retried every PUBLISH_RETRY rounds rather than every
+ * round, so it doesn't flood the log.  Sensors are sampled in the order
+ * of I2C_Order(), so that those behind one channel of a mux are read
+ * before the mux is switched to the next.
+ *
+ * Only 'sfp' and 'osfp' modules are covered, since the others need to
+ * be selected first, which on some boards means loading a PDI.  Sensors
+ * the board reads through a 'Terminate' constraint are left out, since
+ * only the script of the constraint reads them right.
+ */
+#define PUBLISH_INTERVAL	1000	/* In milliseconds */
+#define PUBLISH_RETRY		60
+
+typedef struct {
+	int	Ready;
+	unsigned long	Retry;
+	Telemetry_Sensor_t	*Slot;
+} Published_t;
+
+typedef struct {
+	int	Numbers;
+	Sensor_t	*Sensor;
+	Published_t	*Published;
+	const char	**Buses;
+	int	*Order;
+	Request_t	*Request;
+	Telemetry_Header_t	*Header;
+} Publisher_t;
+
+static void
+Add_Sensor(Publisher_t *Publisher, Sensor_Type_t Type, const char *Name,
+	   const char *I2C_Bus, void *Device)
+{
+	Sensor_t *Sensor = &Publisher->Sensor[Publisher->Numbers];
+
+	if (Sensor_Constrained(Type, Name)) {
+		SC_INFO("%s is read through a board constraint, not published", Name);
+		return;
+	}
+
+	Publisher->Buses[Publisher->Numbers++] = I2C_Bus;
+	Sensor->Type = Type;
+	Sensor->Name = Name;
+	Sensor->I2C_Bus = I2C_Bus;
+	Sensor->Device = Device;
+}
+
+static int
+Add_Sensors(Publisher_t *Publisher)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+	Temperature_t *Temperature = Plat_Devs->Temperature;
+	DIMMs_t *DIMMs = Plat_Devs->DIMMs;
+	SFPs_t *SFPs = Plat_Devs->SFPs;
+	SFP_t *SFP;
+	int Size;
+
+	Size = 1 + ((INA226s != NULL) ? INA226s->Numbers : 0) +
+	       ((Voltages != NULL) ? Voltages->Numbers : 0) +
+	       ((DIMMs != NULL) ? DIMMs->Numbers : 0) +
+	       ((SFPs != NULL) ? SFPs->Numbers : 0);
+	Publisher->Sensor = calloc(Size, sizeof(Sensor_t));
+	Publisher->Published = calloc(Size, sizeof(Published_t));
+	Publisher->Buses = calloc(Size, sizeof(char *));
+	Publisher->Order = calloc(Size, sizeof(int));
+	if ((Publisher->Sensor == NULL) || (Publisher->Published == NULL) ||
+	    (Publisher->Buses == NULL) || (Publisher->Order == NULL)) {
+		SC_ERR("failed to allocate telemetry sensors: %m");
+		return -1;
+	}
+
+	for (int i = 0; (INA226s != NULL) && (i < INA226s->Numbers); i++) {
+		Add_Sensor(Publisher, SENSOR_POWER, INA226s->INA226[i].Name,
+			   INA226s->INA226[i].I2C_Bus, &INA226s->INA226[i]);
+	}
+
+	for (int i = 0; (Voltages != NULL) && (i < Voltages->Numbers); i++) {
+		Add_Sensor(Publisher, SENSOR_VOLTAGE, Voltages->Voltage[i].Name,
+			   Voltages->Voltage[i].I2C_Bus, &Voltages->Voltage[i]);
+	}
+
+	if (Temperature != NULL) {
+		Add_Sensor(Publisher, SENSOR_TEMPERATURE, Temperature->Name, NULL,
+			   Temperature);
+	}
+
+	for (int i = 0; (DIMMs != NULL) && (i < DIMMs->Numbers); i++) {
+		Add_Sensor(Publisher, SENSOR_DIMM, DIMMs->DIMM[i].Name,
+			   DIMMs->DIMM[i].I2C_Bus, &DIMMs->DIMM[i]);
+	}
+
+	for (int i = 0; (SFPs != NULL) && (i < SFPs->Numbers); i++) {
+		SFP = &SFPs->SFP[i];
+		if (((SFP->Type == sfp) || (SFP->Type == osfp)) &&
+		    (SFP->Presence_Boundary_Scan == 0)) {
+			Add_Sensor(Publisher, SENSOR_SFP, SFP->Name, SFP->I2C_Bus, SFP);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Create the segment from scratch, so that readers of a previous
+ * instance of sc_appd notice the change of generation.
+ */
+static int
+Create_Segment(Publisher_t *Publisher)
+{
+	/* Indexed by Sensor_Type_t, which is in the order of Telemetry_Type_t */
+	static const int Value_Numbers[] = { 3, 1, 1, 1, 2 };
+	Telemetry_Header_t *Header;
+	Telemetry_Sensor_t *Slot;
+	struct timespec Time;
+	size_t Size;
+	void *Map;
+	int FD;
+
+	Size = sizeof(Telemetry_Header_t) +
+	       (Publisher->Numbers * sizeof(Telemetry_Sensor_t));
+	(void) shm_unlink(TELEMETRY_SHM);
+	FD = shm_open(TELEMETRY_SHM, (O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC), 0644);
+	if (FD == -1) {
+		SC_ERR("failed to create telemetry segment: %m");
+		return -1;
+	}
+
+	if (ftruncate(FD, Size) == -1) {
+		SC_ERR("failed to size telemetry segment: %m");
+		(void) close(FD);
+		return -1;
+	}
+
+	Map = mmap(NULL, Size, (PROT_READ | PROT_WRITE), MAP_SHARED, FD, 0);
+	(void) close(FD);
+	if (Map == MAP_FAILED) {
+		SC_ERR("failed to map telemetry segment: %m");
+		return -1;
+	}
+
+	Header = Map;
+	Header->Version = TELEMETRY_VERSION;
+	Header->Header_Size = sizeof(Telemetry_Header_t);
+	Header->Sensor_Size = sizeof(Telemetry_Sensor_t);
+	Header->Sensor_Numbers = Publisher->Numbers;
+	Header->History = TELEMETRY_HISTORY;
+	Header->Interval = PUBLISH_INTERVAL;
+	(void) clock_gettime(CLOCK_REALTIME, &Time);
+	Header->Generation = ((uint64_t)Time.tv_sec * 1000000000) + Time.tv_nsec;
+	Slot = (Telemetry_Sensor_t *)(Header + 1);
+	for (int i = 0; i < Publisher->Numbers; i++) {
+		Publisher->Published[i].Slot = &Slot[i];
+		Slot[i].Type = Publisher->Sensor[i].Type;
+		Slot[i].Value_Numbers = Value_Numbers[Slot[i].Type];
+		(void) strncpy(Slot[i].Name, Publisher->Sensor[i].Name,
+			       (TELEMETRY_NAME_MAX - 1));
+	}
+
+	__atomic_store_n(&Header->Magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+	Publisher->Header = Header;
+	return 0;
+}
+
+/*
+ * Append a sample to the history of the sensor under its sequence lock.
+ */
+static void
+Publish_Sample(Telemetry_Sensor_t *Slot, int Status, const float *Value)
+{
+	Telemetry_Sample_t *Sample;
+	struct timespec Time;
+	uint32_t Sequence = Slot->Sequence;
+
+	(void) clock_gettime(CLOCK_REALTIME, &Time);
+	__atomic_store_n(&Slot->Sequence, (Sequence + 1), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	Sample = &Slot->Sample[Slot->Count % TELEMETRY_HISTORY];
+	Sample->Timestamp = ((uint64_t)Time.tv_sec * 1000000000) + Time.tv_nsec;
+	Sample->Status = Status;
+	(void) memcpy(Sample->Value, Value, sizeof(Sample->Value));
+	Slot->Count++;
+	__atomic_store_n(&Slot->Sequence, (Sequence + 2), __ATOMIC_RELEASE);
+}
+
+static void
+Sample_Sensor(Publisher_t *Publisher, int Index, unsigned long Round)
+{
+	Request_t *Request = Publisher->Request;
+	Sensor_t *Sensor = &Publisher->Sensor[Index];
+	Published_t *Published = &Publisher->Published[Index];
+	float Value[TELEMETRY_VALUES_MAX] = { 0 };
+	int Ret = 0;
+
+	if ((Sensor->I2C_Bus != NULL) && (Sensor->FD == -1)) {
+		return;
+	}
+
+	if (!Published->Ready && (Round < Published->Retry)) {
+		return;
+	}
+
+	Request->Resource_Numbers = 0;
+	Add_Resource(Request, Sensor->I2C_Bus);
+	Worker_Acquire(Request);
+	if (!Published->Ready) {
+		Ret = Sensor_Setup(Sensor);
+	}
+
+	if (Ret == 0) {
+		Ret = Sensor_Read(Sensor, Value);
+	}
+
+	Worker_Release(Request);
+	if (Ret < 0) {
+		Published->Ready = 0;
+		Published->Retry = Round + PUBLISH_RETRY;
+		Publish_Sample(Published->Slot, -1, Value);
+		return;
+	}
+
+	Published->Ready = 1;
+	Publish_Sample(Published->Slot, 0, Value);
+}
+
+static void *
+Publish_Thread(void *Arg)
+{
+	Publisher_t *Publisher = Arg;
+	struct timespec Next;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &Next);
+	for (unsigned long Round = 0; ; Round++) {
+		for (int i = 0; i < Publisher->Numbers; i++) {
+			Sample_Sensor(Publisher, Publisher->Order[i], Round);
+		}
+
+		I2C_Count_Saved(Publisher->Buses, Publisher->Numbers, Publisher->Order);
+
+		Next.tv_nsec += (PUBLISH_INTERVAL % 1000) * 1000000;
+		Next.tv_sec += (PUBLISH_INTERVAL / 1000) + (Next.tv_nsec / 1000000000);
+		Next.tv_nsec %= 1000000000;
+		(void) clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Next, NULL);
+	}
+
+	return NULL;
+}
+
+/*
+ * Start publishing telemetry.  Failing to do so isn't fatal to sc_appd,
+ * which still serves commands.
+ */
+int
+Publish_Init(void)
+{
+	Publisher_t *Publisher;
+	pthread_t Thread;
+	int Ret;
+
+	Publisher = calloc(1, sizeof(Publisher_t));
+	if (Publisher == NULL) {
+		SC_ERR("failed to allocate telemetry publisher: %m");
+		return -1;
+	}
+
+	Publisher->Request = calloc(1, sizeof(Request_t));
+	if (Publisher->Request == NULL) {
+		SC_ERR("failed to allocate telemetry request: %m");
+		goto Out;
+	}
+
+	Publisher->Request->Priority = PRIORITY_HIGH;
+
+	if (Add_Sensors(Publisher) != 0) {
+		goto Out;
+	}
+
+	if (Publisher->Numbers == 0) {
+		SC_INFO("No sensors to publish telemetry for");
+		goto Out;
+	}
+
+	if (Create_Segment(Publisher) != 0) {
+		goto Out;
+	}
+
+	/* Sensors on a bus that can't be opened are left out */
+	(void) Sensor_Open(Publisher->Sensor, Publisher->Numbers);
+	I2C_Order(Publisher->Buses, Publisher->Numbers, Publisher->Order);
+	Ret = pthread_create(&Thread, NULL, Publish_Thread, Publisher);
+	if (Ret != 0) {
+		SC_ERR("failed to create telemetry thread: %s", strerror(Ret));
+		goto Out;
+	}
+
+	(void) pthread_detach(Thread);
+	return 0;
+
+Out:
+	free(Publisher->Sensor);
+	free(Publisher->Published);
+	free(Publisher->Buses);
+	free(Publisher->Order);
+	free(Publisher->Request);
+	free(Publisher);
+	return -1;
+}
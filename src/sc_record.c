@@ -0,0 +1,1117 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Record and Replay
+ *
+ * With 'Record: <file>' entry in CONFIGFILE, sc_appd records every command
+ * it serves, and every interaction with the devices of the board along
+ * with its result and how long it took, into the file: the system calls
+ * on I2C buses, reads and writes of GPIO lines through Get_GPIO() and
+ * Set_GPIO(), and programs run through Shell_Execute().
+ *
+ * With 'Replay: <file>' entry instead, the board is the one the trace was
+ * recorded on, and every such interaction is answered from the trace, in
+ * the time it took when it was recorded, rather than by the hardware.
+ * Once sc_appd is up, the recorded commands are sent to it one after
+ * another, each when it was received while recording, and when they're
+ * all done, sc_appd logs a summary and exits with 1 if any of them ended
+ * with another status than it did, or with 0.
+ * So a session in the field, e.g. a boot followed by an hour of polling
+ * 'getpower', can be replayed on a build host to compare the CPU time,
+ * allocations, and latency of two builds of sc_appd.
+ *
+ * The trace is a Trace_Header_t followed by records, each a Trace_Record_t
+ * and Length bytes of data.  The first Key_Length bytes of the data tell
+ * the interaction, e.g. the messages of an I2C_RDWR ioctl with the bytes
+ * they write, or the label of a GPIO line, and the rest is its response,
+ * e.g. the bytes read.  Buses are numbered in the order they're opened,
+ * by TRACE_BUS records, and their interactions are in the stream of the
+ * bus, while the others are in stream 0.
+ *
+ * Threads interleave differently on replay, so an interaction is matched
+ * with the next unused record of its stream with the same key within
+ * TRACE_WINDOW records.  Failing that, any record with the same key is
+ * reused, e.g. for a rail that's polled more often than it was, and an
+ * interaction that wasn't recorded at all fails as a device that doesn't
+ * acknowledge.  Programs whose output is parsed, e.g. xsdb and sensors,
+ * aren't recorded and are run as is on replay.
+ */
+#define TRACE_MAGIC	0x52544353	/* "SCTR" */
+#define TRACE_VERSION	1
+#define TRACE_STREAMS_MAX	64
+#define TRACE_FILES_MAX	64
+#define TRACE_WINDOW	256
+#define REPLAY_CONNECT	100	/* Attempts, REPLAY_CONNECT_DELAY apart */
+#define REPLAY_CONNECT_DELAY	50000	/* In microseconds */
+
+typedef enum {
+	TRACE_BUS = 16,
+	TRACE_IOCTL,
+	TRACE_RDWR,
+	TRACE_READ,
+	TRACE_WRITE,
+	TRACE_COMMAND,
+} Trace_Type_t;
+
+typedef struct {
+	uint32_t	Magic;
+	uint16_t	Version;
+	uint16_t	Record_Size;
+	uint64_t	Start;		/* CLOCK_REALTIME in nanoseconds */
+	char	Board[LSTRLEN_MAX];
+	char	EEPROM_Bus[STRLEN_MAX];
+	int32_t	EEPROM_Address;
+} Trace_Header_t;
+
+typedef struct {
+	uint8_t	Type;		/* Trace_Type_t or Record_Event_t */
+	uint8_t	Stream;
+	uint16_t	Key_Length;
+	uint16_t	Length;
+	int16_t	Error;		/* errno, or 0 */
+	int32_t	Arg;		/* I2C address, or state of GPIO line */
+	uint32_t	Time;		/* In milliseconds since the trace started */
+	uint32_t	Latency;	/* In microseconds */
+	int32_t	Ret;
+} Trace_Record_t;
+
+/* Descriptors of buses, to tell their stream and slave address */
+typedef struct {
+	int	FD;
+	int	Stream;
+	int	Address;
+} Trace_File_t;
+
+typedef struct {
+	Trace_Record_t	Head;
+	const unsigned char	*Data;
+	int	Used;
+} Replay_Record_t;
+
+typedef struct {
+	Replay_Record_t	**Record;
+	int	Numbers;
+	int	Cursor;		/* First unused record */
+} Replay_Stream_t;
+
+static pthread_mutex_t Trace_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Trace_File_t Trace_Files[TRACE_FILES_MAX];
+static int Trace_File_Numbers;
+static char Trace_Buses[TRACE_STREAMS_MAX][STRLEN_MAX];
+static int Trace_Bus_Numbers;
+
+static FILE *Record_File;
+static const I2C_Backend_t *Record_Lower;
+static long long Record_Base;
+
+static unsigned char *Replay_Trace;
+static Replay_Record_t *Replay_Records;
+static Replay_Stream_t Replay_Streams[TRACE_STREAMS_MAX];
+static Replay_Record_t **Replay_Commands;
+static int Replay_Command_Numbers;
+static long long Replay_Base;
+static unsigned long long Replay_Matched, Replay_Reused, Replay_Missing;
+
+/*
+ * The entry of the descriptor, or NULL if it isn't tracked.  Must be
+ * called with Trace_Lock held.
+ */
+static Trace_File_t *
+Trace_File(int FD)
+{
+	for (int i = 0; i < Trace_File_Numbers; i++) {
+		if (Trace_Files[i].FD == FD) {
+			return &Trace_Files[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Track the descriptor of the bus of the stream.  Must be called with
+ * Trace_Lock held.
+ */
+static void
+Trace_Add_File(int FD, int Stream)
+{
+	Trace_File_t *File;
+
+	if (Trace_File_Numbers < TRACE_FILES_MAX) {
+		File = &Trace_Files[Trace_File_Numbers++];
+		File->FD = FD;
+		File->Stream = Stream;
+		File->Address = -1;
+	}
+}
+
+static void
+Trace_Remove_File(int FD)
+{
+	Trace_File_t *File;
+
+	(void) pthread_mutex_lock(&Trace_Lock);
+	File = Trace_File(FD);
+	if (File != NULL) {
+		*File = Trace_Files[--Trace_File_Numbers];
+	}
+
+	(void) pthread_mutex_unlock(&Trace_Lock);
+}
+
+/*
+ * The stream and slave address of the descriptor, or -1 for the stream
+ * if it isn't tracked.
+ */
+static int
+Trace_Stream(int FD, int *Address)
+{
+	Trace_File_t *File;
+	int Stream = -1;
+
+	(void) pthread_mutex_lock(&Trace_Lock);
+	File = Trace_File(FD);
+	if (File != NULL) {
+		Stream = File->Stream;
+		*Address = File->Address;
+	}
+
+	(void) pthread_mutex_unlock(&Trace_Lock);
+	return Stream;
+}
+
+static void
+Trace_Set_Address(int FD, int Address)
+{
+	Trace_File_t *File;
+
+	(void) pthread_mutex_lock(&Trace_Lock);
+	File = Trace_File(FD);
+	if (File != NULL) {
+		File->Address = Address;
+	}
+
+	(void) pthread_mutex_unlock(&Trace_Lock);
+}
+
+/*
+ * The key of an I2C_RDWR ioctl, i.e. the address, flags, and length of
+ * each message followed by the bytes written, into Key if it isn't NULL.
+ * Returns the length of the key.
+ */
+static int
+Trace_Key(struct i2c_rdwr_ioctl_data *Msgset, unsigned char *Key)
+{
+	struct i2c_msg *Msg;
+	uint16_t Header[3];
+	int Length = 0;
+
+	for (int i = 0; i < Msgset->nmsgs; i++) {
+		Msg = &Msgset->msgs[i];
+		Header[0] = Msg->addr;
+		Header[1] = Msg->flags;
+		Header[2] = Msg->len;
+		if (Key != NULL) {
+			(void) memcpy(&Key[Length], Header, sizeof(Header));
+		}
+
+		Length += sizeof(Header);
+	}
+
+	for (int i = 0; i < Msgset->nmsgs; i++) {
+		Msg = &Msgset->msgs[i];
+		if (Msg->flags & I2C_M_RD) {
+			continue;
+		}
+
+		if (Key != NULL) {
+			(void) memcpy(&Key[Length], Msg->buf, Msg->len);
+		}
+
+		Length += Msg->len;
+	}
+
+	return Length;
+}
+
+static uint32_t
+Trace_Clamp(long long Value)
+{
+	return ((Value < 0) ? 0 : (Value > UINT32_MAX) ? UINT32_MAX : Value);
+}
+
+static uint32_t
+Trace_Microseconds(long long Nanoseconds)
+{
+	return Trace_Clamp(Nanoseconds / 1000);
+}
+
+/*
+ * Append a record of an interaction that started at Start, in
+ * Stats_Time(), to the trace.  Records that don't fit are left out.
+ */
+static void
+Trace_Write(int Type, int Stream, int Arg, long long Start, int Ret, int Error,
+	    const void *Key, int Key_Length, const void *Data, int Data_Length)
+{
+	Trace_Record_t Record = { 0 };
+
+	if ((Key_Length + Data_Length) > UINT16_MAX) {
+		return;
+	}
+
+	Record.Type = Type;
+	Record.Stream = Stream;
+	Record.Key_Length = Key_Length;
+	Record.Length = Key_Length + Data_Length;
+	Record.Error = ((Ret < 0) ? Error : 0);
+	Record.Arg = Arg;
+	Record.Latency = Trace_Microseconds(Stats_Time() - Start);
+	Record.Ret = Ret;
+	(void) pthread_mutex_lock(&Trace_Lock);
+	Record.Time = Trace_Clamp((Start - Record_Base) / 1000000);
+	(void) fwrite(&Record, sizeof(Record), 1, Record_File);
+	(void) fwrite(Key, 1, Key_Length, Record_File);
+	(void) fwrite(Data, 1, Data_Length, Record_File);
+
+	/* The trace is complete as of the last command */
+	if (Type == TRACE_COMMAND) {
+		(void) fflush(Record_File);
+	}
+
+	(void) pthread_mutex_unlock(&Trace_Lock);
+}
+
+/*
+ * Recording Backend
+ *
+ * Passes the calls on to the backend it replaced and records them.
+ */
+static int
+Record_Open(const char *Bus)
+{
+	long long Start = Stats_Time();
+	int Stream = -1;
+	int Saved_Errno;
+	int FD;
+
+	FD = Record_Lower->Open(Bus);
+	Saved_Errno = errno;
+	(void) pthread_mutex_lock(&Trace_Lock);
+	for (int i = 0; i < Trace_Bus_Numbers; i++) {
+		if (strcmp(Trace_Buses[i], Bus) == 0) {
+			Stream = i + 1;
+			break;
+		}
+	}
+
+	if ((Stream == -1) && (Trace_Bus_Numbers < (TRACE_STREAMS_MAX - 1)) &&
+	    (strlen(Bus) < STRLEN_MAX)) {
+		(void) strcpy(Trace_Buses[Trace_Bus_Numbers++], Bus);
+		Stream = Trace_Bus_Numbers;
+	}
+
+	if ((FD >= 0) && (Stream != -1)) {
+		Trace_Add_File(FD, Stream);
+	}
+
+	(void) pthread_mutex_unlock(&Trace_Lock);
+	if (Stream != -1) {
+		Trace_Write(TRACE_BUS, Stream, 0, Start, ((FD < 0) ? -1 : 0),
+			    Saved_Errno, Bus, strlen(Bus), NULL, 0);
+	}
+
+	errno = Saved_Errno;
+	return FD;
+}
+
+static int
+Record_Close(int FD)
+{
+	Trace_Remove_File(FD);
+	return Record_Lower->Close(FD);
+}
+
+static int
+Record_Transfer(int FD, struct i2c_rdwr_ioctl_data *Msgset)
+{
+	long long Start = Stats_Time();
+	unsigned char *Key, *Data;
+	int Key_Length, Data_Length = 0;
+	int Stream, Address;
+	int Saved_Errno;
+	int Ret;
+
+	Ret = Record_Lower->Ioctl(FD, I2C_RDWR, (unsigned long)Msgset);
+	Saved_Errno = errno;
+	Stream = Trace_Stream(FD, &Address);
+	if ((Stream == -1) || (Msgset->nmsgs == 0)) {
+		errno = Saved_Errno;
+		return Ret;
+	}
+
+	Key_Length = Trace_Key(Msgset, NULL);
+	for (int i = 0; i < Msgset->nmsgs; i++) {
+		if (Msgset->msgs[i].flags & I2C_M_RD) {
+			Data_Length += Msgset->msgs[i].len;
+		}
+	}
+
+	Key = malloc(Key_Length + Data_Length);
+	if (Key != NULL) {
+		(void) Trace_Key(Msgset, Key);
+		Data = &Key[Key_Length];
+		for (int i = 0; i < Msgset->nmsgs; i++) {
+			if (Msgset->msgs[i].flags & I2C_M_RD) {
+				(void) memcpy(Data, Msgset->msgs[i].buf, Msgset->msgs[i].len);
+				Data += Msgset->msgs[i].len;
+			}
+		}
+
+		Trace_Write(TRACE_RDWR, Stream, Msgset->msgs[0].addr, Start, Ret,
+			    Saved_Errno, Key, Key_Length, &Key[Key_Length],
+			    ((Ret < 0) ? 0 : Data_Length));
+		free(Key);
+	}
+
+	errno = Saved_Errno;
+	return Ret;
+}
+
+static int
+Record_Ioctl(int FD, unsigned long Request, unsigned long Arg)
+{
+	long long Start = Stats_Time();
+	uint32_t Key[2] = { Request, Arg };
+	int Stream, Address;
+	int Saved_Errno;
+	int Ret;
+
+	if (Request == I2C_RDWR) {
+		return Record_Transfer(FD, (struct i2c_rdwr_ioctl_data *)Arg);
+	}
+
+	Ret = Record_Lower->Ioctl(FD, Request, Arg);
+	Saved_Errno = errno;
+	if ((Ret == 0) && ((Request == I2C_SLAVE) || (Request == I2C_SLAVE_FORCE))) {
+		Trace_Set_Address(FD, Arg);
+	}
+
+	Stream = Trace_Stream(FD, &Address);
+	if (Stream != -1) {
+		Trace_Write(TRACE_IOCTL, Stream, Address, Start, Ret, Saved_Errno,
+			    Key, sizeof(Key), NULL, 0);
+	}
+
+	errno = Saved_Errno;
+	return Ret;
+}
+
+static ssize_t
+Record_Read(int FD, void *Buffer, size_t Length)
+{
+	long long Start = Stats_Time();
+	uint16_t Key = Length;
+	int Stream, Address;
+	int Saved_Errno;
+	ssize_t Ret;
+
+	Ret = Record_Lower->Read(FD, Buffer, Length);
+	Saved_Errno = errno;
+	Stream = Trace_Stream(FD, &Address);
+	if (Stream != -1) {
+		Trace_Write(TRACE_READ, Stream, Address, Start, Ret, Saved_Errno,
+			    &Key, sizeof(Key), Buffer, ((Ret < 0) ? 0 : Ret));
+	}
+
+	errno = Saved_Errno;
+	return Ret;
+}
+
+static ssize_t
+Record_Write(int FD, const void *Buffer, size_t Length)
+{
+	long long Start = Stats_Time();
+	int Stream, Address;
+	int Saved_Errno;
+	ssize_t Ret;
+
+	Ret = Record_Lower->Write(FD, Buffer, Length);
+	Saved_Errno = errno;
+	Stream = Trace_Stream(FD, &Address);
+	if (Stream != -1) {
+		Trace_Write(TRACE_WRITE, Stream, Address, Start, Ret, Saved_Errno,
+			    Buffer, Length, NULL, 0);
+	}
+
+	errno = Saved_Errno;
+	return Ret;
+}
+
+static const I2C_Backend_t Record_Backend = {
+	.Open = Record_Open,
+	.Close = Record_Close,
+	.Ioctl = Record_Ioctl,
+	.Read = Record_Read,
+	.Write = Record_Write,
+};
+
+/*
+ * Keep the request of the client as it was received, since it's split
+ * into arguments in place.
+ */
+void
+Record_Request(Client_t *Client)
+{
+	if (Record_File != NULL) {
+		(void) strcpy(Client->Line, Client->Request);
+	}
+}
+
+/*
+ * Record the request of the client along with the status it completed
+ * with.
+ */
+void
+Record_Command(Client_t *Client)
+{
+	if (Record_File != NULL) {
+		Trace_Write(TRACE_COMMAND, 0, 0, Client->Start, Client->Status, 0,
+			    Client->Line, strlen(Client->Line), NULL, 0);
+	}
+}
+
+/*
+ * Record a GPIO access or a program run, which started at Start.  Value
+ * is the state of the line.
+ */
+void
+Record_Event(Record_Event_t Type, const char *Name, int Value, int Ret,
+	     long long Start)
+{
+	int Saved_Errno = errno;
+
+	if (Record_File != NULL) {
+		Trace_Write(Type, 0, Value, Start, Ret, Saved_Errno, Name,
+			    strlen(Name), NULL, 0);
+	}
+
+	errno = Saved_Errno;
+}
+
+/*
+ * Start recording, if 'Record' entry is in CONFIGFILE.  Must be called
+ * after the board is identified and before any bus is opened.
+ */
+int
+Record_Init(const char *Board_Name)
+{
+	OnBoard_EEPROM_t *OnBoard_EEPROM = Plat_Devs->OnBoard_EEPROM;
+	Trace_Header_t Header = { 0 };
+	char Value[LSTRLEN_MAX];
+	struct timespec Time;
+	int Found;
+
+	if (Check_Config_File("Record", Value, &Found) != 0) {
+		return -1;
+	}
+
+	if (!Found) {
+		return 0;
+	}
+
+	if (Replay_Active()) {
+		SC_ERR("recording isn't supported while replaying");
+		return -1;
+	}
+
+	Record_File = fopen(Value, "we");
+	if (Record_File == NULL) {
+		SC_ERR("failed to create trace file %s: %m", Value);
+		return -1;
+	}
+
+	(void) clock_gettime(CLOCK_REALTIME, &Time);
+	Record_Base = Stats_Time();
+	Header.Magic = TRACE_MAGIC;
+	Header.Version = TRACE_VERSION;
+	Header.Record_Size = sizeof(Trace_Record_t);
+	Header.Start = ((uint64_t)Time.tv_sec * 1000000000) + Time.tv_nsec;
+	(void) strncpy(Header.Board, Board_Name, (LSTRLEN_MAX - 1));
+	if (OnBoard_EEPROM != NULL) {
+		(void) strcpy(Header.EEPROM_Bus, OnBoard_EEPROM->I2C_Bus);
+		Header.EEPROM_Address = OnBoard_EEPROM->I2C_Address;
+	}
+
+	if ((fwrite(&Header, sizeof(Header), 1, Record_File) != 1) ||
+	    (fflush(Record_File) != 0)) {
+		SC_ERR("failed to write trace file %s: %m", Value);
+		(void) fclose(Record_File);
+		Record_File = NULL;
+		return -1;
+	}
+
+	Record_Lower = I2C_Set_Backend(&Record_Backend);
+	SC_INFO("Recording to %s", Value);
+	return 0;
+}
+
+/*
+ * The record that the interaction matches, marking it used, or NULL if
+ * none does.  An Arg of -1 matches any.
+ */
+static Replay_Record_t *
+Replay_Match(int Stream_Index, int Type, int Arg, const void *Key, int Key_Length)
+{
+	Replay_Stream_t *Stream = &Replay_Streams[Stream_Index];
+	Replay_Record_t *Record, *Match = NULL;
+	int Reused = 0;
+
+	(void) pthread_mutex_lock(&Trace_Lock);
+	for (int Pass = 0; (Match == NULL) && (Pass < 2); Pass++) {
+		for (int i = ((Pass == 0) ? Stream->Cursor : 0);
+		     (i < Stream->Numbers) && ((Pass == 1) || (i < (Stream->Cursor + TRACE_WINDOW)));
+		     i++) {
+			Record = Stream->Record[i];
+			if ((Record->Head.Type != Type) || ((Pass == 0) && Record->Used) ||
+			    ((Arg != -1) && (Record->Head.Arg != Arg)) ||
+			    (Record->Head.Key_Length != Key_Length) ||
+			    (memcmp(Record->Data, Key, Key_Length) != 0)) {
+				continue;
+			}
+
+			Match = Record;
+			Reused = Pass;
+			break;
+		}
+	}
+
+	if (Match == NULL) {
+		Replay_Missing++;
+	} else if (Reused) {
+		Replay_Reused++;
+	} else {
+		Replay_Matched++;
+		Match->Used = 1;
+		while ((Stream->Cursor < Stream->Numbers) &&
+		       Stream->Record[Stream->Cursor]->Used) {
+			Stream->Cursor++;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&Trace_Lock);
+	return Match;
+}
+
+/*
+ * Return what the record did, in the time it took.
+ */
+static int
+Replay_Result(Replay_Record_t *Record)
+{
+	if (Record->Head.Latency > 0) {
+		(void) usleep(Record->Head.Latency);
+	}
+
+	errno = Record->Head.Error;
+	return Record->Head.Ret;
+}
+
+/*
+ * Replaying Backend
+ *
+ * Each bus is a descriptor of /dev/null, as in the simulator.
+ */
+static int
+Replay_Open(const char *Bus)
+{
+	Replay_Record_t *Record = NULL;
+	int FD;
+
+	for (int i = 0; i < Trace_Bus_Numbers; i++) {
+		if (strcmp(Trace_Buses[i], Bus) == 0) {
+			Record = Replay_Match((i + 1), TRACE_BUS, -1, Bus, strlen(Bus));
+			break;
+		}
+	}
+
+	if (Record == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (Replay_Result(Record) < 0) {
+		return -1;
+	}
+
+	FD = open("/dev/null", (O_RDWR | O_CLOEXEC));
+	if (FD >= 0) {
+		(void) pthread_mutex_lock(&Trace_Lock);
+		Trace_Add_File(FD, Record->Head.Stream);
+		(void) pthread_mutex_unlock(&Trace_Lock);
+	}
+
+	return FD;
+}
+
+static int
+Replay_Close(int FD)
+{
+	Trace_Remove_File(FD);
+	return close(FD);
+}
+
+static int
+Replay_Transfer(int Stream, struct i2c_rdwr_ioctl_data *Msgset)
+{
+	Replay_Record_t *Record;
+	const unsigned char *Data;
+	unsigned char *Key;
+	int Key_Length, Length;
+
+	if (Msgset->nmsgs == 0) {
+		return 0;
+	}
+
+	Key_Length = Trace_Key(Msgset, NULL);
+	Key = malloc(Key_Length);
+	if (Key == NULL) {
+		return -1;
+	}
+
+	(void) Trace_Key(Msgset, Key);
+	Record = Replay_Match(Stream, TRACE_RDWR, Msgset->msgs[0].addr, Key, Key_Length);
+	free(Key);
+	if (Record == NULL) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	Data = &Record->Data[Key_Length];
+	Length = Record->Head.Length - Key_Length;
+	for (int i = 0; i < Msgset->nmsgs; i++) {
+		if (Msgset->msgs[i].flags & I2C_M_RD) {
+			(void) memcpy(Msgset->msgs[i].buf, Data,
+				      MIN(Length, Msgset->msgs[i].len));
+			Data += MIN(Length, Msgset->msgs[i].len);
+			Length -= MIN(Length, Msgset->msgs[i].len);
+		}
+	}
+
+	return Replay_Result(Record);
+}
+
+static int
+Replay_Ioctl(int FD, unsigned long Request, unsigned long Arg)
+{
+	int Stream, Address;
+
+	Stream = Trace_Stream(FD, &Address);
+	if (Stream == -1) {
+		errno = EBADF;
+		return -1;
+	}
+
+	switch (Request) {
+	case I2C_SLAVE:
+	case I2C_SLAVE_FORCE:
+		Trace_Set_Address(FD, Arg);
+		return 0;
+	case I2C_TIMEOUT:
+	case I2C_RETRIES:
+		return 0;
+	case I2C_RDWR:
+		return Replay_Transfer(Stream, (struct i2c_rdwr_ioctl_data *)Arg);
+	default:
+		errno = ENOTTY;
+		return -1;
+	}
+}
+
+static ssize_t
+Replay_Read(int FD, void *Buffer, size_t Length)
+{
+	Replay_Record_t *Record;
+	uint16_t Key = Length;
+	int Stream, Address;
+
+	Stream = Trace_Stream(FD, &Address);
+	if (Stream == -1) {
+		errno = EBADF;
+		return -1;
+	}
+
+	Record = Replay_Match(Stream, TRACE_READ, Address, &Key, sizeof(Key));
+	if (Record == NULL) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	(void) memcpy(Buffer, &Record->Data[sizeof(Key)],
+		      MIN(Length, (size_t)(Record->Head.Length - sizeof(Key))));
+	return Replay_Result(Record);
+}
+
+static ssize_t
+Replay_Write(int FD, const void *Buffer, size_t Length)
+{
+	Replay_Record_t *Record;
+	int Stream, Address;
+
+	Stream = Trace_Stream(FD, &Address);
+	if (Stream == -1) {
+		errno = EBADF;
+		return -1;
+	}
+
+	Record = Replay_Match(Stream, TRACE_WRITE, Address, Buffer, Length);
+	if (Record == NULL) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	return Replay_Result(Record);
+}
+
+static const I2C_Backend_t Replay_Backend = {
+	.Open = Replay_Open,
+	.Close = Replay_Close,
+	.Ioctl = Replay_Ioctl,
+	.Read = Replay_Read,
+	.Write = Replay_Write,
+};
+
+int
+Replay_Active(void)
+{
+	return (Replay_Trace != NULL);
+}
+
+/*
+ * Answer a GPIO access or a program run from the trace.  Value is the
+ * state to set a line to, or gets the state read from it, and may be NULL
+ * for a program.  Returns -1 with errno set to ENOENT if it wasn't
+ * recorded.
+ */
+int
+Replay_Event(Record_Event_t Type, const char *Name, int *Value)
+{
+	Replay_Record_t *Record;
+
+	Record = Replay_Match(0, Type, ((Type == RECORD_GPIO_SET) ? *Value : -1),
+			      Name, strlen(Name));
+	if (Record == NULL) {
+		SC_ERR("no record of %s in the trace", Name);
+		errno = ENOENT;
+		return -1;
+	}
+
+	if ((Value != NULL) && (Type == RECORD_GPIO_GET)) {
+		*Value = Record->Head.Arg;
+	}
+
+	return Replay_Result(Record);
+}
+
+/*
+ * Load the trace and index its records by stream.
+ */
+static int
+Replay_Load(const char *File, Trace_Header_t *Header)
+{
+	Replay_Stream_t *Stream;
+	Replay_Record_t *Record;
+	Trace_Record_t Head;
+	FILE *FP;
+	long Size, Offset;
+	int Numbers = 0;
+
+	FP = fopen(File, "re");
+	if (FP == NULL) {
+		SC_ERR("failed to open trace file %s: %m", File);
+		return -1;
+	}
+
+	if ((fseek(FP, 0, SEEK_END) != 0) || ((Size = ftell(FP)) < 0) ||
+	    (fseek(FP, 0, SEEK_SET) != 0)) {
+		SC_ERR("failed to read trace file %s: %m", File);
+		(void) fclose(FP);
+		return -1;
+	}
+
+	Replay_Trace = malloc(Size + 1);
+	if ((Replay_Trace == NULL) || (fread(Replay_Trace, 1, Size, FP) != (size_t)Size)) {
+		SC_ERR("failed to read trace file %s: %m", File);
+		(void) fclose(FP);
+		return -1;
+	}
+
+	(void) fclose(FP);
+	if (Size < (long)sizeof(Trace_Header_t)) {
+		goto Invalid;
+	}
+
+	(void) memcpy(Header, Replay_Trace, sizeof(Trace_Header_t));
+	if ((Header->Magic != TRACE_MAGIC) || (Header->Version != TRACE_VERSION) ||
+	    (Header->Record_Size != sizeof(Trace_Record_t))) {
+		goto Invalid;
+	}
+
+	Header->Board[LSTRLEN_MAX - 1] = '\0';
+	Header->EEPROM_Bus[STRLEN_MAX - 1] = '\0';
+
+	/* Records may be cut short if recording didn't end cleanly */
+	for (Offset = sizeof(Trace_Header_t); (Offset + (long)sizeof(Head)) <= Size;
+	     Offset += sizeof(Head) + Head.Length) {
+		(void) memcpy(&Head, &Replay_Trace[Offset], sizeof(Head));
+		if (((Offset + (long)sizeof(Head) + Head.Length) > Size) ||
+		    (Head.Key_Length > Head.Length) || (Head.Stream >= TRACE_STREAMS_MAX)) {
+			break;
+		}
+
+		Numbers++;
+	}
+
+	Replay_Records = calloc((Numbers + 1), sizeof(Replay_Record_t));
+	Replay_Commands = calloc((Numbers + 1), sizeof(Replay_Record_t *));
+	if ((Replay_Records == NULL) || (Replay_Commands == NULL)) {
+		SC_ERR("failed to allocate trace records: %m");
+		return -1;
+	}
+
+	Offset = sizeof(Trace_Header_t);
+	for (int i = 0; i < Numbers; i++) {
+		Record = &Replay_Records[i];
+		(void) memcpy(&Record->Head, &Replay_Trace[Offset], sizeof(Head));
+		Record->Data = &Replay_Trace[Offset + sizeof(Head)];
+		Offset += sizeof(Head) + Record->Head.Length;
+		Replay_Streams[Record->Head.Stream].Numbers++;
+		if ((Record->Head.Type == TRACE_BUS) && (Record->Head.Stream > 0) &&
+		    (Record->Head.Key_Length < STRLEN_MAX)) {
+			(void) memcpy(Trace_Buses[Record->Head.Stream - 1], Record->Data,
+				      Record->Head.Key_Length);
+			Trace_Bus_Numbers = MAX(Trace_Bus_Numbers, Record->Head.Stream);
+		}
+	}
+
+	for (int i = 0; i < TRACE_STREAMS_MAX; i++) {
+		Stream = &Replay_Streams[i];
+		Stream->Record = calloc((Stream->Numbers + 1), sizeof(Replay_Record_t *));
+		if (Stream->Record == NULL) {
+			SC_ERR("failed to allocate trace records: %m");
+			return -1;
+		}
+
+		Stream->Numbers = 0;
+	}
+
+	for (int i = 0; i < Numbers; i++) {
+		Record = &Replay_Records[i];
+		Stream = &Replay_Streams[Record->Head.Stream];
+		Stream->Record[Stream->Numbers++] = Record;
+		if (Record->Head.Type == TRACE_COMMAND) {
+			Replay_Commands[Replay_Command_Numbers++] = Record;
+		}
+	}
+
+	SC_INFO("Loaded %d records of %d commands from trace %s", Numbers,
+		Replay_Command_Numbers, File);
+	return 0;
+
+Invalid:
+	SC_ERR("invalid trace file %s", File);
+	return -1;
+}
+
+/*
+ * Replay the trace, if 'Replay' entry is in CONFIGFILE, which tells the
+ * name of the board and where its onboard EEPROM is.  Must be called
+ * before any bus is opened.  Returns 1 if the trace is being replayed.
+ */
+int
+Replay_Init(char *Board_Name, OnBoard_EEPROM_t *OnBoard_EEPROM)
+{
+	Trace_Header_t Header;
+	char Value[LSTRLEN_MAX];
+	int Found;
+
+	if (Check_Config_File("Replay", Value, &Found) != 0) {
+		return -1;
+	}
+
+	if (!Found) {
+		return 0;
+	}
+
+	if (Replay_Load(Value, &Header) != 0) {
+		free(Replay_Trace);
+		Replay_Trace = NULL;
+		return -1;
+	}
+
+	(void) strcpy(Board_Name, Header.Board);
+	(void) strcpy(OnBoard_EEPROM->I2C_Bus, Header.EEPROM_Bus);
+	OnBoard_EEPROM->I2C_Address = Header.EEPROM_Address;
+	(void) I2C_Set_Backend(&Replay_Backend);
+	Replay_Base = Stats_Time();
+	return 1;
+}
+
+/*
+ * Send the request to sc_appd on a connection of its own, in a session so
+ * that the response ends with the status of the command.  Returns -1 if
+ * the request couldn't be sent or the response was cut short.
+ */
+static int
+Replay_Request(const char *Request, int Length, int *Status)
+{
+	struct sockaddr_un Server = { .sun_family = AF_UNIX };
+	char Buffer[SOCKBUF_MAX];
+	char Digits[STRLEN_MAX];
+	int In_Status = 0;
+	int Digit_Numbers = 0;
+	int Responses = 0;
+	int Sock_FD;
+	ssize_t Received;
+
+	Sock_FD = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+	if (Sock_FD == -1) {
+		return -1;
+	}
+
+	(void) strcpy(Server.sun_path, SOCKFILE);
+	for (int i = 0; connect(Sock_FD, (struct sockaddr *)&Server, sizeof(Server)) == -1; i++) {
+		if (i == REPLAY_CONNECT) {
+			SC_ERR("failed to connect to sc_appd: %m");
+			(void) close(Sock_FD);
+			return -1;
+		}
+
+		(void) usleep(REPLAY_CONNECT_DELAY);
+	}
+
+	if ((send(Sock_FD, "sc_app -c session\n", 18, MSG_NOSIGNAL) != 18) ||
+	    (send(Sock_FD, Request, Length, MSG_NOSIGNAL) != Length) ||
+	    (send(Sock_FD, "\n", 1, MSG_NOSIGNAL) != 1)) {
+		(void) close(Sock_FD);
+		return -1;
+	}
+
+	(void) shutdown(Sock_FD, SHUT_WR);
+
+	/* The responses to 'session' and to the request, each ended by SC_EOR */
+	while ((Received = recv(Sock_FD, Buffer, sizeof(Buffer), 0)) > 0) {
+		for (ssize_t i = 0; i < Received; i++) {
+			if (Buffer[i] == SC_EOR) {
+				In_Status = 1;
+				Digit_Numbers = 0;
+			} else if (In_Status && (Buffer[i] == '\n')) {
+				Digits[Digit_Numbers] = '\0';
+				*Status = atoi(Digits);
+				In_Status = 0;
+				Responses++;
+			} else if (In_Status && (Digit_Numbers < (STRLEN_MAX - 1))) {
+				Digits[Digit_Numbers++] = Buffer[i];
+			}
+		}
+	}
+
+	(void) close(Sock_FD);
+	return ((Responses == 2) ? 0 : -1);
+}
+
+static void *
+Replay_Thread(__attribute__((unused)) void *Arg)
+{
+	Replay_Record_t *Command;
+	unsigned long long Replayed = 0, Recorded = 0;
+	unsigned long long Matched, Reused, Missing;
+	long long Start, Due;
+	int Numbers = 0;
+	int Mismatches = 0;
+	int Status;
+
+	for (int i = 0; i < Replay_Command_Numbers; i++) {
+		Command = Replay_Commands[i];
+
+		/* Sessions are replayed request by request */
+		if ((Command->Head.Key_Length == 17) &&
+		    (memcmp(Command->Data, "sc_app -c session", 17) == 0)) {
+			continue;
+		}
+
+		/* At the time it was received, as polling threads run meanwhile */
+		Due = Replay_Base + ((long long)Command->Head.Time * 1000000);
+		Start = Stats_Time();
+		if (Due > Start) {
+			(void) usleep(Trace_Microseconds(Due - Start));
+		}
+
+		Numbers++;
+		Start = Stats_Time();
+		Status = -1;
+		if ((Replay_Request((const char *)Command->Data, Command->Head.Key_Length,
+				    &Status) != 0) || (Status != Command->Head.Ret)) {
+			SC_INFO("Replayed '%.*s' ended with %d rather than %d",
+				Command->Head.Key_Length, Command->Data, Status,
+				Command->Head.Ret);
+			Mismatches++;
+		}
+
+		Replayed += Trace_Microseconds(Stats_Time() - Start);
+		Recorded += Command->Head.Latency;
+	}
+
+	(void) pthread_mutex_lock(&Trace_Lock);
+	Matched = Replay_Matched;
+	Reused = Replay_Reused;
+	Missing = Replay_Missing;
+	(void) pthread_mutex_unlock(&Trace_Lock);
+	SC_INFO("Replayed %d commands in %llu us, recorded in %llu us, %d ended "
+		"otherwise; %llu interactions matched, %llu reused, %llu not recorded",
+		Numbers, Replayed, Recorded, Mismatches, Matched, Reused, Missing);
+	(void) fflush(stdout);
+	exit((Mismatches == 0) ? 0 : 1);
+	return NULL;
+}
+
+/*
+ * Start sending the recorded commands to sc_appd, if the trace is being
+ * replayed.
+ */
+int
+Replay_Start(void)
+{
+	pthread_t Thread;
+	int Ret;
+
+	if (!Replay_Active()) {
+		return 0;
+	}
+
+	Ret = pthread_create(&Thread, NULL, Replay_Thread, NULL);
+	if (Ret != 0) {
+		SC_ERR("failed to create replay thread: %s", strerror(Ret));
+		return -1;
+	}
+
+	(void) pthread_detach(Thread);
+	return 0;
+}
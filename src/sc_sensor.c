@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "sc_app.h"
+
+/*
+ * Sensor Sampling
+ *
+ * Reading a sensor repeatedly is split into a setup step that is done
+ * once, i.e. calibrating INA226s if they aren't already, getting
+ * the exponent of READ_VOUT from regulators, and identifying SFP modules,
+ * and a read step that only reads the measurement registers.  Callers are
+ * responsible for holding the buses.
+ */
+
+/*
+ * Whether the board reads the sensor through a 'Terminate' constraint of
+ * the command that reads it on its own, e.g. a regulator whose VOUT is
+ * only decoded by the script of the constraint.  Such a sensor can't be
+ * sampled directly without disagreeing with that command.
+ */
+int
+Sensor_Constrained(Sensor_Type_t Type, const char *Name)
+{
+	static const char *Commands[] = {
+		[SENSOR_POWER] = "getpower",
+		[SENSOR_VOLTAGE] = "getvoltage",
+		[SENSOR_TEMPERATURE] = "gettemp",
+		[SENSOR_DIMM] = "getddr",
+		[SENSOR_SFP] = "getSFP",
+	};
+
+	return Constraint_Terminates(Commands[Type], Name);
+}
+
+/*
+ * Get the I2C bus of each sensor from the bus registry, so sensors on the
+ * same bus share its descriptor.  Returns -1 if any of the buses couldn't
+ * be opened, in which case the FD of the sensors on it is left at -1.
+ */
+int
+Sensor_Open(Sensor_t *Sensors, int Numbers)
+{
+	Sensor_t *Sensor;
+	int Ret = 0;
+
+	for (int i = 0; i < Numbers; i++) {
+		Sensor = &Sensors[i];
+		Sensor->FD = -1;
+		if (Sensor->I2C_Bus == NULL) {
+			continue;
+		}
+
+		Sensor->FD = I2C_Open(Sensor->I2C_Bus);
+		if (Sensor->FD < 0) {
+			SC_ERR("unable to access I2C bus %s: %m", Sensor->I2C_Bus);
+			Sensor->FD = -1;
+			Ret = -1;
+		}
+	}
+
+	return Ret;
+}
+
+void
+Sensor_Close(Sensor_t *Sensors, int Numbers)
+{
+	for (int i = 0; i < Numbers; i++) {
+		I2C_Close(Sensors[i].FD);
+		Sensors[i].FD = -1;
+	}
+}
+
+static int
+Read_Register(int FD, int Address, int Register, int Length, unsigned char *Value)
+{
+	char Out_Buffer[STRLEN_MAX] = { 0 };
+	char In_Buffer[STRLEN_MAX] = { 0 };
+	int Ret = 0;
+
+	Out_Buffer[0] = Register;
+	I2C_READ(FD, Address, Length, Out_Buffer, In_Buffer, Ret);
+	(void) memcpy(Value, In_Buffer, Length);
+	return Ret;
+}
+
+/*
+ * Only 'sfp' and 'osfp' modules can be read without selecting them first,
+ * see QSFP_ModuleSelect(), and for those the identifier tells which map
+ * the diagnostics are in.
+ */
+static int
+Setup_SFP(Sensor_t *Sensor)
+{
+	SFP_t *SFP = Sensor->Device;
+	unsigned char Value[1];
+
+	if ((SFP->Type != sfp) && (SFP->Type != osfp)) {
+		SC_ERR("diagnostics of %s need a module select", SFP->Name);
+		return -1;
+	}
+
+	if (Read_Register(Sensor->FD, SFP->I2C_Address, 0x0, 1, Value) != 0) {
+		return -1;
+	}
+
+	switch (Value[0]) {
+	case 0x3:
+	case 0x20:
+		Sensor->Module = sfp;
+		break;
+	case 0x19:
+	case 0x21:
+		Sensor->Module = osfp;
+		break;
+	default:
+		SC_ERR("unsupported SFP type identifier %#x", Value[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+Sensor_Setup(Sensor_t *Sensor)
+{
+	INA226_t *INA226;
+	Voltage_t *Regulator;
+	unsigned char Value[2];
+
+	switch (Sensor->Type) {
+	case SENSOR_POWER:
+		INA226 = Sensor->Device;
+		if (!INA226->Calibrated) {
+			return Calibrate_INA226(Sensor->FD, INA226);
+		}
+
+		break;
+	case SENSOR_VOLTAGE:
+		Regulator = Sensor->Device;
+		Sensor->Exponent = -8;
+		if (!Regulator->PMBus_VOUT_MODE) {
+			break;
+		}
+
+		if (PMBus_Get_Mode(Regulator, Value) != 0) {
+			if ((PMBus_Select_Page(Sensor->FD, Regulator, 0) != 0) ||
+			    (Read_Register(Sensor->FD, Regulator->I2C_Address,
+					   PMBUS_VOUT_MODE, 1, Value) != 0)) {
+				return -1;
+			}
+
+			PMBus_Set_Mode(Regulator, Value[0]);
+		}
+
+		Sensor->Exponent = (Value[0] & 0x1F) - (sizeof(int) * 8);
+		break;
+	case SENSOR_SFP:
+		return Setup_SFP(Sensor);
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int
+Read_Power(Sensor_t *Sensor, float *Value)
+{
+	if (Measure_INA226(Sensor->FD, Sensor->Device, 0, &Value[0], &Value[1],
+			   &Value[2]) != 0) {
+		return -1;
+	}
+
+	return 3;
+}
+
+static int
+Read_Voltage(Sensor_t *Sensor, float *Value)
+{
+	Voltage_t *Regulator = Sensor->Device;
+	unsigned char Buffer[2];
+	short Mantissa;
+
+	if ((PMBus_Select_Page(Sensor->FD, Regulator, 0) != 0) ||
+	    (Read_Register(Sensor->FD, Regulator->I2C_Address, PMBUS_READ_VOUT,
+			   2, Buffer) != 0)) {
+		return -1;
+	}
+
+	Mantissa = ((Buffer[1] << 8) | Buffer[0]);
+	Value[0] = Mantissa * pow(2, Sensor->Exponent);
+	if (Regulator->Voltage_Multiplier != 0) {
+		Value[0] *= Regulator->Voltage_Multiplier;
+	}
+
+	return 1;
+}
+
+static int
+Read_Temperature(Sensor_t *Sensor, float *Value)
+{
+	Temperature_t *Temperature = Sensor->Device;
+	FILE *FP;
+	char Buffer[SYSCMD_MAX];
+	char *Temp;
+	char *Save_Ptr;
+	int Ret = -1;
+
+	(void) sprintf(Buffer, "/usr/bin/sensors %s 2>&1", Temperature->Sensor);
+	FP = popen(Buffer, "r");
+	if (FP == NULL) {
+		SC_ERR("failed to invoke '%s': %m", Buffer);
+		return -1;
+	}
+
+	while (fgets(Buffer, sizeof(Buffer), FP) != NULL) {
+		if ((Ret == 1) || (strstr(Buffer, "temp1") == NULL)) {
+			continue;
+		}
+
+		(void) strtok_r(Buffer, " ", &Save_Ptr);
+		Temp = strtok_r(NULL, " ", &Save_Ptr);
+		if (Temp != NULL) {
+			Value[0] = strtof(Temp, NULL);
+			Ret = 1;
+		}
+	}
+
+	(void) pclose(FP);
+	if (Ret != 1) {
+		SC_ERR("temperature is not available");
+	}
+
+	return Ret;
+}
+
+static int
+Read_DIMM(Sensor_t *Sensor, float *Value)
+{
+	DIMM_t *DIMM = Sensor->Device;
+	unsigned char Buffer[2];
+	short Temp;
+
+	if (Read_Register(Sensor->FD, DIMM->I2C_Address_Thermal, 0x5, 2, Buffer) != 0) {
+		return -1;
+	}
+
+	/* See DDR_Ops() for the layout of the SE98A temperature register */
+	Temp = ((Buffer[0] << 8) | Buffer[1]);
+	Temp <<= 3;
+	Temp /= 16;
+	Value[0] = ((float)Temp) * 0.125;
+	return 1;
+}
+
+static int
+Read_SFP(Sensor_t *Sensor, float *Value)
+{
+	SFP_t *SFP = Sensor->Device;
+	I2C_Transaction_t Transaction;
+	unsigned char Buffer[2][2];
+	int I2C_Address = SFP->I2C_Address;
+	int Register = 0xE;	// 0xE-0xF: Temperature, 0x10-0x11: Supply Voltage
+	int Temp;
+
+	if (Sensor->Module == sfp) {
+		/* 0x60-0x61: Temperature, 0x62-0x63: Supply Voltage */
+		I2C_Address++;
+		Register = 0x60;
+	}
+
+	/* See SFP_Ops() for the encoding of the diagnostics */
+	I2C_Begin(&Transaction);
+	(void) I2C_Add_Read(&Transaction, I2C_Address, Register, 2, Buffer[0]);
+	(void) I2C_Add_Read(&Transaction, I2C_Address, (Register + 2), 2, Buffer[1]);
+	if (I2C_Commit(Sensor->FD, &Transaction) != 0) {
+		return -1;
+	}
+
+	Temp = (Buffer[0][0] << 8) | Buffer[0][1];
+	Value[0] = (float)((Temp & 0x7FFF) - (Temp & 0x8000)) / 256;
+	Value[1] = (float)((Buffer[1][0] << 8) | Buffer[1][1]) * 0.0001;
+	return 2;
+}
+
+/*
+ * Read the sensor into Value, which has room for SENSOR_VALUES_MAX
+ * readings.  Returns the number of readings, or -1 on failure.
+ */
+int
+Sensor_Read(Sensor_t *Sensor, float *Value)
+{
+	switch (Sensor->Type) {
+	case SENSOR_POWER:
+		return Read_Power(Sensor, Value);
+	case SENSOR_VOLTAGE:
+		return Read_Voltage(Sensor, Value);
+	case SENSOR_TEMPERATURE:
+		return Read_Temperature(Sensor, Value);
+	case SENSOR_DIMM:
+		return Read_DIMM(Sensor, Value);
+	case SENSOR_SFP:
+		return Read_SFP(Sensor, Value);
+	}
+
+	return -1;
+}
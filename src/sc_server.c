@@ -0,0 +1,514 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define _GNU_SOURCE		/* accept4(2) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "sc_app.h"
+
+/*
+ * Protocol
+ *
+ * A request is a single line holding the sc_app command line, e.g.
+ * "sc_app -c gettemp -t Versal\n".  By default the connection carries
+ * one request; the response is whatever the command prints, and the
+ * daemon closes the connection once the command completes.
+ *
+ * The 'session' command turns the connection into a persistent one.
+ * Requests may then be sent back to back without waiting for responses
+ * (pipelining), they are processed in order, and each response, as well
+ * as the one to 'session' itself, is terminated by:
+ *
+ *	SC_EOR <status> '\n'
+ *
+ * where <status> is the return value of the command in decimal.  The
+ * session ends when the client closes the connection.
+ *
+ * Client sockets are non-blocking.  Output that a client doesn't take
+ * right away is kept until it does, and no more of its requests are read
+ * meanwhile, so a client that doesn't read its responses holds up only
+ * itself.
+ */
+
+#define EVENTS_MAX	32
+#define ACCEPT_BACKOFF	1000	/* In milliseconds */
+
+/* Clients whose request has been completed by a worker thread */
+typedef struct Completion {
+	Client_t		*Client;
+	struct Completion	*Next;
+} Completion_t;
+
+static pthread_mutex_t Completion_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Completion_t *Completions;
+static int Completion_FD = -1;
+
+/*
+ * Allocate a client for every pending connection and add it to the
+ * event loop.  The listening socket is non-blocking, so this returns
+ * once the accept queue has been drained.  A connection that fails
+ * before it's accepted is skipped, and any other error, e.g. running
+ * out of file descriptors, returns -1 for the caller to stop accepting
+ * for a while, as the connection is left pending.
+ */
+static int
+Accept_Clients(int Epoll_FD, int Sock_FD)
+{
+	struct epoll_event Event;
+	Client_t *Client;
+	int FD;
+
+	while (1) {
+		/*
+		 * The flags are set atomically, so that a worker running
+		 * popen(3) meanwhile doesn't leak the client into the child.
+		 */
+		FD = accept4(Sock_FD, NULL, NULL, (SOCK_CLOEXEC | SOCK_NONBLOCK));
+		if (FD == -1) {
+			switch (errno) {
+			case EAGAIN:
+			case EINTR:
+				return 0;
+			case ECONNABORTED:
+			case EPERM:
+			case EPROTO:
+			case ENETDOWN:
+			case ENOPROTOOPT:
+			case EHOSTDOWN:
+			case ENONET:
+			case EHOSTUNREACH:
+			case EOPNOTSUPP:
+			case ENETUNREACH:
+				SC_ERR("failed to accept connection: %m");
+				continue;
+			default:
+				SC_ERR("failed to call accept4(2): %m");
+				return -1;
+			}
+		}
+
+		Client = calloc(1, sizeof(Client_t));
+		if (Client == NULL) {
+			SC_ERR("failed to allocate client: %m");
+			(void) close(FD);
+			continue;
+		}
+
+		Client->FD = FD;
+		Sink_Init(&Client->Sink, FD);
+		Event.events = EPOLLIN | EPOLLRDHUP;
+		Event.data.ptr = Client;
+		if (epoll_ctl(Epoll_FD, EPOLL_CTL_ADD, FD, &Event) == -1) {
+			SC_ERR("failed to add client to epoll: %m");
+			Close_Client(Client);
+		}
+	}
+}
+
+/*
+ * Read whatever is available from the client without blocking.
+ * Returns -1 if the connection should be dropped, or 0 otherwise.
+ */
+static int
+Read_Client(Client_t *Client)
+{
+	int Length;
+
+	while (!Client->Eof && (Client->Length < (SYSCMD_MAX - 1))) {
+		Length = recv(Client->FD, &Client->Buffer[Client->Length],
+			      (SYSCMD_MAX - 1 - Client->Length), MSG_DONTWAIT);
+		if (Length == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				break;
+			}
+
+			return -1;
+		}
+
+		if (Length == 0) {
+			Client->Eof = 1;
+			break;
+		}
+
+		Client->Length += Length;
+	}
+
+	Client->Buffer[Client->Length] = '\0';
+	return 0;
+}
+
+/*
+ * Move the next complete request out of the receive buffer.  A request
+ * is complete once its newline is received, or the client shuts down its
+ * side of the connection.  A request that fills up the buffer is too
+ * long, so it's dropped up to its newline.
+ *
+ * Returns 1 if there's a request, -1 if a request was too long, or 0 if
+ * there's none yet.
+ */
+static int
+Next_Request(Client_t *Client)
+{
+	char *Newline;
+	int Length;
+
+	if (Client->Discard) {
+		Newline = strchr(Client->Buffer, '\n');
+		Length = ((Newline != NULL) ?
+			  (Newline - Client->Buffer + 1) : Client->Length);
+		Client->Length -= Length;
+		(void) memmove(Client->Buffer, &Client->Buffer[Length], Client->Length);
+		Client->Buffer[Client->Length] = '\0';
+		Client->Discard = (Newline == NULL);
+	}
+
+	Newline = strchr(Client->Buffer, '\n');
+	if (Newline != NULL) {
+		Length = Newline - Client->Buffer;
+	} else if (Client->Length == (SYSCMD_MAX - 1)) {
+		Client->Length = 0;
+		Client->Buffer[0] = '\0';
+		Client->Discard = 1;
+		return -1;
+	} else if ((Client->Length > 0) && Client->Eof) {
+		Length = Client->Length;
+	} else {
+		return 0;
+	}
+
+	(void) memcpy(Client->Request, Client->Buffer, Length);
+	Client->Request[Length] = '\0';
+	if (Newline != NULL) {
+		Length++;
+	}
+
+	Client->Length -= Length;
+	(void) memmove(Client->Buffer, &Client->Buffer[Length], Client->Length);
+	Client->Buffer[Client->Length] = '\0';
+	return 1;
+}
+
+/*
+ * Fail a request that's too long, as if it had been processed.
+ */
+static void
+Reject_Request(Client_t *Client)
+{
+	SC_Sink = &Client->Sink;
+	Client->Sink.Format = Client->Format;
+	Client->Status = -1;
+	Client->CmdId = STATS_INVALID;
+	Client->Start = Stats_Time();
+	Client->Request[0] = '\0';
+	Record_Request(Client);
+	SC_ERR("request is longer than %d characters", (SYSCMD_MAX - 2));
+	SC_Sink = NULL;
+}
+
+/*
+ * Send the buffered output of the completed request, ended with its
+ * status in JSON format, and in a session, the response terminator along
+ * with it.  Returns -1 if the client needs to be closed, or 0 otherwise,
+ * with Pending set if the client has yet to take some of the output.
+ */
+static int
+End_Response(Client_t *Client)
+{
+	char Status[STRLEN_MAX] = { 0 };
+	long long Start;
+	int Ret;
+
+	if (Client->Session) {
+		(void) sprintf(Status, "%c%d\n", SC_EOR, Client->Status);
+	}
+
+	Start = Stats_Time();
+	Output_Close(&Client->Sink, Client->Status);
+	Ret = Sink_Flush(&Client->Sink, Status);
+	Stats_Record(Client->CmdId, STATS_SEND, Start);
+	Stats_Complete(Client->CmdId, Client->Status, Client->Start);
+	Record_Command(Client);
+	Client->Pending = (Ret == 1);
+
+	/* Outside of a session, the connection is closed once it's sent */
+	if (!Client->Session) {
+		Client->Eof = 1;
+		Client->Length = 0;
+	}
+
+	return ((Ret == -1) ? -1 : 0);
+}
+
+/*
+ * Send the output the client has yet to take.  Returns -1 if the client
+ * needs to be closed, or 0 otherwise.
+ */
+static int
+Send_Pending(Client_t *Client)
+{
+	int Ret;
+
+	Ret = Sink_Flush(&Client->Sink, NULL);
+	Client->Pending = (Ret == 1);
+	return ((Ret == -1) ? -1 : 0);
+}
+
+/*
+ * The events of the client to wait for: its requests, or until it's
+ * ready to take its pending output.
+ */
+static unsigned int
+Client_Events(Client_t *Client)
+{
+	return (Client->Pending ? EPOLLOUT : (EPOLLIN | EPOLLRDHUP));
+}
+
+/*
+ * Process the buffered requests of the client in order.
+ *
+ * Returns 1 if a worker thread or a job owns the client, -1 if the client
+ * needs to be closed, or 0 if it's waiting for more requests, or to take
+ * its pending output.
+ */
+static int
+Serve_Client(Client_t *Client)
+{
+	int Ret;
+
+	while (!Client->Pending && ((Ret = Next_Request(Client)) != 0)) {
+		if (Ret == -1) {
+			Reject_Request(Client);
+		} else if (Process_Request(Client) == 1) {
+			return 1;
+		}
+
+		if (End_Response(Client) != 0) {
+			return -1;
+		}
+	}
+
+	return ((Client->Eof && !Client->Pending) ? -1 : 0);
+}
+
+/*
+ * Called by a worker thread once it is done with the request of the
+ * client, or by the job the client is waiting on once it ends, to hand
+ * the client back to the event loop.
+ */
+void
+Complete_Request(Client_t *Client)
+{
+	Completion_t *Completion;
+
+	Completion = malloc(sizeof(Completion_t));
+	if (Completion == NULL) {
+		SC_ERR("failed to allocate completion: %m");
+		Close_Client(Client);
+		return;
+	}
+
+	Completion->Client = Client;
+	(void) pthread_mutex_lock(&Completion_Lock);
+	Completion->Next = Completions;
+	Completions = Completion;
+	(void) pthread_mutex_unlock(&Completion_Lock);
+	(void) eventfd_write(Completion_FD, 1);
+}
+
+/*
+ * Resume the clients whose requests have been completed by workers.
+ */
+static void
+Resume_Clients(int Epoll_FD)
+{
+	struct epoll_event Event;
+	Completion_t *Completion, *Next;
+	Client_t *Client;
+	eventfd_t Count;
+
+	(void) eventfd_read(Completion_FD, &Count);
+	(void) pthread_mutex_lock(&Completion_Lock);
+	Completion = Completions;
+	Completions = NULL;
+	(void) pthread_mutex_unlock(&Completion_Lock);
+
+	for (; Completion != NULL; Completion = Next) {
+		Next = Completion->Next;
+		Client = Completion->Client;
+		free(Completion);
+
+		switch ((End_Response(Client) == 0) ? Serve_Client(Client) : -1) {
+		case 0:
+			Event.events = Client_Events(Client);
+			Event.data.ptr = Client;
+			if (epoll_ctl(Epoll_FD, EPOLL_CTL_ADD, Client->FD,
+				      &Event) == -1) {
+				SC_ERR("failed to add client to epoll: %m");
+				Close_Client(Client);
+			}
+			break;
+		case -1:
+			Close_Client(Client);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void
+Close_Client(Client_t *Client)
+{
+	(void) close(Client->FD);
+	Sink_Free(&Client->Sink);
+	free(Client);
+}
+
+/*
+ * Serve client requests from an epoll event loop.  Many clients may be
+ * connected at once, and a command that takes a long time to complete
+ * is handed off to a worker thread by Process_Request() rather than
+ * holding up the loop.  While a worker owns a client, the client is
+ * taken out of the loop so that its requests are served in order.
+ */
+int
+Server_Loop(int Sock_FD)
+{
+	int Epoll_FD;
+	struct epoll_event Event;
+	struct epoll_event Events[EVENTS_MAX];
+	Client_t *Client;
+	long long Resume = 0;
+	int Timeout = -1;
+	int Count;
+	int Ret;
+
+	Sink_No_Wait = 1;
+	if (fcntl(Sock_FD, F_SETFL, (fcntl(Sock_FD, F_GETFL) | O_NONBLOCK)) == -1) {
+		SC_ERR("failed to set socket to non-blocking: %m");
+		return -1;
+	}
+
+	if (listen(Sock_FD, SOMAXCONN) == -1) {
+		SC_ERR("failed to call listen(2): %m");
+		return -1;
+	}
+
+	Epoll_FD = epoll_create1(EPOLL_CLOEXEC);
+	if (Epoll_FD == -1) {
+		SC_ERR("failed to call epoll_create1(2): %m");
+		return -1;
+	}
+
+	Completion_FD = eventfd(0, (EFD_CLOEXEC | EFD_NONBLOCK));
+	if (Completion_FD == -1) {
+		SC_ERR("failed to call eventfd(2): %m");
+		goto Out;
+	}
+
+	Event.events = EPOLLIN;
+	Event.data.ptr = &Completion_FD;
+	if (epoll_ctl(Epoll_FD, EPOLL_CTL_ADD, Completion_FD, &Event) == -1) {
+		SC_ERR("failed to add eventfd to epoll: %m");
+		goto Out;
+	}
+
+	Event.events = EPOLLIN;
+	Event.data.ptr = NULL;
+	if (epoll_ctl(Epoll_FD, EPOLL_CTL_ADD, Sock_FD, &Event) == -1) {
+		SC_ERR("failed to add socket to epoll: %m");
+		goto Out;
+	}
+
+	while (1) {
+		if (Resume != 0) {
+			Timeout = MAX(0, ((Resume - Stats_Time() + 999999) / 1000000));
+		}
+
+		Count = epoll_wait(Epoll_FD, Events, EVENTS_MAX, Timeout);
+		if (Count == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			SC_ERR("failed to call epoll_wait(2): %m");
+			break;
+		}
+
+		/* Accept connections again once the back off is over */
+		if ((Resume != 0) && (Stats_Time() >= Resume)) {
+			Event.events = EPOLLIN;
+			Event.data.ptr = NULL;
+			if (epoll_ctl(Epoll_FD, EPOLL_CTL_ADD, Sock_FD, &Event) == -1) {
+				SC_ERR("failed to add socket to epoll: %m");
+				goto Out;
+			}
+
+			Resume = 0;
+			Timeout = -1;
+		}
+
+		for (int i = 0; i < Count; i++) {
+			Client = Events[i].data.ptr;
+			if (Client == NULL) {
+				if ((Resume == 0) &&
+				    (Accept_Clients(Epoll_FD, Sock_FD) != 0)) {
+					/* The socket stays readable, so take it out meanwhile */
+					(void) epoll_ctl(Epoll_FD, EPOLL_CTL_DEL, Sock_FD, NULL);
+					Resume = Stats_Time() +
+						 (ACCEPT_BACKOFF * 1000000LL);
+				}
+
+				continue;
+			}
+
+			if (Events[i].data.ptr == &Completion_FD) {
+				Resume_Clients(Epoll_FD);
+				continue;
+			}
+
+			if (Client->Pending) {
+				Ret = ((Send_Pending(Client) == 0) ? Serve_Client(Client) : -1);
+			} else if (Read_Client(Client) == 0) {
+				Ret = Serve_Client(Client);
+			} else {
+				Ret = -1;
+			}
+
+			if (Ret == 0) {
+				Event.events = Client_Events(Client);
+				Event.data.ptr = Client;
+				if (epoll_ctl(Epoll_FD, EPOLL_CTL_MOD, Client->FD,
+					      &Event) == 0) {
+					continue;
+				}
+
+				SC_ERR("failed to modify client in epoll: %m");
+				Ret = -1;
+			}
+
+			(void) epoll_ctl(Epoll_FD, EPOLL_CTL_DEL, Client->FD, NULL);
+			if (Ret == -1) {
+				Close_Client(Client);
+			}
+		}
+	}
+
+Out:
+	(void) close(Epoll_FD);
+	return -1;
+}
@@ -0,0 +1,1111 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Device Simulator
+ *
+ * An I2C backend that simulates the devices of the board, as described by
+ * its JSON file, so that sc_appd can be run and benchmarked on any Linux
+ * host.  It's enabled by 'Simulator: 1' entry in CONFIGFILE, along with
+ * 'Board' parameter to name the board.  The simulated devices are:
+ *
+ *	INA226s		- registers, with the shunt voltage, current, and power
+ *			  derived from the calibration the way the chip does
+ *	Voltages	- PMBus regulators with pages, OPERATION, VOUT_MODE,
+ *			  VOUT_COMMAND, READ_VOUT, and the limit registers
+ *	IO_Exp		- TCA6416A, with the pins of its inputs pulled high
+ *	EEPROMs		- FRU EEPROMs of the board, FMCs, and daughter card
+ *	DIMMs		- SE98A thermal sensor, and DDR4 SPD with its page select
+ *	SFPs		- SFF-8472, SFF-8636, or CMIS memory map with pages
+ *	Clocks		- 8A34001 register map
+ *
+ * Each bus is a descriptor of /dev/null that the simulator keeps track of,
+ * so the bus registry works as is, and addresses without a device don't
+ * acknowledge, as an empty SFP cage wouldn't.  Readings are steady: rails
+ * are at their typical voltage and SIM_LOAD of their maximum current, and
+ * DIMMs and modules at SIM_CELSIUS.
+ *
+ * Devices can be made slow, or to not acknowledge a share of transfers,
+ * by lines in SIMFILE, where an address of '*' stands for every device on
+ * the bus, e.g.:
+ *
+ *	# <bus> <address> <delay in us> [<percent of NACKs>]
+ *	/dev/i2c-3 0x40 2000
+ *	/dev/i2c-5 * 0 10
+ *
+ * The temperature from lm-sensors, clocks set through sysfs, GPIO lines,
+ * and anything done through JTAG aren't simulated.
+ */
+#define SIM_BUSES_MAX	32
+#define SIM_DEVICES_MAX	128
+#define SIM_FILES_MAX	64
+#define SIM_PAGES	8
+#define SIM_LOAD	0.4
+#define SIM_CELSIUS	35
+#define SIM_SPD_PAGE_0	0x36	/* And 0x37 for page 1 */
+
+typedef enum {
+	SIM_INA226,
+	SIM_PMBUS,
+	SIM_TCA6416A,
+	SIM_EEPROM,
+	SIM_SE98A,
+	SIM_SPD,
+	SIM_SPD_PAGE,
+	SIM_MODULE,
+	SIM_8A34001,
+} Sim_Type_t;
+
+typedef struct {
+	Sim_Type_t	Type;
+	int	Bus;		/* Index in Sim_Buses */
+	int	Address;
+	int	Delay;		/* In microseconds, per transfer */
+	int	NACK;		/* Percent of transfers */
+	int	NACK_Credit;
+	int	Pointer;	/* Register or offset of the next access */
+	int	Page;
+	int	Offset_Bytes;	/* EEPROM */
+	float	Volts;		/* INA226 */
+	float	Amps;
+	void	*Device;	/* From Plat_Devs */
+	unsigned short	Regs[SIM_PAGES][256];
+	unsigned char	*Memory;
+	int	Size;
+} Sim_Device_t;
+
+typedef struct {
+	int	FD;
+	int	Bus;
+	int	Address;	/* Set by I2C_SLAVE_FORCE, or -1 */
+} Sim_File_t;
+
+static pthread_mutex_t Sim_Lock = PTHREAD_MUTEX_INITIALIZER;
+static char *Sim_Buses[SIM_BUSES_MAX];
+static int Sim_Bus_Numbers;
+static Sim_Device_t *Sim_Devices[SIM_DEVICES_MAX];
+static int Sim_Device_Numbers;
+static Sim_File_t Sim_Files[SIM_FILES_MAX];
+static int Sim_File_Numbers;
+
+/*
+ * The index of the bus, optionally adding it.  Returns -1 if it isn't
+ * simulated.
+ */
+static int
+Sim_Bus(const char *Bus, int Add)
+{
+	for (int i = 0; i < Sim_Bus_Numbers; i++) {
+		if (strcmp(Sim_Buses[i], Bus) == 0) {
+			return i;
+		}
+	}
+
+	if (!Add || (Sim_Bus_Numbers == SIM_BUSES_MAX)) {
+		return -1;
+	}
+
+	Sim_Buses[Sim_Bus_Numbers] = strdup(Bus);
+	if (Sim_Buses[Sim_Bus_Numbers] == NULL) {
+		return -1;
+	}
+
+	return Sim_Bus_Numbers++;
+}
+
+static Sim_Device_t *
+Sim_Find(int Bus, int Address)
+{
+	for (int i = 0; i < Sim_Device_Numbers; i++) {
+		if ((Sim_Devices[i]->Bus == Bus) && (Sim_Devices[i]->Address == Address)) {
+			return Sim_Devices[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Add a device with Size bytes of memory, or get the one that's already
+ * at the address if it's of the same type, e.g. another page of a
+ * regulator.  Returns NULL if the device can't be added.
+ */
+static Sim_Device_t *
+Sim_Add(const char *Bus, int Address, Sim_Type_t Type, int Size)
+{
+	Sim_Device_t *Device;
+	int Index;
+
+	if ((Bus == NULL) || (Bus[0] == '\0')) {
+		return NULL;
+	}
+
+	Index = Sim_Bus(Bus, 1);
+	if (Index < 0) {
+		SC_ERR("failed to simulate I2C bus %s", Bus);
+		return NULL;
+	}
+
+	Device = Sim_Find(Index, Address);
+	if (Device != NULL) {
+		if (Device->Type != Type) {
+			SC_INFO("I2C device %#x on %s is already simulated", Address, Bus);
+			return NULL;
+		}
+
+		return Device;
+	}
+
+	if (Sim_Device_Numbers == SIM_DEVICES_MAX) {
+		SC_ERR("failed to simulate I2C device %#x on %s", Address, Bus);
+		return NULL;
+	}
+
+	Device = calloc(1, sizeof(Sim_Device_t));
+	if ((Device == NULL) || ((Size > 0) &&
+	    ((Device->Memory = calloc(1, Size)) == NULL))) {
+		SC_ERR("failed to allocate simulated device: %m");
+		free(Device);
+		return NULL;
+	}
+
+	Device->Type = Type;
+	Device->Bus = Index;
+	Device->Address = Address;
+	Device->Size = Size;
+	Sim_Devices[Sim_Device_Numbers++] = Device;
+	return Device;
+}
+
+static void
+Sim_Word(unsigned char *Buffer, int Value)
+{
+	Buffer[0] = ((Value >> 8) & 0xFF);
+	Buffer[1] = (Value & 0xFF);
+}
+
+static void
+Sim_String(unsigned char *Buffer, const char *Value, int Length)
+{
+	(void) memset(Buffer, ' ', Length);
+	(void) memcpy(Buffer, Value, MIN((int)strlen(Value), Length));
+}
+
+/*
+ * INA226
+ */
+static unsigned short
+INA226_Register(Sim_Device_t *Device, int Register)
+{
+	INA226_t *INA226 = Device->Device;
+	unsigned short *Regs = Device->Regs[0];
+	double Value;
+
+	switch (Register) {
+	case 0x1:	/* Shunt Voltage, 2.5 uV per bit */
+		Value = (Device->Amps * INA226->Shunt_Resistor) / 2.5;
+		break;
+	case 0x2:	/* Bus Voltage, 1.25 mV per bit */
+		Value = Device->Volts / 0.00125;
+		break;
+	case 0x3:	/* Power */
+		Value = ((double)INA226_Register(Device, 0x4) *
+			 INA226_Register(Device, 0x2)) / 20000;
+		return MIN(Value, 0xFFFF);
+	case 0x4:	/* Current */
+		Value = ((double)INA226_Register(Device, 0x1) * Regs[0x5]) / 2048;
+		break;
+	case 0xFE:	/* Manufacturer ID */
+		return 0x5449;
+	case 0xFF:	/* Die ID */
+		return 0x2260;
+	default:
+		return Regs[Register];
+	}
+
+	return MIN(Value, 0x7FFF);
+}
+
+/*
+ * PMBus regulators return words little endian, and READ_VOUT follows
+ * VOUT_COMMAND while the output is on.
+ */
+static unsigned short
+PMBus_Register(Sim_Device_t *Device, int Register)
+{
+	unsigned short *Regs = Device->Regs[Device->Page];
+
+	switch (Register) {
+	case PMBUS_PAGE:
+		return Device->Page;
+	case PMBUS_READ_VOUT:
+		return ((Regs[PMBUS_OPERATION] & 0x80) ? Regs[PMBUS_VOUT_COMMAND] : 0);
+	default:
+		return Regs[Register];
+	}
+}
+
+/*
+ * TCA6416A registers are in pairs of ports 0 and 1, and inputs read the
+ * output of pins configured as outputs.
+ */
+static unsigned char
+TCA6416A_Register(Sim_Device_t *Device, int Register)
+{
+	unsigned short *Regs = Device->Regs[0];
+	int Port = (Register & 0x1);
+
+	if (Register < 0x2) {
+		return ((((Regs[0x2 + Port] & ~Regs[0x6 + Port]) | Regs[0x6 + Port]) ^
+			 Regs[0x4 + Port]) & 0xFF);
+	}
+
+	return Regs[Register];
+}
+
+/*
+ * SFF modules have a lower page of 128 bytes, and upper pages selected by
+ * byte 127.
+ */
+static unsigned char *
+Module_Byte(Sim_Device_t *Device, int Offset)
+{
+	if (Offset < 128) {
+		return &Device->Memory[Offset];
+	}
+
+	return &Device->Memory[128 + (Device->Page * 128) + (Offset - 128)];
+}
+
+/*
+ * The 8A34001 is accessed with 1-byte offsets, and the page register at
+ * 0xFC-0xFF sets the upper byte of the 16-bit address.
+ */
+static unsigned char *
+IDT_8A34001_Byte(Sim_Device_t *Device, int Offset)
+{
+	return &Device->Memory[(Device->Page << 8) | Offset];
+}
+
+static void
+Device_Write(Sim_Device_t *Device, const unsigned char *Data, int Length)
+{
+	unsigned short *Regs = Device->Regs[Device->Page];
+	Sim_Device_t *SPD;
+	int Register;
+
+	if (Length == 0) {
+		return;
+	}
+
+	Register = Data[0];
+	switch (Device->Type) {
+	case SIM_INA226:
+		/* Only Configuration, Calibration, Mask/Enable, and Alert Limit */
+		if ((Length >= 3) && ((Register == 0x0) ||
+		    ((Register >= 0x5) && (Register <= 0x7)))) {
+			Regs[Register] = ((Data[1] << 8) | Data[2]);
+		}
+
+		break;
+	case SIM_SE98A:
+		/* Only Configuration and the limits */
+		if ((Length >= 3) && (Register >= 0x1) && (Register <= 0x4)) {
+			Regs[Register] = ((Data[1] << 8) | Data[2]);
+		}
+
+		break;
+	case SIM_PMBUS:
+		if (Register == PMBUS_PAGE) {
+			if ((Length >= 2) && (Data[1] < SIM_PAGES)) {
+				Device->Page = Data[1];
+			}
+		} else if (Length == 2) {
+			Regs[Register] = Data[1];
+		} else if (Length >= 3) {
+			Regs[Register] = (Data[1] | (Data[2] << 8));
+		}
+
+		break;
+	case SIM_TCA6416A:
+		Register &= 0x7;
+		for (int i = 1; i < Length; i++) {
+			if (Register >= 0x2) {
+				Regs[Register] = Data[i];
+			}
+
+			Register ^= 0x1;
+		}
+
+		break;
+	case SIM_EEPROM:
+		if (Device->Offset_Bytes == 2) {
+			Register = ((Data[0] << 8) | ((Length > 1) ? Data[1] : 0));
+		}
+
+		for (int i = Device->Offset_Bytes; i < Length; i++) {
+			Device->Memory[Register++ % Device->Size] = Data[i];
+		}
+
+		Register %= Device->Size;
+		break;
+	case SIM_SPD:
+		/* Write protected */
+		break;
+	case SIM_SPD_PAGE:
+		/* Selects the page of every SPD on the bus */
+		for (int i = 0; i < Sim_Device_Numbers; i++) {
+			SPD = Sim_Devices[i];
+			if ((SPD->Type == SIM_SPD) && (SPD->Bus == Device->Bus)) {
+				SPD->Page = (Device->Address - SIM_SPD_PAGE_0);
+			}
+		}
+
+		break;
+	case SIM_MODULE:
+		for (int i = 1; i < Length; i++) {
+			if (Register == 127) {
+				if (Data[i] < SIM_PAGES) {
+					Device->Page = Data[i];
+					Device->Memory[127] = Data[i];
+				}
+			} else {
+				*Module_Byte(Device, Register) = Data[i];
+			}
+
+			Register = ((Register + 1) & 0xFF);
+		}
+
+		break;
+	case SIM_8A34001:
+		for (int i = 1; i < Length; i++) {
+			if (Register == 0xFD) {
+				Device->Page = Data[i];
+			} else if (Register < 0xFC) {
+				*IDT_8A34001_Byte(Device, Register) = Data[i];
+			}
+
+			Register = ((Register + 1) & 0xFF);
+		}
+
+		break;
+	}
+
+	Device->Pointer = Register;
+}
+
+static void
+Device_Read(Sim_Device_t *Device, unsigned char *Buffer, int Length)
+{
+	unsigned short Value;
+
+	for (int i = 0; i < Length; i++) {
+		switch (Device->Type) {
+		case SIM_INA226:
+		case SIM_SE98A:
+			/* Words are big endian, and the pointer stays */
+			Value = ((Device->Type == SIM_INA226) ?
+				 INA226_Register(Device, Device->Pointer) :
+				 Device->Regs[0][Device->Pointer]);
+			Buffer[i] = (((i % 2) == 0) ? (Value >> 8) : (Value & 0xFF));
+			break;
+		case SIM_PMBUS:
+			Value = PMBus_Register(Device, Device->Pointer);
+			Buffer[i] = ((i < 2) ? ((Value >> (8 * i)) & 0xFF) : 0);
+			break;
+		case SIM_TCA6416A:
+			Buffer[i] = TCA6416A_Register(Device, Device->Pointer);
+			Device->Pointer ^= 0x1;
+			break;
+		case SIM_EEPROM:
+			Buffer[i] = Device->Memory[Device->Pointer];
+			Device->Pointer = ((Device->Pointer + 1) % Device->Size);
+			break;
+		case SIM_SPD:
+			Buffer[i] = Device->Memory[(Device->Page * 256) + Device->Pointer];
+			Device->Pointer = ((Device->Pointer + 1) & 0xFF);
+			break;
+		case SIM_SPD_PAGE:
+			Buffer[i] = 0;
+			break;
+		case SIM_MODULE:
+			Buffer[i] = *Module_Byte(Device, Device->Pointer);
+			Device->Pointer = ((Device->Pointer + 1) & 0xFF);
+			break;
+		case SIM_8A34001:
+			Buffer[i] = ((Device->Pointer == 0xFD) ? Device->Page :
+				     (Device->Pointer >= 0xFC) ? 0 :
+				     *IDT_8A34001_Byte(Device, Device->Pointer));
+			Device->Pointer = ((Device->Pointer + 1) & 0xFF);
+			break;
+		}
+	}
+}
+
+/*
+ * Whether the device doesn't acknowledge this transfer, spreading NACKs
+ * evenly over transfers.
+ */
+static int
+Sim_NACK(Sim_Device_t *Device)
+{
+	Device->NACK_Credit += Device->NACK;
+	if (Device->NACK_Credit >= 100) {
+		Device->NACK_Credit -= 100;
+		return 1;
+	}
+
+	return 0;
+}
+
+static Sim_File_t *
+Sim_File(int FD)
+{
+	for (int i = 0; i < Sim_File_Numbers; i++) {
+		if (Sim_Files[i].FD == FD) {
+			return &Sim_Files[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int
+Sim_Open(const char *Bus)
+{
+	Sim_File_t *File;
+	int Saved_Errno;
+	int Index;
+	int FD = -1;
+
+	(void) pthread_mutex_lock(&Sim_Lock);
+	Index = Sim_Bus(Bus, 0);
+	if (Index < 0) {
+		errno = ENOENT;
+	} else if (Sim_File_Numbers == SIM_FILES_MAX) {
+		errno = EMFILE;
+	} else {
+		FD = open("/dev/null", (O_RDWR | O_CLOEXEC));
+		if (FD >= 0) {
+			File = &Sim_Files[Sim_File_Numbers++];
+			File->FD = FD;
+			File->Bus = Index;
+			File->Address = -1;
+		}
+	}
+
+	Saved_Errno = errno;
+	(void) pthread_mutex_unlock(&Sim_Lock);
+	errno = Saved_Errno;
+	return FD;
+}
+
+static int
+Sim_Close(int FD)
+{
+	Sim_File_t *File;
+
+	(void) pthread_mutex_lock(&Sim_Lock);
+	File = Sim_File(FD);
+	if (File != NULL) {
+		*File = Sim_Files[--Sim_File_Numbers];
+	}
+
+	(void) pthread_mutex_unlock(&Sim_Lock);
+	return close(FD);
+}
+
+/*
+ * Issue the messages of an I2C_RDWR ioctl to the devices they address.
+ * Must be called with Sim_Lock held.
+ */
+static int
+Sim_Transfer(Sim_File_t *File, struct i2c_rdwr_ioctl_data *Msgset, int *Delay)
+{
+	Sim_Device_t *Device;
+	struct i2c_msg *Msg;
+
+	for (int i = 0; i < Msgset->nmsgs; i++) {
+		Msg = &Msgset->msgs[i];
+		Device = Sim_Find(File->Bus, Msg->addr);
+		if ((Device == NULL) || ((i == 0) && Sim_NACK(Device))) {
+			errno = ENXIO;
+			return -1;
+		}
+
+		if (i == 0) {
+			*Delay = Device->Delay;
+		}
+
+		if (Msg->flags & I2C_M_RD) {
+			Device_Read(Device, Msg->buf, Msg->len);
+		} else {
+			Device_Write(Device, Msg->buf, Msg->len);
+		}
+	}
+
+	return Msgset->nmsgs;
+}
+
+static int
+Sim_Ioctl(int FD, unsigned long Request, unsigned long Arg)
+{
+	Sim_File_t *File;
+	int Saved_Errno;
+	int Delay = 0;
+	int Ret = 0;
+
+	(void) pthread_mutex_lock(&Sim_Lock);
+	File = Sim_File(FD);
+	if (File == NULL) {
+		errno = EBADF;
+		Ret = -1;
+	} else {
+		switch (Request) {
+		case I2C_SLAVE:
+		case I2C_SLAVE_FORCE:
+			File->Address = Arg;
+			break;
+		case I2C_TIMEOUT:
+		case I2C_RETRIES:
+			break;
+		case I2C_RDWR:
+			Ret = Sim_Transfer(File, (struct i2c_rdwr_ioctl_data *)Arg, &Delay);
+			break;
+		default:
+			errno = ENOTTY;
+			Ret = -1;
+			break;
+		}
+	}
+
+	Saved_Errno = errno;
+	(void) pthread_mutex_unlock(&Sim_Lock);
+	if (Delay > 0) {
+		(void) usleep(Delay);
+	}
+
+	errno = Saved_Errno;
+	return Ret;
+}
+
+/*
+ * A read or write of the device whose address is set on the descriptor.
+ */
+static ssize_t
+Sim_Access(int FD, void *Buffer, size_t Length, int Read)
+{
+	Sim_Device_t *Device = NULL;
+	Sim_File_t *File;
+	int Saved_Errno;
+	ssize_t Ret = -1;
+
+	(void) pthread_mutex_lock(&Sim_Lock);
+	File = Sim_File(FD);
+	if (File == NULL) {
+		errno = EBADF;
+	} else {
+		Device = Sim_Find(File->Bus, File->Address);
+		if ((Device == NULL) || Sim_NACK(Device)) {
+			errno = ENXIO;
+		} else if (Read) {
+			Device_Read(Device, Buffer, Length);
+			Ret = Length;
+		} else {
+			Device_Write(Device, Buffer, Length);
+			Ret = Length;
+		}
+	}
+
+	Saved_Errno = errno;
+	(void) pthread_mutex_unlock(&Sim_Lock);
+	if ((Device != NULL) && (Device->Delay > 0)) {
+		(void) usleep(Device->Delay);
+	}
+
+	errno = Saved_Errno;
+	return Ret;
+}
+
+static ssize_t
+Sim_Read(int FD, void *Buffer, size_t Length)
+{
+	return Sim_Access(FD, Buffer, Length, 1);
+}
+
+static ssize_t
+Sim_Write(int FD, const void *Buffer, size_t Length)
+{
+	return Sim_Access(FD, (void *)Buffer, Length, 0);
+}
+
+static const I2C_Backend_t Sim_Backend = {
+	.Open = Sim_Open,
+	.Close = Sim_Close,
+	.Ioctl = Sim_Ioctl,
+	.Read = Sim_Read,
+	.Write = Sim_Write,
+};
+
+/*
+ * FRU EEPROMs
+ */
+static int
+FRU_Field(unsigned char *Memory, int Offset, const char *Value)
+{
+	int Length = MIN((int)strlen(Value), 0x3F);
+
+	Memory[Offset] = (0xC0 | Length);
+	(void) memcpy(&Memory[Offset + 1], Value, Length);
+	return (Offset + 1 + Length);
+}
+
+static unsigned char
+FRU_Checksum(const unsigned char *Memory, int Length)
+{
+	unsigned char Sum = 0;
+
+	for (int i = 0; i < Length; i++) {
+		Sum += Memory[i];
+	}
+
+	return -Sum;
+}
+
+static int
+FRU_Record(unsigned char *Memory, int Offset, int Type, int Last,
+	   const unsigned char *Data, int Length)
+{
+	unsigned char *Header = &Memory[Offset];
+
+	Header[0] = Type;
+	Header[1] = (0x2 | (Last ? 0x80 : 0));
+	Header[2] = Length;
+	Header[3] = FRU_Checksum(Data, Length);
+	Header[4] = FRU_Checksum(Header, 4);
+	(void) memcpy(&Header[5], Data, Length);
+	return (Offset + 5 + Length);
+}
+
+static void
+FRU_DC_Load(unsigned char *Data, int Output, float Nominal, float Minimum,
+	    float Maximum)
+{
+	int Volts[3] = { lroundf(Nominal * 100), lroundf(Minimum * 100),
+			 lroundf(Maximum * 100) };
+
+	/* Voltages are in 10 mV, little endian */
+	(void) memset(Data, 0, 13);
+	Data[0] = Output;
+	for (int i = 0; i < 3; i++) {
+		Data[1 + (2 * i)] = (Volts[i] & 0xFF);
+		Data[2 + (2 * i)] = (Volts[i] >> 8);
+	}
+}
+
+/*
+ * An IPMI FRU image with a board area, and a multirecord area with either
+ * the MAC address of the SC, or if there's a maximum voltage, the range of
+ * the voltage adjust rail followed by the 3.3 V rail.
+ */
+static void
+Sim_FRU(unsigned char *Memory, const char *Product, float Minimum_Volt,
+	float Maximum_Volt)
+{
+	static const unsigned char MAC[] = {
+		0xDA, 0x10, 0x00,		/* Xilinx IANA ID */
+		0x11,				/* SC MAC ID */
+		0x00, 0x0A, 0x35, 0x00, 0x00, 0x01,
+	};
+	unsigned char Load[13];
+	int Offset;
+
+	Memory[0x0] = 0x1;
+	Memory[0x3] = 0x1;	/* Board area at 0x8 */
+
+	/* Manufacturing date is in minutes since 1/1/1996 */
+	Memory[0x8] = 0x1;
+	Memory[0xB] = 0x40;
+	Memory[0xC] = 0x2A;
+	Memory[0xD] = 0x70;
+	Offset = FRU_Field(Memory, 0xE, "Xilinx");
+	Offset = FRU_Field(Memory, Offset, Product);
+	Offset = FRU_Field(Memory, Offset, "SIM0000000001");
+	Offset = FRU_Field(Memory, Offset, "SIM-0000-01");
+	Memory[Offset++] = 0x1;		/* FRU file ID of one binary byte */
+	Memory[Offset++] = 0x0;
+	Offset = FRU_Field(Memory, Offset, "A");
+	Memory[Offset++] = 0xC1;
+	Offset = ((Offset + 1 + 7) & ~7);
+	Memory[0x9] = ((Offset - 0x8) / 8);
+	Memory[Offset - 1] = FRU_Checksum(&Memory[0x8], (Offset - 0x8 - 1));
+
+	Memory[0x5] = (Offset / 8);
+	Memory[0x7] = FRU_Checksum(Memory, 7);
+	if (Maximum_Volt == 0) {
+		(void) FRU_Record(Memory, Offset, 0xD2, 1, MAC, sizeof(MAC));
+		return;
+	}
+
+	FRU_DC_Load(Load, 0, Minimum_Volt, Minimum_Volt, Maximum_Volt);
+	Offset = FRU_Record(Memory, Offset, 0x2, 0, Load, sizeof(Load));
+	FRU_DC_Load(Load, 1, 3.3, 3.3, 3.3);
+	(void) FRU_Record(Memory, Offset, 0x2, 1, Load, sizeof(Load));
+}
+
+static void
+Sim_EEPROM(const char *Bus, int Address, int Offset_Bytes, const char *Product,
+	   float Minimum_Volt, float Maximum_Volt)
+{
+	Sim_Device_t *Device;
+
+	Device = Sim_Add(Bus, Address, SIM_EEPROM, ((Offset_Bytes == 2) ? 0x2000 : 256));
+	if (Device != NULL) {
+		Device->Offset_Bytes = Offset_Bytes;
+		Sim_FRU(Device->Memory, Product, Minimum_Volt, Maximum_Volt);
+	}
+}
+
+static float
+Rail_Volts(const char *Name)
+{
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+
+	for (int i = 0; (Voltages != NULL) && (i < Voltages->Numbers); i++) {
+		if ((strcmp(Voltages->Voltage[i].Name, Name) == 0) &&
+		    (Voltages->Voltage[i].Typical_Volt > 0)) {
+			return Voltages->Voltage[i].Typical_Volt;
+		}
+	}
+
+	return 1.0;
+}
+
+/*
+ * Set up the page of the regulator with Linear16 VOUT at its typical
+ * voltage, and limits at +/- 5% and 10% of it.
+ */
+static void
+Sim_Regulator(Sim_Device_t *Device, Voltage_t *Regulator)
+{
+	static const struct {
+		int	Register;
+		float	Ratio;
+	} Levels[] = {
+		{ PMBUS_VOUT_COMMAND, 1.0 },
+		{ PMBUS_VOUT_OV_FAULT_LIMIT, 1.1 },
+		{ PMBUS_VOUT_OV_WARN_LIMIT, 1.05 },
+		{ PMBUS_VOUT_UV_WARN_LIMIT, 0.95 },
+		{ PMBUS_VOUT_UV_FAULT_LIMIT, 0.9 },
+	};
+	int Page = ((Regulator->Page_Select == -1) ? 0 : Regulator->Page_Select);
+	unsigned short *Regs;
+	float Volts = Regulator->Typical_Volt;
+	int Mode, Exponent;
+
+	if ((Page < 0) || (Page >= SIM_PAGES)) {
+		SC_INFO("Page %d of regulator %s is not simulated", Page, Regulator->Name);
+		return;
+	}
+
+	if (Volts <= 0) {
+		Volts = ((Regulator->Maximum_Volt > 0) ? Regulator->Maximum_Volt : 1.0);
+	}
+
+	if (Regulator->Voltage_Multiplier != 0) {
+		Volts /= Regulator->Voltage_Multiplier;
+	}
+
+	/* Exponent of -12, or -8 that's assumed without VOUT_MODE */
+	Mode = (Regulator->PMBus_VOUT_MODE ? 0x14 : 0x18);
+	Exponent = (Mode & 0x1F) - (sizeof(int) * 8);
+	Regs = Device->Regs[Page];
+	Regs[PMBUS_OPERATION] = 0x80;
+	Regs[PMBUS_VOUT_MODE] = Mode;
+	for (int i = 0; i < ARRAY_SIZE(Levels); i++) {
+		Regs[Levels[i].Register] = lroundf(ldexpf((Volts * Levels[i].Ratio),
+							  -Exponent));
+	}
+}
+
+/*
+ * DDR4 SPD, page 0 followed by page 1.
+ */
+static void
+Sim_SPD(unsigned char *Memory)
+{
+	Memory[0] = 0x23;	/* 384 bytes used */
+	Memory[1] = 0x11;	/* Revision 1.1 */
+	Memory[2] = 0xC;	/* DDR4 SDRAM */
+	Memory[3] = 0x2;	/* UDIMM */
+	Memory[4] = 0x45;	/* 8 Gb per die */
+	Memory[12] = 0x1;	/* x8, one rank */
+	Memory[13] = 0x3;	/* 64-bit bus */
+	Memory[14] = 0x80;	/* Thermal sensor */
+	Memory[18] = 0x6;	/* tCKmin of 0.75 ns */
+	Memory[0x140] = 0x80;	/* Micron */
+	Memory[0x141] = 0x2C;
+	Memory[0x143] = 0x24;	/* Week 10 of 2024 */
+	Memory[0x144] = 0x10;
+	Memory[0x145] = 0x1;
+	Sim_String(&Memory[0x149], "SIM-DDR4-8GB", 20);
+}
+
+/*
+ * Memory map of the module, or for 'sfp', its A0h page, where SFF-8472
+ * diagnostics are in the A2h page at the next address.
+ */
+static void
+Sim_Module(Sim_Device_t *Device, SFP_Type Type)
+{
+	/* Offsets of page 00h are as is, see Module_Byte() */
+	unsigned char *Lower = Device->Memory;
+	unsigned char *Upper = Device->Memory;
+	unsigned char *Page_3 = &Device->Memory[3 * 128];
+
+	switch (Type) {
+	case sfp:
+		Lower[0] = 0x3;
+		Sim_String(&Lower[0x14], "XILINX SIM", 16);
+		Sim_String(&Lower[0x28], "SIM-SFP28", 16);
+		Sim_String(&Lower[0x44], "SIM0000000001", 16);
+		break;
+	case qsfp:
+		/* SFF-8636, with thresholds of temperature and supply in page 03h */
+		Lower[0] = Upper[128] = 0x11;
+		Sim_Word(&Lower[22], (SIM_CELSIUS * 256));
+		Sim_Word(&Lower[26], 33000);
+		Sim_String(&Upper[148], "XILINX SIM", 16);
+		Sim_String(&Upper[168], "SIM-QSFP28", 16);
+		Sim_String(&Upper[196], "SIM0000000001", 16);
+		Sim_Word(&Page_3[128], (75 * 256));
+		Sim_Word(&Page_3[130], (-5 * 256));
+		Sim_Word(&Page_3[132], (70 * 256));
+		Sim_Word(&Page_3[134], 0);
+		Sim_Word(&Page_3[144], 36000);
+		Sim_Word(&Page_3[146], 30000);
+		Sim_Word(&Page_3[148], 35000);
+		Sim_Word(&Page_3[150], 31000);
+		break;
+	default:
+		/* CMIS */
+		Lower[0] = Upper[128] = ((Type == sfpdd) ? 0x1A : (Type == qsfpdd) ? 0x18 : 0x19);
+		Sim_Word(&Lower[14], (SIM_CELSIUS * 256));
+		Sim_Word(&Lower[16], 33000);
+		Sim_String(&Upper[129], "XILINX SIM", 16);
+		Sim_String(&Upper[148], "SIM-MODULE", 16);
+		Sim_String(&Upper[166], "SIM0000000001", 16);
+		break;
+	}
+}
+
+/*
+ * Apply the delays and NACKs of SIMFILE to the devices.
+ */
+static int
+Sim_Faults(void)
+{
+	Sim_Device_t *Device;
+	FILE *FP;
+	char Buffer[LSTRLEN_MAX];
+	char Bus[LSTRLEN_MAX];
+	char Address[STRLEN_MAX];
+	char *File;
+	int Delay, NACK;
+	int Index, Found;
+	int Line = 0;
+
+	File = SIMFILE;
+	if ((File == NULL) || (access(File, F_OK) != 0)) {
+		return 0;
+	}
+
+	FP = fopen(File, "r");
+	if (FP == NULL) {
+		SC_ERR("failed to read file %s: %m", File);
+		return -1;
+	}
+
+	while (fgets(Buffer, sizeof(Buffer), FP) != NULL) {
+		Line++;
+		if ((Buffer[0] == '#') || (Buffer[0] == '\n')) {
+			continue;
+		}
+
+		NACK = 0;
+		if ((sscanf(Buffer, "%127s %63s %d %d", Bus, Address, &Delay, &NACK) < 3) ||
+		    (Delay < 0) || (NACK < 0) || (NACK > 100)) {
+			SC_ERR("invalid line %d of simulator file", Line);
+			continue;
+		}
+
+		Index = Sim_Bus(Bus, 0);
+		Found = 0;
+		for (int i = 0; (Index >= 0) && (i < Sim_Device_Numbers); i++) {
+			Device = Sim_Devices[i];
+			if ((Device->Bus == Index) && ((strcmp(Address, "*") == 0) ||
+			    (Device->Address == strtol(Address, NULL, 0)))) {
+				Device->Delay = Delay;
+				Device->NACK = NACK;
+				Found = 1;
+			}
+		}
+
+		if (!Found) {
+			SC_ERR("no simulated device %s on %s", Address, Bus);
+		}
+	}
+
+	(void) fclose(FP);
+	return 0;
+}
+
+/*
+ * Simulate the devices of the board, and access them from now on.  Must
+ * be called before any bus is opened.
+ */
+int
+Sim_Init(const char *Board_Name)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+	DIMMs_t *DIMMs = Plat_Devs->DIMMs;
+	SFPs_t *SFPs = Plat_Devs->SFPs;
+	FMCs_t *FMCs = Plat_Devs->FMCs;
+	Clocks_t *Clocks = Plat_Devs->Clocks;
+	IO_Exp_t *IO_Exp = Plat_Devs->IO_Exp;
+	Daughter_Card_t *Daughter_Card = Plat_Devs->Daughter_Card;
+	OnBoard_EEPROM_t *OnBoard_EEPROM = Plat_Devs->OnBoard_EEPROM;
+	Sim_Device_t *Device;
+	INA226_t *INA226;
+	DIMM_t *DIMM;
+	SFP_t *SFP;
+	FMC_t *FMC;
+	float Minimum_Volt, Maximum_Volt;
+
+	for (int i = 0; (INA226s != NULL) && (i < INA226s->Numbers); i++) {
+		INA226 = &INA226s->INA226[i];
+		Device = Sim_Add(INA226->I2C_Bus, INA226->I2C_Address, SIM_INA226, 0);
+		if (Device != NULL) {
+			Device->Device = INA226;
+			Device->Volts = Rail_Volts(INA226->Name);
+			Device->Amps = (SIM_LOAD * INA226->Maximum_Current) / 1000;
+			if (INA226->Phase_Multiplier > 1) {
+				/* The shunt is of one phase */
+				Device->Amps /= INA226->Phase_Multiplier;
+			}
+
+			Device->Regs[0][0x0] = 0x4127;
+		}
+	}
+
+	for (int i = 0; (Voltages != NULL) && (i < Voltages->Numbers); i++) {
+		Device = Sim_Add(Voltages->Voltage[i].I2C_Bus,
+				 Voltages->Voltage[i].I2C_Address, SIM_PMBUS, 0);
+		if (Device != NULL) {
+			Sim_Regulator(Device, &Voltages->Voltage[i]);
+		}
+	}
+
+	if (IO_Exp != NULL) {
+		Device = Sim_Add(IO_Exp->I2C_Bus, IO_Exp->I2C_Address, SIM_TCA6416A, 0);
+		if (Device != NULL) {
+			Device->Regs[0][0x2] = Device->Regs[0][0x3] = 0xFF;
+			Device->Regs[0][0x6] = Device->Regs[0][0x7] = 0xFF;
+		}
+	}
+
+	if (OnBoard_EEPROM != NULL) {
+		Sim_EEPROM(OnBoard_EEPROM->I2C_Bus, OnBoard_EEPROM->I2C_Address, 2,
+			   Board_Name, 0, 0);
+	}
+
+	if (Daughter_Card != NULL) {
+		Sim_EEPROM(Daughter_Card->I2C_Bus, Daughter_Card->I2C_Address, 1,
+			   Daughter_Card->Name, 0, 0);
+	}
+
+	for (int i = 0; (FMCs != NULL) && (i < FMCs->Numbers); i++) {
+		FMC = &FMCs->FMC[i];
+		Minimum_Volt = 1.2;
+		Maximum_Volt = 1.8;
+		for (int j = 0; j < FMC->Volt_Numbers; j++) {
+			Minimum_Volt = ((j == 0) ? FMC->Supported_Volts[j] :
+					MIN(Minimum_Volt, FMC->Supported_Volts[j]));
+			Maximum_Volt = ((j == 0) ? FMC->Supported_Volts[j] :
+					MAX(Maximum_Volt, FMC->Supported_Volts[j]));
+		}
+
+		Sim_EEPROM(FMC->I2C_Bus, FMC->I2C_Address, 1, FMC->Name,
+			   Minimum_Volt, Maximum_Volt);
+	}
+
+	for (int i = 0; (DIMMs != NULL) && (i < DIMMs->Numbers); i++) {
+		DIMM = &DIMMs->DIMM[i];
+		Device = Sim_Add(DIMM->I2C_Bus, DIMM->I2C_Address_Thermal, SIM_SE98A, 0);
+		if (Device != NULL) {
+			Device->Regs[0][0x5] = ((SIM_CELSIUS * 16) & 0x1FFF);
+			Device->Regs[0][0x6] = 0x1131;
+			Device->Regs[0][0x7] = 0xA102;
+		}
+
+		Device = Sim_Add(DIMM->I2C_Bus, DIMM->I2C_Address_SPD, SIM_SPD, 512);
+		if (Device != NULL) {
+			Sim_SPD(Device->Memory);
+		}
+
+		(void) Sim_Add(DIMM->I2C_Bus, SIM_SPD_PAGE_0, SIM_SPD_PAGE, 0);
+		(void) Sim_Add(DIMM->I2C_Bus, (SIM_SPD_PAGE_0 + 1), SIM_SPD_PAGE, 0);
+	}
+
+	for (int i = 0; (SFPs != NULL) && (i < SFPs->Numbers); i++) {
+		SFP = &SFPs->SFP[i];
+		Device = Sim_Add(SFP->I2C_Bus, SFP->I2C_Address, SIM_MODULE,
+				 (128 + (SIM_PAGES * 128)));
+		if (Device != NULL) {
+			Sim_Module(Device, SFP->Type);
+		}
+
+		if (SFP->Type != sfp) {
+			continue;
+		}
+
+		Device = Sim_Add(SFP->I2C_Bus, (SFP->I2C_Address + 1), SIM_MODULE,
+				 (128 + (SIM_PAGES * 128)));
+		if (Device != NULL) {
+			Sim_Word(&Device->Memory[0x60], (SIM_CELSIUS * 256));
+			Sim_Word(&Device->Memory[0x62], 33000);
+		}
+	}
+
+	for (int i = 0; (Clocks != NULL) && (i < Clocks->Numbers); i++) {
+		if (Clocks->Clock[i].Type == IDT_8A34001) {
+			(void) Sim_Add(Clocks->Clock[i].I2C_Bus, Clocks->Clock[i].I2C_Address,
+				       SIM_8A34001, 0x10000);
+		}
+	}
+
+	if (Sim_Faults() != 0) {
+		return -1;
+	}
+
+	SC_INFO("Simulating %d devices on %d I2C buses", Sim_Device_Numbers,
+		Sim_Bus_Numbers);
+	(void) I2C_Set_Backend(&Sim_Backend);
+	return 0;
+}
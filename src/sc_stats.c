@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+/*
+ * Command Statistics
+ *
+ * For every command, count the requests and the ones that failed, and
+ * keep a histogram of the latency of each stage of serving a request:
+ *
+ *	parse	 - splitting and parsing the command line, up to looking up
+ *		   the command
+ *	pre_ops	 - running the pre_phase constraints of the command
+ *	ops	 - running the command itself, including any output that is
+ *		   sent before the command completes
+ *	send	 - sending the rest of the response
+ *	total	 - from receiving the request to sending the response, which
+ *		   includes waiting in line for a worker
+ *
+ * Histograms are log-linear: latencies below STATS_SUB microseconds get
+ * a bucket each, and every power of two above that is split into
+ * STATS_SUB linear buckets, so a bucket is never wider than 1/STATS_SUB
+ * of its lower bound.  Requests that don't name a valid command are kept
+ * in a row of their own.
+ */
+#define STATS_SUB_BITS	2
+#define STATS_SUB	(1 << STATS_SUB_BITS)
+#define STATS_BUCKETS	((32 - STATS_SUB_BITS + 1) * STATS_SUB)
+
+typedef struct {
+	unsigned long long	Count;
+	unsigned long long	Sum;	/* In microseconds */
+	unsigned int	Max;
+	unsigned int	Bucket[STATS_BUCKETS];
+} Stats_Histogram_t;
+
+typedef struct {
+	unsigned long long	Requests;
+	unsigned long long	Errors;
+	Stats_Histogram_t	Stage[STATS_STAGES];
+} Stats_t;
+
+static const char *Stage_Names[STATS_STAGES] = {
+	"parse", "pre_ops", "ops", "send", "total",
+};
+
+static pthread_mutex_t Stats_Lock = PTHREAD_MUTEX_INITIALIZER;
+static Stats_t *Stats;
+static int Stats_Numbers;
+
+/*
+ * The row of the command, or NULL if the command isn't counted.
+ */
+static Stats_t *
+Stats_Row(int CmdId)
+{
+	if ((Stats == NULL) || (CmdId < STATS_INVALID) || (CmdId >= Stats_Numbers)) {
+		return NULL;
+	}
+
+	/* The row of invalid requests is the last one */
+	return &Stats[(CmdId == STATS_INVALID) ? Stats_Numbers : CmdId];
+}
+
+static int
+Bucket_Index(unsigned int Value)
+{
+	int Octave;
+
+	if (Value < STATS_SUB) {
+		return Value;
+	}
+
+	Octave = (31 - __builtin_clz(Value)) - STATS_SUB_BITS;
+	return (((Octave + 1) << STATS_SUB_BITS) +
+		((Value >> Octave) & (STATS_SUB - 1)));
+}
+
+/*
+ * Lower bound of the bucket, the upper one being that of the next bucket.
+ */
+static unsigned long long
+Bucket_Bound(int Index)
+{
+	int Octave;
+
+	if (Index < STATS_SUB) {
+		return Index;
+	}
+
+	Octave = (Index >> STATS_SUB_BITS) - 1;
+	return ((unsigned long long)(STATS_SUB + (Index & (STATS_SUB - 1))) << Octave);
+}
+
+/*
+ * The upper bound of the bucket the percentile falls in, which is
+ * an overestimate by no more than the width of the bucket.
+ */
+static unsigned long long
+Percentile(Stats_Histogram_t *Histogram, int Percent)
+{
+	unsigned long long Rank, Count = 0;
+	unsigned long long Bound;
+
+	Rank = ((Histogram->Count * Percent) + 99) / 100;
+	for (int i = 0; i < STATS_BUCKETS; i++) {
+		Count += Histogram->Bucket[i];
+		if (Count >= Rank) {
+			Bound = Bucket_Bound(i + 1);
+			return ((Bound < Histogram->Max) ? Bound : Histogram->Max);
+		}
+	}
+
+	return Histogram->Max;
+}
+
+/*
+ * Monotonic time in nanoseconds, for the start of a stage.
+ */
+long long
+Stats_Time(void)
+{
+	struct timespec Time;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (((long long)Time.tv_sec * 1000000000) + Time.tv_nsec);
+}
+
+/*
+ * Record the latency of the stage of a request of the command, which
+ * started at Start.
+ */
+void
+Stats_Record(int CmdId, Stats_Stage_t Stage, long long Start)
+{
+	Stats_Histogram_t *Histogram;
+	Stats_t *Row;
+	long long Latency;
+	unsigned int Value;
+
+	Latency = (Stats_Time() - Start) / 1000;
+	Value = ((Latency > 0xFFFFFFFF) ? 0xFFFFFFFF : (Latency < 0) ? 0 : Latency);
+	(void) pthread_mutex_lock(&Stats_Lock);
+	Row = Stats_Row(CmdId);
+	if (Row != NULL) {
+		Histogram = &Row->Stage[Stage];
+		Histogram->Count++;
+		Histogram->Sum += Value;
+		if (Value > Histogram->Max) {
+			Histogram->Max = Value;
+		}
+
+		Histogram->Bucket[Bucket_Index(Value)]++;
+	}
+
+	(void) pthread_mutex_unlock(&Stats_Lock);
+}
+
+/*
+ * Count a request of the command once it's responded to, and record its
+ * total latency.
+ */
+void
+Stats_Complete(int CmdId, int Status, long long Start)
+{
+	Stats_t *Row;
+
+	(void) pthread_mutex_lock(&Stats_Lock);
+	Row = Stats_Row(CmdId);
+	if (Row != NULL) {
+		Row->Requests++;
+		if (Status != 0) {
+			Row->Errors++;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&Stats_Lock);
+	Stats_Record(CmdId, STATS_TOTAL, Start);
+}
+
+void
+Stats_Reset(int CmdId)
+{
+	Stats_t *Row;
+
+	(void) pthread_mutex_lock(&Stats_Lock);
+	Row = Stats_Row(CmdId);
+	if (Row != NULL) {
+		(void) memset(Row, 0, sizeof(Stats_t));
+	}
+
+	(void) pthread_mutex_unlock(&Stats_Lock);
+}
+
+/*
+ * Print the statistics of the command, in brief on one line, or else
+ * with the percentiles and non-empty buckets of each stage.  Commands
+ * that haven't been requested are skipped in brief.
+ */
+void
+Stats_Print(int CmdId, const char *Name, int Detailed)
+{
+	Stats_Histogram_t *Histogram;
+	Stats_t *Row;
+	Stats_t Copy;
+
+	(void) pthread_mutex_lock(&Stats_Lock);
+	Row = Stats_Row(CmdId);
+	if (Row != NULL) {
+		Copy = *Row;
+	}
+
+	(void) pthread_mutex_unlock(&Stats_Lock);
+	if ((Row == NULL) || (!Detailed && (Copy.Requests == 0))) {
+		return;
+	}
+
+	Histogram = &Copy.Stage[STATS_TOTAL];
+	if (!Detailed) {
+		Output_Begin(1);
+		Output_String("command", NULL, Name);
+		Output_Int("requests", "Requests", Copy.Requests);
+		Output_Int("errors", "Errors", Copy.Errors);
+		Output_Int("p50_us", "p50(us)", Percentile(Histogram, 50));
+		Output_Int("p99_us", "p99(us)", Percentile(Histogram, 99));
+		Output_Int("max_us", "Max(us)", Histogram->Max);
+		Output_End();
+		return;
+	}
+
+	Output_Begin(0);
+	Output_Int("requests", "Requests", Copy.Requests);
+	Output_Int("errors", "Errors", Copy.Errors);
+	Output_End();
+	for (int i = 0; i < STATS_STAGES; i++) {
+		Histogram = &Copy.Stage[i];
+		Output_Begin(1);
+		Output_String("stage", NULL, Stage_Names[i]);
+		Output_Int("count", "Count", Histogram->Count);
+		Output_Int("mean_us", "Mean(us)",
+			   ((Histogram->Count != 0) ? (Histogram->Sum / Histogram->Count) : 0));
+		Output_Int("p50_us", "p50(us)", Percentile(Histogram, 50));
+		Output_Int("p90_us", "p90(us)", Percentile(Histogram, 90));
+		Output_Int("p99_us", "p99(us)", Percentile(Histogram, 99));
+		Output_Int("max_us", "Max(us)", Histogram->Max);
+		Output_End();
+	}
+
+	for (int i = 0; i < STATS_STAGES; i++) {
+		Histogram = &Copy.Stage[i];
+		for (int j = 0; j < STATS_BUCKETS; j++) {
+			if (Histogram->Bucket[j] != 0) {
+				SC_PRINT("%s\t[%llu, %llu) us:\t%u", Stage_Names[i],
+					 Bucket_Bound(j), Bucket_Bound(j + 1),
+					 Histogram->Bucket[j]);
+			}
+		}
+	}
+}
+
+/*
+ * Append the statistics of all commands that have been requested to the
+ * sink of this thread in the OpenMetrics text format.  Latencies are in
+ * seconds, and the buckets of the histograms are merged to one per power
+ * of two microseconds.
+ */
+void
+Stats_Export(void)
+{
+	Stats_Histogram_t *Histogram;
+	Stats_t *Copy;
+	const char *Name;
+	unsigned long long Count, Bound;
+	int Size;
+
+	Size = (Stats_Numbers + 1) * sizeof(Stats_t);
+	Copy = malloc(Size);
+	if (Copy == NULL) {
+		return;
+	}
+
+	/* Don't hold up commands while the exporter sends */
+	(void) pthread_mutex_lock(&Stats_Lock);
+	(void) memcpy(Copy, Stats, Size);
+	(void) pthread_mutex_unlock(&Stats_Lock);
+
+	Sink_Printf("# TYPE sc_command_requests counter\n");
+	Sink_Printf("# HELP sc_command_requests Requests responded to.\n");
+	for (int i = 0; i <= Stats_Numbers; i++) {
+		Name = ((i == Stats_Numbers) ? "(invalid)" : Command_Name(i));
+		if (Copy[i].Requests != 0) {
+			Sink_Printf("sc_command_requests_total{command=\"%s\"} %llu\n",
+				    Name, Copy[i].Requests);
+		}
+	}
+
+	Sink_Printf("# TYPE sc_command_errors counter\n");
+	Sink_Printf("# HELP sc_command_errors Requests that failed.\n");
+	for (int i = 0; i <= Stats_Numbers; i++) {
+		Name = ((i == Stats_Numbers) ? "(invalid)" : Command_Name(i));
+		if (Copy[i].Requests != 0) {
+			Sink_Printf("sc_command_errors_total{command=\"%s\"} %llu\n",
+				    Name, Copy[i].Errors);
+		}
+	}
+
+	Sink_Printf("# TYPE sc_command_latency_seconds histogram\n");
+	Sink_Printf("# HELP sc_command_latency_seconds Latency of each stage of requests.\n");
+	for (int i = 0; i <= Stats_Numbers; i++) {
+		Name = ((i == Stats_Numbers) ? "(invalid)" : Command_Name(i));
+		for (int j = 0; j < STATS_STAGES; j++) {
+			Histogram = &Copy[i].Stage[j];
+			if (Histogram->Count == 0) {
+				continue;
+			}
+
+			Count = 0;
+			for (int k = 0; k < STATS_BUCKETS; k++) {
+				Count += Histogram->Bucket[k];
+				Bound = Bucket_Bound(k + 1);
+				if ((Bound & (Bound - 1)) != 0) {
+					continue;
+				}
+
+				Sink_Printf("sc_command_latency_seconds_bucket{command=\"%s\",stage=\"%s\",le=\"%.6f\"} %llu\n",
+					    Name, Stage_Names[j], (Bound / 1000000.0), Count);
+				if (Count == Histogram->Count) {
+					break;
+				}
+			}
+
+			Sink_Printf("sc_command_latency_seconds_bucket{command=\"%s\",stage=\"%s\",le=\"+Inf\"} %llu\n",
+				    Name, Stage_Names[j], Histogram->Count);
+			Sink_Printf("sc_command_latency_seconds_count{command=\"%s\",stage=\"%s\"} %llu\n",
+				    Name, Stage_Names[j], Histogram->Count);
+			Sink_Printf("sc_command_latency_seconds_sum{command=\"%s\",stage=\"%s\"} %.6f\n",
+				    Name, Stage_Names[j], (Histogram->Sum / 1000000.0));
+		}
+	}
+
+	free(Copy);
+}
+
+/*
+ * Allocate a row for each of the given number of commands, plus one for
+ * invalid requests.
+ */
+int
+Stats_Init(int Numbers)
+{
+	Stats = calloc((Numbers + 1), sizeof(Stats_t));
+	if (Stats == NULL) {
+		SC_ERR("failed to allocate command statistics: %m");
+		return -1;
+	}
+
+	Stats_Numbers = Numbers;
+	return 0;
+}
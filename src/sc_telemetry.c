@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sc_telemetry.h"
+
+/*
+ * Telemetry Reader
+ *
+ * Lock-free access to the telemetry segment published by sc_appd, see
+ * sc_telemetry.h for its layout.  This has no dependency on the rest of
+ * sc_app, so that it can be linked into any tool that reads sensors.
+ */
+
+/* Give up on a slot that stays locked, e.g. if sc_appd died writing it */
+#define READ_TRIES	1000
+
+/*
+ * Map the segment read-only.  Returns 0 on success, or -1 with errno set,
+ * e.g. to ENOENT if sc_appd isn't running or EAGAIN if it's still
+ * creating the segment.
+ */
+int
+Telemetry_Open(Telemetry_t *Telemetry)
+{
+	const Telemetry_Header_t *Header;
+	struct stat Stat;
+	void *Map;
+	int FD;
+
+	FD = shm_open(TELEMETRY_SHM, O_RDONLY, 0);
+	if (FD == -1) {
+		return -1;
+	}
+
+	if ((fstat(FD, &Stat) == -1) ||
+	    (Stat.st_size < sizeof(Telemetry_Header_t))) {
+		(void) close(FD);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	Map = mmap(NULL, Stat.st_size, PROT_READ, MAP_SHARED, FD, 0);
+	(void) close(FD);
+	if (Map == MAP_FAILED) {
+		return -1;
+	}
+
+	Header = Map;
+	if (__atomic_load_n(&Header->Magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC) {
+		(void) munmap(Map, Stat.st_size);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	if ((Header->Version != TELEMETRY_VERSION) ||
+	    (Header->Sensor_Size < sizeof(Telemetry_Sensor_t)) ||
+	    ((Header->Header_Size + ((size_t)Header->Sensor_Numbers *
+				     Header->Sensor_Size)) > Stat.st_size)) {
+		(void) munmap(Map, Stat.st_size);
+		errno = EPROTO;
+		return -1;
+	}
+
+	Telemetry->Header = Header;
+	Telemetry->Size = Stat.st_size;
+	return 0;
+}
+
+void
+Telemetry_Close(Telemetry_t *Telemetry)
+{
+	if (Telemetry->Header != NULL) {
+		(void) munmap((void *)Telemetry->Header, Telemetry->Size);
+		Telemetry->Header = NULL;
+	}
+}
+
+const Telemetry_Sensor_t *
+Telemetry_Sensor(const Telemetry_t *Telemetry, int Index)
+{
+	const Telemetry_Header_t *Header = Telemetry->Header;
+
+	if ((Index < 0) || (Index >= Header->Sensor_Numbers)) {
+		return NULL;
+	}
+
+	return (const Telemetry_Sensor_t *)((const char *)Header +
+		Header->Header_Size + ((size_t)Index * Header->Sensor_Size));
+}
+
+/*
+ * Sensor names are only unique per type, e.g. a regulator and the
+ * INA226 on its rail may share a name, so this returns the first match.
+ */
+const Telemetry_Sensor_t *
+Telemetry_Find(const Telemetry_t *Telemetry, const char *Name)
+{
+	const Telemetry_Sensor_t *Sensor;
+
+	for (int i = 0; i < Telemetry->Header->Sensor_Numbers; i++) {
+		Sensor = Telemetry_Sensor(Telemetry, i);
+		if (strncmp(Sensor->Name, Name, TELEMETRY_NAME_MAX) == 0) {
+			return Sensor;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Copy up to Numbers of the latest samples of the sensor, the latest
+ * first, as a consistent snapshot.  Returns the number of samples copied,
+ * which is 0 if the sensor hasn't been sampled yet, or -1 with errno set
+ * to EAGAIN if no consistent snapshot could be taken.
+ */
+int
+Telemetry_History(const Telemetry_t *Telemetry, const Telemetry_Sensor_t *Sensor,
+		  Telemetry_Sample_t *Sample, int Numbers)
+{
+	uint32_t History = Telemetry->Header->History;
+	uint32_t Sequence;
+	uint64_t Count;
+	int Copied;
+
+	if (Numbers > History) {
+		Numbers = History;
+	}
+
+	for (int Try = 0; Try < READ_TRIES; Try++) {
+		Sequence = __atomic_load_n(&Sensor->Sequence, __ATOMIC_ACQUIRE);
+		if (Sequence & 1) {
+			continue;
+		}
+
+		Count = Sensor->Count;
+		Copied = (Count < Numbers) ? Count : Numbers;
+		for (int i = 0; i < Copied; i++) {
+			(void) memcpy(&Sample[i],
+				      &Sensor->Sample[(Count - 1 - i) % History],
+				      sizeof(Telemetry_Sample_t));
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&Sensor->Sequence, __ATOMIC_RELAXED) == Sequence) {
+			return Copied;
+		}
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+/*
+ * Copy the latest sample of the sensor.  Returns 1 if there is one, 0 if
+ * the sensor hasn't been sampled yet, or -1 as Telemetry_History() does.
+ */
+int
+Telemetry_Latest(const Telemetry_t *Telemetry, const Telemetry_Sensor_t *Sensor,
+		 Telemetry_Sample_t *Sample)
+{
+	return Telemetry_History(Telemetry, Sensor, Sample, 1);
+}
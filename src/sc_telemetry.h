@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SC_TELEMETRY_H_
+#define SC_TELEMETRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Telemetry Segment
+ *
+ * sc_appd samples every sensor of the board, i.e. INA226s, voltage
+ * regulators, the temperature sensor, DDR DIMM thermal sensors, and
+ * the diagnostics of SFP modules, once every Interval milliseconds and
+ * publishes the readings in a POSIX shared memory segment named
+ * TELEMETRY_SHM, which any local process may map read-only.
+ *
+ * The segment starts with a Telemetry_Header_t, followed by
+ * Sensor_Numbers sensor slots of Sensor_Size bytes each, the first one
+ * at offset Header_Size.  Readers should use the sizes from the header
+ * rather than sizeof(), so that fields may be appended in later versions
+ * of the same Magic.  All fields are in the native byte order.
+ *
+ * A slot holds the last History samples of its sensor in a ring, the
+ * latest at index ((Count - 1) % History).  Each sample carries up to
+ * TELEMETRY_VALUES_MAX readings, Value_Numbers of which are used by the
+ * sensor, in the order and units given by its Type:
+ *
+ *	TELEMETRY_POWER		voltage (V), current (A), power (W)
+ *	TELEMETRY_VOLTAGE	voltage (V)
+ *	TELEMETRY_TEMPERATURE	temperature (C)
+ *	TELEMETRY_DIMM		temperature (C)
+ *	TELEMETRY_SFP		temperature (C), supply voltage (V)
+ *
+ * A sample whose Status is non-zero is one where the sensor couldn't be
+ * read, e.g. an SFP cage with no module plugged in.
+ *
+ * Slots are updated under a sequence lock rather than a mutex, so that
+ * readers never hold up sc_appd.  Sequence is odd while the slot is
+ * being written, and is incremented again once the write is done.  To
+ * take a consistent snapshot, a reader loads Sequence (acquire), retries
+ * if it's odd, copies what it needs, issues an acquire fence, and
+ * retries if Sequence has changed since.  Telemetry_Latest() and
+ * Telemetry_History() do just that.
+ *
+ * The header is written before Magic is set, so a segment with a zero
+ * Magic is still being created.  Generation changes whenever sc_appd
+ * recreates the segment, at which point readers need to map it again.
+ */
+#define TELEMETRY_SHM		"/sc_telemetry"
+#define TELEMETRY_MAGIC		0x53435431	/* "SCT1" */
+#define TELEMETRY_VERSION	1
+#define TELEMETRY_NAME_MAX	64
+#define TELEMETRY_VALUES_MAX	3
+#define TELEMETRY_HISTORY	60
+
+typedef enum {
+	TELEMETRY_POWER,
+	TELEMETRY_VOLTAGE,
+	TELEMETRY_TEMPERATURE,
+	TELEMETRY_DIMM,
+	TELEMETRY_SFP,
+} Telemetry_Type_t;
+
+typedef struct {
+	uint64_t	Timestamp;	/* CLOCK_REALTIME, in nanoseconds */
+	int32_t		Status;
+	float		Value[TELEMETRY_VALUES_MAX];
+} Telemetry_Sample_t;
+
+typedef struct {
+	uint32_t	Sequence;
+	uint32_t	Type;
+	uint32_t	Value_Numbers;
+	uint32_t	Reserved;
+	uint64_t	Count;		/* Samples taken so far */
+	char		Name[TELEMETRY_NAME_MAX];
+	Telemetry_Sample_t	Sample[TELEMETRY_HISTORY];
+} Telemetry_Sensor_t;
+
+typedef struct {
+	uint32_t	Magic;
+	uint32_t	Version;
+	uint32_t	Header_Size;
+	uint32_t	Sensor_Size;
+	uint32_t	Sensor_Numbers;
+	uint32_t	History;
+	uint32_t	Interval;	/* In milliseconds */
+	uint32_t	Reserved;
+	uint64_t	Generation;
+} Telemetry_Header_t;
+
+/*
+ * Reader Library (libsc_telemetry.a)
+ */
+typedef struct {
+	const Telemetry_Header_t	*Header;
+	size_t	Size;
+} Telemetry_t;
+
+int Telemetry_Open(Telemetry_t *);
+void Telemetry_Close(Telemetry_t *);
+const Telemetry_Sensor_t *Telemetry_Sensor(const Telemetry_t *, int);
+const Telemetry_Sensor_t *Telemetry_Find(const Telemetry_t *, const char *);
+int Telemetry_Latest(const Telemetry_t *, const Telemetry_Sensor_t *,
+		     Telemetry_Sample_t *);
+int Telemetry_History(const Telemetry_t *, const Telemetry_Sensor_t *,
+		      Telemetry_Sample_t *, int);
+
+#endif /* SC_TELEMETRY_H_ */
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+extern Plat_Devs_t *Plat_Devs;
+
+/*
+ * Telemetry Subscriptions
+ *
+ * 'watch' samples a set of sensors every <value> milliseconds and pushes
+ * a timestamped line per sensor over the connection:
+ *
+ *	<seconds>.<milliseconds> <tab> <target> <tab> <label>:<tab><reading>...
+ *
+ * The target is a comma-separated list of power, voltage, temperature,
+ * and DDR DIMM targets.  A name may be qualified as 'power:<name>',
+ * 'voltage:<name>', 'temp:<name>', or 'ddr:<name>' where it's ambiguous,
+ * a bare 'power', 'voltage', 'temp', or 'ddr' stands for all targets of
+ * that kind, and 'all' for every one of them.  Targets the board reads
+ * through a 'Terminate' constraint can't be watched, so they're refused
+ * by name and left out of the others.
+ *
+ * Each subscription is served by its own thread, which owns the client
+ * until the client sends another request or closes the connection.  The
+ * I2C buses are opened once for the whole subscription, INA226s are
+ * calibrated and the VOUT_MODE of regulators is read on the first sample
+ * only, and later samples just read the measurement registers.  Every
+ * sample holds the buses it reads, so it's serialized with commands that
+ * access the same devices.  The targets are read in the order of
+ * I2C_Order(), to switch muxes as little as possible, and printed in the
+ * order they were given.
+ */
+#define WATCH_INTERVAL		1000	/* In milliseconds */
+#define WATCH_INTERVAL_MIN	10
+
+typedef struct {
+	Request_t	*Request;
+	int	Interval;
+	int	Target_Numbers;
+	Sensor_t	*Target;
+	const char	**Buses;
+	int	*Order;
+	int	*Status;
+	float	(*Value)[SENSOR_VALUES_MAX];
+} Watch_t;
+
+/*
+ * Add the target unless it's there already.  Returns -1 if it can't be
+ * watched.
+ */
+static int
+Add_Target(Watch_t *Watch, Sensor_Type_t Type, const char *Name,
+	   const char *I2C_Bus, void *Device)
+{
+	Sensor_t *Target;
+
+	if (Sensor_Constrained(Type, Name)) {
+		return -1;
+	}
+
+	for (int i = 0; i < Watch->Target_Numbers; i++) {
+		if (Watch->Target[i].Device == Device) {
+			return 0;
+		}
+	}
+
+	Watch->Buses[Watch->Target_Numbers] = I2C_Bus;
+	Target = &Watch->Target[Watch->Target_Numbers++];
+	Target->Type = Type;
+	Target->Name = Name;
+	Target->I2C_Bus = I2C_Bus;
+	Target->Device = Device;
+	Target->FD = -1;
+	Add_Resource(Watch->Request, I2C_Bus);
+	return 0;
+}
+
+/*
+ * Add the targets of the given kind that match the name, or all of them
+ * that can be watched if there is no name.  Returns the number of
+ * matching targets, or -1 if the named one can't be watched.
+ */
+static int
+Add_Targets(Watch_t *Watch, Sensor_Type_t Type, const char *Name)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+	Temperature_t *Temperature = Plat_Devs->Temperature;
+	DIMMs_t *DIMMs = Plat_Devs->DIMMs;
+	int Count = 0;
+	int Ret = 0;
+
+	switch (Type) {
+	case SENSOR_POWER:
+		for (int i = 0; (INA226s != NULL) && (i < INA226s->Numbers); i++) {
+			if ((Name == NULL) || (strcmp(Name, INA226s->INA226[i].Name) == 0)) {
+				Ret = Add_Target(Watch, Type, INA226s->INA226[i].Name,
+						 INA226s->INA226[i].I2C_Bus,
+						 &INA226s->INA226[i]);
+				Count++;
+			}
+		}
+
+		break;
+	case SENSOR_VOLTAGE:
+		for (int i = 0; (Voltages != NULL) && (i < Voltages->Numbers); i++) {
+			if ((Name == NULL) || (strcmp(Name, Voltages->Voltage[i].Name) == 0)) {
+				Ret = Add_Target(Watch, Type, Voltages->Voltage[i].Name,
+						 Voltages->Voltage[i].I2C_Bus,
+						 &Voltages->Voltage[i]);
+				Count++;
+			}
+		}
+
+		break;
+	case SENSOR_TEMPERATURE:
+		if ((Temperature != NULL) &&
+		    ((Name == NULL) || (strcmp(Name, Temperature->Name) == 0))) {
+			Ret = Add_Target(Watch, Type, Temperature->Name, NULL,
+					 Temperature);
+			Count++;
+		}
+
+		break;
+	case SENSOR_DIMM:
+		for (int i = 0; (DIMMs != NULL) && (i < DIMMs->Numbers); i++) {
+			if ((Name == NULL) || (strcmp(Name, DIMMs->DIMM[i].Name) == 0)) {
+				Ret = Add_Target(Watch, Type, DIMMs->DIMM[i].Name,
+						 DIMMs->DIMM[i].I2C_Bus, &DIMMs->DIMM[i]);
+				Count++;
+			}
+		}
+
+		break;
+	default:
+		break;
+	}
+
+	if ((Name != NULL) && (Ret != 0)) {
+		SC_ERR("%s is read through a board constraint, it can't be watched",
+		       Name);
+		return -1;
+	}
+
+	return Count;
+}
+
+static int
+Parse_Targets(Watch_t *Watch, char *Targets)
+{
+	static const char *Kinds[] = { "power", "voltage", "temp", "ddr" };
+	char *Token, *Name;
+	char *Save_Ptr;
+	int Type;
+	int Count;
+
+	for (Token = strtok_r(Targets, ",", &Save_Ptr); Token != NULL;
+	     Token = strtok_r(NULL, ",", &Save_Ptr)) {
+		if (strcmp(Token, "all") == 0) {
+			for (Type = SENSOR_POWER; Type <= SENSOR_DIMM; Type++) {
+				(void) Add_Targets(Watch, Type, NULL);
+			}
+
+			continue;
+		}
+
+		Name = strchr(Token, ':');
+		if (Name != NULL) {
+			*Name++ = '\0';
+		}
+
+		for (Type = SENSOR_POWER; Type <= SENSOR_DIMM; Type++) {
+			if (strcmp(Token, Kinds[Type]) == 0) {
+				break;
+			}
+		}
+
+		if (Type <= SENSOR_DIMM) {
+			Count = Add_Targets(Watch, Type, Name);
+		} else if (Name == NULL) {
+			/* An unqualified name */
+			Count = 0;
+			for (Type = SENSOR_POWER; (Count == 0) && (Type <= SENSOR_DIMM); Type++) {
+				Count = Add_Targets(Watch, Type, Token);
+			}
+		} else {
+			Count = 0;
+		}
+
+		if (Count < 0) {
+			return -1;
+		} else if (Count == 0) {
+			SC_ERR("invalid watch target %s", Token);
+			return -1;
+		}
+	}
+
+	if (Watch->Target_Numbers == 0) {
+		SC_ERR("no watch target");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Print the readings of the target, labeled the same way as the command
+ * that reads it on its own.
+ */
+static void
+Print_Target(Sensor_t *Target, const char *Time, float *Value)
+{
+	Output_Begin(1);
+	Output_Number("time", NULL, Time);
+	Output_String("name", NULL, Target->Name);
+	switch (Target->Type) {
+	case SENSOR_POWER:
+		Output_Float("voltage", "Voltage(V)", 4, Value[0]);
+		Output_Float("current", "Current(A)", 4, Value[1]);
+		Output_Float("power", "Power(W)", 4, Value[2]);
+		break;
+	case SENSOR_VOLTAGE:
+		Output_Float("voltage", "Voltage(V)", 2, Value[0]);
+		break;
+	case SENSOR_TEMPERATURE:
+		Output_Float("temperature", "Temperature(C)", 1, Value[0]);
+		break;
+	case SENSOR_DIMM:
+		Output_Float("temperature", "Temperature(C)", 2, Value[0]);
+		break;
+	default:
+		break;
+	}
+
+	Output_End();
+}
+
+static long
+Now_Milliseconds(void)
+{
+	struct timespec Time;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &Time);
+	return ((Time.tv_sec * 1000) + (Time.tv_nsec / 1000000));
+}
+
+static void *
+Watch_Thread(void *Arg)
+{
+	Watch_t *Watch = Arg;
+	Request_t *Request = Watch->Request;
+	Client_t *Client = Request->Client;
+	struct pollfd Poll_FD;
+	struct timespec Time;
+	char Timestamp[STRLEN_MAX];
+	long Next, Now;
+	int Index;
+	int Ret = 0;
+
+	SC_Sink = &Client->Sink;
+	Poll_FD.fd = Client->FD;
+	Poll_FD.events = POLLIN;
+	I2C_Order(Watch->Buses, Watch->Target_Numbers, Watch->Order);
+	Next = Now_Milliseconds();
+	for (int Sample = 0; ; Sample++) {
+		Worker_Acquire(Request);
+		if (Sample == 0) {
+			Ret = Sensor_Open(Watch->Target, Watch->Target_Numbers);
+			for (int i = 0; (Ret == 0) && (i < Watch->Target_Numbers); i++) {
+				Ret = Sensor_Setup(&Watch->Target[i]);
+			}
+		}
+
+		(void) clock_gettime(CLOCK_REALTIME, &Time);
+		(void) sprintf(Timestamp, "%ld.%03ld", (long)Time.tv_sec,
+			       (Time.tv_nsec / 1000000));
+		for (int i = 0; (Ret == 0) && (i < Watch->Target_Numbers); i++) {
+			Index = Watch->Order[i];
+			Watch->Status[Index] = Sensor_Read(&Watch->Target[Index],
+							   Watch->Value[Index]);
+		}
+
+		for (int i = 0; (Ret == 0) && (i < Watch->Target_Numbers); i++) {
+			if (Watch->Status[i] > 0) {
+				Print_Target(&Watch->Target[i], Timestamp, Watch->Value[i]);
+			}
+		}
+
+		Worker_Release(Request);
+		if (Ret == 0) {
+			I2C_Count_Saved(Watch->Buses, Watch->Target_Numbers, Watch->Order);
+		}
+
+		if ((Ret != 0) || (Sink_Flush(&Client->Sink, NULL) != 0)) {
+			break;
+		}
+
+		/* The client has already sent another request, or hung up */
+		if ((Client->Length > 0) || Client->Eof) {
+			break;
+		}
+
+		Next += Watch->Interval;
+		Now = Now_Milliseconds();
+		if (Next < Now) {
+			/* Skip the samples that have been missed */
+			Next = Now;
+		}
+
+		if (poll(&Poll_FD, 1, (Next - Now)) != 0) {
+			break;
+		}
+	}
+
+	Sensor_Close(Watch->Target, Watch->Target_Numbers);
+	SC_Sink = NULL;
+	Client->Status = Ret;
+	free(Watch->Target);
+	free(Watch->Buses);
+	free(Watch->Order);
+	free(Watch->Status);
+	free(Watch->Value);
+	free(Watch);
+	free(Request);
+	Complete_Request(Client);
+	return NULL;
+}
+
+/*
+ * Called by the event loop for 'watch'.  Returns 1 if the subscription
+ * thread now owns the request and the client, or 0 if the request has
+ * been completed here.
+ */
+int
+Watch_Start(Request_t *Request)
+{
+	INA226s_t *INA226s = Plat_Devs->INA226s;
+	Voltages_t *Voltages = Plat_Devs->Voltages;
+	DIMMs_t *DIMMs = Plat_Devs->DIMMs;
+	Watch_t *Watch;
+	pthread_t Thread;
+	char *End;
+	int Size;
+	int Ret;
+
+	if (Request->T_Flag == 0) {
+		SC_ERR("no watch target");
+		return 0;
+	}
+
+	Watch = calloc(1, sizeof(Watch_t));
+	if (Watch == NULL) {
+		SC_ERR("failed to allocate watch: %m");
+		return 0;
+	}
+
+	Watch->Request = Request;
+	Request->Priority = PRIORITY_HIGH;
+	Watch->Interval = WATCH_INTERVAL;
+	if (Request->V_Flag) {
+		Watch->Interval = strtol(Request->Value_Arg, &End, 10);
+		if ((*End != '\0') || (Watch->Interval < WATCH_INTERVAL_MIN)) {
+			SC_ERR("invalid watch interval, the minimum is %d ms",
+			       WATCH_INTERVAL_MIN);
+			goto Out;
+		}
+	}
+
+	Size = 1 + ((INA226s != NULL) ? INA226s->Numbers : 0) +
+	       ((Voltages != NULL) ? Voltages->Numbers : 0) +
+	       ((DIMMs != NULL) ? DIMMs->Numbers : 0);
+	Watch->Target = calloc(Size, sizeof(Sensor_t));
+	Watch->Buses = calloc(Size, sizeof(char *));
+	Watch->Order = calloc(Size, sizeof(int));
+	Watch->Status = calloc(Size, sizeof(int));
+	Watch->Value = calloc(Size, sizeof(*Watch->Value));
+	if ((Watch->Target == NULL) || (Watch->Buses == NULL) ||
+	    (Watch->Order == NULL) || (Watch->Status == NULL) ||
+	    (Watch->Value == NULL)) {
+		SC_ERR("failed to allocate watch targets: %m");
+		goto Out;
+	}
+
+	if (Parse_Targets(Watch, Request->Target_Arg) != 0) {
+		goto Out;
+	}
+
+	Ret = pthread_create(&Thread, NULL, Watch_Thread, Watch);
+	if (Ret != 0) {
+		SC_ERR("failed to create watch thread: %s", strerror(Ret));
+		goto Out;
+	}
+
+	(void) pthread_detach(Thread);
+	return 1;
+
+Out:
+	free(Watch->Target);
+	free(Watch->Buses);
+	free(Watch->Order);
+	free(Watch->Status);
+	free(Watch->Value);
+	free(Watch);
+	return 0;
+}
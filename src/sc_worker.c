@@ -0,0 +1,542 @@
+/*
+ * Copyright (c) 2024 Advanced Micro Devices, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sc_app.h"
+
+/*
+ * Worker Pool
+ *
+ * Requests are queued in the order they're received and run by a pool
+ * of worker threads.  A queued request is picked up once none of its
+ * resources are held by a running request, or wanted by a request that
+ * was queued before it.  So commands that access different devices, and
+ * so different I2C buses, run in parallel, while conflicting commands
+ * run in order.
+ *
+ * Each request has a priority, see Command_Priority(), and the highest
+ * priority request that is free to run is picked first.  A request is
+ * only held up by earlier requests of the same or a higher priority, so
+ * e.g. reading a regulator doesn't wait behind reading a whole EEPROM on
+ * the same bus.  A lower priority request that has waited for longer
+ * than WORKER_AGING holds up later requests again, so it isn't starved.
+ *
+ * A long running request may also call Worker_Yield() between the steps
+ * of a bulk transfer, to let PRIORITY_HIGH requests that want its
+ * resources run in the meantime.  The yielding worker keeps its thread,
+ * so it only yields to requests that an idle worker is left to run, or
+ * that are run by a thread of their own, see Worker_Acquire(); otherwise
+ * every worker could end up waiting on requests that none is free to run.
+ */
+#define WORKERS_MAX	4
+#define WORKER_AGING	1000000000LL	/* In nanoseconds */
+
+typedef struct {
+	unsigned long long	Requests;
+	unsigned long long	Yields;
+	unsigned long long	Wait_Sum;	/* In microseconds */
+	unsigned int	Wait_Max;
+} Queue_Stats_t;
+
+static const char *Priority_Names[PRIORITIES] = {
+	"bulk", "normal", "high",
+};
+
+static pthread_mutex_t Pool_Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Pool_Cond = PTHREAD_COND_INITIALIZER;
+static Request_t *Pending;
+static Request_t *Running;
+static int Idle_Workers;
+static Queue_Stats_t Queue_Stats[PRIORITIES];
+static __thread Request_t *Current_Request;
+
+/*
+ * RESOURCE_ALL conflicts with every resource, and a resource such as
+ * RESOURCE_GPIO conflicts with its sub-resources, e.g. "gpio:<line>".
+ */
+static int
+Resource_Conflict(const char *A, const char *B)
+{
+	size_t Length;
+
+	if ((strcmp(A, RESOURCE_ALL) == 0) || (strcmp(B, RESOURCE_ALL) == 0) ||
+	    (strcmp(A, B) == 0)) {
+		return 1;
+	}
+
+	Length = strlen(A);
+	if ((strncmp(A, B, Length) == 0) && (B[Length] == ':')) {
+		return 1;
+	}
+
+	Length = strlen(B);
+	if ((strncmp(A, B, Length) == 0) && (A[Length] == ':')) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+Request_Conflict(Request_t *A, Request_t *B)
+{
+	for (int i = 0; i < A->Resource_Numbers; i++) {
+		for (int j = 0; j < B->Resource_Numbers; j++) {
+			if (Resource_Conflict(A->Resources[i], B->Resources[j])) {
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * A pending request is free to run once none of its resources are held
+ * by a running request or wanted by an earlier pending one.  A running
+ * request that yields only makes way for PRIORITY_HIGH requests, and an
+ * earlier request of a lower priority only holds it up once it's aged.
+ * Must be called with Pool_Lock held.
+ */
+static int
+Runnable(Request_t *Request, long long Now)
+{
+	Request_t *Other;
+
+	for (Other = Running; Other != NULL; Other = Other->Next) {
+		if (Other->Yielded && (Request->Priority == PRIORITY_HIGH) &&
+		    (Other->Priority != PRIORITY_HIGH)) {
+			continue;
+		}
+
+		if (Request_Conflict(Request, Other)) {
+			return 0;
+		}
+	}
+
+	for (Other = Pending; Other != Request; Other = Other->Next) {
+		if ((Other->Priority < Request->Priority) &&
+		    ((Now - Other->Queued) < WORKER_AGING)) {
+			continue;
+		}
+
+		if (Request_Conflict(Request, Other)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Unlink the highest priority pending request that is free to run,
+ * skipping those that are waited on by Worker_Acquire().  Must be called
+ * with Pool_Lock held.
+ */
+static Request_t *
+Next_Runnable(void)
+{
+	Request_t **Link, *Request;
+	long long Now = Stats_Time();
+
+	for (int Priority = PRIORITY_HIGH; Priority >= PRIORITY_BULK; Priority--) {
+		for (Link = &Pending; *Link != NULL; Link = &(*Link)->Next) {
+			Request = *Link;
+			if ((Request->Priority == Priority) && !Request->Held &&
+			    Runnable(Request, Now)) {
+				*Link = Request->Next;
+				return Request;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Move a dequeued request to the running ones, and count how long it
+ * waited in line.  Must be called with Pool_Lock held.
+ */
+static void
+Start_Request(Request_t *Request)
+{
+	Queue_Stats_t *Stats = &Queue_Stats[Request->Priority - PRIORITY_BULK];
+	long long Wait;
+
+	Wait = (Stats_Time() - Request->Queued) / 1000;
+	Stats->Requests++;
+	Stats->Wait_Sum += Wait;
+	if (Wait > Stats->Wait_Max) {
+		Stats->Wait_Max = ((Wait > 0xFFFFFFFF) ? 0xFFFFFFFF : Wait);
+	}
+
+	Request->Yielded = 0;
+	Request->Next = Running;
+	Running = Request;
+}
+
+/*
+ * Whether a PRIORITY_HIGH request is waiting for the resources of the
+ * running request, and would be free to run if it yielded, on an idle
+ * worker or on its own thread.  Must be called with Pool_Lock held.
+ */
+static int
+Preempted(Request_t *Request)
+{
+	Request_t *Other;
+	long long Now = Stats_Time();
+	int Yielded = Request->Yielded;
+	int Ret = 0;
+
+	Request->Yielded = 1;
+	for (Other = Pending; Other != NULL; Other = Other->Next) {
+		if ((Other->Priority == PRIORITY_HIGH) &&
+		    (Other->Held || (Idle_Workers > 0)) &&
+		    Request_Conflict(Request, Other) && Runnable(Other, Now)) {
+			Ret = 1;
+			break;
+		}
+	}
+
+	Request->Yielded = Yielded;
+	return Ret;
+}
+
+/*
+ * Whether another running request holds any of the resources of the
+ * request.  Must be called with Pool_Lock held.
+ */
+static int
+Held_By_Other(Request_t *Request)
+{
+	for (Request_t *Other = Running; Other != NULL; Other = Other->Next) {
+		if ((Other != Request) && Request_Conflict(Request, Other)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void *
+Worker_Thread(void *Arg)
+{
+	Request_t **Link, *Request;
+	Client_t *Client;
+
+	while (1) {
+		(void) pthread_mutex_lock(&Pool_Lock);
+		while ((Request = Next_Runnable()) == NULL) {
+			Idle_Workers++;
+			(void) pthread_cond_wait(&Pool_Cond, &Pool_Lock);
+			Idle_Workers--;
+		}
+
+		Start_Request(Request);
+		(void) pthread_mutex_unlock(&Pool_Lock);
+
+		Current_Request = Request;
+		Run_Request(Request);
+		Current_Request = NULL;
+
+		(void) pthread_mutex_lock(&Pool_Lock);
+		for (Link = &Running; *Link != Request; Link = &(*Link)->Next);
+		*Link = Request->Next;
+		(void) pthread_cond_broadcast(&Pool_Cond);
+		(void) pthread_mutex_unlock(&Pool_Lock);
+
+		if (Request->Job != NULL) {
+			Job_Finish(Request);
+			free(Request);
+			continue;
+		}
+
+		Client = Request->Client;
+		Client->Status = Request->Status;
+		free(Request);
+		Complete_Request(Client);
+	}
+
+	return NULL;
+}
+
+/*
+ * Add a resource needed by the request.  If there are more resources than
+ * fit, the request falls back to needing all of them.
+ */
+void
+Add_Resource(Request_t *Request, const char *Resource)
+{
+	if (Resource == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < Request->Resource_Numbers; i++) {
+		if (strcmp(Request->Resources[i], Resource) == 0) {
+			return;
+		}
+	}
+
+	if (Request->Resource_Numbers == RESOURCES_MAX) {
+		Request->Resource_Numbers = 0;
+		Resource = RESOURCE_ALL;
+	}
+
+	(void) strncpy(Request->Resources[Request->Resource_Numbers], Resource,
+		       (STRLEN_MAX - 1));
+	Request->Resource_Numbers++;
+}
+
+/*
+ * Queue the request to be run by the worker pool, which takes over its
+ * ownership.
+ */
+void
+Worker_Submit(Request_t *Request)
+{
+	Request_t **Link;
+
+	Request->Next = NULL;
+	Request->Queued = Stats_Time();
+	(void) pthread_mutex_lock(&Pool_Lock);
+	for (Link = &Pending; *Link != NULL; Link = &(*Link)->Next);
+	*Link = Request;
+	(void) pthread_cond_broadcast(&Pool_Cond);
+	(void) pthread_mutex_unlock(&Pool_Lock);
+}
+
+/*
+ * Wait in line for the resources of the request like a queued request
+ * would, and then hold them for the calling thread, which isn't one of
+ * the pool's, until Worker_Release() is called.
+ */
+void
+Worker_Acquire(Request_t *Request)
+{
+	Request_t **Link;
+
+	Request->Held = 1;
+	Request->Next = NULL;
+	Request->Queued = Stats_Time();
+	(void) pthread_mutex_lock(&Pool_Lock);
+	for (Link = &Pending; *Link != NULL; Link = &(*Link)->Next);
+	*Link = Request;
+	while (!Runnable(Request, Stats_Time())) {
+		(void) pthread_cond_wait(&Pool_Cond, &Pool_Lock);
+	}
+
+	for (Link = &Pending; *Link != Request; Link = &(*Link)->Next);
+	*Link = Request->Next;
+	Start_Request(Request);
+	(void) pthread_mutex_unlock(&Pool_Lock);
+}
+
+void
+Worker_Release(Request_t *Request)
+{
+	Request_t **Link;
+
+	(void) pthread_mutex_lock(&Pool_Lock);
+	for (Link = &Running; *Link != Request; Link = &(*Link)->Next);
+	*Link = Request->Next;
+	(void) pthread_cond_broadcast(&Pool_Cond);
+	(void) pthread_mutex_unlock(&Pool_Lock);
+}
+
+/*
+ * Take the request off the queue if no worker has picked it up yet, in
+ * which case its ownership returns to the caller.  Returns 0 if the
+ * request has been dequeued, or -1 otherwise.
+ */
+int
+Worker_Cancel(Request_t *Request)
+{
+	Request_t **Link;
+	int Ret = -1;
+
+	(void) pthread_mutex_lock(&Pool_Lock);
+	for (Link = &Pending; *Link != NULL; Link = &(*Link)->Next) {
+		if (*Link == Request) {
+			*Link = Request->Next;
+			Ret = 0;
+			break;
+		}
+	}
+
+	/* Requests queued behind it may be able to run now */
+	(void) pthread_cond_broadcast(&Pool_Cond);
+	(void) pthread_mutex_unlock(&Pool_Lock);
+	return Ret;
+}
+
+/*
+ * Let PRIORITY_HIGH requests that are waiting for the resources of the
+ * request running on this thread go first, and resume once they're done.
+ * Must only be called where the devices of the request may be accessed
+ * by others, e.g. between the writes of a bulk transfer.  Does nothing on
+ * threads that aren't the pool's.
+ */
+void
+Worker_Yield(void)
+{
+	Request_t *Request = Current_Request;
+
+	if ((Request == NULL) || (Request->Priority == PRIORITY_HIGH)) {
+		return;
+	}
+
+	(void) pthread_mutex_lock(&Pool_Lock);
+	if (Preempted(Request)) {
+		Queue_Stats[Request->Priority - PRIORITY_BULK].Yields++;
+		Request->Yielded = 1;
+		(void) pthread_cond_broadcast(&Pool_Cond);
+		while (Preempted(Request) || Held_By_Other(Request)) {
+			(void) pthread_cond_wait(&Pool_Cond, &Pool_Lock);
+		}
+
+		Request->Yielded = 0;
+	}
+
+	(void) pthread_mutex_unlock(&Pool_Lock);
+}
+
+/*
+ * Print the requests waiting in line and the wait times of those that
+ * were picked up, per priority.
+ */
+void
+Worker_Print(void)
+{
+	Queue_Stats_t Copy[PRIORITIES];
+	int Depth[PRIORITIES] = { 0 };
+
+	(void) pthread_mutex_lock(&Pool_Lock);
+	(void) memcpy(Copy, Queue_Stats, sizeof(Copy));
+	for (Request_t *Request = Pending; Request != NULL; Request = Request->Next) {
+		Depth[Request->Priority - PRIORITY_BULK]++;
+	}
+
+	(void) pthread_mutex_unlock(&Pool_Lock);
+	for (int i = (PRIORITIES - 1); i >= 0; i--) {
+		Output_Begin(1);
+		Output_String("queue", NULL, Priority_Names[i]);
+		Output_Int("depth", "Depth", Depth[i]);
+		Output_Int("requests", "Requests", Copy[i].Requests);
+		Output_Int("mean_wait_us", "Mean Wait(us)",
+			   ((Copy[i].Requests != 0) ? (Copy[i].Wait_Sum / Copy[i].Requests) : 0));
+		Output_Int("max_wait_us", "Max Wait(us)", Copy[i].Wait_Max);
+		Output_Int("yields", "Yields", Copy[i].Yields);
+		Output_End();
+	}
+}
+
+void
+Worker_Reset(void)
+{
+	(void) pthread_mutex_lock(&Pool_Lock);
+	(void) memset(Queue_Stats, 0, sizeof(Queue_Stats));
+	(void) pthread_mutex_unlock(&Pool_Lock);
+}
+
+/*
+ * Append the queue statistics to the sink of this thread in the
+ * OpenMetrics text format, along with the number of pending requests that
+ * want each resource, e.g. I2C bus.
+ */
+void
+Worker_Export(void)
+{
+	Queue_Stats_t Copy[PRIORITIES];
+	int Depth[PRIORITIES] = { 0 };
+	char (*Resource)[STRLEN_MAX];
+	int *Count;
+	int Numbers = 0;
+	int Size = 0;
+	int j;
+
+	(void) pthread_mutex_lock(&Pool_Lock);
+	(void) memcpy(Copy, Queue_Stats, sizeof(Copy));
+	for (Request_t *Request = Pending; Request != NULL; Request = Request->Next) {
+		Depth[Request->Priority - PRIORITY_BULK]++;
+		Size += Request->Resource_Numbers;
+	}
+
+	Resource = malloc((Size + 1) * STRLEN_MAX);
+	Count = calloc((Size + 1), sizeof(int));
+	for (Request_t *Request = Pending; (Resource != NULL) && (Count != NULL) &&
+	     (Request != NULL); Request = Request->Next) {
+		for (int i = 0; i < Request->Resource_Numbers; i++) {
+			for (j = 0; j < Numbers; j++) {
+				if (strcmp(Resource[j], Request->Resources[i]) == 0) {
+					break;
+				}
+			}
+
+			if (j == Numbers) {
+				(void) strcpy(Resource[Numbers++], Request->Resources[i]);
+			}
+
+			Count[j]++;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&Pool_Lock);
+
+	Sink_Printf("# TYPE sc_worker_queue_depth gauge\n");
+	Sink_Printf("# HELP sc_worker_queue_depth Requests waiting for a worker.\n");
+	for (int i = 0; i < PRIORITIES; i++) {
+		Sink_Printf("sc_worker_queue_depth{priority=\"%s\"} %d\n",
+			    Priority_Names[i], Depth[i]);
+	}
+
+	Sink_Printf("# TYPE sc_worker_resource_queue_depth gauge\n");
+	Sink_Printf("# HELP sc_worker_resource_queue_depth Requests waiting that want the resource.\n");
+	for (int i = 0; (Resource != NULL) && (Count != NULL) && (i < Numbers); i++) {
+		Sink_Printf("sc_worker_resource_queue_depth{resource=\"%s\"} %d\n",
+			    Resource[i], Count[i]);
+	}
+
+	Sink_Printf("# TYPE sc_worker_wait_seconds summary\n");
+	Sink_Printf("# HELP sc_worker_wait_seconds Time requests waited for a worker.\n");
+	for (int i = 0; i < PRIORITIES; i++) {
+		Sink_Printf("sc_worker_wait_seconds_count{priority=\"%s\"} %llu\n",
+			    Priority_Names[i], Copy[i].Requests);
+		Sink_Printf("sc_worker_wait_seconds_sum{priority=\"%s\"} %.6f\n",
+			    Priority_Names[i], (Copy[i].Wait_Sum / 1000000.0));
+	}
+
+	Sink_Printf("# TYPE sc_worker_yields counter\n");
+	Sink_Printf("# HELP sc_worker_yields Times requests made way for high priority ones.\n");
+	for (int i = 0; i < PRIORITIES; i++) {
+		Sink_Printf("sc_worker_yields_total{priority=\"%s\"} %llu\n",
+			    Priority_Names[i], Copy[i].Yields);
+	}
+
+	free(Resource);
+	free(Count);
+}
+
+int
+Worker_Init(void)
+{
+	pthread_t Thread;
+	int Ret;
+
+	for (int i = 0; i < WORKERS_MAX; i++) {
+		Ret = pthread_create(&Thread, NULL, Worker_Thread, NULL);
+		if (Ret != 0) {
+			SC_ERR("failed to create worker thread: %s", strerror(Ret));
+			return -1;
+		}
+
+		(void) pthread_detach(Thread);
+	}
+
+	return 0;
+}